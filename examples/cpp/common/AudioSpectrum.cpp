@@ -0,0 +1,59 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#include "Common.h"
+#include "AudioSpectrum.h"
+
+// Matches the defaults of the WebAudio AnalyserNode that shadertoy uses, so
+// that existing music visualisations look the way their authors intended
+static const float SMOOTHING = 0.8f;
+static const float MIN_DECIBELS = -100.0f;
+static const float MAX_DECIBELS = -30.0f;
+
+AudioSpectrum::AudioSpectrum() : window(FFT_SIZE), buffer(FFT_SIZE), smoothed(BINS, 0.0f) {
+  // Blackman window, as used by the WebAudio analyser
+  for (size_t i = 0; i < FFT_SIZE; ++i) {
+    float x = (float)i / (float)FFT_SIZE;
+    window[i] = 0.42f - 0.5f * cos(2.0f * PI * x) + 0.08f * cos(4.0f * PI * x);
+  }
+}
+
+void AudioSpectrum::analyze(const std::vector<float> & samples, size_t position, TextureData & out) {
+  size_t count = samples.size();
+  size_t first = (position + count - (FFT_SIZE % count)) % count;
+  for (size_t i = 0; i < FFT_SIZE; ++i) {
+    buffer[i] = Fft::Complex(samples[(first + i) % count] * window[i], 0.0f);
+  }
+  fft.transform(&buffer[0]);
+
+  static const float DECIBEL_SCALE = 255.0f / (MAX_DECIBELS - MIN_DECIBELS);
+  for (size_t i = 0; i < BINS; ++i) {
+    float magnitude = std::abs(buffer[i]) / FFT_SIZE;
+    smoothed[i] = SMOOTHING * smoothed[i] + (1.0f - SMOOTHING) * magnitude;
+    float decibels = smoothed[i] > 0 ? 20.0f * log10(smoothed[i]) : MIN_DECIBELS;
+    out[i] = (uint8_t)glm::clamp((decibels - MIN_DECIBELS) * DECIBEL_SCALE, 0.0f, 255.0f);
+  }
+
+  // The waveform is the most recent half of the block
+  for (size_t i = 0; i < BINS; ++i) {
+    float sample = samples[(first + BINS + i) % count];
+    out[BINS + i] = (uint8_t)glm::clamp(128.0f * (1.0f + sample), 0.0f, 255.0f);
+  }
+}
@@ -0,0 +1,78 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+#include "Fft.h"
+
+// Destination for the decoded audio of a music channel.  The sink owns the
+// playback clock, so the spectrum shown to the shader follows whatever is
+// actually being heard.
+class AudioSink {
+public:
+  virtual ~AudioSink() {}
+  // Called once, from the analysis thread, with the whole decoded (mono)
+  // track.  The sink should loop it until destroyed.
+  virtual void start(const std::vector<float> & samples, int sampleRate) = 0;
+  // The current playback position in seconds, not wrapped to the track length
+  virtual double getPosition() const = 0;
+};
+
+typedef std::shared_ptr<AudioSink> AudioSinkPtr;
+
+// Plays nothing, just advances the playback clock in real time.  Used when
+// there's no audio output, and anywhere deterministic timing is wanted.
+class NullAudioSink : public AudioSink {
+  typedef std::chrono::high_resolution_clock Clock;
+  Clock::time_point startTime;
+
+public:
+  virtual void start(const std::vector<float> & samples, int sampleRate) {
+    startTime = Clock::now();
+  }
+
+  virtual double getPosition() const {
+    return std::chrono::duration<double>(Clock::now() - startTime).count();
+  }
+};
+
+// Turns a block of a track into what shadertoy gives music visualisations:
+// 512x2 bytes with the frequency spectrum in the first row and the waveform
+// in the second, in the same scale and with the same smoothing as the
+// WebAudio analyser it uses.
+class AudioSpectrum {
+public:
+  static const size_t BINS = 512;
+  static const size_t FFT_SIZE = BINS * 2;
+  typedef std::array<uint8_t, BINS * 2> TextureData;
+
+  AudioSpectrum();
+
+  // Analyzes the block of samples ending at position, wrapping back around
+  // to the start of the track.  The spectrum is smoothed with the previous
+  // calls.
+  void analyze(const std::vector<float> & samples, size_t position, TextureData & out);
+
+private:
+  Fft fft{ FFT_SIZE };
+  std::vector<float> window;
+  std::vector<Fft::Complex> buffer;
+  std::vector<float> smoothed;
+};
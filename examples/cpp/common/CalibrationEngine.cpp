@@ -0,0 +1,482 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+#include "CalibrationEngine.h"
+
+#ifdef HAVE_OPENCV
+#include <cfloat>
+#include <fstream>
+
+namespace {
+  const char REMAP_MAGIC[4] = { 'R', 'M', 'A', 'P' };
+  const int32_t REMAP_VERSION = 1;
+
+  double millisSince(const std::chrono::high_resolution_clock::time_point & start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  }
+}
+
+CalibrationEngine::CalibrationEngine() {
+  start();
+}
+
+CalibrationEngine::CalibrationEngine(const Settings & settings) : settings(settings) {
+  start();
+}
+
+CalibrationEngine::~CalibrationEngine() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    quit = true;
+  }
+  jobAvailable.notify_all();
+  jobTaken.notify_all();
+  solveNeeded.notify_all();
+  for (std::thread & worker : workers) {
+    worker.join();
+  }
+  solver.join();
+}
+
+void CalibrationEngine::start() {
+  for (int i = 0; i < settings.boardSize.height; ++i) {
+    for (int j = 0; j < settings.boardSize.width; ++j) {
+      boardPoints.push_back(cv::Point3f(j * settings.squareSize, i * settings.squareSize, 0));
+    }
+  }
+  coverage = cv::Mat::zeros(settings.coverageGrid, CV_32S);
+  for (int i = 0; i < std::max(1, settings.workers); ++i) {
+    workers.push_back(std::thread([this] { workerLoop(); }));
+  }
+  solver = std::thread([this] { solverLoop(); });
+}
+
+bool CalibrationEngine::submit(const cv::Mat & image, double timestamp, bool wait) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ++stats.submitted;
+    if ((int)jobs.size() >= settings.maxPending) {
+      if (!wait) {
+        ++stats.dropped;
+        return false;
+      }
+      jobTaken.wait(lock, [&] {
+        return quit || (int)jobs.size() < settings.maxPending;
+      });
+    }
+  }
+
+  // Copy outside the lock so the workers aren't held up.  Another caller
+  // could fill the queue in the meantime, which only means it briefly holds
+  // one more frame than it should.
+  Job job;
+  job.timestamp = timestamp;
+  job.image = image.clone();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (image.size() != imageSize) {
+    // The views from frames of a different size are meaningless now
+    resetLocked();
+    imageSize = image.size();
+  }
+  job.index = nextIndex++;
+  jobs.push_back(job);
+  lock.unlock();
+  jobAvailable.notify_one();
+  return true;
+}
+
+void CalibrationEngine::waitForIdle() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [&] {
+    bool solvePending = viewsChanged && (int)views.size() >= settings.minViews;
+    return jobs.empty() && 0 == busyWorkers && !solving && !solvePending;
+  });
+}
+
+void CalibrationEngine::setAccepting(bool accepting) {
+  std::unique_lock<std::mutex> lock(mutex);
+  this->accepting = accepting;
+}
+
+void CalibrationEngine::reset() {
+  std::unique_lock<std::mutex> lock(mutex);
+  resetLocked();
+}
+
+void CalibrationEngine::resetLocked() {
+  views.clear();
+  coverage.setTo(0);
+  detection = Detection();
+  // Keep counting generations, so anything caching the calibration sees
+  // the next one as new
+  uint64_t generation = calibration.generation;
+  calibration = Calibration();
+  calibration.generation = generation;
+  viewsChanged = false;
+  ++resets;
+}
+
+bool CalibrationEngine::getDetection(Detection & result) const {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (0 == detection.index) {
+    return false;
+  }
+  result = detection;
+  return true;
+}
+
+CalibrationEngine::Calibration CalibrationEngine::getCalibration() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return calibration;
+}
+
+std::vector<CalibrationEngine::View> CalibrationEngine::getViews() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return views;
+}
+
+CalibrationEngine::Stats CalibrationEngine::getStats() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return stats;
+}
+
+float CalibrationEngine::getCoverage() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return (float)cv::countNonZero(coverage) / coverage.total();
+}
+
+void CalibrationEngine::drawCoverage(cv::Mat & image) const {
+  cv::Mat counts;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    counts = coverage.clone();
+  }
+  for (int y = 0; y < counts.rows; ++y) {
+    for (int x = 0; x < counts.cols; ++x) {
+      cv::Rect cell(x * image.cols / counts.cols, y * image.rows / counts.rows,
+        image.cols / counts.cols, image.rows / counts.rows);
+      int count = counts.at<int>(y, x);
+      // Red where the board still needs to go, greener the more views
+      // have covered a cell
+      cv::Scalar color = count ? cv::Scalar(0, 255, 0) : cv::Scalar(0, 0, 255);
+      double weight = count ? 0.1 * std::min(count, 4) : 0.15;
+      cv::Mat roi = image(cell);
+      cv::Mat tint(roi.size(), roi.type(), color);
+      cv::addWeighted(roi, 1.0 - weight, tint, weight, 0, roi);
+    }
+  }
+}
+
+void CalibrationEngine::workerLoop() {
+  Profiler::setThreadName("Calibration worker");
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    jobAvailable.wait(lock, [&] {
+      return quit || !jobs.empty();
+    });
+    if (quit) {
+      break;
+    }
+    Job job = jobs.front();
+    jobs.pop_front();
+    ++busyWorkers;
+    uint64_t startResets = resets;
+    lock.unlock();
+    jobTaken.notify_one();
+
+    View view;
+    view.index = job.index;
+    view.timestamp = job.timestamp;
+    double detectMillis = 0, refineMillis = 0;
+    bool found;
+    {
+      PROFILE_SCOPE("Find board");
+      found = findBoard(job.image, view.corners, detectMillis, refineMillis);
+      if (found) {
+        view.pose = describePose(view.corners, settings.boardSize, job.image.size());
+      }
+    }
+
+    lock.lock();
+    stats.detect.add(detectMillis);
+    bool accepted = false;
+    if (found) {
+      ++stats.found;
+      stats.refine.add(refineMillis);
+      // The engine was reset while the frame was being searched
+      if (startResets == resets && accepting) {
+        accepted = score(view);
+        ++(accepted ? stats.accepted : stats.rejected);
+      }
+    }
+    // Workers can finish out of order, and the preview wants the latest
+    if (startResets == resets && job.index > detection.index) {
+      detection.index = job.index;
+      detection.found = found;
+      detection.accepted = accepted;
+      detection.view = view;
+    }
+    --busyWorkers;
+    if (accepted) {
+      solveNeeded.notify_one();
+    }
+    idle.notify_all();
+  }
+}
+
+bool CalibrationEngine::findBoard(const cv::Mat & image, std::vector<cv::Point2f> & corners,
+  double & detectMillis, double & refineMillis) const {
+  auto start = std::chrono::high_resolution_clock::now();
+  cv::Mat gray;
+  if (image.channels() == 3) {
+    cv::cvtColor(image, gray, CV_BGR2GRAY);
+  } else {
+    gray = image;
+  }
+
+  // The search for the board is by far the most expensive part, and
+  // doesn't need the full resolution to find it
+  double scale = std::min(1.0, (double)settings.detectionWidth / gray.cols);
+  cv::Mat small = gray;
+  if (scale < 1.0) {
+    cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+  }
+  bool found = cv::findChessboardCorners(small, settings.boardSize, corners,
+    CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE);
+  detectMillis = millisSince(start);
+  if (!found) {
+    return false;
+  }
+
+  start = std::chrono::high_resolution_clock::now();
+  // Pixel centers are at integer coordinates in both images
+  float inverse = (float)(1.0 / scale);
+  float offset = 0.5f * (inverse - 1.0f);
+  float spacing = FLT_MAX;
+  for (size_t i = 0; i < corners.size(); ++i) {
+    corners[i] = corners[i] * inverse + cv::Point2f(offset, offset);
+    if (i % settings.boardSize.width) {
+      spacing = std::min(spacing, (float)cv::norm(corners[i] - corners[i - 1]));
+    }
+  }
+  // The window has to cover the error from the downscaled search, but stay
+  // clear of the neighbouring corners
+  int window = std::max(2, std::min(11, (int)(spacing / 2.0f) - 1));
+  cv::cornerSubPix(gray, corners, cv::Size(window, window), cv::Size(-1, -1),
+    cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.01));
+  refineMillis = millisSince(start);
+  return true;
+}
+
+cv::Vec<float, 5> CalibrationEngine::describePose(const std::vector<cv::Point2f> & corners,
+  const cv::Size & boardSize, const cv::Size & imageSize) {
+  int w = boardSize.width, h = boardSize.height;
+  const cv::Point2f & topLeft = corners[0];
+  const cv::Point2f & topRight = corners[w - 1];
+  const cv::Point2f & bottomRight = corners[w * h - 1];
+  const cv::Point2f & bottomLeft = corners[(h - 1) * w];
+  cv::Point2f center = (topLeft + topRight + bottomRight + bottomLeft) * 0.25f;
+  std::vector<cv::Point2f> outline = { topLeft, topRight, bottomRight, bottomLeft };
+  float area = (float)cv::contourArea(outline);
+  float top = (float)cv::norm(topRight - topLeft), bottom = (float)cv::norm(bottomRight - bottomLeft);
+  float left = (float)cv::norm(bottomLeft - topLeft), right = (float)cv::norm(bottomRight - topRight);
+  return cv::Vec<float, 5>(
+    center.x / imageSize.width, center.y / imageSize.height,
+    sqrt(area / imageSize.area()),
+    log(std::max(top, 1.0f) / std::max(bottom, 1.0f)),
+    log(std::max(left, 1.0f) / std::max(right, 1.0f)));
+}
+
+float CalibrationEngine::poseDistance(const cv::Vec<float, 5> & a, const cv::Vec<float, 5> & b) {
+  return (float)cv::norm(a - b);
+}
+
+cv::Point CalibrationEngine::cellOf(const cv::Point2f & point) const {
+  int x = (int)(point.x * coverage.cols / imageSize.width);
+  int y = (int)(point.y * coverage.rows / imageSize.height);
+  return cv::Point(std::max(0, std::min(coverage.cols - 1, x)), std::max(0, std::min(coverage.rows - 1, y)));
+}
+
+bool CalibrationEngine::score(View & view) {
+  int uncovered = 0;
+  for (const cv::Point2f & corner : view.corners) {
+    if (0 == coverage.at<int>(cellOf(corner))) {
+      ++uncovered;
+    }
+  }
+  view.newCoverage = (float)uncovered / view.corners.size();
+  view.distance = FLT_MAX;
+  for (const View & other : views) {
+    view.distance = std::min(view.distance, poseDistance(view.pose, other.pose));
+  }
+  if (!views.empty() && view.newCoverage < settings.minNewCoverage && view.distance < settings.minPoseDistance) {
+    return false;
+  }
+
+  // Each view counts once per cell
+  cv::Mat touched = cv::Mat::zeros(coverage.size(), CV_8U);
+  for (const cv::Point2f & corner : view.corners) {
+    touched.at<uint8_t>(cellOf(corner)) = 1;
+  }
+  for (int y = 0; y < coverage.rows; ++y) {
+    for (int x = 0; x < coverage.cols; ++x) {
+      coverage.at<int>(y, x) += touched.at<uint8_t>(y, x);
+    }
+  }
+  views.push_back(view);
+  viewsChanged = true;
+  return true;
+}
+
+void CalibrationEngine::solverLoop() {
+  Profiler::setThreadName("Calibration solver");
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    solveNeeded.wait(lock, [&] {
+      return quit || (viewsChanged && (int)views.size() >= settings.minViews);
+    });
+    if (quit) {
+      break;
+    }
+    // Views accepted while solving are picked up by the next solve, so a
+    // burst of them only costs one extra solve
+    viewsChanged = false;
+    solving = true;
+    std::vector<std::vector<cv::Point2f> > imagePoints;
+    for (const View & view : views) {
+      imagePoints.push_back(view.corners);
+    }
+    Calibration previous = calibration;
+    cv::Size size = imageSize;
+    uint64_t startResets = resets;
+    lock.unlock();
+
+    Calibration result;
+    result.imageSize = size;
+    result.views = (int)imagePoints.size();
+    int flags = settings.flags;
+    if (previous.valid && previous.imageSize == size) {
+      // Each solve only adds a view or two, so the last solution is a good
+      // place to start from
+      result.cameraMatrix = previous.cameraMatrix.clone();
+      result.distCoeffs = previous.distCoeffs.clone();
+      flags |= CV_CALIB_USE_INTRINSIC_GUESS;
+    } else {
+      result.cameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+      result.distCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+    }
+    std::vector<std::vector<cv::Point3f> > objectPoints(imagePoints.size(), boardPoints);
+    std::vector<cv::Mat> rvecs, tvecs;
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+      PROFILE_SCOPE("Solve calibration");
+      result.rmsError = cv::calibrateCamera(objectPoints, imagePoints, size,
+        result.cameraMatrix, result.distCoeffs, rvecs, tvecs, flags);
+    }
+    double solveMillis = millisSince(start);
+    result.valid = cv::checkRange(result.cameraMatrix) && cv::checkRange(result.distCoeffs);
+
+    lock.lock();
+    stats.solve.add(solveMillis);
+    if (result.valid && startResets == resets) {
+      result.generation = calibration.generation + 1;
+      calibration = result;
+    }
+    solving = false;
+    idle.notify_all();
+  }
+}
+
+bool CalibrationEngine::save(const Calibration & calibration, const Settings & settings, const std::string & path) {
+  if (!calibration.valid) {
+    return false;
+  }
+  cv::FileStorage fs(path, cv::FileStorage::WRITE);
+  if (!fs.isOpened()) {
+    return false;
+  }
+  time_t now = time(nullptr);
+  char buffer[1024];
+  strftime(buffer, sizeof(buffer) - 1, "%c", localtime(&now));
+  fs << "calibration_Time" << buffer;
+  fs << "nrOfFrames" << calibration.views;
+  fs << "image_Width" << calibration.imageSize.width;
+  fs << "image_Height" << calibration.imageSize.height;
+  fs << "board_Width" << settings.boardSize.width;
+  fs << "board_Height" << settings.boardSize.height;
+  fs << "square_Size" << settings.squareSize;
+  fs << "flagValue" << settings.flags;
+  fs << "Camera_Matrix" << calibration.cameraMatrix;
+  fs << "Distortion_Coefficients" << calibration.distCoeffs;
+  fs << "Avg_Reprojection_Error" << calibration.rmsError;
+  return true;
+}
+
+bool CalibrationEngine::exportRemap(const Calibration & calibration, const std::string & path, double alpha) {
+  if (!calibration.valid) {
+    return false;
+  }
+  const cv::Size & size = calibration.imageSize;
+  cv::Mat newMatrix = cv::getOptimalNewCameraMatrix(calibration.cameraMatrix,
+    calibration.distCoeffs, size, alpha, size, 0);
+  cv::Mat map, unused;
+  cv::initUndistortRectifyMap(calibration.cameraMatrix, calibration.distCoeffs, cv::Mat(),
+    newMatrix, size, CV_32FC2, map, unused);
+
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!out) {
+    return false;
+  }
+  int32_t header[3] = { REMAP_VERSION, size.width, size.height };
+  out.write(REMAP_MAGIC, sizeof(REMAP_MAGIC));
+  out.write((const char *)header, sizeof(header));
+  cv::Mat matrix;
+  newMatrix.convertTo(matrix, CV_64F);
+  out.write((const char *)matrix.ptr<double>(), 9 * sizeof(double));
+  for (int y = 0; y < map.rows; ++y) {
+    out.write((const char *)map.ptr<cv::Vec2f>(y), map.cols * sizeof(cv::Vec2f));
+  }
+  return out.good();
+}
+
+bool CalibrationEngine::loadRemap(const std::string & path, cv::Mat & map, cv::Mat & cameraMatrix) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char magic[4];
+  int32_t header[3];
+  if (!in.read(magic, sizeof(magic)) || 0 != memcmp(magic, REMAP_MAGIC, sizeof(magic)) ||
+    !in.read((char *)header, sizeof(header)) || REMAP_VERSION != header[0] ||
+    header[1] <= 0 || header[2] <= 0) {
+    return false;
+  }
+  cameraMatrix.create(3, 3, CV_64F);
+  map.create(header[2], header[1], CV_32FC2);
+  if (!in.read((char *)cameraMatrix.ptr<double>(), 9 * sizeof(double))) {
+    return false;
+  }
+  for (int y = 0; y < map.rows; ++y) {
+    if (!in.read((char *)map.ptr<cv::Vec2f>(y), map.cols * sizeof(cv::Vec2f))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
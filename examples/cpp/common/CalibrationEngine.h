@@ -0,0 +1,198 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+#ifdef HAVE_OPENCV
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+
+// Calibrates a camera from a stream of checkerboard views without holding
+// up the caller.  Frames are handed to a pool of worker threads, which find
+// the board in a downscaled copy and then refine the corners in the full
+// resolution image.  Each view is scored by how much it adds to the
+// coverage of the image and the spread of board poses, and redundant views
+// are rejected, so the user can keep waving the board around without
+// swamping the solver with near duplicates.  Every time views are accepted
+// the calibration is re-solved on another thread, starting from the
+// previous solution.
+//
+// submit() never blocks unless asked to: if all the workers are busy and
+// the queue is full the frame is dropped, so a live preview can call it
+// every frame.
+class CalibrationEngine {
+public:
+  struct Settings {
+    // Inner corners, as used by findChessboardCorners
+    cv::Size boardSize{ 9, 6 };
+    float squareSize{ 0.024f };
+    int workers{ std::max(1, (int)std::thread::hardware_concurrency() - 1) };
+    // Frames waiting for a worker, beyond which frames are dropped
+    int maxPending{ 2 };
+    // The board is found in a copy scaled down to at most this width
+    int detectionWidth{ 640 };
+    // The image is divided into this many cells to track coverage
+    cv::Size coverageGrid{ 8, 6 };
+    // A view is accepted if at least this fraction of its corners land in
+    // cells no earlier view has covered...
+    float minNewCoverage{ 0.15f };
+    // ...or its pose descriptor is at least this far from every accepted
+    // view.  See poseDistance().
+    float minPoseDistance{ 0.12f };
+    // Views needed before the first solve
+    int minViews{ 4 };
+    int flags{ CV_CALIB_ZERO_TANGENT_DIST | CV_CALIB_FIX_ASPECT_RATIO | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5 };
+  };
+
+  // A board found in a frame
+  struct View {
+    uint64_t index{ 0 };
+    double timestamp{ 0 };
+    std::vector<cv::Point2f> corners;
+    // Center, size and the two perspective ratios of the board outline,
+    // see poseDistance()
+    cv::Vec<float, 5> pose;
+    float newCoverage{ 0 };
+    float distance{ 0 };
+  };
+
+  // The outcome of the most recently processed frame, for drawing on the
+  // preview
+  struct Detection {
+    uint64_t index{ 0 };
+    bool found{ false };
+    bool accepted{ false };
+    View view;
+  };
+
+  struct Calibration {
+    bool valid{ false };
+    // Incremented every time the calibration is re-solved
+    uint64_t generation{ 0 };
+    cv::Size imageSize;
+    cv::Mat cameraMatrix;
+    cv::Mat distCoeffs;
+    double rmsError{ 0 };
+    int views{ 0 };
+  };
+
+  struct Stats {
+    TimingStats detect;
+    TimingStats refine;
+    TimingStats solve;
+    uint64_t submitted{ 0 };
+    uint64_t dropped{ 0 };
+    uint64_t found{ 0 };
+    uint64_t accepted{ 0 };
+    uint64_t rejected{ 0 };
+  };
+
+  CalibrationEngine();
+  CalibrationEngine(const Settings & settings);
+  ~CalibrationEngine();
+
+  // Queues a BGR or grayscale frame for detection.  The image is copied.
+  // Returns false if the frame was dropped, which only happens if wait is
+  // false.
+  bool submit(const cv::Mat & image, double timestamp = 0, bool wait = false);
+  // Blocks until every queued frame has been processed and the calibration
+  // is up to date with the accepted views
+  void waitForIdle();
+  // Views are only accepted while this is enabled, but detection results
+  // are still available for the preview
+  void setAccepting(bool accepting);
+  // Drops all the views and the calibration
+  void reset();
+
+  bool getDetection(Detection & result) const;
+  Calibration getCalibration() const;
+  std::vector<View> getViews() const;
+  Stats getStats() const;
+  // The fraction of coverage cells with at least one corner in them
+  float getCoverage() const;
+  // Tints each coverage cell by the number of views covering it
+  void drawCoverage(cv::Mat & image) const;
+
+  // Writes the calibration in the format CalibrateCamera has always used,
+  // which HighResWebcamDemo reads
+  static bool save(const Calibration & calibration, const Settings & settings, const std::string & path);
+  // Writes the undistortion table for the calibration, so it can be loaded
+  // without running initUndistortRectifyMap.  alpha is as for
+  // getOptimalNewCameraMatrix.  The table holds, for each pixel of the
+  // undistorted image, the position to sample in the raw image.
+  static bool exportRemap(const Calibration & calibration, const std::string & path, double alpha = 1.0);
+  // Returns a CV_32FC2 map for cv::remap and the camera matrix of the
+  // undistorted image
+  static bool loadRemap(const std::string & path, cv::Mat & map, cv::Mat & cameraMatrix);
+
+  // The distance between two board poses, as the Euclidean distance
+  // between their descriptors: the center of the board outline and its
+  // size as fractions of the image, and the log ratios of the lengths of
+  // its opposite sides, which measure its tilt.
+  static float poseDistance(const cv::Vec<float, 5> & a, const cv::Vec<float, 5> & b);
+
+private:
+  struct Job {
+    uint64_t index;
+    double timestamp;
+    cv::Mat image;
+  };
+
+  const Settings settings;
+  std::vector<cv::Point3f> boardPoints;
+
+  mutable std::mutex mutex;
+  std::condition_variable jobAvailable;
+  std::condition_variable jobTaken;
+  std::condition_variable solveNeeded;
+  std::condition_variable idle;
+  std::deque<Job> jobs;
+  std::vector<std::thread> workers;
+  std::thread solver;
+  bool quit{ false };
+  bool accepting{ true };
+  int busyWorkers{ 0 };
+  bool solving{ false };
+  bool viewsChanged{ false };
+  // Counts calls to reset(), so work started before one can be discarded
+  uint64_t resets{ 0 };
+  uint64_t nextIndex{ 1 };
+  cv::Size imageSize;
+
+  std::vector<View> views;
+  // Number of accepted views with a corner in each coverage cell
+  cv::Mat coverage;
+  Detection detection;
+  Calibration calibration;
+  Stats stats;
+
+  void start();
+  void workerLoop();
+  void solverLoop();
+  bool findBoard(const cv::Mat & image, std::vector<cv::Point2f> & corners, double & detectMillis, double & refineMillis) const;
+  static cv::Vec<float, 5> describePose(const std::vector<cv::Point2f> & corners, const cv::Size & boardSize, const cv::Size & imageSize);
+  // The remaining functions are called with the mutex held
+  cv::Point cellOf(const cv::Point2f & point) const;
+  // Decides whether to keep a view, and if so adds it to the coverage
+  bool score(View & view);
+  void resetLocked();
+};
+
+#endif
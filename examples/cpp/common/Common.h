@@ -27,14 +27,17 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cinttypes>
 #include <cmath>
+#include <deque>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <set>
 #include <sstream>
 #include <stack>
@@ -70,6 +73,7 @@
 #include <glm/gtc/epsilon.hpp>
 #include <glm/gtx/norm.hpp>
 
+using glm::ivec4;
 using glm::ivec3;
 using glm::ivec2;
 using glm::uvec2;
@@ -107,6 +111,12 @@ public:
 
 #include "Platform.h"
 #include "Utils.h"
+#include "Profiler.h"
+#include "Json.h"
+#include "TripleBuffer.h"
+#include "StereoFrameSync.h"
+#include "LedDetector.h"
+#include "LedPoseSolver.h"
 
 #include "rendering/Lights.h"
 #include "rendering/MatrixStack.h"
@@ -116,10 +126,15 @@ public:
 #include "rendering/Interaction.h"
 
 #include "opengl/Constants.h"
+#include "opengl/GpuMemory.h"
 #include "opengl/Textures.h"
 #include "opengl/Shaders.h"
 #include "opengl/Framebuffer.h"
+#include "opengl/StreamingTexture.h"
+#include "opengl/Mesh.h"
 #include "opengl/GlUtils.h"
+#include "opengl/DebugOutput.h"
+#include "opengl/GpuTimer.h"
 
 #include "glfw/GlfwUtils.h"
 #include "glfw/GlfwApp.h"
@@ -136,6 +151,8 @@ public:
 #include <OVR_CAPI_GL.h>
 
 #include "ovr/OvrUtils.h"
+#include "ovr/PoseHistory.h"
+#include "ovr/LatencyTracker.h"
 #include "ovr/RiftManagerApp.h"
 #include "ovr/RiftGlfwApp.h"
 #include "ovr/RiftApp.h"
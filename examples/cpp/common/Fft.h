@@ -0,0 +1,79 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+#include <complex>
+
+// An in-place iterative radix-2 FFT for a fixed power of two size.  The
+// twiddle factors and bit reversal permutation are computed once up front,
+// so transforming a block does no allocation and no trig.
+class Fft {
+public:
+  typedef std::complex<float> Complex;
+
+  Fft(size_t size) : size(size), twiddles(size / 2), reversed(size) {
+    assert(size && 0 == (size & (size - 1)));
+    size_t bits = 0;
+    while ((size_t(1) << bits) < size) {
+      ++bits;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      size_t r = 0;
+      for (size_t b = 0; b < bits; ++b) {
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      }
+      reversed[i] = r;
+    }
+    for (size_t i = 0; i < size / 2; ++i) {
+      float angle = -2.0f * PI * (float)i / (float)size;
+      twiddles[i] = Complex(cos(angle), sin(angle));
+    }
+  }
+
+  size_t getSize() const {
+    return size;
+  }
+
+  // data must hold getSize() elements
+  void transform(Complex * data) const {
+    for (size_t i = 0; i < size; ++i) {
+      size_t r = reversed[i];
+      if (r > i) {
+        std::swap(data[i], data[r]);
+      }
+    }
+    for (size_t span = 2; span <= size; span <<= 1) {
+      size_t half = span >> 1;
+      size_t stride = size / span;
+      for (size_t start = 0; start < size; start += span) {
+        for (size_t k = 0; k < half; ++k) {
+          Complex t = twiddles[k * stride] * data[start + k + half];
+          data[start + k + half] = data[start + k] - t;
+          data[start + k] += t;
+        }
+      }
+    }
+  }
+
+private:
+  const size_t size;
+  std::vector<Complex> twiddles;
+  std::vector<size_t> reversed;
+};
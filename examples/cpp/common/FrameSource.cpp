@@ -0,0 +1,429 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#include "Common.h"
+#include "FrameSource.h"
+
+#include <fstream>
+
+#ifdef HAVE_OPENCV
+
+static double steadyClock() {
+  typedef std::chrono::steady_clock Clock;
+  static const Clock::time_point start = Clock::now();
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void FrameSource::setClock(Clock newClock) {
+  clock = newClock;
+}
+
+double FrameSource::now() const {
+  return clock ? clock() : steadyClock();
+}
+
+void FrameSource::setEstimatedLatency(double latency) {
+  estimatedLatency = latency;
+}
+
+void FrameSource::stamp(CapturedFrame & frame, double timestamp) {
+  frame.index = frameCount++;
+  frame.timestamp = timestamp;
+  frame.exposureTime = timestamp - estimatedLatency;
+}
+
+void FrameSource::waitUntil(double time) const {
+  double remaining = time - now();
+  if (remaining > 0) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+  }
+}
+
+// Splits "name:WxH@fps" into its parts, leaving the size and rate alone if
+// they're not given
+static std::string parseModifiers(const std::string & spec, cv::Size & size, double & fps) {
+  std::string name = spec;
+  size_t at = name.find('@');
+  if (at != std::string::npos) {
+    fps = atof(name.substr(at + 1).c_str());
+    name = name.substr(0, at);
+  }
+  size_t colon = name.find(':');
+  if (colon != std::string::npos) {
+    int width = 0, height = 0;
+    if (2 == sscanf(name.substr(colon + 1).c_str(), "%dx%d", &width, &height)) {
+      size = cv::Size(width, height);
+    }
+    name = name.substr(0, colon);
+  }
+  return name;
+}
+
+static bool endsWith(const std::string & string, const std::string & suffix) {
+  return string.size() >= suffix.size() &&
+    0 == string.compare(string.size() - suffix.size(), suffix.size(), suffix);
+}
+
+FrameSourcePtr FrameSource::create(const std::string & spec) {
+  FrameSourcePtr result;
+  if (spec.empty()) {
+    return result;
+  }
+
+  if (isdigit(spec[0]) || 0 == spec.find("synthetic")) {
+    cv::Size size;
+    double fps = 0;
+    std::string name = parseModifiers(spec, size, fps);
+    if ("synthetic" == name) {
+      SyntheticFrameSource::Settings settings;
+      if (size.area()) {
+        settings.size = size;
+      }
+      if (fps > 0) {
+        settings.fps = fps;
+      }
+      result = FrameSourcePtr(new SyntheticFrameSource(settings));
+    } else {
+      result = FrameSourcePtr(new DeviceFrameSource(atoi(name.c_str()), size, fps));
+    }
+  } else if (std::string::npos != spec.find('%')) {
+    result = FrameSourcePtr(new ImageSequenceFrameSource(
+      ImageSequenceFrameSource::expandPattern(spec)));
+  } else if (endsWith(spec, ".txt")) {
+    result = FrameSourcePtr(new ImageSequenceFrameSource(
+      ImageSequenceFrameSource::readList(spec)));
+  } else {
+    result = FrameSourcePtr(new VideoFileFrameSource(spec));
+  }
+
+  if (!result->isOpened()) {
+    SAY_ERR("Unable to open frame source %s", spec.c_str());
+    result.reset();
+  }
+  return result;
+}
+
+FrameSourcePtr FrameSource::create(const std::string & defaultSpec, const char * environmentVariable) {
+  const char * spec = getenv(environmentVariable);
+  if (spec && *spec) {
+    SAY("Using frame source %s from %s", spec, environmentVariable);
+    return create(spec);
+  }
+  return create(defaultSpec);
+}
+
+DeviceFrameSource::DeviceFrameSource(int device, const cv::Size & size, double fps) {
+  capture.open(device);
+  if (size.area()) {
+    capture.set(CV_CAP_PROP_FRAME_WIDTH, size.width);
+    capture.set(CV_CAP_PROP_FRAME_HEIGHT, size.height);
+  }
+  if (fps > 0) {
+    capture.set(CV_CAP_PROP_FPS, fps);
+  }
+}
+
+bool DeviceFrameSource::isOpened() const {
+  return capture.isOpened();
+}
+
+bool DeviceFrameSource::read(CapturedFrame & frame) {
+  if (!capture.grab()) {
+    return false;
+  }
+  // As close to the actual capture as we can get
+  stamp(frame, now());
+  return capture.retrieve(frame.image);
+}
+
+cv::Size DeviceFrameSource::getSize() const {
+  cv::VideoCapture & c = const_cast<cv::VideoCapture &>(capture);
+  return cv::Size((int)c.get(CV_CAP_PROP_FRAME_WIDTH), (int)c.get(CV_CAP_PROP_FRAME_HEIGHT));
+}
+
+double DeviceFrameSource::getFps() const {
+  return const_cast<cv::VideoCapture &>(capture).get(CV_CAP_PROP_FPS);
+}
+
+bool DeviceFrameSource::isLive() const {
+  return true;
+}
+
+VideoFileFrameSource::VideoFileFrameSource(const std::string & path, bool paced, bool loop)
+  : path(path), paced(paced), loop(loop) {
+  capture.open(path);
+  double reportedFps = capture.get(CV_CAP_PROP_FPS);
+  if (reportedFps > 0) {
+    fps = reportedFps;
+  }
+}
+
+bool VideoFileFrameSource::isOpened() const {
+  return capture.isOpened();
+}
+
+bool VideoFileFrameSource::read(CapturedFrame & frame) {
+  if (!capture.read(frame.image)) {
+    if (!loop) {
+      return false;
+    }
+    capture.set(CV_CAP_PROP_POS_FRAMES, 0);
+    if (!capture.read(frame.image)) {
+      return false;
+    }
+  }
+  if (start < 0) {
+    start = now();
+  }
+  double timestamp = start + (double)frameCount / fps;
+  if (paced) {
+    waitUntil(timestamp);
+  }
+  stamp(frame, timestamp);
+  return true;
+}
+
+cv::Size VideoFileFrameSource::getSize() const {
+  cv::VideoCapture & c = const_cast<cv::VideoCapture &>(capture);
+  return cv::Size((int)c.get(CV_CAP_PROP_FRAME_WIDTH), (int)c.get(CV_CAP_PROP_FRAME_HEIGHT));
+}
+
+double VideoFileFrameSource::getFps() const {
+  return fps;
+}
+
+ImageSequenceFrameSource::ImageSequenceFrameSource(const std::vector<std::string> & files, double fps, bool paced, bool loop)
+  : files(files), fps(fps), paced(paced), loop(loop) {
+  if (!files.empty()) {
+    size = cv::imread(files[0]).size();
+  }
+}
+
+std::vector<std::string> ImageSequenceFrameSource::expandPattern(const std::string & pattern) {
+  std::vector<std::string> result;
+  for (int i = 0; ; ++i) {
+    std::string file = Platform::format(pattern.c_str(), i);
+    if (!std::ifstream(file).good()) {
+      // Sequences may be numbered from 1
+      if (0 == i) {
+        continue;
+      }
+      break;
+    }
+    result.push_back(file);
+  }
+  return result;
+}
+
+std::vector<std::string> ImageSequenceFrameSource::readList(const std::string & listFile) {
+  std::vector<std::string> result;
+  std::string directory;
+  size_t slash = listFile.find_last_of("/\\");
+  if (slash != std::string::npos) {
+    directory = listFile.substr(0, slash + 1);
+  }
+  std::ifstream in(listFile);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || '#' == line[0]) {
+      continue;
+    }
+    bool absolute = '/' == line[0] || '\\' == line[0] ||
+      (line.size() > 1 && ':' == line[1]);
+    result.push_back(absolute ? line : directory + line);
+  }
+  return result;
+}
+
+bool ImageSequenceFrameSource::isOpened() const {
+  return size.area() > 0;
+}
+
+bool ImageSequenceFrameSource::read(CapturedFrame & frame) {
+  if (next >= files.size()) {
+    if (!loop || files.empty()) {
+      return false;
+    }
+    next = 0;
+  }
+  frame.image = cv::imread(files[next++]);
+  if (frame.image.empty()) {
+    return false;
+  }
+  if (start < 0) {
+    start = now();
+  }
+  double timestamp = start + (double)frameCount / fps;
+  if (paced) {
+    waitUntil(timestamp);
+  }
+  stamp(frame, timestamp);
+  return true;
+}
+
+cv::Size ImageSequenceFrameSource::getSize() const {
+  return size;
+}
+
+double ImageSequenceFrameSource::getFps() const {
+  return fps;
+}
+
+SyntheticFrameSource::SyntheticFrameSource()
+  : SyntheticFrameSource(Settings()) {
+}
+
+SyntheticFrameSource::SyntheticFrameSource(const Settings & settings)
+  : settings(settings), rng(settings.seed) {
+}
+
+bool SyntheticFrameSource::isOpened() const {
+  return settings.size.area() > 0 && settings.fps > 0;
+}
+
+cv::Size SyntheticFrameSource::getSize() const {
+  return settings.size;
+}
+
+double SyntheticFrameSource::getFps() const {
+  return settings.fps;
+}
+
+const SyntheticFrameSource::Settings & SyntheticFrameSource::getSettings() const {
+  return settings;
+}
+
+double SyntheticFrameSource::toSceneTime(double exposureTime) const {
+  return exposureTime - start;
+}
+
+void SyntheticFrameSource::getLedPositions(double sceneTime, std::vector<cv::Point2f> & result) const {
+  result.resize(settings.leds);
+  cv::Point2f center(settings.size.width / 2.0f, settings.size.height / 2.0f);
+  cv::Point2f amplitude = center * 0.8f;
+  float t = (float)sceneTime;
+  for (int i = 0; i < settings.leds; ++i) {
+    // Each LED gets its own path and speed, so they cross each other
+    float a = 0.31f + 0.07f * i;
+    float b = 0.23f + 0.05f * ((i * 3) % 7);
+    float phase = 1.7f * i;
+    result[i] = center + cv::Point2f(
+      amplitude.x * sin(a * t * TWO_PI + phase),
+      amplitude.y * sin(b * t * TWO_PI + phase * 0.5f));
+  }
+}
+
+cv::Matx23f SyntheticFrameSource::boardTransform(double sceneTime) const {
+  float t = (float)sceneTime;
+  cv::Size squares = settings.boardSize + cv::Size(1, 1);
+  // Scale the board to about half the image height
+  float scale = settings.size.height * 0.5f / squares.height * (1.0f + 0.1f * sin(t * 0.9f));
+  float angle = 0.25f * sin(t * 0.6f);
+  cv::Point2f center(
+    settings.size.width * (0.5f + 0.15f * sin(t * 0.4f)),
+    settings.size.height * (0.5f + 0.1f * sin(t * 0.7f)));
+  float c = cos(angle) * scale, s = sin(angle) * scale;
+  cv::Point2f half(squares.width / 2.0f, squares.height / 2.0f);
+  return cv::Matx23f(
+    c, -s, center.x - (c * half.x - s * half.y),
+    s, c, center.y - (s * half.x + c * half.y));
+}
+
+void SyntheticFrameSource::getBoardCorners(double sceneTime, std::vector<cv::Point2f> & result) const {
+  cv::Matx23f transform = boardTransform(sceneTime);
+  result.clear();
+  for (int y = 1; y <= settings.boardSize.height; ++y) {
+    for (int x = 1; x <= settings.boardSize.width; ++x) {
+      result.push_back(cv::Point2f(transform * cv::Vec3f((float)x, (float)y, 1.0f)));
+    }
+  }
+}
+
+void SyntheticFrameSource::render(double sceneTime, cv::Mat & image) {
+  image.create(settings.size, CV_8UC3);
+  image.setTo(cv::Scalar::all(24));
+
+  // Sub-pixel precision for the anti-aliased shapes
+  static const int SHIFT = 4;
+  static const float ONE = (float)(1 << SHIFT);
+
+  if (settings.checkerboard) {
+    cv::Matx23f transform = boardTransform(sceneTime);
+    cv::Size squares = settings.boardSize + cv::Size(1, 1);
+    auto toImage = [&](float x, float y) {
+      cv::Point2f p = cv::Point2f(transform * cv::Vec3f(x, y, 1.0f));
+      return cv::Point(cvRound(p.x * ONE), cvRound(p.y * ONE));
+    };
+    // A white margin around the board, which the detector needs
+    cv::Point margin[4] = {
+      toImage(-1, -1), toImage(squares.width + 1.0f, -1),
+      toImage(squares.width + 1.0f, squares.height + 1.0f), toImage(-1, squares.height + 1.0f)
+    };
+    cv::fillConvexPoly(image, margin, 4, cv::Scalar::all(220), CV_AA, SHIFT);
+    for (int y = 0; y < squares.height; ++y) {
+      for (int x = (y & 1); x < squares.width; x += 2) {
+        cv::Point square[4] = {
+          toImage((float)x, (float)y), toImage(x + 1.0f, (float)y),
+          toImage(x + 1.0f, y + 1.0f), toImage((float)x, y + 1.0f)
+        };
+        cv::fillConvexPoly(image, square, 4, cv::Scalar::all(16), CV_AA, SHIFT);
+      }
+    }
+  }
+
+  std::vector<cv::Point2f> leds;
+  getLedPositions(sceneTime, leds);
+  for (const cv::Point2f & led : leds) {
+    cv::Point center(cvRound(led.x * ONE), cvRound(led.y * ONE));
+    // A dimmer halo around a saturated core, roughly like an IR LED
+    cv::circle(image, center, cvRound(settings.ledRadius * 2.0f * ONE), cv::Scalar::all(96), -1, CV_AA, SHIFT);
+    cv::circle(image, center, cvRound(settings.ledRadius * ONE), cv::Scalar::all(255), -1, CV_AA, SHIFT);
+  }
+
+  if (settings.noise > 0) {
+    noise.create(image.size(), CV_8SC3);
+    rng.fill(noise, cv::RNG::NORMAL, 0, settings.noise);
+    cv::add(image, noise, image, cv::noArray(), CV_8UC3);
+  }
+}
+
+bool SyntheticFrameSource::read(CapturedFrame & frame) {
+  if (start < 0) {
+    start = now();
+  }
+  double sceneTime = (double)frameCount / settings.fps;
+  if (settings.jitter > 0) {
+    sceneTime += rng.gaussian(settings.jitter);
+  }
+  // Jitter can't reorder frames
+  sceneTime = std::max(sceneTime, lastExposure + 1e-6);
+  lastExposure = sceneTime;
+
+  render(sceneTime, frame.image);
+  double delivery = start + sceneTime + settings.latency;
+  if (settings.paced) {
+    waitUntil(delivery);
+  }
+  stamp(frame, delivery);
+  frame.exposureTime = start + sceneTime;
+  return true;
+}
+
+#endif
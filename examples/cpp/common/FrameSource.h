@@ -0,0 +1,207 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+#ifdef HAVE_OPENCV
+#include <opencv2/opencv.hpp>
+
+struct CapturedFrame {
+  // BGR, 8 bits per channel
+  cv::Mat image;
+  // Counts up from 0 for each frame the source delivers
+  uint64_t index{ 0 };
+  // When the frame was delivered, on the source's clock
+  double timestamp{ 0 };
+  // When the image was exposed.  Only synthetic sources actually know this,
+  // the others estimate it from the timestamp and the latency they've been
+  // told about.
+  double exposureTime{ 0 };
+};
+
+// A stream of camera-like frames, so the capture code in the examples and
+// tools can run from a webcam, a recording or a generated pattern without
+// any changes, and benchmarks can be repeated on any machine.
+//
+// Sources are created from a spec string:
+// - "1", "1:1280x720@60": a capture device, optionally with the resolution
+//   and frame rate to request
+// - "synthetic", "synthetic:1920x1080@60": generated LEDs and checkerboard
+// - a path containing a printf style "%d" pattern, or to a .txt file
+//   listing one image per line: an image sequence
+// - anything else: a video file
+//
+// read() blocks until the next frame is due, so file and synthetic sources
+// play back at their own frame rate, just like a camera would.
+class FrameSource {
+public:
+  typedef std::function<double()> Clock;
+
+  virtual ~FrameSource() {}
+
+  virtual bool isOpened() const = 0;
+  // Returns false at the end of the stream, or if the source failed
+  virtual bool read(CapturedFrame & frame) = 0;
+  virtual cv::Size getSize() const = 0;
+  virtual double getFps() const = 0;
+
+  // Whether frames arrive at a rate the reader doesn't control
+  virtual bool isLive() const {
+    return false;
+  }
+
+  // Timestamps default to a monotonic clock starting at an arbitrary point.
+  // The examples use ovr_GetTimeInSeconds, so they can look up poses by
+  // frame time.
+  void setClock(Clock clock);
+  double now() const;
+
+  // The time between exposure and delivery, for sources that can't know it
+  void setEstimatedLatency(double latency);
+
+  static std::shared_ptr<FrameSource> create(const std::string & spec);
+  // As above, but the spec is taken from the named environment variable if
+  // it's set, so the examples can be pointed at a recording or a generated
+  // pattern without rebuilding
+  static std::shared_ptr<FrameSource> create(const std::string & defaultSpec, const char * environmentVariable);
+
+protected:
+  Clock clock;
+  double estimatedLatency{ 0 };
+  uint64_t frameCount{ 0 };
+
+  // Stamps and counts a frame that was just delivered
+  void stamp(CapturedFrame & frame, double timestamp);
+  void waitUntil(double time) const;
+};
+
+typedef std::shared_ptr<FrameSource> FrameSourcePtr;
+
+class DeviceFrameSource : public FrameSource {
+  cv::VideoCapture capture;
+
+public:
+  DeviceFrameSource(int device, const cv::Size & size = cv::Size(), double fps = 0);
+  virtual bool isOpened() const;
+  virtual bool read(CapturedFrame & frame);
+  virtual cv::Size getSize() const;
+  virtual double getFps() const;
+  virtual bool isLive() const;
+};
+
+// Plays back a file at its own frame rate, or as fast as it can be decoded
+// if paced is false.  Timestamps are the presentation times of the frames.
+class VideoFileFrameSource : public FrameSource {
+  cv::VideoCapture capture;
+  std::string path;
+  bool paced;
+  bool loop;
+  double fps{ 30 };
+  double start{ -1 };
+
+public:
+  VideoFileFrameSource(const std::string & path, bool paced = true, bool loop = false);
+  virtual bool isOpened() const;
+  virtual bool read(CapturedFrame & frame);
+  virtual cv::Size getSize() const;
+  virtual double getFps() const;
+};
+
+class ImageSequenceFrameSource : public FrameSource {
+  std::vector<std::string> files;
+  double fps;
+  bool paced;
+  bool loop;
+  size_t next{ 0 };
+  double start{ -1 };
+  cv::Size size;
+
+public:
+  ImageSequenceFrameSource(const std::vector<std::string> & files, double fps = 30, bool paced = true, bool loop = false);
+  // Expands a printf style pattern, starting from 0 or 1, until a file is
+  // missing
+  static std::vector<std::string> expandPattern(const std::string & pattern);
+  // Reads a text file with one image path per line, relative to the file
+  static std::vector<std::string> readList(const std::string & listFile);
+
+  virtual bool isOpened() const;
+  virtual bool read(CapturedFrame & frame);
+  virtual cv::Size getSize() const;
+  virtual double getFps() const;
+};
+
+// Generates frames containing a slowly moving checkerboard and a number of
+// small bright LEDs on Lissajous paths over a dark background, with
+// optional sensor noise.  Frames are exposed at exactly 1 / fps intervals,
+// plus any jitter, and delivered after the configured latency.  Since the
+// scene is known, the true LED and board corner positions can be retrieved
+// for any exposure time to measure the accuracy of detection code.
+class SyntheticFrameSource : public FrameSource {
+public:
+  struct Settings {
+    cv::Size size{ 1280, 720 };
+    double fps{ 60 };
+    int leds{ 8 };
+    float ledRadius{ 3.0f };
+    bool checkerboard{ true };
+    // Inner corners, as used by findChessboardCorners
+    cv::Size boardSize{ 9, 6 };
+    // Seconds from exposure to delivery
+    double latency{ 0 };
+    // Standard deviation of the exposure time, in seconds
+    double jitter{ 0 };
+    // Standard deviation of the per-pixel noise
+    double noise{ 0 };
+    // If false, frames are delivered as fast as they're read, with
+    // timestamps still spaced at the frame rate
+    bool paced{ true };
+    unsigned int seed{ 1 };
+  };
+
+  SyntheticFrameSource();
+  SyntheticFrameSource(const Settings & settings);
+
+  virtual bool isOpened() const;
+  virtual bool read(CapturedFrame & frame);
+  virtual cv::Size getSize() const;
+  virtual double getFps() const;
+
+  const Settings & getSettings() const;
+  // Converts the exposure time of a frame to the time in the generated
+  // scene, which starts at 0 with the first frame
+  double toSceneTime(double exposureTime) const;
+  // Positions in image coordinates at a scene time
+  void getLedPositions(double sceneTime, std::vector<cv::Point2f> & result) const;
+  void getBoardCorners(double sceneTime, std::vector<cv::Point2f> & result) const;
+
+private:
+  Settings settings;
+  cv::RNG rng;
+  double start{ -1 };
+  double lastExposure{ -1 };
+  cv::Mat noise;
+
+  // Maps board coordinates (in squares, origin at the top left of the
+  // outer squares) to the image at the given scene time
+  cv::Matx23f boardTransform(double sceneTime) const;
+  void render(double sceneTime, cv::Mat & image);
+};
+
+#endif
@@ -0,0 +1,958 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+#include "Json.h"
+
+#include <clocale>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+  // Numbers delivered to a sink at a time
+  const size_t NUMBER_BATCH = 256;
+
+  const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  inline bool isWhitespace(char c) {
+    return ' ' == c || '\n' == c || '\r' == c || '\t' == c;
+  }
+
+  inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  int hexValue(char c) {
+    if (isDigit(c)) {
+      return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  }
+
+  void appendUtf8(std::string & out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+      out += (char)codepoint;
+    } else if (codepoint < 0x800) {
+      out += (char)(0xC0 | (codepoint >> 6));
+      out += (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+      out += (char)(0xE0 | (codepoint >> 12));
+      out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      out += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+      out += (char)(0xF0 | (codepoint >> 18));
+      out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+      out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      out += (char)(0x80 | (codepoint & 0x3F));
+    }
+  }
+
+  inline int lowestBit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+  }
+}
+
+bool JsonReader::parse(const std::string & text, JsonHandler & handler) {
+  return parse(text.data(), text.size(), handler);
+}
+
+bool JsonReader::parse(const char * data, size_t size, JsonHandler & handler) {
+  begin = cursor = data;
+  end = data + size;
+  this->handler = &handler;
+  error.clear();
+  errorOffset = 0;
+
+  skipWhitespace();
+  if (end - cursor > 4 && 0 == strncmp(cursor, "var", 3) && isWhitespace(cursor[3])) {
+    const char * equals = (const char *)memchr(cursor, '=', end - cursor);
+    if (!equals) {
+      return fail("Expected = after var");
+    }
+    cursor = equals + 1;
+    skipWhitespace();
+  }
+  if (!parseValue(0)) {
+    return false;
+  }
+  skipWhitespace();
+  if (cursor < end && ';' == *cursor) {
+    ++cursor;
+    skipWhitespace();
+  }
+  if (cursor != end) {
+    return fail("Unexpected text after the end of the document");
+  }
+  return true;
+}
+
+const std::string & JsonReader::getError() const {
+  return error;
+}
+
+size_t JsonReader::getErrorOffset() const {
+  return errorOffset;
+}
+
+bool JsonReader::isSimdEnabled() {
+#ifdef JSON_USE_SSE2
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool JsonReader::fail(const char * message) {
+  // Only the first, innermost, failure counts
+  if (error.empty()) {
+    errorOffset = cursor - begin;
+    error = Platform::format("%s at offset %d", message, (int)errorOffset);
+  }
+  return false;
+}
+
+void JsonReader::skipWhitespace() {
+  // Usually there's none, or a single space
+  if (cursor == end || !isWhitespace(*cursor)) {
+    return;
+  }
+  ++cursor;
+#ifdef JSON_USE_SSE2
+  // Indentation in pretty printed files runs for a while
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriageReturn = _mm_set1_epi8('\r');
+  const __m128i tab = _mm_set1_epi8('\t');
+  while (end - cursor >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)cursor);
+    __m128i whitespace = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, carriageReturn), _mm_cmpeq_epi8(chunk, tab)));
+    unsigned int other = ~_mm_movemask_epi8(whitespace) & 0xFFFF;
+    if (other) {
+      cursor += lowestBit(other);
+      return;
+    }
+    cursor += 16;
+  }
+#endif
+  while (cursor < end && isWhitespace(*cursor)) {
+    ++cursor;
+  }
+}
+
+bool JsonReader::parseValue(int depth) {
+  if (cursor == end) {
+    return fail("Unexpected end of the document");
+  }
+  switch (*cursor) {
+  case '{':
+    return parseObject(depth + 1);
+
+  case '[':
+    return parseArray(depth + 1);
+
+  case '"': {
+      const char * value;
+      size_t length;
+      if (!parseString(value, length)) {
+        return false;
+      }
+      handler->string(value, length);
+      return true;
+    }
+
+  case 't':
+    if (!parseLiteral("true", 4)) {
+      return false;
+    }
+    handler->boolean(true);
+    return true;
+
+  case 'f':
+    if (!parseLiteral("false", 5)) {
+      return false;
+    }
+    handler->boolean(false);
+    return true;
+
+  case 'n':
+    if (!parseLiteral("null", 4)) {
+      return false;
+    }
+    handler->null();
+    return true;
+
+  default: {
+      double value;
+      if (!parseNumber(value)) {
+        return false;
+      }
+      handler->number(value);
+      return true;
+    }
+  }
+}
+
+bool JsonReader::parseObject(int depth) {
+  if (depth > MAX_DEPTH) {
+    return fail("Nested too deeply");
+  }
+  ++cursor;
+  handler->startObject();
+  skipWhitespace();
+  if (cursor < end && '}' == *cursor) {
+    ++cursor;
+    handler->endObject();
+    return true;
+  }
+  while (true) {
+    if (cursor == end || '"' != *cursor) {
+      return fail("Expected a key");
+    }
+    const char * key;
+    size_t length;
+    if (!parseString(key, length)) {
+      return false;
+    }
+    handler->key(key, length);
+    skipWhitespace();
+    if (cursor == end || ':' != *cursor) {
+      return fail("Expected :");
+    }
+    ++cursor;
+    skipWhitespace();
+    if (!parseValue(depth)) {
+      return false;
+    }
+    skipWhitespace();
+    if (cursor == end) {
+      return fail("Unterminated object");
+    }
+    if ('}' == *cursor) {
+      ++cursor;
+      handler->endObject();
+      return true;
+    }
+    if (',' != *cursor) {
+      return fail("Expected , or }");
+    }
+    ++cursor;
+    skipWhitespace();
+  }
+}
+
+bool JsonReader::parseArray(int depth) {
+  if (depth > MAX_DEPTH) {
+    return fail("Nested too deeply");
+  }
+  ++cursor;
+  JsonNumberSink * sink = handler->startArray();
+  skipWhitespace();
+  if (sink) {
+    if (!parseNumbers(*sink)) {
+      return false;
+    }
+    handler->endArray();
+    return true;
+  }
+  if (cursor < end && ']' == *cursor) {
+    ++cursor;
+    handler->endArray();
+    return true;
+  }
+  while (true) {
+    if (!parseValue(depth)) {
+      return false;
+    }
+    skipWhitespace();
+    if (cursor == end) {
+      return fail("Unterminated array");
+    }
+    if (']' == *cursor) {
+      ++cursor;
+      handler->endArray();
+      return true;
+    }
+    if (',' != *cursor) {
+      return fail("Expected , or ]");
+    }
+    ++cursor;
+    skipWhitespace();
+  }
+}
+
+bool JsonReader::parseNumbers(JsonNumberSink & sink) {
+  double batch[NUMBER_BATCH];
+  size_t count = 0;
+  if (cursor < end && ']' == *cursor) {
+    ++cursor;
+    return true;
+  }
+  while (true) {
+    if (!parseNumber(batch[count])) {
+      return false;
+    }
+    if (++count == NUMBER_BATCH) {
+      sink.numbers(batch, count);
+      count = 0;
+    }
+    skipWhitespace();
+    if (cursor == end) {
+      return fail("Unterminated array");
+    }
+    if (']' == *cursor) {
+      ++cursor;
+      break;
+    }
+    if (',' != *cursor) {
+      return fail("Expected , or ]");
+    }
+    ++cursor;
+    skipWhitespace();
+  }
+  if (count) {
+    sink.numbers(batch, count);
+  }
+  return true;
+}
+
+bool JsonReader::parseString(const char * & value, size_t & length) {
+  const char * start = ++cursor;
+  // Find the closing quote, or the first escape
+#ifdef JSON_USE_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (end - cursor >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)cursor);
+    unsigned int special = _mm_movemask_epi8(_mm_or_si128(
+      _mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+    if (special) {
+      cursor += lowestBit(special);
+      break;
+    }
+    cursor += 16;
+  }
+#endif
+  while (cursor < end && '"' != *cursor && '\\' != *cursor) {
+    ++cursor;
+  }
+  if (cursor == end) {
+    return fail("Unterminated string");
+  }
+  if ('"' == *cursor) {
+    value = start;
+    length = cursor - start;
+    ++cursor;
+    return true;
+  }
+
+  // Escaped, so it has to be copied
+  scratch.assign(start, cursor);
+  while (cursor < end && '"' != *cursor) {
+    if ('\\' != *cursor) {
+      scratch += *cursor++;
+      continue;
+    }
+    if (++cursor == end) {
+      break;
+    }
+    char escaped = *cursor++;
+    switch (escaped) {
+    case '"':
+    case '\\':
+    case '/':
+      scratch += escaped;
+      break;
+    case 'b':
+      scratch += '\b';
+      break;
+    case 'f':
+      scratch += '\f';
+      break;
+    case 'n':
+      scratch += '\n';
+      break;
+    case 'r':
+      scratch += '\r';
+      break;
+    case 't':
+      scratch += '\t';
+      break;
+    case 'u': {
+        uint32_t codepoint = 0;
+        for (int i = 0; i < 4; ++i) {
+          int digit = cursor < end ? hexValue(*cursor++) : -1;
+          if (digit < 0) {
+            return fail("Invalid \\u escape");
+          }
+          codepoint = codepoint << 4 | digit;
+        }
+        // A surrogate pair is two escapes
+        if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - cursor >= 6 && '\\' == cursor[0] && 'u' == cursor[1]) {
+          uint32_t low = 0;
+          for (int i = 2; i < 6; ++i) {
+            int digit = hexValue(cursor[i]);
+            low = digit < 0 ? 0 : low << 4 | digit;
+          }
+          if (low >= 0xDC00 && low < 0xE000) {
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+            cursor += 6;
+          }
+        }
+        appendUtf8(scratch, codepoint);
+      }
+      break;
+    default:
+      return fail("Invalid escape");
+    }
+  }
+  if (cursor == end) {
+    return fail("Unterminated string");
+  }
+  ++cursor;
+  value = scratch.c_str();
+  length = scratch.size();
+  return true;
+}
+
+bool JsonReader::parseNumber(double & value) {
+  const char * start = cursor;
+  bool negative = false;
+  if (cursor < end && '-' == *cursor) {
+    negative = true;
+    ++cursor;
+  }
+  if (cursor == end || !isDigit(*cursor)) {
+    return fail("Expected a value");
+  }
+
+  // Up to 19 significant digits fit in the mantissa
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  while (cursor < end && isDigit(*cursor)) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*cursor - '0');
+      if (mantissa) {
+        ++digits;
+      }
+    } else {
+      ++exponent;
+    }
+    ++cursor;
+  }
+  if (cursor < end && '.' == *cursor) {
+    ++cursor;
+    if (cursor == end || !isDigit(*cursor)) {
+      return fail("Expected a digit after the decimal point");
+    }
+    while (cursor < end && isDigit(*cursor)) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*cursor - '0');
+        if (mantissa) {
+          ++digits;
+        }
+        --exponent;
+      }
+      ++cursor;
+    }
+  }
+  if (cursor < end && ('e' == *cursor || 'E' == *cursor)) {
+    ++cursor;
+    bool negativeExponent = false;
+    if (cursor < end && ('-' == *cursor || '+' == *cursor)) {
+      negativeExponent = '-' == *cursor;
+      ++cursor;
+    }
+    if (cursor == end || !isDigit(*cursor)) {
+      return fail("Expected a digit in the exponent");
+    }
+    int explicitExponent = 0;
+    while (cursor < end && isDigit(*cursor)) {
+      if (explicitExponent < 10000) {
+        explicitExponent = explicitExponent * 10 + (*cursor - '0');
+      }
+      ++cursor;
+    }
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+  }
+
+  // Exact when both the mantissa and the power of ten are exactly
+  // representable, which covers nearly everything in practice
+  if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+    double result = (double)mantissa;
+    result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+    value = negative ? -result : result;
+    return true;
+  }
+
+  // Everything else goes to strtod, which follows the locale, and Qt sets
+  // that from the environment, so the decimal point is swapped for the
+  // locale's own
+  char buffer[64];
+  size_t length = cursor - start;
+  if (length >= sizeof(buffer)) {
+    return fail("Number too long");
+  }
+  memcpy(buffer, start, length);
+  buffer[length] = 0;
+  char decimalPoint = *localeconv()->decimal_point;
+  if ('.' != decimalPoint) {
+    char * point = strchr(buffer, '.');
+    if (point) {
+      *point = decimalPoint;
+    }
+  }
+  value = strtod(buffer, nullptr);
+  return true;
+}
+
+bool JsonReader::parseLiteral(const char * literal, size_t length) {
+  if ((size_t)(end - cursor) < length || 0 != strncmp(cursor, literal, length)) {
+    return fail("Expected a value");
+  }
+  cursor += length;
+  return true;
+}
+
+// Builds the tree for a JsonDocument.  The items of the arrays and objects
+// still open are kept on a stack, and copied into the document's memory in
+// one go when they close, so the stack is the only thing that grows.
+class JsonBuilder : public JsonHandler {
+public:
+  JsonBuilder(JsonDocument & document) : document(document) {
+  }
+
+  virtual void startObject() {
+    openContainer();
+  }
+
+  virtual void endObject() {
+    size_t start = starts.back();
+    starts.pop_back();
+    size_t count = values.size() - start;
+    JsonValue::Member * members = (JsonValue::Member *)document.allocate(count * sizeof(JsonValue::Member));
+    for (size_t i = 0; i < count; ++i) {
+      members[i].key = keys[keys.size() - count + i];
+      members[i].value = values[start + i];
+    }
+    keys.resize(keys.size() - count);
+    values.resize(start);
+    JsonValue value;
+    value.type = JsonValue::OBJECT;
+    value.length = (uint32_t)count;
+    value.members = members;
+    add(value);
+  }
+
+  virtual JsonNumberSink * startArray() {
+    openContainer();
+    return nullptr;
+  }
+
+  virtual void endArray() {
+    size_t start = starts.back();
+    starts.pop_back();
+    size_t count = values.size() - start;
+    JsonValue * items = (JsonValue *)document.allocate(count * sizeof(JsonValue));
+    if (count) {
+      memcpy(items, &values[start], count * sizeof(JsonValue));
+    }
+    values.resize(start);
+    JsonValue value;
+    value.type = JsonValue::ARRAY;
+    value.length = (uint32_t)count;
+    value.items = items;
+    add(value);
+  }
+
+  virtual void key(const char * key, size_t length) {
+    keys.push_back(copy(key, length));
+  }
+
+  virtual void string(const char * chars, size_t length) {
+    JsonValue value;
+    value.type = JsonValue::STRING;
+    value.length = (uint32_t)length;
+    value.chars = copy(chars, length);
+    add(value);
+  }
+
+  virtual void number(double number) {
+    JsonValue value;
+    value.type = JsonValue::NUMBER;
+    value.number = number;
+    add(value);
+  }
+
+  virtual void boolean(bool boolean) {
+    JsonValue value;
+    value.type = JsonValue::BOOLEAN;
+    value.boolean = boolean;
+    add(value);
+  }
+
+  virtual void null() {
+    add(JsonValue());
+  }
+
+private:
+  JsonDocument & document;
+  std::vector<JsonValue> values;
+  std::vector<const char *> keys;
+  std::vector<size_t> starts;
+
+  void openContainer() {
+    starts.push_back(values.size());
+  }
+
+  void add(const JsonValue & value) {
+    if (starts.empty()) {
+      document.root = value;
+    } else {
+      values.push_back(value);
+    }
+  }
+
+  const char * copy(const char * chars, size_t length) {
+    char * result = (char *)document.allocate(length + 1);
+    memcpy(result, chars, length);
+    result[length] = 0;
+    return result;
+  }
+};
+
+JsonValue::JsonValue() : type(NUL), length(0), number(0) {
+}
+
+JsonValue::Type JsonValue::getType() const {
+  return type;
+}
+
+bool JsonValue::isNull() const {
+  return NUL == type;
+}
+
+bool JsonValue::isNumber() const {
+  return NUMBER == type;
+}
+
+bool JsonValue::isString() const {
+  return STRING == type;
+}
+
+bool JsonValue::isArray() const {
+  return ARRAY == type;
+}
+
+bool JsonValue::isObject() const {
+  return OBJECT == type;
+}
+
+bool JsonValue::asBool(bool defaultValue) const {
+  return BOOLEAN == type ? boolean : defaultValue;
+}
+
+double JsonValue::asNumber(double defaultValue) const {
+  return NUMBER == type ? number : defaultValue;
+}
+
+int JsonValue::asInt(int defaultValue) const {
+  return NUMBER == type ? (int)number : defaultValue;
+}
+
+const char * JsonValue::asCString(const char * defaultValue) const {
+  return STRING == type ? chars : defaultValue;
+}
+
+std::string JsonValue::asString(const std::string & defaultValue) const {
+  return STRING == type ? std::string(chars, length) : defaultValue;
+}
+
+size_t JsonValue::size() const {
+  return (ARRAY == type || OBJECT == type || STRING == type) ? length : 0;
+}
+
+static const JsonValue NULL_VALUE;
+
+const JsonValue & JsonValue::operator[](int index) const {
+  if (ARRAY != type || index < 0 || (size_t)index >= length) {
+    return NULL_VALUE;
+  }
+  return items[index];
+}
+
+const JsonValue & JsonValue::operator[](const char * key) const {
+  if (OBJECT == type) {
+    for (size_t i = 0; i < length; ++i) {
+      if (0 == strcmp(members[i].key, key)) {
+        return members[i].value;
+      }
+    }
+  }
+  return NULL_VALUE;
+}
+
+bool JsonValue::hasMember(const char * key) const {
+  return &NULL_VALUE != &(*this)[key];
+}
+
+const char * JsonValue::keyAt(size_t index) const {
+  return (OBJECT == type && index < length) ? members[index].key : "";
+}
+
+const JsonValue & JsonValue::valueAt(size_t index) const {
+  return (OBJECT == type && index < length) ? members[index].value : NULL_VALUE;
+}
+
+JsonDocument::JsonDocument() {
+}
+
+bool JsonDocument::parse(const std::string & text) {
+  return parse(text.data(), text.size());
+}
+
+bool JsonDocument::parse(const char * data, size_t size) {
+  clear();
+  JsonBuilder builder(*this);
+  JsonReader reader;
+  if (!reader.parse(data, size, builder)) {
+    clear();
+    error = reader.getError();
+    return false;
+  }
+  return true;
+}
+
+const std::string & JsonDocument::getError() const {
+  return error;
+}
+
+const JsonValue & JsonDocument::getRoot() const {
+  return root;
+}
+
+const JsonValue & JsonDocument::operator[](const char * key) const {
+  return root[key];
+}
+
+size_t JsonDocument::getMemoryUsage() const {
+  return allocated;
+}
+
+void * JsonDocument::allocate(size_t bytes) {
+  // Empty arrays and objects
+  if (!bytes) {
+    return nullptr;
+  }
+  // Keep everything aligned for the doubles
+  bytes = (bytes + 7) & ~(size_t)7;
+  if (bytes > BLOCK_SIZE / 4) {
+    // Large arrays get a block of their own, kept out of the way of the
+    // block being filled
+    blocks.insert(blocks.begin(), std::unique_ptr<char[]>(new char[bytes]));
+    allocated += bytes;
+    return blocks.front().get();
+  }
+  if (blockUsed + bytes > BLOCK_SIZE) {
+    blocks.push_back(std::unique_ptr<char[]>(new char[BLOCK_SIZE]));
+    blockUsed = 0;
+    allocated += BLOCK_SIZE;
+  }
+  void * result = blocks.back().get() + blockUsed;
+  blockUsed += bytes;
+  return result;
+}
+
+void JsonDocument::clear() {
+  blocks.clear();
+  blockUsed = BLOCK_SIZE;
+  allocated = 0;
+  root = JsonValue();
+  error.clear();
+}
+
+static void extractArrays(const JsonValue & value, const std::string & name, size_t minimumCount, std::vector<JsonArrays::Array> & arrays) {
+  if (value.isObject()) {
+    for (size_t i = 0; i < value.size(); ++i) {
+      std::string memberName = name.empty() ? value.keyAt(i) : name + "." + value.keyAt(i);
+      extractArrays(value.valueAt(i), memberName, minimumCount, arrays);
+    }
+    return;
+  }
+  if (!value.isArray()) {
+    return;
+  }
+
+  std::vector<double> numbers;
+  if (value.size() < minimumCount || !value.getNumbers(numbers)) {
+    for (size_t i = 0; i < value.size(); ++i) {
+      extractArrays(value[(int)i], Platform::format("%s[%d]", name.c_str(), (int)i), minimumCount, arrays);
+    }
+    return;
+  }
+
+  bool integers = true;
+  double largest = 0;
+  for (double number : numbers) {
+    if (number < 0 || number != floor(number)) {
+      integers = false;
+      break;
+    }
+    largest = std::max(largest, number);
+  }
+
+  JsonArrays::Array array;
+  array.name = name;
+  array.count = numbers.size();
+  if (integers && largest <= 0xFFFF) {
+    array.type = JsonArrays::UINT16;
+    array.data.resize(array.count * sizeof(uint16_t));
+    uint16_t * target = (uint16_t *)&array.data[0];
+    for (size_t i = 0; i < array.count; ++i) {
+      target[i] = (uint16_t)numbers[i];
+    }
+  } else if (integers && largest <= 0xFFFFFFFF) {
+    array.type = JsonArrays::UINT32;
+    array.data.resize(array.count * sizeof(uint32_t));
+    uint32_t * target = (uint32_t *)&array.data[0];
+    for (size_t i = 0; i < array.count; ++i) {
+      target[i] = (uint32_t)numbers[i];
+    }
+  } else {
+    array.type = JsonArrays::FLOAT32;
+    array.data.resize(array.count * sizeof(float));
+    float * target = (float *)&array.data[0];
+    for (size_t i = 0; i < array.count; ++i) {
+      target[i] = (float)numbers[i];
+    }
+  }
+  arrays.push_back(array);
+}
+
+std::vector<JsonArrays::Array> JsonArrays::extract(const JsonValue & root, size_t minimumCount) {
+  std::vector<Array> result;
+  extractArrays(root, "", std::max<size_t>(1, minimumCount), result);
+  return result;
+}
+
+static const char FILE_TAG[4] = { 'J', 'S', 'N', 'A' };
+
+static void writeUint32(std::ostream & out, uint32_t value) {
+  out.write((const char *)&value, sizeof(value));
+}
+
+static void writePadded(std::ostream & out, const void * data, size_t size) {
+  static const char PADDING[4] = { 0 };
+  out.write((const char *)data, size);
+  out.write(PADDING, (4 - size % 4) % 4);
+}
+
+static bool readUint32(std::istream & in, uint32_t & value) {
+  return (bool)in.read((char *)&value, sizeof(value));
+}
+
+static bool readPadded(std::istream & in, void * data, size_t size) {
+  char padding[4];
+  return in.read((char *)data, size) && in.read(padding, (4 - size % 4) % 4);
+}
+
+bool JsonArrays::write(const std::string & path, const std::vector<Array> & arrays) {
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!out) {
+    return false;
+  }
+  out.write(FILE_TAG, sizeof(FILE_TAG));
+  writeUint32(out, VERSION);
+  writeUint32(out, (uint32_t)arrays.size());
+  for (const Array & array : arrays) {
+    writeUint32(out, (uint32_t)array.name.size());
+    writePadded(out, array.name.data(), array.name.size());
+    writeUint32(out, (uint32_t)array.type);
+    writeUint32(out, (uint32_t)array.count);
+    writePadded(out, array.data.data(), array.data.size());
+  }
+  return (bool)out;
+}
+
+bool JsonArrays::read(const std::string & path, std::vector<Array> & arrays) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char tag[4];
+  uint32_t version, count;
+  if (!in.read(tag, sizeof(tag)) || 0 != memcmp(tag, FILE_TAG, sizeof(tag)) ||
+    !readUint32(in, version) || VERSION != version || !readUint32(in, count)) {
+    return false;
+  }
+  arrays.resize(count);
+  for (Array & array : arrays) {
+    uint32_t nameLength, type, arrayCount;
+    if (!readUint32(in, nameLength)) {
+      return false;
+    }
+    array.name.resize(nameLength);
+    if (!readPadded(in, &array.name[0], nameLength) || !readUint32(in, type) || type > UINT32 || !readUint32(in, arrayCount)) {
+      return false;
+    }
+    array.type = (Type)type;
+    array.count = arrayCount;
+    array.data.resize(arrayCount * (UINT16 == array.type ? 2 : 4));
+    if (!readPadded(in, array.data.data(), array.data.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const JsonArrays::Array * JsonArrays::find(const std::vector<Array> & arrays, const std::string & name) {
+  for (const Array & array : arrays) {
+    if (array.name == name) {
+      return &array;
+    }
+  }
+  return nullptr;
+}
+
+const char * JsonArrays::typeName(Type type) {
+  switch (type) {
+  case UINT16:
+    return "uint16";
+  case UINT32:
+    return "uint32";
+  default:
+    return "float32";
+  }
+}
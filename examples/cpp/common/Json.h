@@ -0,0 +1,276 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// A JSON reader for assets too large to go through a tree of individually
+// allocated nodes, such as the distortion meshes the WebGL examples load.
+//
+// JsonReader is a streaming (SAX style) parser.  It walks the text once and
+// reports what it finds to a JsonHandler, skipping whitespace and scanning
+// strings 16 bytes at a time with SSE2 where it's available.  A handler that
+// expects an array of numbers can return a JsonNumberSink from startArray(),
+// and the numbers are then parsed in a tight loop and delivered in batches,
+// for example straight into a std::vector<float> through JsonNumbers.
+//
+// JsonDocument builds a read only tree on top of the reader.  The nodes,
+// strings and keys are all allocated from a few large blocks owned by the
+// document, so there's no per node allocation or free.
+//
+// Since the WebGL assets are scripts, a leading "var name =" and a trailing
+// semicolon are skipped.
+class JsonNumberSink {
+public:
+  virtual ~JsonNumberSink() {}
+  virtual void numbers(const double * values, size_t count) = 0;
+};
+
+// Appends the numbers of an array to a vector, converted to its type
+template <typename T>
+class JsonNumbers : public JsonNumberSink {
+public:
+  JsonNumbers(std::vector<T> & target) : target(target) {
+  }
+
+  virtual void numbers(const double * values, size_t count) {
+    size_t offset = target.size();
+    target.resize(offset + count);
+    for (size_t i = 0; i < count; ++i) {
+      target[offset + i] = (T)values[i];
+    }
+  }
+
+private:
+  std::vector<T> & target;
+};
+
+class JsonHandler {
+public:
+  virtual ~JsonHandler() {}
+  virtual void startObject() {}
+  virtual void endObject() {}
+  // Returning a sink means the array must contain only numbers, which go to
+  // the sink rather than number(), and it's an error if it doesn't
+  virtual JsonNumberSink * startArray() { return nullptr; }
+  virtual void endArray() {}
+  // Strings and keys are unescaped, and only valid during the call
+  virtual void key(const char * key, size_t length) {}
+  virtual void string(const char * value, size_t length) {}
+  virtual void number(double value) {}
+  virtual void boolean(bool value) {}
+  virtual void null() {}
+};
+
+class JsonReader {
+public:
+  static const int MAX_DEPTH = 256;
+
+  bool parse(const char * data, size_t size, JsonHandler & handler);
+  bool parse(const std::string & text, JsonHandler & handler);
+
+  // Describes why parse() failed, and where
+  const std::string & getError() const;
+  size_t getErrorOffset() const;
+
+  static bool isSimdEnabled();
+
+private:
+  const char * begin{ nullptr };
+  const char * end{ nullptr };
+  const char * cursor{ nullptr };
+  JsonHandler * handler{ nullptr };
+  std::string scratch;
+  std::string error;
+  size_t errorOffset{ 0 };
+
+  bool fail(const char * message);
+  void skipWhitespace();
+  bool parseValue(int depth);
+  bool parseObject(int depth);
+  bool parseArray(int depth);
+  bool parseNumbers(JsonNumberSink & sink);
+  bool parseString(const char * & value, size_t & length);
+  bool parseNumber(double & value);
+  bool parseLiteral(const char * literal, size_t length);
+};
+
+class JsonValue {
+public:
+  enum Type {
+    NUL,
+    BOOLEAN,
+    NUMBER,
+    STRING,
+    ARRAY,
+    OBJECT,
+  };
+
+  struct Member;
+
+  JsonValue();
+
+  Type getType() const;
+  bool isNull() const;
+  bool isNumber() const;
+  bool isString() const;
+  bool isArray() const;
+  bool isObject() const;
+
+  bool asBool(bool defaultValue = false) const;
+  double asNumber(double defaultValue = 0) const;
+  int asInt(int defaultValue = 0) const;
+  // Strings are null terminated
+  const char * asCString(const char * defaultValue = "") const;
+  std::string asString(const std::string & defaultValue = std::string()) const;
+
+  // The number of items or members, or the length of a string
+  size_t size() const;
+  // Missing items and members, and looking either up in the wrong type of
+  // value, give a null value
+  const JsonValue & operator[](int index) const;
+  const JsonValue & operator[](const char * key) const;
+  bool hasMember(const char * key) const;
+  const char * keyAt(size_t index) const;
+  const JsonValue & valueAt(size_t index) const;
+
+  // Copies an array of numbers into the vector, returning false if this
+  // isn't one
+  template <typename T>
+  bool getNumbers(std::vector<T> & target) const {
+    if (ARRAY != type) {
+      return false;
+    }
+    target.resize(length);
+    for (size_t i = 0; i < length; ++i) {
+      if (NUMBER != items[i].type) {
+        return false;
+      }
+      target[i] = (T)items[i].number;
+    }
+    return true;
+  }
+
+private:
+  friend class JsonDocument;
+  friend class JsonBuilder;
+
+  Type type;
+  uint32_t length;
+  union {
+    bool boolean;
+    double number;
+    const char * chars;
+    const JsonValue * items;
+    const Member * members;
+  };
+};
+
+struct JsonValue::Member {
+  const char * key;
+  JsonValue value;
+};
+
+class JsonDocument {
+public:
+  static const size_t BLOCK_SIZE = 64 * 1024;
+
+  JsonDocument();
+
+  bool parse(const char * data, size_t size);
+  bool parse(const std::string & text);
+  const std::string & getError() const;
+
+  const JsonValue & getRoot() const;
+  const JsonValue & operator[](const char * key) const;
+  // Memory allocated for the tree
+  size_t getMemoryUsage() const;
+
+private:
+  friend class JsonBuilder;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  size_t blockUsed{ BLOCK_SIZE };
+  size_t allocated{ 0 };
+  JsonValue root;
+  std::string error;
+
+  void * allocate(size_t bytes);
+  void clear();
+};
+
+// Numeric arrays taken out of a JSON document and stored as flat binary,
+// so that they can be loaded without parsing anything.  Each array is named
+// by its path in the document, such as "left.mesh.indices".  Arrays of
+// integers are stored in 16 or 32 bits if they fit, and everything else as
+// 32 bit floats.
+//
+// The file is a "JSNA" tag, a version and the number of arrays, followed
+// by each array's name, type, count and data, all padded to four bytes.
+// Everything is in the byte order of the machine that wrote it, which is
+// little endian on every platform the examples run on.
+class JsonArrays {
+public:
+  static const uint32_t VERSION = 1;
+
+  enum Type {
+    FLOAT32,
+    UINT16,
+    UINT32,
+  };
+
+  struct Array {
+    std::string name;
+    Type type{ FLOAT32 };
+    size_t count{ 0 };
+    std::vector<uint8_t> data;
+
+    template <typename T>
+    const T * as() const {
+      return (const T *)&data[0];
+    }
+    // Converts whatever the stored type is
+    template <typename T>
+    void copyTo(std::vector<T> & target) const {
+      target.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        switch (type) {
+        case UINT16:
+          target[i] = (T)as<uint16_t>()[i];
+          break;
+        case UINT32:
+          target[i] = (T)as<uint32_t>()[i];
+          break;
+        default:
+          target[i] = (T)as<float>()[i];
+          break;
+        }
+      }
+    }
+  };
+
+  // Collects every array of at least the minimum number of numbers in the
+  // document
+  static std::vector<Array> extract(const JsonValue & root, size_t minimumCount = 16);
+
+  static bool write(const std::string & path, const std::vector<Array> & arrays);
+  static bool read(const std::string & path, std::vector<Array> & arrays);
+  static const Array * find(const std::vector<Array> & arrays, const std::string & name);
+  static const char * typeName(Type type);
+};
@@ -0,0 +1,279 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LED_DETECTOR_SSE2 1
+#endif
+
+static bool overlaps(const LedDetector::Region & a, const LedDetector::Region & b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+    a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+LedDetector::LedDetector() {
+}
+
+LedDetector::LedDetector(const Settings & settings) : settings(settings) {
+}
+
+void LedDetector::reset() {
+  blobs.clear();
+  previousBlobs.clear();
+  regions.clear();
+}
+
+const std::vector<LedDetector::Blob> & LedDetector::detectFull(const uint8_t * pixels, int width, int height, size_t stride) {
+  framesSinceFullSearch = settings.fullSearchInterval;
+  return detect(pixels, width, height, stride);
+}
+
+const std::vector<LedDetector::Blob> & LedDetector::detect(const uint8_t * pixels, int width, int height, size_t stride) {
+  stats.detect.time([&] {
+    previousBlobs.swap(blobs);
+    bool full = previousBlobs.empty() || ++framesSinceFullSearch >= (uint64_t)settings.fullSearchInterval;
+    if (!full) {
+      if (!predictRegions(width, height) || !search(pixels, width, height, stride)) {
+        ++stats.recoveries;
+        full = true;
+      }
+    }
+    if (full) {
+      regions.clear();
+      regions.push_back(Region{ glm::ivec2(0), glm::ivec2(width, height) });
+      search(pixels, width, height, stride);
+      framesSinceFullSearch = 0;
+      ++stats.fullSearches;
+    }
+    updateVelocities();
+  });
+  ++stats.frames;
+  return blobs;
+}
+
+bool LedDetector::predictRegions(int width, int height) {
+  regions.clear();
+  for (const Blob & blob : previousBlobs) {
+    glm::ivec2 offset(glm::round(blob.velocity));
+    Region region;
+    region.min = glm::max(glm::ivec2(0), blob.min + offset - settings.regionMargin);
+    region.max = glm::min(glm::ivec2(width, height), blob.max + offset + settings.regionMargin + 1);
+    if (region.min.x >= region.max.x || region.min.y >= region.max.y) {
+      // Predicted to have left the frame
+      return false;
+    }
+    regions.push_back(region);
+  }
+
+  // Overlapping regions would find the same blob twice, so they're merged
+  for (size_t i = 0; i < regions.size(); ++i) {
+    for (size_t j = i + 1; j < regions.size(); ++j) {
+      if (overlaps(regions[i], regions[j])) {
+        regions[i].min = glm::min(regions[i].min, regions[j].min);
+        regions[i].max = glm::max(regions[i].max, regions[j].max);
+        regions.erase(regions.begin() + j);
+        // The grown region may now overlap ones already checked
+        j = i;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns false if any blob touched an edge of its region that isn't also
+// an edge of the image, since it may continue outside the region, or if
+// fewer blobs were found than were being tracked
+bool LedDetector::search(const uint8_t * pixels, int width, int height, size_t stride) {
+  blobs.clear();
+  bool complete = true;
+  for (const Region & region : regions) {
+    size_t first = blobs.size();
+    scanRegion(pixels, stride, region);
+    stats.pixelsSearched += (uint64_t)(region.max.x - region.min.x) * (region.max.y - region.min.y);
+    for (size_t i = first; i < blobs.size(); ++i) {
+      const Blob & blob = blobs[i];
+      if ((region.min.x > 0 && blob.min.x == region.min.x) ||
+        (region.min.y > 0 && blob.min.y == region.min.y) ||
+        (region.max.x < width && blob.max.x == region.max.x - 1) ||
+        (region.max.y < height && blob.max.y == region.max.y - 1)) {
+        complete = false;
+      }
+    }
+  }
+  return complete && blobs.size() >= previousBlobs.size();
+}
+
+void LedDetector::scanRegion(const uint8_t * pixels, size_t stride, const Region & region) {
+  previousRuns.clear();
+  parents.clear();
+  moments.clear();
+  const int threshold = settings.threshold;
+
+  for (int y = region.min.y; y < region.max.y; ++y) {
+    const uint8_t * row = pixels + y * stride;
+    currentRuns.clear();
+    findRuns(row, region.min.x, region.max.x);
+
+    // Both lists of runs are sorted, so the runs of the previous row that
+    // could touch this one start at or after the ones that touched the last
+    size_t first = 0;
+    for (Run & run : currentRuns) {
+      // Diagonal neighbours count as connected
+      while (first < previousRuns.size() && previousRuns[first].end + 1 < run.start) {
+        ++first;
+      }
+      uint32_t label = UINT32_MAX;
+      for (size_t i = first; i < previousRuns.size() && previousRuns[i].start <= run.end + 1; ++i) {
+        uint32_t other = findRoot(previousRuns[i].label);
+        if (UINT32_MAX == label) {
+          label = other;
+        } else if (other != label) {
+          // The smaller label always becomes the root
+          uint32_t root = std::min(label, other);
+          parents[std::max(label, other)] = root;
+          label = root;
+        }
+      }
+      if (UINT32_MAX == label) {
+        label = (uint32_t)parents.size();
+        parents.push_back(label);
+        moments.push_back(Moments());
+        moments.back().min = glm::ivec2(run.start, y);
+        moments.back().max = glm::ivec2(run.end, y);
+      }
+      run.label = label;
+
+      Moments & m = moments[label];
+      for (int x = run.start; x <= run.end; ++x) {
+        uint32_t weight = row[x] - threshold + 1;
+        m.m00 += weight;
+        m.m10 += weight * x;
+        m.m01 += weight * y;
+      }
+      m.area += run.end - run.start + 1;
+      m.min = glm::min(m.min, glm::ivec2(run.start, y));
+      m.max = glm::max(m.max, glm::ivec2(run.end, y));
+    }
+    previousRuns.swap(currentRuns);
+  }
+
+  // Fold the moments of the labels that were joined into their roots
+  for (uint32_t i = 0; i < (uint32_t)moments.size(); ++i) {
+    uint32_t root = findRoot(i);
+    if (root == i) {
+      continue;
+    }
+    Moments & target = moments[root];
+    const Moments & source = moments[i];
+    target.m00 += source.m00;
+    target.m10 += source.m10;
+    target.m01 += source.m01;
+    target.area += source.area;
+    target.min = glm::min(target.min, source.min);
+    target.max = glm::max(target.max, source.max);
+  }
+
+  for (uint32_t i = 0; i < (uint32_t)moments.size(); ++i) {
+    const Moments & m = moments[i];
+    if (parents[i] != i || m.area < settings.minArea || m.area > settings.maxArea) {
+      continue;
+    }
+    Blob blob;
+    blob.centroid = glm::vec2((double)m.m10 / m.m00, (double)m.m01 / m.m00);
+    blob.mass = (float)m.m00;
+    blob.area = m.area;
+    blob.min = m.min;
+    blob.max = m.max;
+    blobs.push_back(blob);
+  }
+}
+
+void LedDetector::findRuns(const uint8_t * row, int start, int end) {
+  int runStart = -1;
+  int x = start;
+#ifdef LED_DETECTOR_SSE2
+  // There's no unsigned byte compare, but max(v, t) == v exactly when v >= t
+  const __m128i threshold = _mm_set1_epi8((char)settings.threshold);
+  for (; x + 16 <= end; x += 16) {
+    __m128i values = _mm_loadu_si128((const __m128i *)(row + x));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(values, threshold), values));
+    if (0 == mask) {
+      if (runStart >= 0) {
+        currentRuns.push_back(Run{ runStart, x - 1, 0 });
+        runStart = -1;
+      }
+      continue;
+    }
+    if (0xFFFF == mask) {
+      if (runStart < 0) {
+        runStart = x;
+      }
+      continue;
+    }
+    for (int i = 0; i < 16; ++i) {
+      bool bright = 0 != (mask & (1 << i));
+      if (bright && runStart < 0) {
+        runStart = x + i;
+      } else if (!bright && runStart >= 0) {
+        currentRuns.push_back(Run{ runStart, x + i - 1, 0 });
+        runStart = -1;
+      }
+    }
+  }
+#endif
+  for (; x < end; ++x) {
+    bool bright = row[x] >= settings.threshold;
+    if (bright && runStart < 0) {
+      runStart = x;
+    } else if (!bright && runStart >= 0) {
+      currentRuns.push_back(Run{ runStart, x - 1, 0 });
+      runStart = -1;
+    }
+  }
+  if (runStart >= 0) {
+    currentRuns.push_back(Run{ runStart, end - 1, 0 });
+  }
+}
+
+uint32_t LedDetector::findRoot(uint32_t label) {
+  while (parents[label] != label) {
+    parents[label] = parents[parents[label]];
+    label = parents[label];
+  }
+  return label;
+}
+
+// Pairs each blob with the nearest one from the previous frame
+void LedDetector::updateVelocities() {
+  float maxDistance = (float)settings.regionMargin;
+  for (Blob & blob : blobs) {
+    float best = maxDistance * maxDistance;
+    blob.velocity = glm::vec2(0);
+    for (const Blob & previous : previousBlobs) {
+      glm::vec2 offset = blob.centroid - previous.centroid;
+      float distance = glm::dot(offset, offset);
+      if (distance < best) {
+        best = distance;
+        blob.velocity = offset;
+      }
+    }
+  }
+}
@@ -0,0 +1,155 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#pragma once
+
+// Finds small bright blobs, such as the tracking LEDs on the DK2 seen by
+// an IR camera, in an 8 bit single channel image.
+//
+// Almost all of such an image is dark background, so the detector works
+// on runs of pixels at or above the threshold rather than on the pixels
+// themselves.  Each row is scanned 16 pixels at a time with SSE2, skipping
+// dark spans with a single compare, and the runs it finds are labelled
+// against the runs of the previous row as they're found, with a union-find
+// to join blobs that turn out to be connected further down.  Thresholding
+// and labelling are therefore a single pass over the image, and the only
+// per-pixel work outside that pass is accumulating the intensity weighted
+// moments of the bright pixels.
+//
+// Once blobs have been found, the next frame only searches a region around
+// the predicted position of each of them, based on how far it moved in the
+// previous frame.  The whole frame is searched again every
+// fullSearchInterval frames to pick up LEDs that have come into view, and
+// immediately whenever a tracked blob is lost or runs into the edge of its
+// region.
+class LedDetector {
+public:
+  struct Blob {
+    // Intensity weighted centre, in pixels, where 0,0 is the centre of the
+    // top left pixel
+    glm::vec2 centroid;
+    // The sum of the weights, the brightness above the threshold
+    float mass{ 0 };
+    uint32_t area{ 0 };
+    // Inclusive bounds
+    glm::ivec2 min;
+    glm::ivec2 max;
+    // Movement since the previous frame, if the blob was tracked
+    glm::vec2 velocity;
+  };
+
+  // Half open, in pixels
+  struct Region {
+    glm::ivec2 min;
+    glm::ivec2 max;
+  };
+
+  struct Settings {
+    uint8_t threshold{ 128 };
+    uint32_t minArea{ 2 };
+    uint32_t maxArea{ 1000 };
+    // Added on each side of the predicted bounds of a tracked blob
+    int regionMargin{ 12 };
+    int fullSearchInterval{ 30 };
+  };
+
+  struct Stats {
+    TimingStats detect;
+    uint64_t frames{ 0 };
+    // Searches of the whole frame, including the periodic ones
+    uint64_t fullSearches{ 0 };
+    // Full searches forced by losing a blob
+    uint64_t recoveries{ 0 };
+    uint64_t pixelsSearched{ 0 };
+  };
+
+  LedDetector();
+  LedDetector(const Settings & settings);
+
+  // Finds the blobs in the image, using the previous frame to predict where
+  // to look.  The result remains valid until the next call.
+  const std::vector<Blob> & detect(const uint8_t * pixels, int width, int height, size_t stride);
+  // As above, but always searches the whole image
+  const std::vector<Blob> & detectFull(const uint8_t * pixels, int width, int height, size_t stride);
+
+  // Forgets the tracked blobs, so the next frame is a full search
+  void reset();
+
+  const std::vector<Blob> & getBlobs() const {
+    return blobs;
+  }
+
+  // The regions searched in the last frame
+  const std::vector<Region> & getRegions() const {
+    return regions;
+  }
+
+  const Settings & getSettings() const {
+    return settings;
+  }
+
+  void setThreshold(uint8_t threshold) {
+    settings.threshold = threshold;
+  }
+
+  const Stats & getStats() const {
+    return stats;
+  }
+
+  void resetStats() {
+    stats = Stats();
+  }
+
+private:
+  struct Run {
+    int start;
+    // Inclusive
+    int end;
+    uint32_t label;
+  };
+
+  struct Moments {
+    uint64_t m00{ 0 };
+    uint64_t m10{ 0 };
+    uint64_t m01{ 0 };
+    uint32_t area{ 0 };
+    glm::ivec2 min;
+    glm::ivec2 max;
+  };
+
+  Settings settings;
+  Stats stats;
+  std::vector<Blob> blobs;
+  std::vector<Blob> previousBlobs;
+  std::vector<Region> regions;
+  uint64_t framesSinceFullSearch{ 0 };
+
+  // Scratch space, kept between frames to avoid allocations
+  std::vector<Run> previousRuns;
+  std::vector<Run> currentRuns;
+  std::vector<uint32_t> parents;
+  std::vector<Moments> moments;
+
+  bool predictRegions(int width, int height);
+  bool search(const uint8_t * pixels, int width, int height, size_t stride);
+  void scanRegion(const uint8_t * pixels, size_t stride, const Region & region);
+  void findRuns(const uint8_t * row, int start, int end);
+  uint32_t findRoot(uint32_t label);
+  void updateVelocities();
+};
@@ -0,0 +1,672 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+#include <complex>
+#include <fstream>
+
+typedef LedPoseSolver::Transform Transform;
+
+// Rotation by |w| radians about w, with Rodrigues' formula
+static glm::dmat3 rotationFromVector(const glm::dvec3 & w) {
+  double angle = glm::length(w);
+  if (angle < 1e-12) {
+    return glm::dmat3(1.0);
+  }
+  glm::dvec3 k = w / angle;
+  double c = cos(angle), s = sin(angle), t = 1.0 - c;
+  return glm::dmat3(
+    glm::dvec3(c + k.x * k.x * t, k.y * k.x * t + k.z * s, k.z * k.x * t - k.y * s),
+    glm::dvec3(k.x * k.y * t - k.z * s, c + k.y * k.y * t, k.z * k.y * t + k.x * s),
+    glm::dvec3(k.x * k.z * t + k.y * s, k.y * k.z * t - k.x * s, c + k.z * k.z * t));
+}
+
+// Removes the drift that builds up from composing small rotations
+static glm::dmat3 orthonormalize(const glm::dmat3 & m) {
+  return glm::mat3_cast(glm::normalize(glm::quat_cast(m)));
+}
+
+static double angleBetween(const glm::dmat3 & a, const glm::dmat3 & b) {
+  glm::dmat3 difference = a * glm::transpose(b);
+  double trace = difference[0][0] + difference[1][1] + difference[2][2];
+  return acos(glm::clamp((trace - 1.0) / 2.0, -1.0, 1.0));
+}
+
+// An orthonormal frame with its x axis from a to b and b - a, c - a in its
+// xy plane
+static glm::dmat3 triad(const glm::dvec3 & a, const glm::dvec3 & b, const glm::dvec3 & c) {
+  glm::dvec3 x = glm::normalize(b - a);
+  glm::dvec3 z = glm::normalize(glm::cross(x, c - a));
+  return glm::dmat3(x, glm::cross(z, x), z);
+}
+
+// Finds the real roots of c[4] x^4 + c[3] x^3 + c[2] x^2 + c[1] x + c[0]
+// with the Durand-Kerner iteration, which converges on all four roots at
+// once without the cancellation problems of the closed form
+static int solveQuartic(const double c[5], double roots[4]) {
+  typedef std::complex<double> Complex;
+  if (fabs(c[4]) < 1e-12) {
+    return 0;
+  }
+  double b[4];
+  double bound = 0;
+  for (int i = 0; i < 4; ++i) {
+    b[i] = c[i] / c[4];
+    bound = std::max(bound, fabs(b[i]));
+  }
+  bound += 1.0;
+
+  auto evaluate = [&](const Complex & x) {
+    return (((x + b[3]) * x + b[2]) * x + b[1]) * x + b[0];
+  };
+  Complex z[4];
+  Complex seed(0.4, 0.9);
+  z[0] = bound * 0.5;
+  for (int i = 1; i < 4; ++i) {
+    z[i] = z[i - 1] * seed;
+  }
+  for (int iteration = 0; iteration < 50; ++iteration) {
+    double change = 0;
+    for (int i = 0; i < 4; ++i) {
+      Complex denominator = 1.0;
+      for (int j = 0; j < 4; ++j) {
+        if (i != j) {
+          denominator *= z[i] - z[j];
+        }
+      }
+      if (std::abs(denominator) < 1e-300) {
+        denominator = 1e-300;
+      }
+      Complex step = evaluate(z[i]) / denominator;
+      z[i] -= step;
+      change = std::max(change, std::abs(step));
+    }
+    // Clustered roots, which are common here, stall well above the machine
+    // precision, so this only aims for what the Newton polish can finish
+    if (change < 1e-9 * bound) {
+      break;
+    }
+  }
+
+  int count = 0;
+  for (int i = 0; i < 4; ++i) {
+    // Near double roots come out with small imaginary parts, and the callers
+    // check every solution anyway
+    if (fabs(z[i].imag()) > 1e-4 * (1.0 + fabs(z[i].real()))) {
+      continue;
+    }
+    double x = z[i].real();
+    // Polish on the real polynomial
+    for (int j = 0; j < 2; ++j) {
+      double f = (((x + b[3]) * x + b[2]) * x + b[1]) * x + b[0];
+      double df = ((4.0 * x + 3.0 * b[3]) * x + 2.0 * b[2]) * x + b[1];
+      if (fabs(df) > 1e-12) {
+        x -= f / df;
+      }
+    }
+    roots[count++] = x;
+  }
+  return count;
+}
+
+// Solves H x = g for a symmetric positive definite 6x6 H, by Cholesky
+// decomposition
+static bool solveNormalEquations(const double h[6][6], const double g[6], double x[6]) {
+  double l[6][6] = {};
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      double sum = h[i][j];
+      for (int k = 0; k < j; ++k) {
+        sum -= l[i][k] * l[j][k];
+      }
+      if (i == j) {
+        if (sum <= 0) {
+          return false;
+        }
+        l[i][i] = sqrt(sum);
+      } else {
+        l[i][j] = sum / l[j][j];
+      }
+    }
+  }
+  double y[6];
+  for (int i = 0; i < 6; ++i) {
+    double sum = g[i];
+    for (int k = 0; k < i; ++k) {
+      sum -= l[i][k] * y[k];
+    }
+    y[i] = sum / l[i][i];
+  }
+  for (int i = 5; i >= 0; --i) {
+    double sum = y[i];
+    for (int k = i + 1; k < 6; ++k) {
+      sum -= l[k][i] * x[k];
+    }
+    x[i] = sum / l[i][i];
+  }
+  return true;
+}
+
+bool LedPoseSolver::Model::load(const std::string & path) {
+  std::ifstream in(path.c_str());
+  positions.clear();
+  normals.clear();
+  glm::vec3 position, normal;
+  while (in >> position.x >> position.y >> position.z >> normal.x >> normal.y >> normal.z) {
+    positions.push_back(position);
+    normals.push_back(glm::normalize(normal));
+  }
+  return !positions.empty();
+}
+
+LedPoseSolver::Model LedPoseSolver::Model::createTest(unsigned int seed) {
+  struct Face {
+    glm::vec3 center;
+    glm::vec3 normal;
+    // Half the extent of the face along its two axes
+    glm::vec3 u;
+    glm::vec3 v;
+    int leds;
+  };
+  // The front of the headset faces -z, as in the SDK
+  static const Face FACES[] = {
+    { vec3(0, 0, -0.04f), vec3(0, 0, -1), vec3(0.08f, 0, 0), vec3(0, 0.045f, 0), 20 },
+    { vec3(-0.085f, 0, 0), vec3(-1, 0, 0), vec3(0, 0, 0.035f), vec3(0, 0.045f, 0), 5 },
+    { vec3(0.085f, 0, 0), vec3(1, 0, 0), vec3(0, 0, 0.035f), vec3(0, 0.045f, 0), 5 },
+    { vec3(0, 0.05f, 0), vec3(0, 1, 0), vec3(0.08f, 0, 0), vec3(0, 0, 0.035f), 6 },
+    { vec3(0, -0.05f, 0), vec3(0, -1, 0), vec3(0.08f, 0, 0), vec3(0, 0, 0.035f), 4 },
+  };
+  // Keeps the blobs from merging at the distances the camera works at
+  static const float MIN_SPACING = 0.015f;
+
+  Model result;
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  for (const Face & face : FACES) {
+    for (int placed = 0, attempts = 0; placed < face.leds && attempts < 1000; ++attempts) {
+      vec3 position = face.center + face.u * distribution(random) + face.v * distribution(random);
+      bool clear = true;
+      for (const vec3 & other : result.positions) {
+        clear &= glm::length(other - position) >= MIN_SPACING;
+      }
+      if (clear) {
+        result.positions.push_back(position);
+        result.normals.push_back(face.normal);
+        ++placed;
+      }
+    }
+  }
+  return result;
+}
+
+LedPoseSolver::LedPoseSolver(const Model & model, const Camera & camera)
+  : LedPoseSolver(model, camera, Settings()) {
+}
+
+LedPoseSolver::LedPoseSolver(const Model & model, const Camera & camera, const Settings & settings)
+  : model(model), camera(camera), settings(settings) {
+  findNeighbours();
+}
+
+void LedPoseSolver::reset() {
+  historySize = 0;
+}
+
+void LedPoseSolver::setOrientationPrior(const glm::dmat3 & rotation, double tolerance) {
+  hasPrior = true;
+  prior = rotation;
+  priorTolerance = tolerance;
+}
+
+void LedPoseSolver::clearOrientationPrior() {
+  hasPrior = false;
+}
+
+bool LedPoseSolver::fitsPrior(const Transform & pose) const {
+  return !hasPrior || angleBetween(pose.rotation, prior) <= priorTolerance;
+}
+
+void LedPoseSolver::findNeighbours() {
+  size_t count = model.positions.size();
+  neighbours.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    glm::dvec3 position(model.positions[i]);
+    glm::dvec3 normal(model.normals[i]);
+    std::vector<std::pair<double, int> > nearest;
+    for (size_t j = 0; j < count; ++j) {
+      // Only LEDs that are likely to be visible at the same time
+      if (i != j && glm::dot(model.normals[i], model.normals[j]) > 0.5f) {
+        nearest.push_back(std::make_pair(glm::length(glm::dvec3(model.positions[j]) - position), (int)j));
+      }
+    }
+    std::sort(nearest.begin(), nearest.end());
+    nearest.resize(std::min<size_t>(nearest.size(), 4));
+
+    // Sort by angle around the LED, clockwise as seen from the front, which
+    // is the order atan2 gives for image coordinates with y down
+    glm::dvec3 u = glm::normalize(glm::cross(normal,
+      fabs(normal.x) < 0.9 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 1, 0)));
+    glm::dvec3 v = glm::cross(normal, u);
+    std::vector<std::pair<double, int> > ordered;
+    for (const auto & entry : nearest) {
+      glm::dvec3 offset = glm::dvec3(model.positions[entry.second]) - position;
+      ordered.push_back(std::make_pair(-atan2(glm::dot(offset, v), glm::dot(offset, u)), entry.second));
+    }
+    std::sort(ordered.begin(), ordered.end());
+    neighbours[i].clear();
+    for (const auto & entry : ordered) {
+      neighbours[i].push_back(entry.second);
+    }
+  }
+}
+
+bool LedPoseSolver::project(const Transform & pose, int led, glm::dvec2 & out) const {
+  glm::dvec3 position = pose.rotation * glm::dvec3(model.positions[led]) + pose.translation;
+  if (position.z < 1e-6) {
+    return false;
+  }
+  glm::dvec3 normal = pose.rotation * glm::dvec3(model.normals[led]);
+  if (-glm::dot(normal, position) < settings.minFacing * glm::length(position)) {
+    return false;
+  }
+  out = glm::dvec2(
+    camera.focalLength.x * position.x / position.z + camera.principalPoint.x,
+    camera.focalLength.y * position.y / position.z + camera.principalPoint.y);
+  return true;
+}
+
+void LedPoseSolver::projectAll(const Transform & pose) {
+  size_t count = model.positions.size();
+  projected.resize(count);
+  visible.resize(count);
+  glm::dvec2 size(camera.size);
+  double margin = settings.matchDistance;
+  for (size_t i = 0; i < count; ++i) {
+    glm::dvec2 & point = projected[i];
+    visible[i] = project(pose, (int)i, point) &&
+      point.x > -margin && point.y > -margin &&
+      point.x < size.x + margin && point.y < size.y + margin;
+  }
+}
+
+// Pairs blobs and projected LEDs closest first, so each LED gets at most one
+// blob and vice versa.  Returns the number of pairs.
+int LedPoseSolver::match(const Transform & pose, const std::vector<glm::vec2> & blobs, float distance, std::vector<int> & leds) {
+  projectAll(pose);
+  candidates.clear();
+  double limit = distance * distance;
+  for (size_t b = 0; b < blobs.size(); ++b) {
+    glm::dvec2 blob(blobs[b]);
+    for (size_t i = 0; i < projected.size(); ++i) {
+      if (!visible[i]) {
+        continue;
+      }
+      glm::dvec2 offset = projected[i] - blob;
+      double squared = glm::dot(offset, offset);
+      if (squared < limit) {
+        candidates.push_back(Candidate{ squared, (int)b, (int)i });
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const Candidate & a, const Candidate & b) {
+    return a.distance < b.distance;
+  });
+
+  leds.assign(blobs.size(), -1);
+  taken.assign(projected.size(), 0);
+  int matched = 0;
+  for (const Candidate & candidate : candidates) {
+    if (-1 == leds[candidate.blob] && !taken[candidate.led]) {
+      leds[candidate.blob] = candidate.led;
+      taken[candidate.led] = 1;
+      ++matched;
+    }
+  }
+  return matched;
+}
+
+// Counts the blobs that lie close to an LED projected by projectAll
+int LedPoseSolver::countInliers(const std::vector<glm::vec2> & blobs) {
+  double limit = settings.inlierDistance * settings.inlierDistance;
+  int count = 0;
+  for (const glm::vec2 & blob : blobs) {
+    for (size_t i = 0; i < projected.size(); ++i) {
+      glm::dvec2 offset = projected[i] - glm::dvec2(blob);
+      if (visible[i] && glm::dot(offset, offset) < limit) {
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+// Gauss-Newton on the reprojection error of the paired blobs.  The update
+// is a small rotation w applied after the current one plus a translation t,
+// so each point p = R m + t moves by w x (R m) + t.
+bool LedPoseSolver::refine(Transform & pose, const std::vector<glm::vec2> & blobs, const std::vector<int> & leds) const {
+  const double fx = camera.focalLength.x, fy = camera.focalLength.y;
+  for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+    double h[6][6] = {};
+    double g[6] = {};
+    int pairs = 0;
+    for (size_t b = 0; b < blobs.size(); ++b) {
+      if (leds[b] < 0) {
+        continue;
+      }
+      glm::dvec3 q = pose.rotation * glm::dvec3(model.positions[leds[b]]);
+      glm::dvec3 p = q + pose.translation;
+      if (p.z < 1e-6) {
+        return false;
+      }
+      double iz = 1.0 / p.z;
+      double residual[2] = {
+        fx * p.x * iz + camera.principalPoint.x - blobs[b].x,
+        fy * p.y * iz + camera.principalPoint.y - blobs[b].y,
+      };
+      // Derivatives of the projection with respect to p
+      double dp[2][3] = {
+        { fx * iz, 0, -fx * p.x * iz * iz },
+        { 0, fy * iz, -fy * p.y * iz * iz },
+      };
+      // Derivatives of p with respect to w, the columns of -[q]x
+      double dw[3][3] = {
+        { 0, q.z, -q.y },
+        { -q.z, 0, q.x },
+        { q.y, -q.x, 0 },
+      };
+      for (int r = 0; r < 2; ++r) {
+        double j[6];
+        for (int c = 0; c < 3; ++c) {
+          j[c] = dp[r][0] * dw[0][c] + dp[r][1] * dw[1][c] + dp[r][2] * dw[2][c];
+          j[c + 3] = dp[r][c];
+        }
+        for (int a = 0; a < 6; ++a) {
+          g[a] -= j[a] * residual[r];
+          for (int c = 0; c <= a; ++c) {
+            h[a][c] += j[a] * j[c];
+          }
+        }
+      }
+      ++pairs;
+    }
+    if (pairs < 3) {
+      return false;
+    }
+    for (int a = 0; a < 6; ++a) {
+      for (int c = a + 1; c < 6; ++c) {
+        h[a][c] = h[c][a];
+      }
+    }
+
+    double step[6];
+    if (!solveNormalEquations(h, g, step)) {
+      return false;
+    }
+    glm::dvec3 w(step[0], step[1], step[2]);
+    glm::dvec3 t(step[3], step[4], step[5]);
+    pose.rotation = rotationFromVector(w) * pose.rotation;
+    pose.translation += t;
+    if (glm::length(w) < 1e-9 && glm::length(t) < 1e-9) {
+      break;
+    }
+  }
+  pose.rotation = orthonormalize(pose.rotation);
+  return true;
+}
+
+// Refines a pose from the initial pairing in result.leds, pairs the blobs
+// again and refines once more, then checks the reprojection error and
+// the orientation prior
+bool LedPoseSolver::finish(Transform & pose, const std::vector<glm::vec2> & blobs) {
+  if (result.matched < settings.minMatches || !refine(pose, blobs, result.leds)) {
+    return false;
+  }
+  result.matched = match(pose, blobs, settings.inlierDistance, result.leds);
+  if (result.matched < settings.minMatches || !refine(pose, blobs, result.leds)) {
+    return false;
+  }
+
+  double total = 0, maximum = 0;
+  for (size_t b = 0; b < blobs.size(); ++b) {
+    glm::dvec2 point;
+    if (result.leds[b] < 0) {
+      continue;
+    }
+    if (!project(pose, result.leds[b], point)) {
+      return false;
+    }
+    double error = glm::length(point - glm::dvec2(blobs[b]));
+    total += error * error;
+    maximum = std::max(maximum, error);
+  }
+  result.rmsError = (float)sqrt(total / result.matched);
+  result.maxError = (float)maximum;
+  result.pose = pose;
+  return result.rmsError <= settings.maxError && fitsPrior(pose);
+}
+
+// Extrapolates the motion between the two most recent poses
+Transform LedPoseSolver::predict() const {
+  if (historySize < 2) {
+    return history[0];
+  }
+  Transform result;
+  result.rotation = orthonormalize(history[0].rotation * glm::transpose(history[1].rotation) * history[0].rotation);
+  result.translation = history[0].translation * 2.0 - history[1].translation;
+  return result;
+}
+
+bool LedPoseSolver::track(const std::vector<glm::vec2> & blobs) {
+  Transform pose = predict();
+  result.matched = match(pose, blobs, settings.matchDistance, result.leds);
+  return finish(pose, blobs);
+}
+
+bool LedPoseSolver::reacquire(const std::vector<glm::vec2> & blobs) {
+  size_t count = blobs.size();
+  if (count < 4) {
+    return false;
+  }
+
+  // The three nearest neighbours of each blob, in the same angular order
+  // as the model neighbours
+  blobNeighbours.resize(count);
+  std::vector<std::pair<double, int> > nearest;
+  for (size_t i = 0; i < count; ++i) {
+    nearest.clear();
+    for (size_t j = 0; j < count; ++j) {
+      if (i != j) {
+        nearest.push_back(std::make_pair((double)glm::length(blobs[j] - blobs[i]), (int)j));
+      }
+    }
+    std::partial_sort(nearest.begin(), nearest.begin() + 3, nearest.end());
+    for (int k = 0; k < 3; ++k) {
+      glm::vec2 offset = blobs[nearest[k].second] - blobs[i];
+      nearest[k].first = atan2(offset.y, offset.x);
+    }
+    std::sort(nearest.begin(), nearest.begin() + 3);
+    for (int k = 0; k < 3; ++k) {
+      blobNeighbours[i][k] = nearest[k].second;
+    }
+  }
+
+  auto bearing = [&](const glm::vec2 & blob) {
+    return glm::normalize(glm::dvec3(
+      (blob.x - camera.principalPoint.x) / camera.focalLength.x,
+      (blob.y - camera.principalPoint.y) / camera.focalLength.y, 1.0));
+  };
+
+  std::vector<int> seeds(count);
+  for (size_t i = 0; i < count; ++i) {
+    seeds[i] = (int)i;
+  }
+  std::shuffle(seeds.begin(), seeds.end(), random);
+
+  // Stop early once a hypothesis explains most of the blobs
+  int goal = std::max(settings.minMatches, (int)ceil(0.75 * count));
+  int best = 0;
+  Transform bestPose;
+  int hypotheses = 0;
+  for (int seed : seeds) {
+    const std::array<int, 3> & around = blobNeighbours[seed];
+    glm::dvec3 bearings[3] = { bearing(blobs[seed]), bearing(blobs[around[0]]), bearing(blobs[around[1]]) };
+    const glm::vec2 & check = blobs[around[2]];
+
+    for (size_t led = 0; led < neighbours.size() && best < goal && hypotheses < settings.maxHypotheses; ++led) {
+      const std::vector<int> & ring = neighbours[led];
+      if (ring.size() < 3) {
+        continue;
+      }
+      // Every way of picking three of the neighbours that keeps their order
+      for (size_t skip = 0; skip < (ring.size() > 3 ? ring.size() : 1); ++skip) {
+        int triple[3];
+        for (size_t k = 0, n = 0; k < ring.size() && n < 3; ++k) {
+          if (ring.size() == 3 || k != skip) {
+            triple[n++] = ring[k];
+          }
+        }
+        // And every starting point
+        for (int rotation = 0; rotation < 3; ++rotation) {
+          glm::dvec3 points[3] = {
+            glm::dvec3(model.positions[led]),
+            glm::dvec3(model.positions[triple[rotation]]),
+            glm::dvec3(model.positions[triple[(rotation + 1) % 3]]),
+          };
+          int checkLed = triple[(rotation + 2) % 3];
+          Transform solutions[4];
+          int solutionCount = solveP3P(points, bearings, solutions);
+          ++hypotheses;
+          for (int s = 0; s < solutionCount; ++s) {
+            glm::dvec2 point;
+            if (!fitsPrior(solutions[s]) || !project(solutions[s], checkLed, point) ||
+              glm::length(point - glm::dvec2(check)) > 2.0 * settings.inlierDistance) {
+              continue;
+            }
+            projectAll(solutions[s]);
+            int inliers = countInliers(blobs);
+            if (inliers > best) {
+              best = inliers;
+              bestPose = solutions[s];
+            }
+          }
+        }
+      }
+    }
+    if (best >= goal || hypotheses >= settings.maxHypotheses) {
+      break;
+    }
+  }
+  result.hypotheses = hypotheses;
+  if (best < settings.minMatches) {
+    return false;
+  }
+
+  result.matched = match(bestPose, blobs, settings.inlierDistance, result.leds);
+  return finish(bestPose, blobs);
+}
+
+const LedPoseSolver::Result & LedPoseSolver::solve(const std::vector<glm::vec2> & blobs) {
+  ++stats.solves;
+  result.valid = false;
+  result.reacquired = false;
+  result.hypotheses = 0;
+
+  bool solved = false;
+  if (historySize > 0) {
+    stats.tracking.time([&] {
+      solved = track(blobs);
+    });
+  }
+  if (!solved) {
+    result.reacquired = true;
+    ++stats.reacquisitions;
+    stats.reacquiring.time([&] {
+      solved = reacquire(blobs);
+    });
+  }
+
+  if (!solved) {
+    ++stats.failures;
+    historySize = 0;
+    result.leds.assign(blobs.size(), -1);
+    result.matched = 0;
+    return result;
+  }
+
+  result.valid = true;
+  // The motion across a re-acquisition can't be trusted for prediction
+  history[1] = history[0];
+  history[0] = result.pose;
+  historySize = result.reacquired ? 1 : std::min(historySize + 1, 2);
+  return result;
+}
+
+// Grunert's solution, as presented by Haralick et al, "Review and analysis
+// of solutions of the three point perspective pose estimation problem".
+// With s1, s2 and s3 the distances to the points along their bearings, and
+// u = s2 / s1, v = s3 / s1, the law of cosines for the three pairs of
+// points gives a quartic in v.  Each positive root gives the three points
+// in camera space, and the transform is then the one between the two
+// triangles.
+int LedPoseSolver::solveP3P(const glm::dvec3 points[3], const glm::dvec3 bearings[3], Transform solutions[4]) {
+  glm::dvec3 bc = points[1] - points[2], ac = points[0] - points[2], ab = points[0] - points[1];
+  double a2 = glm::dot(bc, bc), b2 = glm::dot(ac, ac), c2 = glm::dot(ab, ab);
+  if (a2 < 1e-12 || b2 < 1e-12 || c2 < 1e-12) {
+    return 0;
+  }
+  double cosAlpha = glm::dot(bearings[1], bearings[2]);
+  double cosBeta = glm::dot(bearings[0], bearings[2]);
+  double cosGamma = glm::dot(bearings[0], bearings[1]);
+  double p = (a2 - c2) / b2;
+  double q = (a2 + c2) / b2;
+  double a2b2 = a2 / b2, c2b2 = c2 / b2, bc2b2 = (b2 - c2) / b2, ba2b2 = (b2 - a2) / b2;
+  double cosAlpha2 = cosAlpha * cosAlpha, cosBeta2 = cosBeta * cosBeta, cosGamma2 = cosGamma * cosGamma;
+
+  double coefficients[5];
+  coefficients[4] = (p - 1) * (p - 1) - 4 * c2b2 * cosAlpha2;
+  coefficients[3] = 4 * (p * (1 - p) * cosBeta - (1 - q) * cosAlpha * cosGamma + 2 * c2b2 * cosAlpha2 * cosBeta);
+  coefficients[2] = 2 * (p * p - 1 + 2 * p * p * cosBeta2 + 2 * bc2b2 * cosAlpha2
+    - 4 * q * cosAlpha * cosBeta * cosGamma + 2 * ba2b2 * cosGamma2);
+  coefficients[1] = 4 * (-p * (1 + p) * cosBeta + 2 * a2b2 * cosGamma2 * cosBeta - (1 - q) * cosAlpha * cosGamma);
+  coefficients[0] = (1 + p) * (1 + p) - 4 * a2b2 * cosGamma2;
+
+  double roots[4];
+  int rootCount = solveQuartic(coefficients, roots);
+  glm::dmat3 model = glm::transpose(triad(points[0], points[1], points[2]));
+  int count = 0;
+  for (int i = 0; i < rootCount; ++i) {
+    double v = roots[i];
+    double denominator = 2 * (cosGamma - v * cosAlpha);
+    if (v <= 0 || fabs(denominator) < 1e-12) {
+      continue;
+    }
+    double u = ((p - 1) * v * v - 2 * p * cosBeta * v + 1 + p) / denominator;
+    double s1Squared = b2 / (1 + v * v - 2 * v * cosBeta);
+    if (u <= 0 || s1Squared <= 0) {
+      continue;
+    }
+    double s1 = sqrt(s1Squared);
+    glm::dvec3 camera[3] = { bearings[0] * s1, bearings[1] * (u * s1), bearings[2] * (v * s1) };
+    Transform & solution = solutions[count++];
+    solution.rotation = triad(camera[0], camera[1], camera[2]) * model;
+    solution.translation = camera[0] - solution.rotation * points[0];
+  }
+  return count;
+}
@@ -0,0 +1,191 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#pragma once
+
+// Works out the pose of a rigid constellation of LEDs, such as the ones on
+// the DK2, from the centroids of the blobs a LedDetector finds in a camera
+// image.
+//
+// While tracking, the previous pose, extrapolated by the motion between the
+// two poses before it, is used to project the LEDs into the image, and each
+// blob is paired with the nearest projected LED.  The pose is refined with
+// Gauss-Newton on the reprojection error, then the blobs are paired again
+// with the refined pose and it's refined once more, to pick up LEDs that
+// the prediction missed and drop pairings that don't fit.
+//
+// When there's no previous pose, or tracking fails, the solver re-acquires
+// with RANSAC.  Each hypothesis pairs a blob and its three nearest
+// neighbours with an LED and three of its neighbours on the model, taken in
+// the same angular order, and solves P3P (Grunert's method) on three of
+// the pairs, with the fourth picking between the solutions.  The pose that
+// explains the most blobs is then refined the same way as when tracking.
+// Spurious blobs are only searched for at this point; while tracking, the
+// prediction is trusted to leave them unpaired.
+//
+// Camera coordinates follow the OpenCV convention: x right, y down and z
+// forward.  Image coordinates are in pixels, and blobs are expected to have
+// been undistorted already.
+class LedPoseSolver {
+public:
+  struct Camera {
+    glm::vec2 focalLength{ 700, 700 };
+    glm::vec2 principalPoint{ 640, 360 };
+    glm::uvec2 size{ 1280, 720 };
+  };
+
+  struct Model {
+    // In metres, in the frame of the tracked object
+    std::vector<glm::vec3> positions;
+    // Outward facing, unit length
+    std::vector<glm::vec3> normals;
+
+    // One LED per line, "x y z nx ny nz"
+    bool load(const std::string & path);
+    // A constellation with roughly the shape and LED count of a DK2, with
+    // the LEDs scattered at random over the front, sides and top
+    static Model createTest(unsigned int seed = 1);
+  };
+
+  // Takes model coordinates into camera coordinates
+  struct Transform {
+    glm::dmat3 rotation;
+    glm::dvec3 translation;
+  };
+
+  struct Settings {
+    // Blobs further than this from a predicted LED position aren't paired
+    // with it
+    float matchDistance{ 8.0f };
+    // How close a blob has to be to an LED projected with a solved pose
+    float inlierDistance{ 3.0f };
+    int minMatches{ 5 };
+    // Solutions with a larger RMS reprojection error are rejected
+    float maxError{ 2.0f };
+    int iterations{ 10 };
+    // The most P3P solves to try when re-acquiring
+    int maxHypotheses{ 20000 };
+    // LEDs are only visible when the cosine of the angle between their
+    // normal and the direction to the camera is at least this
+    float minFacing{ 0.2f };
+  };
+
+  struct Result {
+    bool valid{ false };
+    // Whether this pose came from RANSAC rather than the prediction
+    bool reacquired{ false };
+    Transform pose;
+    // The LED paired with each blob, or -1 for blobs that weren't paired
+    std::vector<int> leds;
+    int matched{ 0 };
+    // Reprojection error of the paired blobs, in pixels
+    float rmsError{ 0 };
+    float maxError{ 0 };
+    int hypotheses{ 0 };
+  };
+
+  struct Stats {
+    TimingStats tracking;
+    TimingStats reacquiring;
+    uint64_t solves{ 0 };
+    uint64_t reacquisitions{ 0 };
+    uint64_t failures{ 0 };
+  };
+
+  LedPoseSolver(const Model & model, const Camera & camera);
+  LedPoseSolver(const Model & model, const Camera & camera, const Settings & settings);
+
+  // Finds the pose for this frame's blobs.  The result remains valid until
+  // the next call.
+  const Result & solve(const std::vector<glm::vec2> & blobs);
+
+  // Forgets the previous poses, so the next solve re-acquires
+  void reset();
+
+  // Rejects solutions more than tolerance radians away from the given
+  // rotation, typically the orientation reported by the IMU of the tracked
+  // object, taken into the camera frame.  When only a roughly flat group of
+  // LEDs is visible two poses, tilted opposite ways, fit them almost
+  // equally well, and this is what picks between them.  Stays in effect
+  // until it's cleared, so it should be updated every frame.
+  void setOrientationPrior(const glm::dmat3 & rotation, double tolerance);
+  void clearOrientationPrior();
+
+  // Returns false if the LED faces away from the camera or is behind it
+  bool project(const Transform & pose, int led, glm::dvec2 & result) const;
+
+  const Result & getResult() const {
+    return result;
+  }
+
+  const Stats & getStats() const {
+    return stats;
+  }
+
+  void resetStats() {
+    stats = Stats();
+  }
+
+  // Finds the transforms that take the three points onto the rays along the
+  // unit bearings, returning the number of solutions (at most 4)
+  static int solveP3P(const glm::dvec3 points[3], const glm::dvec3 bearings[3], Transform solutions[4]);
+
+private:
+  Model model;
+  Camera camera;
+  Settings settings;
+  Stats stats;
+  Result result;
+  // Up to 4 neighbours of each LED that face roughly the same way, in
+  // clockwise order seen from the front
+  std::vector<std::vector<int> > neighbours;
+  std::mt19937 random;
+
+  bool hasPrior{ false };
+  glm::dmat3 prior;
+  double priorTolerance{ 0 };
+
+  // The most recent poses, newest first
+  Transform history[2];
+  int historySize{ 0 };
+
+  struct Candidate {
+    double distance;
+    int blob;
+    int led;
+  };
+
+  // Scratch space, kept between frames to avoid allocations
+  std::vector<glm::dvec2> projected;
+  std::vector<char> visible;
+  std::vector<Candidate> candidates;
+  std::vector<char> taken;
+  std::vector<std::array<int, 3> > blobNeighbours;
+
+  void findNeighbours();
+  Transform predict() const;
+  void projectAll(const Transform & pose);
+  int match(const Transform & pose, const std::vector<glm::vec2> & blobs, float distance, std::vector<int> & leds);
+  int countInliers(const std::vector<glm::vec2> & blobs);
+  bool refine(Transform & pose, const std::vector<glm::vec2> & blobs, const std::vector<int> & leds) const;
+  bool fitsPrior(const Transform & pose) const;
+  bool finish(Transform & pose, const std::vector<glm::vec2> & blobs);
+  bool track(const std::vector<glm::vec2> & blobs);
+  bool reacquire(const std::vector<glm::vec2> & blobs);
+};
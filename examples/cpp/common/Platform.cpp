@@ -93,6 +93,7 @@ void Platform::say(std::ostream & out, const char * message, ...) {
 }
 
 std::string Platform::getResourceString(Resource resource) {
+  PROFILE_SCOPE("Load resource");
   size_t size = Resources::getResourceSize(resource);
   char * data = new char[size];
   Resources::getResourceData(resource, data);
@@ -102,6 +103,7 @@ std::string Platform::getResourceString(Resource resource) {
 }
 
 std::vector<uint8_t> Platform::getResourceByteVector(Resource resource) {
+  PROFILE_SCOPE("Load resource");
   size_t size = Resources::getResourceSize(resource);
   std::vector<uint8_t> data; 
   data.resize(size);
@@ -0,0 +1,185 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+
+#include <ctime>
+#include <fstream>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL thread_local
+#endif
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  struct Event {
+    const char * name;
+    Profiler::Ticks start;
+    Profiler::Ticks end;
+  };
+
+  // Only the owning thread writes to a ring.  Readers copy the events and
+  // then discard any the owner may have overwritten in the meantime.  Rings
+  // outlive their threads, so the trace still shows threads that have
+  // since finished.
+  struct ThreadRing {
+    int id;
+    std::string name;
+    std::vector<Event> events;
+    std::atomic<uint64_t> written{ 0 };
+
+    ThreadRing(int id) : id(id), events(Profiler::RING_SIZE) {
+    }
+  };
+
+  typedef std::shared_ptr<ThreadRing> ThreadRingPtr;
+
+  std::mutex ringsMutex;
+  std::vector<ThreadRingPtr> rings;
+  // The reference the timestamps are converted against
+  const Profiler::Ticks startTicks = Profiler::now();
+  const Clock::time_point startTime = Clock::now();
+
+  PROFILER_THREAD_LOCAL ThreadRing * currentRing = nullptr;
+
+  ThreadRing * getRing() {
+    if (!currentRing) {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      rings.push_back(ThreadRingPtr(new ThreadRing((int)rings.size() + 1)));
+      rings.back()->name = Platform::format("Thread %d", rings.back()->id);
+      currentRing = rings.back().get();
+    }
+    return currentRing;
+  }
+
+  double ticksPerMicrosecond() {
+#ifdef PROFILER_USE_TSC
+    // Measured against the steady clock over the whole run so far, which is
+    // plenty accurate by the time anyone asks for a trace
+    if (Clock::now() - startTime < std::chrono::milliseconds(100)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    Profiler::Ticks ticks = Profiler::now();
+    double micros = std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+    return (double)(ticks - startTicks) / micros;
+#else
+    return 1000.0;
+#endif
+  }
+
+  std::string escape(const std::string & in) {
+    std::string result;
+    for (char c : in) {
+      if ('"' == c || '\\' == c) {
+        result += '\\';
+      }
+      result += c;
+    }
+    return result;
+  }
+}
+
+void Profiler::record(const char * name, Ticks start, Ticks end) {
+  ThreadRing * ring = getRing();
+  uint64_t index = ring->written.load(std::memory_order_relaxed);
+  // Keeps the overwrite of the slot from becoming visible before the count
+  // that tells readers it's being reused
+  std::atomic_thread_fence(std::memory_order_release);
+  Event & event = ring->events[index & (RING_SIZE - 1)];
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  ring->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const char * name) {
+  ThreadRing * ring = getRing();
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  ring->name = name;
+}
+
+bool Profiler::dump(const std::string & path, double seconds) {
+  double tickRate = ticksPerMicrosecond();
+  Ticks current = now();
+  Ticks span = (Ticks)(seconds * 1e6 * tickRate);
+  Ticks cutoff = current - startTicks > span ? current - span : startTicks;
+
+  std::vector<ThreadRingPtr> threads;
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    threads = rings;
+    for (const ThreadRingPtr & ring : rings) {
+      names.push_back(ring->name);
+    }
+  }
+
+  std::ofstream out(path.c_str());
+  if (!out) {
+    return false;
+  }
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Oculus Rift in Action\"}}";
+  std::vector<Event> events;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    ThreadRing & ring = *threads[i];
+    out << Platform::format(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+      ring.id, escape(names[i]).c_str());
+    out << Platform::format(",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+      ring.id, ring.id);
+
+    uint64_t written = ring.written.load(std::memory_order_acquire);
+    uint64_t first = written > RING_SIZE ? written - RING_SIZE : 0;
+    events.clear();
+    for (uint64_t index = first; index < written; ++index) {
+      events.push_back(ring.events[index & (RING_SIZE - 1)]);
+    }
+    // Anything at or before the slot the owner is writing now may be torn.
+    // The fence keeps the copies above from moving below the re-check.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = ring.written.load(std::memory_order_relaxed);
+    uint64_t valid = after >= RING_SIZE ? after - RING_SIZE + 1 : 0;
+    for (uint64_t index = std::max(first, valid); index < written; ++index) {
+      const Event & event = events[(size_t)(index - first)];
+      if (event.end < cutoff || event.start < startTicks) {
+        continue;
+      }
+      out << Platform::format(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%0.3f,\"dur\":%0.3f}",
+        escape(event.name).c_str(), ring.id, (double)(event.start - startTicks) / tickRate,
+        (double)(event.end - event.start) / tickRate);
+    }
+  }
+  out << "\n]}\n";
+  return (bool)out;
+}
+
+void Profiler::dumpToFile(double seconds) {
+  char stamp[32];
+  std::time_t time = std::time(nullptr);
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&time));
+  std::string path = Platform::format("trace_%s.json", stamp);
+  if (dump(path, seconds)) {
+    SAY("Wrote the last %0.0f seconds of profiling to %s", seconds, path.c_str());
+  } else {
+    SAY_ERR("Unable to write a profiling trace to %s", path.c_str());
+  }
+}
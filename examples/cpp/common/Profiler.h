@@ -0,0 +1,92 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// A scoped CPU profiler, for finding out where the time went when a frame
+// misses.  PROFILE_SCOPE("name") records the time from that point to the end
+// of the enclosing scope into a ring buffer belonging to the current thread,
+// without taking any locks, and dump() writes the last few seconds of every
+// thread's events as a Chrome trace (load it in chrome://tracing).
+//
+// Names must be string literals, or otherwise outlive the profiler, as only
+// the pointer is stored.  Define NO_PROFILING to compile the scopes out.
+class Profiler {
+public:
+  // Events each thread keeps, about 20 seconds' worth at a few dozen scopes
+  // per frame and 75 frames per second.  Must be a power of two.
+  static const size_t RING_SIZE = 1 << 15;
+
+  // Raw timestamps, from the TSC on x86 and the steady clock elsewhere
+  typedef uint64_t Ticks;
+
+  static Ticks now();
+  static void record(const char * name, Ticks start, Ticks end);
+
+  // Names the calling thread in the trace
+  static void setThreadName(const char * name);
+
+  // Writes the events of the last seconds from all threads as Chrome
+  // trace_event JSON
+  static bool dump(const std::string & path, double seconds = 10.0);
+  // Dumps to a time stamped file in the working directory, logging where
+  static void dumpToFile(double seconds = 10.0);
+
+  class Scope {
+    const char * name;
+    Ticks start;
+
+  public:
+    Scope(const char * name) : name(name), start(now()) {
+    }
+
+    ~Scope() {
+      record(name, start, now());
+    }
+  };
+};
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+#define PROFILER_USE_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+inline Profiler::Ticks Profiler::now() {
+#ifdef PROFILER_USE_TSC
+  // Assumes an invariant TSC, which every CPU able to drive a Rift has
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef NO_PROFILING
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
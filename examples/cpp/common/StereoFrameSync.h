@@ -0,0 +1,162 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Pairs up the frames from two independently running cameras, so that a
+// stereo display only ever shows left and right images captured at (close
+// to) the same moment.
+//
+// Each camera pushes its frames from its own capture thread, stamped with
+// a monotonic clock, into a small ring.  Whenever a frame arrives the
+// oldest frames of both rings are compared:
+// - If they're further apart than the tolerance, the older one can never be
+//   matched, since everything the other camera delivers from now on is
+//   later still, so it's dropped.
+// - If they're within the tolerance they're paired, unless the next frame
+//   from the same camera as the older one is already waiting and is an even
+//   closer match, in which case the older one is dropped in its favor.
+//
+// Matched pairs are queued for presentation.  The queue depth is the drop
+// policy: with a depth of 1 (the default) the consumer always gets the most
+// recent pair and any pair it didn't pick up in time is dropped, while a
+// deeper queue presents every pair in order, at the cost of latency.
+//
+// T should be cheap to move; the pairing itself never looks at it.
+template <typename T>
+class StereoFrameSync {
+public:
+  static const size_t RING_SIZE = 4;
+
+  struct Frame {
+    double timestamp{ 0 };
+    T data;
+  };
+
+  struct Pair {
+    Frame frames[2];
+
+    // Right minus left, in seconds
+    double getSkew() const {
+      return frames[1].timestamp - frames[0].timestamp;
+    }
+  };
+
+  struct Stats {
+    // Absolute difference between the capture times of each matched pair
+    TimingStats skew;
+    size_t pairs{ 0 };
+    // Frames from each camera that never found a partner, either because
+    // none arrived within the tolerance or because the ring overflowed
+    size_t unmatched[2]{ 0, 0 };
+    // Pairs replaced in the presentation queue before they were picked up
+    size_t droppedPairs{ 0 };
+  };
+
+private:
+  typedef std::lock_guard<std::mutex> Lock;
+
+  mutable std::mutex mutex;
+  std::deque<Frame> rings[2];
+  std::deque<Pair> pending;
+  double tolerance;
+  size_t queueDepth;
+  Stats stats;
+
+  void match() {
+    while (!rings[0].empty() && !rings[1].empty()) {
+      Frame & left = rings[0].front();
+      Frame & right = rings[1].front();
+      double skew = right.timestamp - left.timestamp;
+      int older = skew > 0 ? 0 : 1;
+      if (std::abs(skew) > tolerance) {
+        rings[older].pop_front();
+        ++stats.unmatched[older];
+        continue;
+      }
+
+      std::deque<Frame> & olderRing = rings[older];
+      const Frame & newer = rings[1 - older].front();
+      if (olderRing.size() > 1 &&
+          std::abs(olderRing[1].timestamp - newer.timestamp) < std::abs(skew)) {
+        olderRing.pop_front();
+        ++stats.unmatched[older];
+        continue;
+      }
+
+      if (pending.size() >= queueDepth) {
+        pending.pop_front();
+        ++stats.droppedPairs;
+      }
+      pending.push_back(Pair());
+      Pair & pair = pending.back();
+      pair.frames[0] = std::move(left);
+      pair.frames[1] = std::move(right);
+      rings[0].pop_front();
+      rings[1].pop_front();
+      stats.skew.add(std::abs(skew) * 1000.0);
+      ++stats.pairs;
+    }
+  }
+
+public:
+  // Tolerance in seconds, typically around half a frame interval
+  StereoFrameSync(double tolerance = 0.008, size_t queueDepth = 1)
+    : tolerance(tolerance), queueDepth(std::max<size_t>(queueDepth, 1)) {
+  }
+
+  // Called from the capture thread of the given camera (0 for left, 1 for
+  // right).  Timestamps from each camera must be increasing.
+  void push(int camera, double timestamp, T && data) {
+    assert(0 == camera || 1 == camera);
+    Lock lock(mutex);
+    std::deque<Frame> & ring = rings[camera];
+    if (ring.size() >= RING_SIZE) {
+      ring.pop_front();
+      ++stats.unmatched[camera];
+    }
+    ring.push_back(Frame());
+    ring.back().timestamp = timestamp;
+    ring.back().data = std::move(data);
+    match();
+  }
+
+  // Takes the next matched pair for presentation, returning false if there
+  // isn't a new one
+  bool getPair(Pair & result) {
+    Lock lock(mutex);
+    if (pending.empty()) {
+      return false;
+    }
+    result = std::move(pending.front());
+    pending.pop_front();
+    return true;
+  }
+
+  Stats getStats() const {
+    Lock lock(mutex);
+    return stats;
+  }
+
+  void resetStats() {
+    Lock lock(mutex);
+    stats = Stats();
+  }
+};
@@ -0,0 +1,693 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+#include "TiledPanorama.h"
+
+#ifdef HAVE_OPENCV
+
+namespace {
+  const char * GPANO_PROPERTIES[] = {
+    "FullPanoWidthPixels",
+    "FullPanoHeightPixels",
+    "CroppedAreaLeftPixels",
+    "CroppedAreaTopPixels",
+    "CroppedAreaImageWidthPixels",
+    "CroppedAreaImageHeightPixels",
+  };
+
+  const char XMP_NAMESPACE[] = "http://ns.adobe.com/xap/1.0/";
+
+  // The fill outside the cropped area of a partial panorama
+  const uint8_t BACKGROUND = 84;
+
+  // Finds the value following GPano:name, either as an attribute or as the
+  // content of an element
+  bool findProperty(const std::string & xmp, const std::string & name, int & result) {
+    std::string tag = "GPano:" + name;
+    for (size_t pos = xmp.find(tag); pos != std::string::npos; pos = xmp.find(tag, pos + 1)) {
+      size_t next = xmp.find_first_not_of(" \t\r\n", pos + tag.size());
+      if (next == std::string::npos) {
+        return false;
+      }
+      if (xmp[next] == '=') {
+        next = xmp.find_first_not_of(" \t\r\n", next + 1);
+        if (next == std::string::npos || (xmp[next] != '"' && xmp[next] != '\'')) {
+          continue;
+        }
+        ++next;
+      } else if (xmp[next] == '>') {
+        ++next;
+      } else {
+        continue;
+      }
+      const char * start = xmp.c_str() + next;
+      char * end = nullptr;
+      long value = strtol(start, &end, 10);
+      if (end != start) {
+        result = (int)value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int roundUp(int value, int multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+  }
+
+  // Enough levels for the coarsest to fit in a single tile
+  int levelsFor(const glm::uvec2 & size) {
+    int level = 0;
+    while ((size.x >> level) > (unsigned)TiledPanorama::TILE_SIZE || (size.y >> level) > (unsigned)TiledPanorama::TILE_SIZE) {
+      ++level;
+    }
+    return level + 1;
+  }
+
+  glm::uvec2 scaled(const glm::uvec2 & value, const glm::dvec2 & scale) {
+    return glm::uvec2(glm::round(glm::dvec2(value) * scale));
+  }
+}
+
+bool PanoramaMetadata::parseXmp(const std::string & xmp, PanoramaMetadata & result) {
+  int values[6];
+  for (int i = 0; i < 6; ++i) {
+    if (!findProperty(xmp, GPANO_PROPERTIES[i], values[i]) || values[i] < 0) {
+      return false;
+    }
+  }
+  result.fullSize = glm::uvec2(values[0], values[1]);
+  result.croppedPosition = glm::uvec2(values[2], values[3]);
+  result.croppedSize = glm::uvec2(values[4], values[5]);
+  result.valid = result.fullSize.x && result.fullSize.y && result.croppedSize.x && result.croppedSize.y;
+  return result.valid;
+}
+
+std::string PanoramaMetadata::findXmp(const std::vector<uint8_t> & jpeg) {
+  if (jpeg.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+    return std::string();
+  }
+  size_t pos = 2;
+  while (pos + 4 <= jpeg.size()) {
+    if (jpeg[pos] != 0xFF) {
+      break;
+    }
+    uint8_t marker = jpeg[pos + 1];
+    // Padding
+    if (marker == 0xFF) {
+      ++pos;
+      continue;
+    }
+    // The metadata segments all come before the image data
+    if (marker == 0xDA || marker == 0xD9) {
+      break;
+    }
+    size_t length = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+    size_t data = pos + 4;
+    size_t end = pos + 2 + length;
+    if (length < 2 || end > jpeg.size()) {
+      break;
+    }
+    // APP1 segments hold either Exif or XMP data, the latter starting with
+    // the namespace and a null
+    if (marker == 0xE1 && end - data > sizeof(XMP_NAMESPACE) &&
+      0 == memcmp(&jpeg[data], XMP_NAMESPACE, sizeof(XMP_NAMESPACE))) {
+      return std::string((const char *)&jpeg[data + sizeof(XMP_NAMESPACE)], end - data - sizeof(XMP_NAMESPACE));
+    }
+    pos = end;
+  }
+  return std::string();
+}
+
+TiledPanorama::TiledPanorama() {
+  loader = std::thread([this] { loaderLoop(); });
+}
+
+TiledPanorama::~TiledPanorama() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    quit = true;
+  }
+  workAvailable.notify_all();
+  loader.join();
+}
+
+void TiledPanorama::load(const std::vector<uint8_t> & jpeg, const PanoramaMetadata & fallback) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    this->jpeg = jpeg;
+    this->fallback = fallback;
+    loadStart = std::chrono::high_resolution_clock::now();
+    loadPending = true;
+    failed = false;
+    levelCount = 0;
+    levels.clear();
+    offsets.clear();
+    ready.clear();
+    requests.clear();
+    copied.clear();
+    stats = Stats();
+  }
+  workAvailable.notify_all();
+}
+
+double TiledPanorama::millisSinceLoad() const {
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+}
+
+bool TiledPanorama::isFailed() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return failed;
+}
+
+int TiledPanorama::getLevelCount() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return levelCount;
+}
+
+bool TiledPanorama::isLevelReady(int level) const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return level >= 0 && level < levelCount && ready[level];
+}
+
+glm::uvec2 TiledPanorama::getSize(int level) const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return glm::uvec2(metadata.fullSize.x >> level, metadata.fullSize.y >> level);
+}
+
+glm::uvec2 TiledPanorama::getTileCount(int level) const {
+  glm::uvec2 size = getSize(level);
+  return (size + glm::uvec2(TILE_SIZE - 1)) / glm::uvec2(TILE_SIZE);
+}
+
+PanoramaMetadata TiledPanorama::getMetadata() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return metadata;
+}
+
+TiledPanorama::Stats TiledPanorama::getStats() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return stats;
+}
+
+size_t TiledPanorama::getMemoryUsage() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  size_t result = 0;
+  for (size_t i = 0; i < levels.size(); ++i) {
+    if (ready[i]) {
+      result += levels[i].total() * levels[i].elemSize();
+    }
+  }
+  return result;
+}
+
+void TiledPanorama::requestTile(const PanoramaTile & tile) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    requests.push_back(tile);
+  }
+  workAvailable.notify_one();
+}
+
+void TiledPanorama::takeTiles(std::vector<Tile> & result, size_t max) {
+  result.clear();
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!copied.empty() && result.size() < max) {
+    result.push_back(Tile());
+    result.back().id = copied.front().id;
+    result.back().pixels.swap(copied.front().pixels);
+    copied.pop_front();
+  }
+}
+
+bool TiledPanorama::copyTile(const PanoramaTile & tile, uint8_t * bgra) const {
+  cv::Mat image;
+  glm::ivec2 offset, size;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (tile.level < 0 || tile.level >= levelCount || !ready[tile.level]) {
+      return false;
+    }
+    image = levels[tile.level];
+    offset = offsets[tile.level];
+    size = glm::ivec2(metadata.fullSize.x >> tile.level, metadata.fullSize.y >> tile.level);
+  }
+
+  int x0 = tile.x * TILE_SIZE - TILE_BORDER;
+  int y0 = tile.y * TILE_SIZE - TILE_BORDER;
+  uint8_t * out = bgra;
+  for (int row = 0; row < SLOT_SIZE; ++row) {
+    int y = std::max(0, std::min(size.y - 1, y0 + row)) - offset.y;
+    const uint8_t * source = (y >= 0 && y < image.rows) ? image.ptr<uint8_t>(y) : nullptr;
+    for (int column = 0; column < SLOT_SIZE; ++column, out += 4) {
+      int x = (x0 + column) % size.x;
+      if (x < 0) {
+        x += size.x;
+      }
+      x -= offset.x;
+      if (source && x >= 0 && x < image.cols) {
+        const uint8_t * pixel = source + x * 3;
+        out[0] = pixel[0];
+        out[1] = pixel[1];
+        out[2] = pixel[2];
+      } else {
+        out[0] = out[1] = out[2] = BACKGROUND;
+      }
+      out[3] = 255;
+    }
+  }
+  return true;
+}
+
+void TiledPanorama::loaderLoop() {
+  Profiler::setThreadName("Panorama loader");
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    workAvailable.wait(lock, [&] {
+      return quit || loadPending || !requests.empty();
+    });
+    if (quit) {
+      break;
+    }
+    if (loadPending) {
+      loadPending = false;
+      lock.unlock();
+      PROFILE_SCOPE("Decode panorama");
+      decode();
+    } else {
+      lock.unlock();
+      // Every level is ready by now, so anything left is a bad request
+      copyRequested(true);
+    }
+    lock.lock();
+  }
+}
+
+void TiledPanorama::copyRequested(bool dropUnready) {
+  std::unique_lock<std::mutex> lock(mutex);
+  std::deque<PanoramaTile> waiting;
+  while (!requests.empty() && !quit && !loadPending) {
+    PanoramaTile tile = requests.front();
+    requests.pop_front();
+    if (tile.level < 0 || tile.level >= levelCount || !ready[tile.level]) {
+      if (!dropUnready) {
+        waiting.push_back(tile);
+      }
+      continue;
+    }
+    lock.unlock();
+    Tile result;
+    result.id = tile;
+    result.pixels.resize(TILE_BYTES);
+    auto start = std::chrono::high_resolution_clock::now();
+    bool copiedTile;
+    {
+      PROFILE_SCOPE("Copy tile");
+      copiedTile = copyTile(tile, &result.pixels[0]);
+    }
+    double millis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    lock.lock();
+    if (copiedTile) {
+      stats.tileCopy.add(millis);
+      copied.push_back(Tile());
+      copied.back().id = tile;
+      copied.back().pixels.swap(result.pixels);
+    }
+  }
+  requests.insert(requests.begin(), waiting.begin(), waiting.end());
+}
+
+void TiledPanorama::publishLevel(int level, const cv::Mat & image) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    glm::dvec2 scale(1.0 / (1 << level));
+    levels[level] = image;
+    offsets[level] = glm::ivec2(glm::round(glm::dvec2(metadata.croppedPosition) * scale));
+    ready[level] = true;
+  }
+  // Serve the requests for the new level before building the next one
+  copyRequested(false);
+}
+
+void TiledPanorama::decode() {
+  std::vector<uint8_t> data;
+  PanoramaMetadata info;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    data.swap(jpeg);
+    info = fallback;
+  }
+  PanoramaMetadata parsed;
+  if (PanoramaMetadata::parseXmp(PanoramaMetadata::findXmp(data), parsed)) {
+    info = parsed;
+  }
+
+  cv::Mat image = cv::imdecode(data, CV_LOAD_IMAGE_COLOR);
+  // The compressed data isn't needed any more
+  std::vector<uint8_t>().swap(data);
+  if (image.empty()) {
+    std::unique_lock<std::mutex> lock(mutex);
+    failed = true;
+    return;
+  }
+  double decodeMillis = millisSinceLoad();
+
+  glm::uvec2 imageSize(image.cols, image.rows);
+  if (!info.valid) {
+    info.fullSize = info.croppedSize = imageSize;
+    info.croppedPosition = glm::uvec2(0);
+    info.valid = true;
+  } else if (info.croppedSize != imageSize) {
+    // The image has been resized since the metadata was written
+    glm::dvec2 scale = glm::dvec2(imageSize) / glm::dvec2(info.croppedSize);
+    info.fullSize = scaled(info.fullSize, scale);
+    info.croppedPosition = scaled(info.croppedPosition, scale);
+    info.croppedSize = imageSize;
+  }
+  info.fullSize = glm::max(info.fullSize, info.croppedPosition + info.croppedSize);
+
+  // Every level has to be exactly half the size of the one below it, for
+  // the tiles of one level to line up with those of the next, so the
+  // panorama is resampled if its size isn't a multiple of the size of the
+  // coarsest level
+  int count = levelsFor(info.fullSize);
+  glm::uvec2 aligned = info.fullSize;
+  while (true) {
+    int multiple = 1 << (count - 1);
+    aligned = glm::uvec2(roundUp(info.fullSize.x, multiple), roundUp(info.fullSize.y, multiple));
+    int alignedCount = levelsFor(aligned);
+    if (alignedCount == count) {
+      break;
+    }
+    count = alignedCount;
+  }
+  if (aligned != info.fullSize) {
+    glm::dvec2 scale = glm::dvec2(aligned) / glm::dvec2(info.fullSize);
+    info.fullSize = aligned;
+    info.croppedPosition = scaled(info.croppedPosition, scale);
+    info.croppedSize = glm::max(glm::uvec2(1), scaled(info.croppedSize, scale));
+    cv::resize(image, image, cv::Size(info.croppedSize.x, info.croppedSize.y), 0, 0, cv::INTER_AREA);
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    metadata = info;
+    levelCount = count;
+    levels.assign(count, cv::Mat());
+    offsets.assign(count, glm::ivec2(0));
+    ready.assign(count, false);
+    stats.decodeMillis = decodeMillis;
+  }
+
+  auto levelSize = [&](int level) {
+    glm::dvec2 size = glm::round(glm::dvec2(info.croppedSize) / (double)(1 << level));
+    return cv::Size(std::max(1, (int)size.x), std::max(1, (int)size.y));
+  };
+
+  publishLevel(0, image);
+  // The coarsest level goes straight from the full image, so there's
+  // something to show as soon as possible
+  if (count > 1) {
+    cv::Mat coarsest;
+    cv::resize(image, coarsest, levelSize(count - 1), 0, 0, cv::INTER_AREA);
+    publishLevel(count - 1, coarsest);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stats.firstLevelMillis = millisSinceLoad();
+  }
+  cv::Mat previous = image;
+  for (int level = 1; level < count - 1; ++level) {
+    cv::Mat result;
+    cv::resize(previous, result, levelSize(level), 0, 0, cv::INTER_AREA);
+    publishLevel(level, result);
+    previous = result;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  stats.pyramidMillis = millisSinceLoad();
+}
+
+TileResidency::TileResidency(TiledPanorama & panorama) : panorama(panorama) {
+}
+
+TileResidency::TileResidency(TiledPanorama & panorama, const Settings & settings)
+  : panorama(panorama), settings(settings) {
+}
+
+void TileResidency::initialize() {
+  levelCount = panorama.getLevelCount();
+  levelSizes.clear();
+  tileCounts.clear();
+  levelRows.clear();
+  int rows = 0;
+  for (int level = 0; level < levelCount; ++level) {
+    levelSizes.push_back(panorama.getSize(level));
+    tileCounts.push_back(panorama.getTileCount(level));
+    levelRows.push_back(rows);
+    rows += tileCounts.back().y;
+  }
+  pageTableSize = glm::uvec2(tileCounts[0].x, rows);
+  PageEntry empty = { 0, 0, 0, 0 };
+  pageTable.assign(pageTableSize.x * pageTableSize.y, empty);
+
+  // Popped from the back, so filled from the first slot on
+  freeSlots.clear();
+  for (int y = settings.slots.y - 1; y >= 0; --y) {
+    for (int x = settings.slots.x - 1; x >= 0; --x) {
+      freeSlots.push_back(glm::uvec2(x, y));
+    }
+  }
+  resident.clear();
+  requested.clear();
+}
+
+glm::vec2 TileResidency::toTexCoord(const glm::vec3 & direction) {
+  glm::vec3 d = glm::normalize(direction);
+  return glm::vec2(
+    atan2(d.x, -d.z) / TWO_PI + 0.5f,
+    acos(glm::clamp(d.y, -1.0f, 1.0f)) / PI);
+}
+
+void TileResidency::collectNeeded(const glm::quat & orientation) {
+  // The finest level with at least as many texels per radian as the
+  // display has pixels, falling back to coarser ones while it's built
+  float texelsPerRadian = levelSizes[0].x / TWO_PI;
+  int level = (int)floor(log2(std::max(1.0f, texelsPerRadian / settings.pixelsPerRadian)));
+  level = std::max(0, std::min(levelCount - 1, level));
+  std::vector<bool> ready(levelCount);
+  for (int i = 0; i < levelCount; ++i) {
+    ready[i] = panorama.isLevelReady(i);
+  }
+  while (level < levelCount - 1 && !ready[level]) {
+    ++level;
+  }
+  desiredLevel = level;
+
+  // Coarser levels first, then by distance from the center of the view.
+  // The samples need to be closer together than the smallest tile, which
+  // is about 10 degrees at the DK2's resolution.
+  static const int SAMPLES = 24;
+  std::unordered_map<uint32_t, size_t> indices;
+  std::vector<std::pair<float, PanoramaTile> > candidates;
+  float extent = settings.fov / 2.0f + settings.margin;
+  for (int i = 0; i < SAMPLES; ++i) {
+    float yaw = extent * (2.0f * i / (SAMPLES - 1) - 1.0f);
+    for (int j = 0; j < SAMPLES; ++j) {
+      float pitch = extent * (2.0f * j / (SAMPLES - 1) - 1.0f);
+      glm::vec3 direction(sin(yaw) * cos(pitch), sin(pitch), -cos(yaw) * cos(pitch));
+      glm::vec2 texCoord = toTexCoord(orientation * direction);
+      float offCenter = sqrt(yaw * yaw + pitch * pitch);
+      for (int l = levelCount - 1; l >= desiredLevel; --l) {
+        if (!ready[l]) {
+          continue;
+        }
+        glm::uvec2 texel = glm::uvec2(texCoord * glm::vec2(levelSizes[l]));
+        PanoramaTile tile = {
+          l,
+          (int)std::min(texel.x / TiledPanorama::TILE_SIZE, tileCounts[l].x - 1),
+          (int)std::min(texel.y / TiledPanorama::TILE_SIZE, tileCounts[l].y - 1)
+        };
+        float priority = (levelCount - 1 - l) * 10.0f + offCenter;
+        auto found = indices.find(tile.key());
+        if (found == indices.end()) {
+          indices[tile.key()] = candidates.size();
+          candidates.push_back(std::make_pair(priority, tile));
+        } else if (priority < candidates[found->second].first) {
+          candidates[found->second].first = priority;
+        }
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+    [](const std::pair<float, PanoramaTile> & a, const std::pair<float, PanoramaTile> & b) {
+    return a.first < b.first;
+  });
+
+  // Anything that doesn't fit in the atlas isn't needed
+  size_t capacity = settings.slots.x * settings.slots.y;
+  needed.clear();
+  neededKeys.clear();
+  for (size_t i = 0; i < candidates.size() && i < capacity; ++i) {
+    needed.push_back(candidates[i].second);
+    neededKeys.insert(candidates[i].second.key());
+  }
+}
+
+bool TileResidency::allocateSlot(glm::uvec2 & slot) {
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+    return true;
+  }
+  // The least recently needed tile that isn't needed now, and isn't the
+  // coarsest level
+  auto victim = resident.end();
+  for (auto it = resident.begin(); it != resident.end(); ++it) {
+    if (it->second.lastUsed < frame && (int)(it->first >> 26) != levelCount - 1 &&
+      (victim == resident.end() || it->second.lastUsed < victim->second.lastUsed)) {
+      victim = it;
+    }
+  }
+  if (victim == resident.end()) {
+    return false;
+  }
+  slot = victim->second.slot;
+  resident.erase(victim);
+  ++stats.evictions;
+  return true;
+}
+
+bool TileResidency::update(const glm::quat & orientation, const Upload & upload) {
+  auto start = std::chrono::high_resolution_clock::now();
+  if (!levelCount) {
+    if (!panorama.getLevelCount()) {
+      return false;
+    }
+    initialize();
+  }
+  ++frame;
+  collectNeeded(orientation);
+
+  size_t missing = 0;
+  for (const PanoramaTile & tile : needed) {
+    uint32_t key = tile.key();
+    auto found = resident.find(key);
+    if (found != resident.end()) {
+      found->second.lastUsed = frame;
+      continue;
+    }
+    ++missing;
+    if (!requested.count(key) && (int)requested.size() < settings.maxRequests) {
+      panorama.requestTile(tile);
+      requested.insert(key);
+    }
+  }
+
+  bool changed = false;
+  panorama.takeTiles(arrived, settings.uploadsPerFrame);
+  for (const TiledPanorama::Tile & tile : arrived) {
+    uint32_t key = tile.id.key();
+    requested.erase(key);
+    // The view may have moved on while it was being copied
+    if (resident.count(key) || !neededKeys.count(key)) {
+      continue;
+    }
+    glm::uvec2 slot;
+    if (!allocateSlot(slot)) {
+      continue;
+    }
+    upload(slot, &tile.pixels[0]);
+    Resident & entry = resident[key];
+    entry.slot = slot;
+    entry.lastUsed = frame;
+    ++stats.uploads;
+    --missing;
+    changed = true;
+  }
+  arrived.clear();
+  if (changed) {
+    rebuildPageTable();
+  }
+  stats.needed = needed.size();
+  stats.missing = missing;
+  stats.update.add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+  return changed;
+}
+
+void TileResidency::rebuildPageTable() {
+  PageEntry empty = { 0, 0, 0, 0 };
+  for (int level = levelCount - 1; level >= 0; --level) {
+    const glm::uvec2 & count = tileCounts[level];
+    for (int y = 0; y < (int)count.y; ++y) {
+      for (int x = 0; x < (int)count.x; ++x) {
+        PageEntry & entry = pageTable[(levelRows[level] + y) * pageTableSize.x + x];
+        PanoramaTile tile = { level, x, y };
+        auto found = resident.find(tile.key());
+        if (found != resident.end()) {
+          PageEntry value = { (uint8_t)found->second.slot.x, (uint8_t)found->second.slot.y, (uint8_t)level, 255 };
+          entry = value;
+        } else if (level + 1 < levelCount) {
+          // Each tile is covered by a quarter of the tile above it
+          entry = pageTable[(levelRows[level + 1] + y / 2) * pageTableSize.x + x / 2];
+        } else {
+          entry = empty;
+        }
+      }
+    }
+  }
+}
+
+bool TileResidency::isInitialized() const {
+  return levelCount > 0;
+}
+
+bool TileResidency::isComplete() const {
+  return levelCount > 0 && 0 == stats.missing;
+}
+
+int TileResidency::getDesiredLevel() const {
+  return desiredLevel;
+}
+
+size_t TileResidency::getResidentCount() const {
+  return resident.size();
+}
+
+const std::vector<TileResidency::PageEntry> & TileResidency::getPageTable() const {
+  return pageTable;
+}
+
+glm::uvec2 TileResidency::getPageTableSize() const {
+  return pageTableSize;
+}
+
+int TileResidency::getLevelRow(int level) const {
+  return levelRows[level];
+}
+
+const TileResidency::Settings & TileResidency::getSettings() const {
+  return settings;
+}
+
+const TileResidency::Stats & TileResidency::getStats() const {
+  return stats;
+}
+
+#endif
@@ -0,0 +1,258 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+#ifdef HAVE_OPENCV
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+
+// The Google Photo Sphere (GPano) XMP properties, which place a partial
+// panorama within the full equirectangular frame
+struct PanoramaMetadata {
+  bool valid{ false };
+  glm::uvec2 fullSize;
+  glm::uvec2 croppedSize;
+  glm::uvec2 croppedPosition;
+
+  // Accepts both the attribute form, GPano:FullPanoWidthPixels="8000", and
+  // the element form, <GPano:FullPanoWidthPixels>8000</...>
+  static bool parseXmp(const std::string & xmp, PanoramaMetadata & result);
+  // Returns the XMP packet from the APP1 segment of a JPEG file, or an
+  // empty string if there isn't one
+  static std::string findXmp(const std::vector<uint8_t> & jpeg);
+};
+
+struct PanoramaTile {
+  int level;
+  int x;
+  int y;
+
+  uint32_t key() const {
+    return (uint32_t)level << 26 | (uint32_t)y << 13 | (uint32_t)x;
+  }
+};
+
+// An equirectangular panorama split into fixed size tiles at every level of
+// a mip pyramid, so it can be streamed into a virtual texture rather than
+// uploaded as a single texture, which for large panoramas takes seconds and
+// may exceed the maximum texture size.
+//
+// Decoding happens on a background thread, which publishes the coarsest
+// level, a single tile covering the whole panorama, as soon as the image is
+// decoded and then builds the rest of the pyramid.  The same thread copies
+// tiles out of the levels on request.
+//
+// Only the cropped area the file actually contains is stored.  Tiles are
+// filled with gray outside it.
+class TiledPanorama {
+public:
+  static const int TILE_SIZE = 256;
+  // Each tile carries a border copied from its neighbours, so bilinear
+  // filtering is seamless across tile edges
+  static const int TILE_BORDER = 1;
+  static const int SLOT_SIZE = TILE_SIZE + 2 * TILE_BORDER;
+  // Tiles are BGRA
+  static const size_t TILE_BYTES = SLOT_SIZE * SLOT_SIZE * 4;
+
+  struct Tile {
+    PanoramaTile id;
+    std::vector<uint8_t> pixels;
+  };
+
+  // Times are in milliseconds since load() was called
+  struct Stats {
+    double decodeMillis{ 0 };
+    double firstLevelMillis{ 0 };
+    double pyramidMillis{ 0 };
+    TimingStats tileCopy;
+  };
+
+  TiledPanorama();
+  ~TiledPanorama();
+
+  // Starts decoding a JPEG on the background thread and returns at once.
+  // Only call it once per panorama.
+  // The fallback metadata is used if the file has no GPano properties, and
+  // if neither does the image is taken to be the full panorama.
+  void load(const std::vector<uint8_t> & jpeg, const PanoramaMetadata & fallback = PanoramaMetadata());
+
+  bool isFailed() const;
+  // Zero until the image has been decoded
+  int getLevelCount() const;
+  bool isLevelReady(int level) const;
+  // The size of the full panorama at a level, which is exactly half the
+  // size of the level below
+  glm::uvec2 getSize(int level) const;
+  glm::uvec2 getTileCount(int level) const;
+  PanoramaMetadata getMetadata() const;
+  Stats getStats() const;
+  // Bytes held by the decoded levels
+  size_t getMemoryUsage() const;
+
+  // Queues a tile to be copied out of its level on the background thread
+  void requestTile(const PanoramaTile & tile);
+  // Hands over up to max of the tiles copied since the last call
+  void takeTiles(std::vector<Tile> & result, size_t max);
+  // Copies a tile and its border into SLOT_SIZE * SLOT_SIZE BGRA pixels.
+  // The panorama wraps horizontally and is clamped vertically.
+  bool copyTile(const PanoramaTile & tile, uint8_t * bgra) const;
+
+private:
+  mutable std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::thread loader;
+  bool quit{ false };
+  bool failed{ false };
+  bool loadPending{ false };
+  std::vector<uint8_t> jpeg;
+  PanoramaMetadata fallback;
+  std::chrono::high_resolution_clock::time_point loadStart;
+
+  // Scaled to match the decoded image
+  PanoramaMetadata metadata;
+  int levelCount{ 0 };
+  // The cropped area at each level, as BGR, and its position
+  std::vector<cv::Mat> levels;
+  std::vector<glm::ivec2> offsets;
+  std::vector<bool> ready;
+  std::deque<PanoramaTile> requests;
+  std::deque<Tile> copied;
+  Stats stats;
+
+  void loaderLoop();
+  void decode();
+  void publishLevel(int level, const cv::Mat & image);
+  // Copies the requested tiles of any levels that are ready, keeping the
+  // rest queued unless they're to be dropped
+  void copyRequested(bool dropUnready);
+  double millisSinceLoad() const;
+};
+
+// Decides which tiles of a TiledPanorama should be resident in a fixed size
+// tile atlas, from the direction the viewer is looking in, and maintains the
+// page table the shader uses to find them.
+//
+// Every frame the view, plus a margin to cover head movement, is sampled to
+// find the tiles it touches at the level matching the display resolution
+// and at every coarser level.  The coarser ones are wanted first, so the
+// view fills in quickly at low resolution and then sharpens.  The list is
+// cut off at the size of the atlas, which is the residency budget.  Missing
+// tiles are requested from the panorama, and the ones it has ready are
+// uploaded, a few per frame, replacing the least recently needed tiles once
+// the atlas is full.  The coarsest level is never evicted, so there is
+// always something to draw.
+//
+// The page table has a row of entries per tile row of each level, level 0
+// at the top.  Each entry gives the atlas slot and level of the finest
+// resident tile covering that tile.
+class TileResidency {
+public:
+  struct Settings {
+    // The size of the atlas in tiles
+    glm::uvec2 slots{ 16, 16 };
+    // The horizontal and vertical field of view, in radians
+    float fov{ 110.0f * DEGREES_TO_RADIANS };
+    // Tiles this far outside the field of view are fetched ahead of time
+    float margin{ 15.0f * DEGREES_TO_RADIANS };
+    // Display pixels per radian, which picks the finest level to stream
+    float pixelsPerRadian{ 700.0f };
+    // Tile copies waiting on the panorama's thread
+    int maxRequests{ 16 };
+    int uploadsPerFrame{ 8 };
+  };
+
+  struct PageEntry {
+    uint8_t slotX;
+    uint8_t slotY;
+    uint8_t level;
+    // 255 if there's a resident tile
+    uint8_t valid;
+  };
+
+  struct Stats {
+    size_t uploads{ 0 };
+    size_t evictions{ 0 };
+    // For the last frame
+    size_t needed{ 0 };
+    size_t missing{ 0 };
+    TimingStats update;
+  };
+
+  // Called to copy a tile into the atlas
+  typedef std::function<void(const glm::uvec2 & slot, const uint8_t * bgra)> Upload;
+
+  TileResidency(TiledPanorama & panorama);
+  TileResidency(TiledPanorama & panorama, const Settings & settings);
+
+  // Returns true if the page table changed
+  bool update(const glm::quat & orientation, const Upload & upload);
+
+  bool isInitialized() const;
+  // Whether every tile needed for the last view was resident
+  bool isComplete() const;
+  int getDesiredLevel() const;
+  size_t getResidentCount() const;
+  const std::vector<PageEntry> & getPageTable() const;
+  glm::uvec2 getPageTableSize() const;
+  // The first page table row of a level
+  int getLevelRow(int level) const;
+  const Settings & getSettings() const;
+  const Stats & getStats() const;
+
+  // Equirectangular texture coordinates, with the top of the image at 0,
+  // for a direction.  Forward (-Z) is the middle of the image, right (+X)
+  // is to the right of it and up (+Y) is at the top.
+  static glm::vec2 toTexCoord(const glm::vec3 & direction);
+
+private:
+  struct Resident {
+    glm::uvec2 slot;
+    uint64_t lastUsed;
+  };
+
+  TiledPanorama & panorama;
+  const Settings settings;
+  int levelCount{ 0 };
+  // The size and tile count of each level, which are fixed once the
+  // panorama has been decoded
+  std::vector<glm::uvec2> levelSizes;
+  std::vector<glm::uvec2> tileCounts;
+  int desiredLevel{ 0 };
+  uint64_t frame{ 0 };
+  std::unordered_map<uint32_t, Resident> resident;
+  std::set<uint32_t> requested;
+  std::vector<glm::uvec2> freeSlots;
+  // Most important first
+  std::vector<PanoramaTile> needed;
+  std::set<uint32_t> neededKeys;
+  std::vector<TiledPanorama::Tile> arrived;
+  std::vector<int> levelRows;
+  std::vector<PageEntry> pageTable;
+  glm::uvec2 pageTableSize;
+  Stats stats;
+
+  void initialize();
+  void collectNeeded(const glm::quat & orientation);
+  bool allocateSlot(glm::uvec2 & slot);
+  void rebuildPageTable();
+};
+
+#endif
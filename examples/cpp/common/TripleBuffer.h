@@ -0,0 +1,103 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#pragma once
+
+// Lock free, single producer, single consumer exchange of the most recent
+// value of T between two threads, without copying.
+//
+// There are three pre-allocated slots.  The producer owns the back slot and
+// the consumer owns the front slot, and each can use its own slot freely.
+// The third slot sits between them: publishing swaps the back slot into the
+// middle, and the consumer picking up a new value swaps the middle slot into
+// the front.  Since the consumer only ever wants the latest value, a value
+// that gets replaced before the consumer sees it is counted as dropped.
+//
+// Per-frame metadata (poses, timestamps and so on) should live in T, so it
+// travels with the data it describes.
+template <typename T>
+class TripleBuffer {
+  // The middle slot index lives in the low bits, along with a flag that
+  // says whether it holds a value the consumer hasn't seen yet
+  static const uint8_t INDEX_MASK = 0x03;
+  static const uint8_t FRESH = 0x04;
+
+  std::array<T, 3> slots;
+  std::atomic<uint8_t> middle{ 1 };
+  // Only touched by the producer
+  uint8_t back{ 0 };
+  // Only touched by the consumer
+  uint8_t front{ 2 };
+
+  std::atomic<uint64_t> published{ 0 };
+  std::atomic<uint64_t> dropped{ 0 };
+
+public:
+  // Lets the caller pre-allocate every slot, e.g. to size image buffers
+  template <typename F>
+  void forEachSlot(F f) {
+    std::for_each(slots.begin(), slots.end(), f);
+  }
+
+  // Producer side.  The slot to fill in before calling publish().
+  T & getBack() {
+    return slots[back];
+  }
+
+  // Producer side.  Makes the back slot available to the consumer, and
+  // hands the producer a new back slot.
+  void publish() {
+    uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    if (previous & FRESH) {
+      ++dropped;
+    }
+    back = previous & INDEX_MASK;
+    ++published;
+  }
+
+  // Consumer side.  Swaps in the most recently published value if there is
+  // one the consumer hasn't seen, and returns true if it did.
+  bool update() {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+    front = previous & INDEX_MASK;
+    return true;
+  }
+
+  // Consumer side.  The most recent value picked up by update(), valid until
+  // the next call to update().
+  T & getFront() {
+    return slots[front];
+  }
+
+  const T & getFront() const {
+    return slots[front];
+  }
+
+  uint64_t getPublishedCount() const {
+    return published;
+  }
+
+  // Values that were replaced by the producer before the consumer got to them
+  uint64_t getDroppedCount() const {
+    return dropped;
+  }
+};
@@ -4,6 +4,7 @@ namespace oria {
 
 
   std::string readFile(const std::string & filename) {
+    PROFILE_SCOPE("Read file");
     using namespace std;
     ifstream ins(filename.c_str(), ios::binary);
     if (!ins) {
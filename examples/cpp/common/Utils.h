@@ -60,3 +60,60 @@ public:
     return (times.size() - 1) / elapsed();
   }
 };
+
+
+// Accumulates the duration of some repeated piece of work, so that examples
+// can report the cost of an operation (in milliseconds) over a number of frames
+class TimingStats {
+  typedef std::chrono::high_resolution_clock Clock;
+
+  size_t count{ 0 };
+  double total{ 0 };
+  double minimum{ 0 };
+  double maximum{ 0 };
+
+public:
+  void reset() {
+    count = 0;
+    total = minimum = maximum = 0;
+  }
+
+  void add(double millis) {
+    if (0 == count || millis < minimum) {
+      minimum = millis;
+    }
+    if (0 == count || millis > maximum) {
+      maximum = millis;
+    }
+    total += millis;
+    ++count;
+  }
+
+  template <typename F>
+  void time(F f) {
+    Clock::time_point start = Clock::now();
+    f();
+    add(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+
+  size_t getCount() const {
+    return count;
+  }
+
+  double getAverage() const {
+    return count ? total / count : 0;
+  }
+
+  double getMin() const {
+    return minimum;
+  }
+
+  double getMax() const {
+    return maximum;
+  }
+
+  std::string toString() const {
+    return Platform::format("avg %0.3f ms, min %0.3f ms, max %0.3f ms over %d samples",
+      getAverage(), getMin(), getMax(), (int)count);
+  }
+};
@@ -70,6 +70,7 @@ GlfwApp::~GlfwApp() {
   }
 
 int GlfwApp::run() {
+  Profiler::setThreadName("Render");
   try {
     preCreate();
     window = createRenderingTarget(windowSize, windowPosition);
@@ -89,11 +90,25 @@ int GlfwApp::run() {
     });
 
     while (!glfwWindowShouldClose(window)) {
-      glfwPollEvents();
+      PROFILE_SCOPE("Frame");
+      {
+        PROFILE_SCOPE("Poll events");
+        glfwPollEvents();
+      }
       ++frame;
-      update();
-      draw();
-      finishFrame();
+      {
+        PROFILE_SCOPE("Update");
+        update();
+      }
+      {
+        PROFILE_SCOPE("Draw");
+        draw();
+      }
+      {
+        PROFILE_SCOPE("Finish frame");
+        finishFrame();
+      }
+      debugOutput.drain();
       fpsCounter.increment();
       if (fpsCounter.elapsed() >= 2.0f) {
         fps = fpsCounter.getRate();
@@ -105,6 +120,7 @@ int GlfwApp::run() {
   catch (std::runtime_error & err) {
     SAY(err.what());
   }
+  debugOutput.report();
   return 0;
 }
 
@@ -150,20 +166,8 @@ void GlfwApp::postCreate()  {
   }
   glGetError();
 
-  //#if DEBUG
-  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-  GLuint unusedIds = 0;
-  if (glDebugMessageCallback) {
-    glDebugMessageCallback(oria::debugCallback, this);
-    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
-      0, &unusedIds, true);
-  }
-  else if (glDebugMessageCallbackARB) {
-    glDebugMessageCallbackARB(oria::debugCallback, this);
-    glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
-      0, &unusedIds, true);
-  }
-  //#endif
+  debugOutput.install();
+  GpuMemory::initBudget();
 }
 
 const glm::uvec2 & GlfwApp::getSize() const {
@@ -211,6 +215,14 @@ void GlfwApp::onKey(int key, int scancode, int action, int mods) {
   case GLFW_KEY_ESCAPE:
     glfwSetWindowShouldClose(window, 1);
     return;
+
+  case GLFW_KEY_F12:
+    Profiler::dumpToFile();
+    return;
+
+  case GLFW_KEY_F10:
+    GpuMemory::report();
+    return;
   }
 }
 
@@ -26,6 +26,7 @@ protected:
   glm::ivec2    windowPosition;
   int           frame{ 0 };
   RateCounter   fpsCounter;
+  DebugOutput   debugOutput;
 
 protected:
   float         windowAspect{ 1.0f };
@@ -0,0 +1,298 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+
+// Sources and ids are both 32 bits, so together they make the key
+static uint64_t messageKey(GLenum source, GLuint id) {
+  return (uint64_t)source << 32 | id;
+}
+
+static int severityRank(GLenum severity) {
+  switch (severity) {
+  case GL_DEBUG_SEVERITY_HIGH:
+    return 3;
+  case GL_DEBUG_SEVERITY_MEDIUM:
+    return 2;
+  case GL_DEBUG_SEVERITY_LOW:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+DebugOutput::Settings::Settings() {
+  const char * sync = getenv("GL_DEBUG_SYNC");
+  synchronous = sync && 0 == strcmp(sync, "1");
+}
+
+DebugOutput::DebugOutput() : slots(new Slot[QUEUE_SIZE]) {
+  for (size_t i = 0; i < QUEUE_SIZE; ++i) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool DebugOutput::install(const Settings & settings) {
+  this->settings = settings;
+  bool khr = nullptr != glDebugMessageCallback;
+  if (!khr && nullptr == glDebugMessageCallbackARB) {
+    return false;
+  }
+  lastSummary = Platform::elapsedSeconds();
+  if (settings.synchronous) {
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  } else {
+    glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  }
+
+  // Everything off, then back on from the minimum severity up.  The ARB
+  // extension has no notification severity.
+  static const GLenum SEVERITIES[] = {
+    GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+    GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH
+  };
+  int minimumRank = severityRank(settings.minimumSeverity);
+  for (GLenum severity : SEVERITIES) {
+    GLboolean enabled = severityRank(severity) >= minimumRank ? GL_TRUE : GL_FALSE;
+    if (khr) {
+      glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, enabled);
+    } else if (GL_DEBUG_SEVERITY_NOTIFICATION != severity) {
+      glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, enabled);
+    }
+  }
+  if (khr) {
+    glDebugMessageCallback(callback, this);
+    glEnable(GL_DEBUG_OUTPUT);
+  } else {
+    glDebugMessageCallbackARB(callback, this);
+  }
+  installed = true;
+  return true;
+}
+
+void GL_CALLBACK DebugOutput::callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei length, const GLchar * message, void * userParam) {
+  DebugOutput * output = (DebugOutput *)userParam;
+  if (!output->push(source, type, id, severity, length, message)) {
+    ++output->dropped;
+    return;
+  }
+  // In synchronous mode this is the thread that made the offending call,
+  // so the message can be reported without waiting for the frame to end
+  if (output->settings.synchronous) {
+    output->process();
+  }
+}
+
+bool DebugOutput::push(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar * text) {
+  size_t position = head.load(std::memory_order_relaxed);
+  Slot * slot;
+  while (true) {
+    slot = &slots[position & (QUEUE_SIZE - 1)];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+    if (0 == difference) {
+      if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // Full
+      return false;
+    } else {
+      position = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  Message & message = slot->message;
+  message.source = source;
+  message.type = type;
+  message.id = id;
+  message.severity = severity;
+  // Some drivers pass a negative length for null terminated messages
+  size_t textLength = length >= 0 ? (size_t)length : strlen(text);
+  textLength = std::min(textLength, MAX_MESSAGE_LENGTH - 1);
+  memcpy(message.text, text, textLength);
+  message.text[textLength] = 0;
+  slot->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+bool DebugOutput::pop(Message & message) {
+  Slot & slot = slots[tail & (QUEUE_SIZE - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+    return false;
+  }
+  message = slot.message;
+  slot.sequence.store(tail + QUEUE_SIZE, std::memory_order_release);
+  ++tail;
+  return true;
+}
+
+void DebugOutput::process() {
+  if (!installed || draining) {
+    return;
+  }
+  draining = true;
+  Message message;
+  while (pop(message)) {
+    handle(message);
+  }
+  draining = false;
+}
+
+void DebugOutput::drain() {
+  if (!installed) {
+    return;
+  }
+  process();
+  // GL calls aren't allowed from the callback, so messages are only muted
+  // here.  Muting may call back in, which can queue more.
+  std::vector<uint64_t> mutes;
+  mutes.swap(pendingMutes);
+  for (uint64_t key : mutes) {
+    const Counter & counter = counters[key];
+    GLuint id = counter.id;
+    if (glDebugMessageControl) {
+      glDebugMessageControl(counter.source, counter.type, GL_DONT_CARE, 1, &id, GL_FALSE);
+    } else {
+      glDebugMessageControlARB(counter.source, counter.type, GL_DONT_CARE, 1, &id, GL_FALSE);
+    }
+  }
+  size_t droppedNow = dropped.load();
+  if (droppedNow != droppedReported) {
+    SAY_ERR("GL debug: %d messages dropped, the queue was full", (int)(droppedNow - droppedReported));
+    droppedReported = droppedNow;
+  }
+  if (Platform::elapsedSeconds() - lastSummary >= settings.summarySeconds) {
+    summarize();
+  }
+}
+
+void DebugOutput::handle(const Message & message) {
+  uint64_t key = messageKey(message.source, message.id);
+  Counter & counter = counters[key];
+  ++counter.count;
+  if (1 == counter.count) {
+    counter.source = message.source;
+    counter.type = message.type;
+    counter.id = message.id;
+    counter.severity = message.severity;
+    counter.text = message.text;
+    SAY("GL debug %s %s %s (%d): %s", severityName(message.severity), sourceName(message.source),
+      typeName(message.type), message.id, message.text);
+    return;
+  }
+  if (settings.muteAfter && counter.count >= settings.muteAfter && !counter.muted) {
+    counter.muted = true;
+    pendingMutes.push_back(key);
+    SAY("GL debug %s (%d) repeated %d times, disabling it", sourceName(counter.source),
+      counter.id, (int)counter.count);
+  }
+}
+
+void DebugOutput::summarize() {
+  lastSummary = Platform::elapsedSeconds();
+  for (auto & entry : counters) {
+    Counter & counter = entry.second;
+    size_t repeats = counter.count - std::max<size_t>(1, counter.countAtLastSummary);
+    if (counter.count > 1 && repeats) {
+      SAY("GL debug %s (%d) repeated %d times in the last %0.0f seconds", sourceName(counter.source),
+        counter.id, (int)repeats, settings.summarySeconds);
+    }
+    counter.countAtLastSummary = counter.count;
+  }
+}
+
+void DebugOutput::report() const {
+  if (counters.empty()) {
+    return;
+  }
+  SAY("GL debug output, %d distinct messages, %d dropped:", (int)counters.size(), (int)dropped.load());
+  for (const Counter & counter : getCounters()) {
+    SAY("  %8d x %s %s %s (%d)%s: %s", (int)counter.count, severityName(counter.severity),
+      sourceName(counter.source), typeName(counter.type), counter.id,
+      counter.muted ? " muted" : "", counter.text.c_str());
+  }
+}
+
+size_t DebugOutput::getDroppedCount() const {
+  return dropped.load();
+}
+
+// Most frequent first
+std::vector<DebugOutput::Counter> DebugOutput::getCounters() const {
+  std::vector<Counter> result;
+  for (const auto & entry : counters) {
+    result.push_back(entry.second);
+  }
+  std::sort(result.begin(), result.end(), [](const Counter & a, const Counter & b) {
+    return a.count > b.count;
+  });
+  return result;
+}
+
+const char * DebugOutput::sourceName(GLenum source) {
+  switch (source) {
+  case GL_DEBUG_SOURCE_API:
+    return "API";
+  case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+    return "WINDOW_SYSTEM";
+  case GL_DEBUG_SOURCE_SHADER_COMPILER:
+    return "SHADER_COMPILER";
+  case GL_DEBUG_SOURCE_THIRD_PARTY:
+    return "THIRD_PARTY";
+  case GL_DEBUG_SOURCE_APPLICATION:
+    return "APPLICATION";
+  case GL_DEBUG_SOURCE_OTHER:
+    return "OTHER";
+  }
+  return "?";
+}
+
+const char * DebugOutput::typeName(GLenum type) {
+  switch (type) {
+  case GL_DEBUG_TYPE_ERROR:
+    return "ERROR";
+  case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+    return "DEPRECATED_BEHAVIOR";
+  case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+    return "UNDEFINED_BEHAVIOR";
+  case GL_DEBUG_TYPE_PORTABILITY:
+    return "PORTABILITY";
+  case GL_DEBUG_TYPE_PERFORMANCE:
+    return "PERFORMANCE";
+  case GL_DEBUG_TYPE_OTHER:
+    return "OTHER";
+  }
+  return "?";
+}
+
+const char * DebugOutput::severityName(GLenum severity) {
+  switch (severity) {
+  case GL_DEBUG_SEVERITY_HIGH:
+    return "HIGH";
+  case GL_DEBUG_SEVERITY_MEDIUM:
+    return "MEDIUM";
+  case GL_DEBUG_SEVERITY_LOW:
+    return "LOW";
+  case GL_DEBUG_SEVERITY_NOTIFICATION:
+    return "NOTIFICATION";
+  }
+  return "?";
+}
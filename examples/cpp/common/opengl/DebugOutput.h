@@ -0,0 +1,126 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Receives the driver's debug output without getting in the way of the
+// frame.  The callback only copies each message into a lock-free queue,
+// since in the default asynchronous mode the driver may call it from any
+// of its threads, and drain() reports them from the render thread once per
+// frame.  Messages are told apart by source and id: the first occurrence of
+// each is reported in full, repeats are only counted and summarized now and
+// then, and a message that keeps repeating can be switched off in the
+// driver altogether.
+//
+// Synchronous output serializes the driver, so it's opt-in, for when a
+// breakpoint in the callback needs to show the call responsible.  Set
+// GL_DEBUG_SYNC=1 to turn it on without rebuilding.  The callback then
+// reports messages straight away, but since GL calls aren't allowed from
+// inside it, muting still waits for drain().
+class DebugOutput {
+public:
+  // Messages waiting to be drained.  More than this per frame are dropped,
+  // and counted.  Must be a power of two.
+  static const size_t QUEUE_SIZE = 1024;
+  static const size_t MAX_MESSAGE_LENGTH = 256;
+
+  struct Settings {
+    bool synchronous{ false };
+    // Messages less severe than this are filtered out by the driver
+    GLenum minimumSeverity{ GL_DEBUG_SEVERITY_LOW };
+    // How often repeats of messages already reported are summarized
+    double summarySeconds{ 10.0 };
+    // Messages that repeat this many times are disabled in the driver, or
+    // never if zero
+    size_t muteAfter{ 1000 };
+
+    Settings();
+  };
+
+  struct Counter {
+    GLenum source{ 0 };
+    GLenum type{ 0 };
+    GLuint id{ 0 };
+    GLenum severity{ 0 };
+    std::string text;
+    size_t count{ 0 };
+    size_t countAtLastSummary{ 0 };
+    bool muted{ false };
+  };
+
+  DebugOutput();
+
+  // Installs the callback on the current context.  Returns false if the
+  // context doesn't support debug output.
+  bool install(const Settings & settings = Settings());
+  // Reports any queued messages.  Call on the context's thread, once a frame.
+  void drain();
+  // Lists every distinct message seen and how often it occurred
+  void report() const;
+
+  size_t getDroppedCount() const;
+  std::vector<Counter> getCounters() const;
+
+  static const char * sourceName(GLenum source);
+  static const char * typeName(GLenum type);
+  static const char * severityName(GLenum severity);
+
+private:
+  struct Message {
+    GLenum source;
+    GLenum type;
+    GLuint id;
+    GLenum severity;
+    char text[MAX_MESSAGE_LENGTH];
+  };
+
+  // A bounded multiple producer queue, after Dmitry Vyukov's.  Each slot's
+  // sequence says whether it's free for the producer claiming that position
+  // or holds a message for the consumer.
+  struct Slot {
+    std::atomic<size_t> sequence;
+    Message message;
+  };
+
+  Settings settings;
+  bool installed{ false };
+  // Set while messages are being handled, which in synchronous mode the
+  // callback may interrupt
+  bool draining{ false };
+  // Messages to disable in the driver at the next drain()
+  std::vector<uint64_t> pendingMutes;
+  std::unique_ptr<Slot[]> slots;
+  std::atomic<size_t> head{ 0 };
+  size_t tail{ 0 };
+  std::atomic<size_t> dropped{ 0 };
+  size_t droppedReported{ 0 };
+  std::unordered_map<uint64_t, Counter> counters;
+  double lastSummary{ 0 };
+
+  bool push(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar * text);
+  bool pop(Message & message);
+  // Reports the queued messages, without making any GL calls
+  void process();
+  void handle(const Message & message);
+  void summarize();
+
+  static void GL_CALLBACK callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei length, const GLchar * message, void * userParam);
+};
@@ -38,13 +38,18 @@ Font::Font(void)
 Font::~Font(void) {
 }
 
+// Glyph quads are flat, and the texture coordinates lie in [-1, 1] (the y
+// axis is flipped), so they're stored as normalized shorts, which resolves
+// far finer than a texel of the atlas
 struct TextureVertex {
-  glm::vec4 pos;
-  glm::vec4 tex;
+  glm::vec2 pos;
+  int16_t tex[2];
   TextureVertex() {
   }
   TextureVertex(const glm::vec2 & pos, const glm::vec2 & tex)
-      : pos(pos, 0, 0), tex(tex, 0, 0) {
+      : pos(pos) {
+    this->tex[0] = VertexFormat::toSnorm16(tex.x);
+    this->tex[1] = VertexFormat::toSnorm16(tex.y);
   }
 };
 
@@ -68,6 +73,7 @@ void readPngToTexture(const char * data, size_t size,  TexturePtr & texture, glm
 }
 
 void Font::read(const void * data, size_t size) {
+  GpuMemory::Owner memoryOwner("Fonts");
   std::istringstream in(std::string(static_cast<const char*>(data), size));
 //  SignedDistanceFontFile sdff;
 //  sdff.read(in);
@@ -160,30 +166,36 @@ void Font::read(const void * data, size_t size) {
   using namespace oglplus;
   mVao = VertexArrayPtr(new VertexArray());
   mVao->Bind();
-  BufferPtr vertexBuffer;
-  BufferPtr indexBuffer;
   Platform::addShutdownHook([&]{
     mVao.reset();
+    mVertexMemory.release();
+    mIndexMemory.release();
+    mVertexBuffer.reset();
+    mIndexBuffer.reset();
     mTexture.reset();
   });
 
-  vertexBuffer = BufferPtr(new Buffer());
-  vertexBuffer->Bind(Buffer::Target::Array);
+  mVertexBuffer = BufferPtr(new Buffer());
+  mVertexBuffer->Bind(Buffer::Target::Array);
   Buffer::Data(Buffer::Target::Array, vertexData);
+  mVertexMemory.set(GpuMemory::BUFFER, GetName(*mVertexBuffer), vertexData.size() * sizeof(TextureVertex));
 
-  indexBuffer = BufferPtr(new Buffer());
-  indexBuffer->Bind(Buffer::Target::ElementArray);
-  Buffer::Data(Buffer::Target::ElementArray, indexData);
+  IndexData packedIndices = IndexData::pack(indexData, vertexData.size());
+  mIndexType = packedIndices.type;
+  mIndexBuffer = BufferPtr(new Buffer());
+  mIndexBuffer->Bind(Buffer::Target::ElementArray);
+  Buffer::Data(Buffer::Target::ElementArray, packedIndices.bytes);
+  mIndexMemory.set(GpuMemory::BUFFER, GetName(*mIndexBuffer), packedIndices.bytes.size());
 
   GLsizei stride = (GLsizei)sizeof(TextureVertex);
   void* offset = (void*)offsetof(TextureVertex, tex);
 
   VertexArrayAttrib(oria::Layout::Attribute::Position)
-    .Pointer(3, DataType::Float, false, stride, 0)
+    .Pointer(2, DataType::Float, false, stride, 0)
     .Enable();
 
   VertexArrayAttrib(oria::Layout::Attribute::TexCoord0)
-    .Pointer(2, DataType::Float, false, stride, (void*)offset)
+    .Pointer(2, DataType::Short, true, stride, (void*)offset)
     .Enable();
 
   NoVertexArray().Bind();
@@ -345,7 +357,7 @@ void Font::renderString(
           mv.translate(offset);
           Mat4Uniform(*TEXT_PROGRAM, "ModelView").Set(mv.top());
           // Render the item
-          glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)(m.indexOffset * sizeof(GLuint)));
+          glDrawElements(GL_TRIANGLES, 6, mIndexType, (void*)(m.indexOffset * IndexData::typeSize(mIndexType)));
         });
         advance.x += m.d;//+ m.offset.x;// font->getAdvance(m, mFontSize);
       });
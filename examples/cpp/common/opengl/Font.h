@@ -145,6 +145,11 @@ public:
 
   TexturePtr mTexture;
   VertexArrayPtr mVao;
+  BufferPtr mVertexBuffer;
+  BufferPtr mIndexBuffer;
+  GLenum mIndexType{ GL_UNSIGNED_INT };
+  GpuMemory::Allocation mVertexMemory;
+  GpuMemory::Allocation mIndexMemory;
   glm::vec2 mTextureSize;
 
   MetricsData mMetrics;
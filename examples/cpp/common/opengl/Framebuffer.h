@@ -26,6 +26,15 @@ struct FramebufferWrapper {
   oglplus::Framebuffer    fbo;
   oglplus::Texture        color;
   oglplus::Renderbuffer   depth;
+  // What the attachments are counted against in GpuMemory
+  std::string             owner{ "Framebuffers" };
+  // Set before init(), for float targets or ones that don't need depth
+  GLenum                  colorFormat{ GL_RGBA8 };
+  bool                    useDepth{ true };
+  // For targets that get minified, see generateMipmaps()
+  bool                    mipmaps{ false };
+  GpuMemory::Allocation   colorMemory;
+  GpuMemory::Allocation   depthMemory;
 
   FramebufferWrapper() {
   }
@@ -37,15 +46,18 @@ struct FramebufferWrapper {
   void initColor() {
       using namespace oglplus;
       Context::Bound(Texture::Target::_2D, color)
-          .MinFilter(TextureMinFilter::Linear)
+          .MinFilter(mipmaps ? TextureMinFilter::LinearMipmapLinear : TextureMinFilter::Linear)
           .MagFilter(TextureMagFilter::Linear)
           .WrapS(TextureWrap::ClampToEdge)
           .WrapT(TextureWrap::ClampToEdge)
           .Image2D(
-          0, PixelDataInternalFormat::RGBA8,
+          0, PixelDataInternalFormat(colorFormat),
           size.x, size.y,
           0, PixelDataFormat::RGB, PixelDataType::UnsignedByte, nullptr
           );
+      GpuMemory::Owner memoryOwner(owner.c_str());
+      colorMemory.setTexture(GetName(color), colorFormat, size,
+          mipmaps ? GpuMemory::mipLevels(size) : 1);
   }
 
   void initDepth() {
@@ -54,13 +66,18 @@ struct FramebufferWrapper {
           .Storage(
           PixelDataInternalFormat::DepthComponent,
           size.x, size.y);
+      GpuMemory::Owner memoryOwner(owner.c_str());
+      depthMemory.set(GpuMemory::RENDERBUFFER, GetName(depth),
+          GpuMemory::imageBytes(GL_DEPTH_COMPONENT, size));
   }
 
   void initDone() {
       using namespace oglplus;
       Bound([&] {
           fbo.AttachTexture(Framebuffer::Target::Draw, FramebufferAttachment::Color, color, 0);
-          fbo.AttachRenderbuffer(Framebuffer::Target::Draw, FramebufferAttachment::Depth, depth);
+          if (useDepth) {
+              fbo.AttachRenderbuffer(Framebuffer::Target::Draw, FramebufferAttachment::Depth, depth);
+          }
           fbo.Complete(Framebuffer::Target::Draw);
       });
   }
@@ -69,7 +86,9 @@ struct FramebufferWrapper {
     using namespace oglplus;
     this->size = size;
     initColor();
-    initDepth();
+    if (useDepth) {
+      initDepth();
+    }
     initDone();
   }
 
@@ -97,6 +116,13 @@ struct FramebufferWrapper {
   void BindColor(oglplus::Texture::Target target = oglplus::Texture::Target::_2D) {
     color.Bind(target);
   }
+
+  // Rebuilds the smaller levels from what's been rendered, leaving the
+  // color texture bound
+  void generateMipmaps() {
+    color.Bind(oglplus::Texture::Target::_2D);
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
 };
 
 typedef std::shared_ptr<FramebufferWrapper> FramebufferWrapperPtr;
@@ -20,7 +20,6 @@
 #include "Common.h"
 
 #include "Font.h"
-#include <openctmpp.h>
 #pragma warning( disable : 4068 4244 4267 4065 4101 4244)
 #include <oglplus/bound/buffer.hpp>
 #include <oglplus/shapes/cube.hpp>
@@ -38,6 +37,8 @@ namespace oglplus {
   namespace shapes {
 
     /// Class providing attributes and instructions for drawing of mesh loaded from obj
+    /// ShapeWrapper always uploads it as floats with 32 bit indices, see
+    /// oria::loadMesh for a more compact encoding
     class CtmMesh
       : public DrawingInstructionWriter
       , public DrawMode
@@ -145,30 +146,12 @@ namespace oglplus {
         _loading_options opts
         ) {
 
-        CTMimporter importer;
-        importer.LoadData(Platform::getResourceString(resource));
-        int vertexCount = importer.GetInteger(CTM_VERTEX_COUNT);
-        {
-          const float * ctmData = importer.GetFloatArray(CTM_VERTICES);
-          _pos_data = std::vector<float>(ctmData, ctmData + (vertexCount * 3));
-        }
-
-        if (opts.load_texcoords && importer.GetInteger(CTM_UV_MAP_COUNT)) {
-          const float * ctmData = importer.GetFloatArray(CTM_UV_MAP_1);
-          _tex_data = std::vector<float>(ctmData, ctmData + (vertexCount * 2));
-        }
-
-        if (opts.load_normals && importer.GetInteger(CTM_HAS_NORMALS)) {
-          const float * ctmData = importer.GetFloatArray(CTM_NORMALS);
-          _nml_data = std::vector<float>(ctmData, ctmData + (vertexCount * 3));
-        }
-
-        {
-          _prim_count = importer.GetInteger(CTM_TRIANGLE_COUNT);
-          int indexCount = 3 * _prim_count;
-          const CTMuint * ctmIntData = importer.GetIntegerArray(CTM_INDICES);
-          _idx_data = IndexArray(ctmIntData, ctmIntData + indexCount);
-        }
+        MeshData data = MeshData::loadCtm(resource, opts.load_normals, opts.load_texcoords);
+        _pos_data.swap(data.positions);
+        _nml_data.swap(data.normals);
+        _tex_data.swap(data.texCoords);
+        _idx_data.swap(data.indices);
+        _prim_count = (unsigned int)(_idx_data.size() / 3);
       }
 
     public:
@@ -366,11 +349,11 @@ namespace oria {
 
   typedef std::function<void()> Lambda;
   typedef std::list<Lambda> LambdaList;
-  template <typename Iter>
-  void renderGeometryWithLambdas(ShapeWrapperPtr & shape, ProgramPtr & program, Iter begin, const Iter & end) {
+  template <typename Shape, typename Iter>
+  void renderGeometryWithLambdas(Shape & shape, ProgramPtr & program, const mat4 & modelView, Iter begin, const Iter & end) {
     program->Use();
 
-    Mat4Uniform(*program, "ModelView").Set(Stacks::modelview().top());
+    Mat4Uniform(*program, "ModelView").Set(modelView);
     Mat4Uniform(*program, "Projection").Set(Stacks::projection().top());
 
     std::for_each(begin, end, [&](const std::function<void()>&f){
@@ -389,14 +372,39 @@ namespace oria {
   }
 
   void renderGeometry(ShapeWrapperPtr & shape, ProgramPtr & program, const std::list<std::function<void()>> & list) {
-    renderGeometryWithLambdas(shape, program, list.begin(), list.end());
+    renderGeometryWithLambdas(shape, program, Stacks::modelview().top(), list.begin(), list.end());
   }
 
   void renderGeometry(ShapeWrapperPtr & shape, ProgramPtr & program) {
     static const std::list<std::function<void()>> EMPTY_LIST;
-    renderGeometryWithLambdas(shape, program, EMPTY_LIST.begin(), EMPTY_LIST.end());
+    renderGeometryWithLambdas(shape, program, Stacks::modelview().top(), EMPTY_LIST.begin(), EMPTY_LIST.end());
+  }
+
+  void renderGeometry(MeshPtr & mesh, ProgramPtr & program, std::function<void()> lambda) {
+    renderGeometry(mesh, program, LambdaList({ lambda }));
   }
 
+  void renderGeometry(MeshPtr & mesh, ProgramPtr & program, const std::list<std::function<void()>> & list) {
+    mat4 modelView = Stacks::modelview().top() * mesh->getPositionTransform();
+    renderGeometryWithLambdas(mesh, program, modelView, list.begin(), list.end());
+  }
+
+  void renderGeometry(MeshPtr & mesh, ProgramPtr & program) {
+    static const std::list<std::function<void()>> EMPTY_LIST;
+    renderGeometry(mesh, program, EMPTY_LIST);
+  }
+
+  void renderGeometryInstanced(MeshPtr & mesh, ProgramPtr & program, GLsizei instances, std::function<void()> lambda) {
+    assert(VertexFormat::POSITION_SNORM16 != mesh->getFormat().position);
+    program->Use();
+    Mat4Uniform(*program, "ModelView").Set(Stacks::modelview().top());
+    Mat4Uniform(*program, "Projection").Set(Stacks::projection().top());
+    lambda();
+    mesh->Use();
+    mesh->DrawInstanced(instances);
+    oglplus::NoProgram().Bind();
+    oglplus::NoVertexArray().Bind();
+  }
 
   void renderCube(const glm::vec3 & color) {
     using namespace oglplus;
@@ -458,6 +466,46 @@ namespace oria {
     );
   }
 
+  MeshPtr loadPlaneMesh(ProgramPtr program, float aspect) {
+    vec2 extent(1.0f);
+    if (aspect > 1) {
+      extent.y /= aspect;
+    } else {
+      extent.x *= aspect;
+    }
+    MeshData data;
+    for (int i = 0; i < 4; ++i) {
+      vec2 corner(i & 1, i >> 1);
+      vec2 position = (corner * 2.0f - 1.0f) * extent;
+      data.positions.insert(data.positions.end(), { position.x, position.y, 0.0f });
+      data.texCoords.insert(data.texCoords.end(), { corner.x, corner.y });
+    }
+    data.indices = { 0, 1, 2, 2, 1, 3 };
+    GpuMemory::Owner memoryOwner("Meshes");
+    return MeshPtr(new Mesh({ "Position", "TexCoord" }, data, program));
+  }
+
+  bool intersectsFrustum(const mat4 & clipFromLocal, const vec3 & min, const vec3 & max) {
+    vec4 corners[8];
+    for (int i = 0; i < 8; ++i) {
+      vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+      corners[i] = clipFromLocal * vec4(corner, 1.0f);
+    }
+    // -w <= x, y, z <= w inside the frustum
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int sign = -1; sign <= 1; sign += 2) {
+        bool allOutside = true;
+        for (int i = 0; i < 8 && allOutside; ++i) {
+          allOutside = sign * corners[i][axis] > corners[i].w;
+        }
+        if (allOutside) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
   void renderSkybox(Resource firstImageResource) {
     using namespace oglplus;
 
@@ -496,6 +544,7 @@ namespace oria {
       shape = ShapeWrapperPtr(new shapes::ShapeWrapper(List("Position")("TexCoord").Get(), shapes::Plane(), *program));
       texture = load2dTexture(Resource::IMAGES_FLOOR_PNG);
       Context::Bound(TextureTarget::_2D, *texture).MinFilter(TextureMinFilter::LinearMipmapNearest).GenerateMipmap();
+      GpuMemory::mipmapsGenerated(*texture);
       Platform::addShutdownHook([&]{
         program.reset();
         shape.reset();
@@ -525,13 +574,18 @@ namespace oria {
     return ShapeWrapperPtr(new shapes::ShapeWrapper(names, shapes::CtmMesh(resource), *program));
   }
 
+  MeshPtr loadMesh(const std::initializer_list<const GLchar*>& names, Resource resource, ProgramPtr program, const VertexFormat & format) {
+    GpuMemory::Owner memoryOwner("Meshes");
+    return MeshPtr(new Mesh(names, MeshData::loadCtm(resource), program, format));
+  }
+
   void renderManikin() {
     static ProgramPtr program;
-    static ShapeWrapperPtr shape;
+    static MeshPtr shape;
 
     if (!program) {
       program = loadProgram(Resource::SHADERS_LIT_VS, Resource::SHADERS_LITCOLORED_FS);
-      shape = loadShape({ "Position", "Normal" }, Resource::MESHES_MANIKIN_CTM, program);
+      shape = loadMesh({ "Position", "Normal" }, Resource::MESHES_MANIKIN_CTM, program);
       Platform::addShutdownHook([&]{
         program.reset();
         shape.reset();
@@ -547,7 +601,7 @@ namespace oria {
   void renderRift(float alpha) {
     using namespace oglplus;
     static ProgramPtr program;
-    static ShapeWrapperPtr shape;
+    static MeshPtr shape;
     if (!program) {
       Platform::addShutdownHook([&]{
         program.reset();
@@ -555,7 +609,7 @@ namespace oria {
       });
 
       program = loadProgram(Resource::SHADERS_LIT_VS, Resource::SHADERS_LITCOLORED_FS);
-      shape = ::oria::loadShape({ "Position", "Normal" }, Resource::MESHES_RIFT_CTM, program);
+      shape = ::oria::loadMesh({ "Position", "Normal" }, Resource::MESHES_RIFT_CTM, program);
     }
 
     auto & mv = Stacks::modelview();
@@ -647,54 +701,6 @@ namespace oria {
     });
   }
 
-  void GL_CALLBACK debugCallback(
-    GLenum source,
-    GLenum type,
-    GLuint id,
-    GLenum severity,
-    GLsizei length,
-    const GLchar * message,
-    void * userParam) {
-    const char * typeStr = "?";
-    switch (type) {
-    case GL_DEBUG_TYPE_ERROR:
-      typeStr = "ERROR";
-      break;
-    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-      typeStr = "DEPRECATED_BEHAVIOR";
-      break;
-    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-      typeStr = "UNDEFINED_BEHAVIOR";
-      break;
-    case GL_DEBUG_TYPE_PORTABILITY:
-      typeStr = "PORTABILITY";
-      break;
-    case GL_DEBUG_TYPE_PERFORMANCE:
-      typeStr = "PERFORMANCE";
-      break;
-    case GL_DEBUG_TYPE_OTHER:
-      typeStr = "OTHER";
-      break;
-    }
-
-    const char * severityStr = "?";
-    switch (severity) {
-    case GL_DEBUG_SEVERITY_LOW:
-      severityStr = "LOW";
-      break;
-    case GL_DEBUG_SEVERITY_MEDIUM:
-      severityStr = "MEDIUM";
-      break;
-    case GL_DEBUG_SEVERITY_HIGH:
-      severityStr = "HIGH";
-      break;
-    }
-    SAY("--- OpenGL Callback Message ---");
-    SAY("type: %s\nseverity: %-8s\nid: %d\nmsg: %s", typeStr, severityStr, id,
-      message);
-    SAY("--- OpenGL Callback Message ---");
-  }
-
   ShapeWrapperPtr loadSphere(const std::initializer_list<const GLchar*>& names, ProgramPtr program) {
     using namespace oglplus;
     return ShapeWrapperPtr(new shapes::ShapeWrapper(names, shapes::Sphere(), *program));
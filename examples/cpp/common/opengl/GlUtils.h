@@ -29,14 +29,31 @@ namespace oria {
   }
 
   ShapeWrapperPtr loadShape(const std::initializer_list<const GLchar*>& names, Resource resource, ProgramPtr program);
+  // Loads a CTM mesh in the given vertex format, compact by default
+  MeshPtr loadMesh(const std::initializer_list<const GLchar*>& names, Resource resource, ProgramPtr program,
+      const VertexFormat & format = VertexFormat());
   ShapeWrapperPtr loadSphere(const std::initializer_list<const GLchar*>& names, ProgramPtr program);
   ShapeWrapperPtr loadSkybox(ProgramPtr program);
   ShapeWrapperPtr loadPlane(ProgramPtr program, float aspect);
+  // The same plane as a Mesh, so it can be drawn instanced
+  MeshPtr loadPlaneMesh(ProgramPtr program, float aspect);
+  // False if the box is entirely outside one of the frustum's planes.  It
+  // can be true for boxes that only cross the planes' extensions, near the
+  // corners of the frustum.
+  bool intersectsFrustum(const mat4 & clipFromLocal, const vec3 & min, const vec3 & max);
   void bindLights(ProgramPtr & program);
 
   void renderGeometry(ShapeWrapperPtr & shape, ProgramPtr & program);
   void renderGeometry(ShapeWrapperPtr & shape, ProgramPtr & program, const std::list<std::function<void()>> & list);
   void renderGeometry(ShapeWrapperPtr & shape, ProgramPtr & program, std::function<void()> lambda);
+  // Applies the mesh's position transform on top of the modelview
+  void renderGeometry(MeshPtr & mesh, ProgramPtr & program);
+  void renderGeometry(MeshPtr & mesh, ProgramPtr & program, const std::list<std::function<void()>> & list);
+  void renderGeometry(MeshPtr & mesh, ProgramPtr & program, std::function<void()> lambda);
+  // The lambda sets whatever per-instance uniforms the program indexes with
+  // gl_InstanceID.  The mesh's position transform isn't applied, so it
+  // mustn't use POSITION_SNORM16.
+  void renderGeometryInstanced(MeshPtr & mesh, ProgramPtr & program, GLsizei instances, std::function<void()> lambda);
   void renderCube(const glm::vec3 & color = Colors::white);
   void renderColorCube();
   void renderSkybox(Resource firstImageResource);
@@ -65,15 +82,6 @@ namespace oria {
 #else
 #define GL_CALLBACK 
 #endif
-
-  void GL_CALLBACK debugCallback(
-      GLenum source,
-      GLenum type,
-      GLuint id,
-      GLenum severity,
-      GLsizei length,
-      const GLchar * message,
-      void * userParam);
 }
 
 template <typename F>
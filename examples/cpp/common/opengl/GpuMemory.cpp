@@ -0,0 +1,473 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define GPU_MEMORY_THREAD_LOCAL __declspec(thread)
+#else
+#define GPU_MEMORY_THREAD_LOCAL thread_local
+#endif
+
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+namespace {
+  const char * const DEFAULT_OWNER = "Other";
+
+  struct Entry {
+    std::string owner;
+    size_t bytes{ 0 };
+    // Kept for textures, so mipmap generation can be accounted for
+    GLenum internalFormat{ 0 };
+    uvec2 size;
+    int layers{ 1 };
+  };
+
+  typedef std::pair<int, GLuint> Key;
+
+  struct Registry {
+    std::mutex mutex;
+    std::map<Key, Entry> entries;
+    GpuMemory::Total totals[GpuMemory::CATEGORY_COUNT];
+    size_t budget{ 0 };
+    bool warned{ false };
+    std::vector<GpuMemory::BudgetListener> listeners;
+  };
+
+  Registry & getRegistry() {
+    static Registry registry;
+    return registry;
+  }
+
+  GPU_MEMORY_THREAD_LOCAL const char * currentOwner = nullptr;
+  // Stops the listeners' own releases and allocations from calling them
+  // again
+  GPU_MEMORY_THREAD_LOCAL bool inListeners = false;
+
+  double megabytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+  }
+
+  size_t totalBytes(const Registry & registry) {
+    size_t result = 0;
+    for (int i = 0; i < GpuMemory::CATEGORY_COUNT; ++i) {
+      result += registry.totals[i].bytes;
+    }
+    return result;
+  }
+
+  void checkBudget() {
+    Registry & registry = getRegistry();
+    size_t over = 0;
+    std::vector<GpuMemory::BudgetListener> listeners;
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      size_t total = totalBytes(registry);
+      if (!registry.budget || total <= registry.budget) {
+        registry.warned = false;
+        return;
+      }
+      over = total - registry.budget;
+      listeners = registry.listeners;
+    }
+
+    if (inListeners) {
+      return;
+    }
+    inListeners = true;
+    size_t freed = 0;
+    for (GpuMemory::BudgetListener & listener : listeners) {
+      if (freed >= over) {
+        break;
+      }
+      freed += listener(over - freed);
+    }
+    inListeners = false;
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t total = totalBytes(registry);
+    if (total > registry.budget && !registry.warned) {
+      SAY_ERR("GPU memory over budget: an estimated %0.1f MB of %0.1f MB, after freeing %0.1f MB",
+        megabytes(total), megabytes(registry.budget), megabytes(freed));
+      registry.warned = true;
+    }
+  }
+
+  void record(GpuMemory::Category category, GLuint name, const Entry & entry) {
+    Registry & registry = getRegistry();
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      Entry & existing = registry.entries[Key(category, name)];
+      GpuMemory::Total & total = registry.totals[category];
+      if (existing.owner.empty()) {
+        ++total.count;
+      } else {
+        total.bytes -= existing.bytes;
+      }
+      existing = entry;
+      total.bytes += entry.bytes;
+    }
+    checkBudget();
+  }
+}
+
+GpuMemory::Owner::Owner(const char * name) : previous(currentOwner) {
+  currentOwner = name;
+}
+
+GpuMemory::Owner::~Owner() {
+  currentOwner = previous;
+}
+
+GpuMemory::Allocation::Allocation() {
+}
+
+GpuMemory::Allocation::Allocation(Allocation && other) : category(other.category), name(other.name) {
+  other.name = 0;
+}
+
+GpuMemory::Allocation & GpuMemory::Allocation::operator=(Allocation && other) {
+  if (this != &other) {
+    release();
+    category = other.category;
+    name = other.name;
+    other.name = 0;
+  }
+  return *this;
+}
+
+GpuMemory::Allocation::~Allocation() {
+  release();
+}
+
+void GpuMemory::Allocation::set(Category category, GLuint name, size_t bytes) {
+  if (name != this->name || category != this->category) {
+    release();
+  }
+  this->category = category;
+  this->name = name;
+  allocated(category, name, bytes);
+}
+
+void GpuMemory::Allocation::setTexture(GLuint name, GLenum internalFormat, const uvec2 & size, int levels, int layers) {
+  if (name != this->name || TEXTURE != category) {
+    release();
+  }
+  category = TEXTURE;
+  this->name = name;
+  textureAllocated(name, internalFormat, size, levels, layers);
+}
+
+void GpuMemory::Allocation::release() {
+  if (name) {
+    released(category, name);
+    name = 0;
+  }
+}
+
+size_t GpuMemory::bitsPerPixel(GLenum internalFormat) {
+  switch (internalFormat) {
+  case GL_R8:
+  case GL_R8_SNORM:
+  case GL_R8I:
+  case GL_R8UI:
+  case GL_RED:
+  case GL_STENCIL_INDEX8:
+    return 8;
+
+  case GL_RG8:
+  case GL_RG8_SNORM:
+  case GL_R16:
+  case GL_R16F:
+  case GL_R16I:
+  case GL_R16UI:
+  case GL_RG:
+  case GL_DEPTH_COMPONENT16:
+    return 16;
+
+  case GL_RG16:
+  case GL_RG16F:
+  case GL_R32F:
+  case GL_R32I:
+  case GL_R32UI:
+  case GL_RGB10_A2:
+  case GL_R11F_G11F_B10F:
+  case GL_RGB9_E5:
+  // Three byte formats are padded out to four
+  case GL_RGB8:
+  case GL_SRGB8:
+  case GL_RGB:
+  case GL_RGBA8:
+  case GL_SRGB8_ALPHA8:
+  case GL_RGBA:
+  case GL_DEPTH_COMPONENT:
+  case GL_DEPTH_COMPONENT24:
+  case GL_DEPTH_COMPONENT32:
+  case GL_DEPTH_COMPONENT32F:
+  case GL_DEPTH24_STENCIL8:
+    return 32;
+
+  case GL_RG32F:
+  case GL_RGB16F:
+  case GL_RGBA16:
+  case GL_RGBA16F:
+  case GL_DEPTH32F_STENCIL8:
+    return 64;
+
+  case GL_RGB32F:
+  case GL_RGBA32F:
+    return 128;
+
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RED_RGTC1:
+  case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    return 4;
+
+  case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+  case GL_COMPRESSED_RG_RGTC2:
+  case GL_COMPRESSED_SIGNED_RG_RGTC2:
+  case GL_COMPRESSED_RGBA_BPTC_UNORM:
+  case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    return 8;
+  }
+  // Most things are four bytes
+  return 32;
+}
+
+int GpuMemory::mipLevels(const uvec2 & size) {
+  int result = 1;
+  for (unsigned int largest = std::max(size.x, size.y); largest > 1; largest >>= 1) {
+    ++result;
+  }
+  return result;
+}
+
+size_t GpuMemory::imageBytes(GLenum internalFormat, const uvec2 & size, int levels, int layers) {
+  size_t bits = bitsPerPixel(internalFormat);
+  size_t result = 0;
+  for (int level = 0; level < levels; ++level) {
+    size_t width = std::max(1u, size.x >> level);
+    size_t height = std::max(1u, size.y >> level);
+    result += (width * height * bits + 7) / 8;
+  }
+  return result * layers;
+}
+
+void GpuMemory::allocated(Category category, GLuint name, size_t bytes) {
+  Entry entry;
+  entry.owner = currentOwner ? currentOwner : DEFAULT_OWNER;
+  entry.bytes = bytes;
+  record(category, name, entry);
+}
+
+void GpuMemory::textureAllocated(GLuint name, GLenum internalFormat, const uvec2 & size, int levels, int layers) {
+  Entry entry;
+  entry.owner = currentOwner ? currentOwner : DEFAULT_OWNER;
+  entry.bytes = imageBytes(internalFormat, size, levels, layers);
+  entry.internalFormat = internalFormat;
+  entry.size = size;
+  entry.layers = layers;
+  record(TEXTURE, name, entry);
+}
+
+void GpuMemory::textureAllocated(const oglplus::Texture & texture, GLenum internalFormat, const uvec2 & size, int levels, int layers) {
+  textureAllocated(oglplus::GetName(texture), internalFormat, size, levels, layers);
+}
+
+void GpuMemory::mipmapsGenerated(const oglplus::Texture & texture) {
+  Registry & registry = getRegistry();
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::map<Key, Entry>::iterator itr = registry.entries.find(Key(TEXTURE, oglplus::GetName(texture)));
+    if (registry.entries.end() == itr || !itr->second.internalFormat) {
+      return;
+    }
+    entry = itr->second;
+  }
+  entry.bytes = imageBytes(entry.internalFormat, entry.size, mipLevels(entry.size), entry.layers);
+  record(TEXTURE, oglplus::GetName(texture), entry);
+}
+
+void GpuMemory::released(Category category, GLuint name) {
+  Registry & registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::map<Key, Entry>::iterator itr = registry.entries.find(Key(category, name));
+  if (registry.entries.end() == itr) {
+    return;
+  }
+  Total & total = registry.totals[category];
+  total.bytes -= itr->second.bytes;
+  --total.count;
+  registry.entries.erase(itr);
+}
+
+GpuMemory::Total GpuMemory::getTotal() {
+  Registry & registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  Total result;
+  for (int i = 0; i < CATEGORY_COUNT; ++i) {
+    result.bytes += registry.totals[i].bytes;
+    result.count += registry.totals[i].count;
+  }
+  return result;
+}
+
+GpuMemory::Total GpuMemory::getTotal(Category category) {
+  Registry & registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return registry.totals[category];
+}
+
+std::map<std::string, GpuMemory::Total> GpuMemory::getTotalsByOwner() {
+  Registry & registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::map<std::string, Total> result;
+  for (const std::pair<const Key, Entry> & item : registry.entries) {
+    Total & total = result[item.second.owner];
+    total.bytes += item.second.bytes;
+    ++total.count;
+  }
+  return result;
+}
+
+GpuMemory::DriverInfo GpuMemory::queryDriver() {
+  DriverInfo result;
+  // Both report kilobytes
+  if (GLEW_NVX_gpu_memory_info) {
+    GLint dedicated = 0, available = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+    result.extension = "GL_NVX_gpu_memory_info";
+    result.dedicated = (size_t)dedicated * 1024;
+    result.available = (size_t)available * 1024;
+  } else if (GLEW_ATI_meminfo) {
+    // The total free, the largest free block, and the same for auxiliary
+    // memory.  The size of the pool isn't available.
+    GLint free[4] = { 0 };
+    glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free);
+    result.extension = "GL_ATI_meminfo";
+    result.available = (size_t)free[0] * 1024;
+  }
+  return result;
+}
+
+void GpuMemory::setBudget(size_t bytes) {
+  {
+    Registry & registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.budget = bytes;
+    registry.warned = false;
+  }
+  checkBudget();
+}
+
+size_t GpuMemory::getBudget() {
+  Registry & registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return registry.budget;
+}
+
+void GpuMemory::initBudget() {
+  const char * budgetMb = getenv("GPU_MEMORY_BUDGET_MB");
+  if (budgetMb && *budgetMb) {
+    setBudget((size_t)atoi(budgetMb) * 1024 * 1024);
+    return;
+  }
+  DriverInfo driver = queryDriver();
+  size_t pool = driver.dedicated;
+  if (!pool && driver.available) {
+    // What's free now plus what we've already taken
+    pool = driver.available + getTotal().bytes;
+  }
+  if (pool) {
+    setBudget(pool / 4 * 3);
+  }
+}
+
+void GpuMemory::addBudgetListener(BudgetListener listener) {
+  Registry & registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.listeners.push_back(listener);
+}
+
+std::vector<std::string> GpuMemory::getSummary() {
+  std::vector<std::string> result;
+  Total total = getTotal();
+  size_t budget = getBudget();
+  result.push_back(Platform::format("Estimated GPU memory: %0.1f MB in %d allocations%s",
+    megabytes(total.bytes), (int)total.count,
+    budget ? Platform::format(", budget %0.1f MB", megabytes(budget)).c_str() : ""));
+  for (int i = 0; i < CATEGORY_COUNT; ++i) {
+    Total categoryTotal = getTotal((Category)i);
+    result.push_back(Platform::format("  %-24s %8.1f MB %5d", categoryName((Category)i),
+      megabytes(categoryTotal.bytes), (int)categoryTotal.count));
+  }
+
+  std::map<std::string, Total> owners = getTotalsByOwner();
+  std::vector<std::pair<std::string, Total>> sorted(owners.begin(), owners.end());
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Total> & a, const std::pair<std::string, Total> & b) {
+    return a.second.bytes > b.second.bytes;
+  });
+  result.push_back("By owner:");
+  for (const std::pair<std::string, Total> & owner : sorted) {
+    result.push_back(Platform::format("  %-24s %8.1f MB %5d", owner.first.c_str(),
+      megabytes(owner.second.bytes), (int)owner.second.count));
+  }
+
+  DriverInfo driver = queryDriver();
+  if (driver.extension) {
+    if (driver.dedicated) {
+      result.push_back(Platform::format("Driver (%s): %0.1f MB available of %0.1f MB",
+        driver.extension, megabytes(driver.available), megabytes(driver.dedicated)));
+    } else {
+      result.push_back(Platform::format("Driver (%s): %0.1f MB available",
+        driver.extension, megabytes(driver.available)));
+    }
+  }
+  return result;
+}
+
+void GpuMemory::report() {
+  for (const std::string & line : getSummary()) {
+    SAY("%s", line.c_str());
+  }
+}
+
+const char * GpuMemory::categoryName(Category category) {
+  switch (category) {
+  case TEXTURE:
+    return "Textures";
+  case RENDERBUFFER:
+    return "Renderbuffers";
+  case BUFFER:
+    return "Buffers";
+  default:
+    return "";
+  }
+}
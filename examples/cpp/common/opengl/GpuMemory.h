@@ -0,0 +1,126 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Keeps an estimate of the video memory the examples have allocated, since
+// GL itself can't say how much a texture or buffer takes up.  The texture,
+// buffer and framebuffer wrappers record each allocation as it's made, with
+// its size worked out from the internal format and the number of mip levels,
+// and release it again when the object is deleted.  The estimates ignore
+// driver padding and alignment, so they err on the low side.
+//
+// Allocations are attributed to the innermost GpuMemory::Owner on the
+// thread that makes them, so the totals can be broken down by what they're
+// for as well as by kind.
+//
+// When a budget is set, going over it is reported once, and the budget
+// listeners, such as the shared texture cache, are asked to free what they
+// can.  The budget comes from GPU_MEMORY_BUDGET_MB if it's set, and is
+// otherwise three quarters of the dedicated memory the driver reports, when
+// it supports GL_NVX_gpu_memory_info or GL_ATI_meminfo.
+class GpuMemory {
+public:
+  enum Category {
+    TEXTURE,
+    RENDERBUFFER,
+    BUFFER,
+    CATEGORY_COUNT
+  };
+
+  struct Total {
+    size_t bytes{ 0 };
+    size_t count{ 0 };
+  };
+
+  // What the driver says about the memory, in bytes, if it says anything
+  struct DriverInfo {
+    const char * extension{ nullptr };
+    // Zero if the driver doesn't report it
+    size_t dedicated{ 0 };
+    size_t available{ 0 };
+  };
+
+  // Attributes allocations made on this thread to the given owner for as
+  // long as it's in scope
+  class Owner {
+  public:
+    Owner(const char * name);
+    ~Owner();
+  private:
+    const char * previous;
+  };
+
+  // Releases an allocation recorded by set() when it goes out of scope, for
+  // GL objects held by value
+  class Allocation {
+  public:
+    Allocation();
+    Allocation(Allocation && other);
+    Allocation & operator=(Allocation && other);
+    ~Allocation();
+
+    void set(Category category, GLuint name, size_t bytes);
+    void setTexture(GLuint name, GLenum internalFormat, const uvec2 & size, int levels = 1, int layers = 1);
+    void release();
+
+  private:
+    Category category{ TEXTURE };
+    GLuint name{ 0 };
+  };
+
+  // Called on the thread that went over the budget, with the number of bytes
+  // over.  Returns the number of bytes freed.
+  typedef std::function<size_t(size_t)> BudgetListener;
+
+  // Estimated storage for a single pixel, in bits, so compressed formats
+  // can be included
+  static size_t bitsPerPixel(GLenum internalFormat);
+  // The length of a full mip chain for an image of this size
+  static int mipLevels(const uvec2 & size);
+  static size_t imageBytes(GLenum internalFormat, const uvec2 & size, int levels = 1, int layers = 1);
+
+  // Records an allocation, replacing any earlier one for the same object
+  static void allocated(Category category, GLuint name, size_t bytes);
+  static void textureAllocated(GLuint name, GLenum internalFormat, const uvec2 & size, int levels = 1, int layers = 1);
+  static void textureAllocated(const oglplus::Texture & texture, GLenum internalFormat, const uvec2 & size, int levels = 1, int layers = 1);
+  // Extends a recorded texture to the full mip chain
+  static void mipmapsGenerated(const oglplus::Texture & texture);
+  static void released(Category category, GLuint name);
+
+  static Total getTotal();
+  static Total getTotal(Category category);
+  static std::map<std::string, Total> getTotalsByOwner();
+  // Needs a current context
+  static DriverInfo queryDriver();
+
+  // Zero for no budget
+  static void setBudget(size_t bytes);
+  static size_t getBudget();
+  // Sets the budget from the environment or the driver.  Needs a current
+  // context.
+  static void initBudget();
+  static void addBudgetListener(BudgetListener listener);
+
+  static std::vector<std::string> getSummary();
+  static void report();
+
+  static const char * categoryName(Category category);
+};
@@ -0,0 +1,96 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+
+GpuTimer::GpuTimer() {
+  for (int i = 0; i < RING_SIZE; ++i) {
+    queries[i][0] = queries[i][1] = 0;
+    pending[i] = false;
+  }
+}
+
+GpuTimer::~GpuTimer() {
+  // The context may already be gone, so the queries are only deleted by
+  // an explicit release()
+}
+
+void GpuTimer::release() {
+  if (queries[0][0]) {
+    glDeleteQueries(RING_SIZE * 2, &queries[0][0]);
+  }
+  for (int i = 0; i < RING_SIZE; ++i) {
+    queries[i][0] = queries[i][1] = 0;
+    pending[i] = false;
+  }
+  active = false;
+}
+
+void GpuTimer::begin() {
+  if (!queries[0][0]) {
+    glGenQueries(RING_SIZE * 2, &queries[0][0]);
+  }
+  collect();
+  if (pending[next]) {
+    return;
+  }
+  glQueryCounter(queries[next][0], GL_TIMESTAMP);
+  active = true;
+}
+
+void GpuTimer::end() {
+  if (!active) {
+    return;
+  }
+  glQueryCounter(queries[next][1], GL_TIMESTAMP);
+  pending[next] = true;
+  next = (next + 1) % RING_SIZE;
+  active = false;
+}
+
+void GpuTimer::collect() {
+  // Results become available in the order the queries were issued
+  for (int i = 0; i < RING_SIZE; ++i) {
+    int index = (next + i) % RING_SIZE;
+    if (!pending[index]) {
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(queries[index][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      break;
+    }
+    GLuint64 start = 0, end = 0;
+    glGetQueryObjectui64v(queries[index][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries[index][1], GL_QUERY_RESULT, &end);
+    stats.add((end - start) / 1.0e6);
+    pending[index] = false;
+  }
+}
+
+const TimingStats & GpuTimer::getStats() {
+  if (queries[0][0]) {
+    collect();
+  }
+  return stats;
+}
+
+void GpuTimer::reset() {
+  stats.reset();
+}
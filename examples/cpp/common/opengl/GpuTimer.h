@@ -0,0 +1,62 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Measures the GPU time of a piece of rendering without stalling on the
+// result.  Each begin()/end() pair writes a pair of GL_TIMESTAMP queries
+// from a small ring, and the results are collected a few frames later,
+// once the GPU has caught up.  If the ring is full the measurement is
+// skipped rather than waited for.
+//
+// Timestamps are used rather than GL_TIME_ELAPSED so that timers can be
+// nested, and used inside code that's itself being timed.
+class GpuTimer {
+public:
+  static const int RING_SIZE = 4;
+
+  GpuTimer();
+  ~GpuTimer();
+
+  void begin();
+  void end();
+
+  template <typename F>
+  void time(F f) {
+    begin();
+    f();
+    end();
+  }
+
+  // Milliseconds, for the measurements collected so far
+  const TimingStats & getStats();
+  void reset();
+  // Deletes the queries, which needs the context they were made in
+  void release();
+
+private:
+  GLuint queries[RING_SIZE][2];
+  bool pending[RING_SIZE];
+  int next{ 0 };
+  bool active{ false };
+  TimingStats stats;
+
+  void collect();
+};
@@ -0,0 +1,362 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+#include <openctmpp.h>
+
+// Infinities and NaNs are kept, and values too small for a half denormal
+// flush to zero
+uint16_t VertexFormat::toHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+  if (exponent >= 31) {
+    bool nan = (bits & 0x7fffffff) > 0x7f800000;
+    return (uint16_t)(sign | 0x7c00 | (nan ? 0x200 : 0));
+  }
+
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return (uint16_t)sign;
+    }
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) {
+      ++half;
+    }
+    return (uint16_t)(sign | half);
+  }
+
+  uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+  uint32_t remainder = mantissa & 0x1fff;
+  // A carry out of the mantissa correctly bumps the exponent
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    ++half;
+  }
+  return (uint16_t)half;
+}
+
+int16_t VertexFormat::toSnorm16(float value) {
+  value = glm::clamp(value, -1.0f, 1.0f);
+  return (int16_t)glm::round(value * 32767.0f);
+}
+
+static uint32_t toSnorm10(float value) {
+  value = glm::clamp(value, -1.0f, 1.0f);
+  return (uint32_t)(int)glm::round(value * 511.0f) & 0x3ff;
+}
+
+uint32_t VertexFormat::toInt2_10_10_10(const vec3 & v) {
+  return toSnorm10(v.x) | (toSnorm10(v.y) << 10) | (toSnorm10(v.z) << 20);
+}
+
+template <typename T>
+static void write(uint8_t * & out, const T & value) {
+  memcpy(out, &value, sizeof(T));
+  out += sizeof(T);
+}
+
+VertexFormat VertexFormat::full() {
+  VertexFormat result;
+  result.position = POSITION_FLOAT;
+  result.normal = NORMAL_FLOAT;
+  result.texCoord = TEXCOORD_FLOAT;
+  result.shortIndices = false;
+  return result;
+}
+
+VertexFormat VertexFormat::compact() {
+  return VertexFormat();
+}
+
+size_t VertexFormat::positionBytes(Position position) {
+  switch (position) {
+  case POSITION_HALF:
+  case POSITION_SNORM16:
+    // Padded out to four components, with w = 1
+    return 4 * sizeof(uint16_t);
+  default:
+    return 3 * sizeof(float);
+  }
+}
+
+size_t VertexFormat::normalBytes(Normal normal) {
+  return NORMAL_INT_2_10_10_10 == normal ? sizeof(uint32_t) : 3 * sizeof(float);
+}
+
+size_t VertexFormat::texCoordBytes(TexCoord texCoord) {
+  return TEXCOORD_HALF == texCoord ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+}
+
+std::string VertexFormat::toString() const {
+  static const char * POSITIONS[] = { "float", "half", "snorm16" };
+  static const char * NORMALS[] = { "float", "2_10_10_10" };
+  static const char * TEXCOORDS[] = { "float", "half" };
+  return Platform::format("positions %s, normals %s, tex coords %s, %s indices",
+    POSITIONS[position], NORMALS[normal], TEXCOORDS[texCoord],
+    shortIndices ? "16 bit" : "32 bit");
+}
+
+size_t MeshData::getVertexCount() const {
+  return positions.size() / 3;
+}
+
+void MeshData::getBounds(vec3 & min, vec3 & max) const {
+  min = max = vec3();
+  size_t count = getVertexCount();
+  for (size_t i = 0; i < count; ++i) {
+    vec3 v = glm::make_vec3(&positions[i * 3]);
+    min = i ? glm::min(min, v) : v;
+    max = i ? glm::max(max, v) : v;
+  }
+}
+
+MeshData MeshData::loadCtm(Resource resource, bool loadNormals, bool loadTexCoords) {
+  MeshData result;
+  CTMimporter importer;
+  importer.LoadData(Platform::getResourceString(resource));
+  size_t vertexCount = importer.GetInteger(CTM_VERTEX_COUNT);
+  {
+    const float * ctmData = importer.GetFloatArray(CTM_VERTICES);
+    result.positions.assign(ctmData, ctmData + vertexCount * 3);
+  }
+
+  if (loadTexCoords && importer.GetInteger(CTM_UV_MAP_COUNT)) {
+    const float * ctmData = importer.GetFloatArray(CTM_UV_MAP_1);
+    result.texCoords.assign(ctmData, ctmData + vertexCount * 2);
+  }
+
+  if (loadNormals && importer.GetInteger(CTM_HAS_NORMALS)) {
+    const float * ctmData = importer.GetFloatArray(CTM_NORMALS);
+    result.normals.assign(ctmData, ctmData + vertexCount * 3);
+  }
+
+  {
+    size_t indexCount = 3 * importer.GetInteger(CTM_TRIANGLE_COUNT);
+    const CTMuint * ctmIntData = importer.GetIntegerArray(CTM_INDICES);
+    result.indices.assign(ctmIntData, ctmIntData + indexCount);
+  }
+  return result;
+}
+
+size_t IndexData::typeSize(GLenum type) {
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+    return 1;
+  case GL_UNSIGNED_SHORT:
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+IndexData IndexData::pack(const std::vector<GLuint> & indices, size_t vertexCount, bool allowShort) {
+  IndexData result;
+  result.count = indices.size();
+  // Byte indices are slow on most hardware, so 16 bits is as narrow as it goes
+  if (allowShort && vertexCount <= 0x10000) {
+    result.type = GL_UNSIGNED_SHORT;
+    result.bytes.resize(indices.size() * sizeof(GLushort));
+    GLushort * out = (GLushort*)result.bytes.data();
+    for (GLuint index : indices) {
+      *out++ = (GLushort)index;
+    }
+  } else {
+    result.type = GL_UNSIGNED_INT;
+    result.bytes.resize(indices.size() * sizeof(GLuint));
+    if (!indices.empty()) {
+      memcpy(result.bytes.data(), indices.data(), result.bytes.size());
+    }
+  }
+  return result;
+}
+
+size_t Mesh::Stats::getTotalBytes() const {
+  return vertexBytes + indexBytes;
+}
+
+Mesh::Mesh(const std::initializer_list<const GLchar*> & names, const MeshData & data,
+    ProgramPtr program, const VertexFormat & format)
+  : format(format) {
+  using namespace oglplus;
+  size_t vertexCount = data.getVertexCount();
+  bool hasNormals = data.normals.size() == vertexCount * 3;
+  bool hasTexCoords = data.texCoords.size() == vertexCount * 2;
+
+  size_t positionOffset = 0;
+  size_t normalOffset = VertexFormat::positionBytes(format.position);
+  size_t texCoordOffset = normalOffset + (hasNormals ? VertexFormat::normalBytes(format.normal) : 0);
+  size_t stride = texCoordOffset + (hasTexCoords ? VertexFormat::texCoordBytes(format.texCoord) : 0);
+
+  // Quantized positions are stored relative to the center of the bounding
+  // box, scaled by its largest half extent, so one uniform scale undoes it
+  vec3 center;
+  float extent = 1.0f;
+  if (VertexFormat::POSITION_SNORM16 == format.position) {
+    vec3 min, max;
+    data.getBounds(min, max);
+    center = (min + max) / 2.0f;
+    vec3 halfSize = (max - min) / 2.0f;
+    extent = std::max(halfSize.x, std::max(halfSize.y, halfSize.z));
+    if (extent <= 0.0f) {
+      extent = 1.0f;
+    }
+    positionTransform = glm::scale(glm::translate(mat4(), center), vec3(extent));
+  }
+
+  std::vector<uint8_t> vertexData(vertexCount * stride);
+  uint8_t * out = vertexData.data();
+  for (size_t i = 0; i < vertexCount; ++i) {
+    const float * p = &data.positions[i * 3];
+    switch (format.position) {
+    case VertexFormat::POSITION_HALF:
+      for (int j = 0; j < 3; ++j) {
+        write(out, VertexFormat::toHalf(p[j]));
+      }
+      write(out, VertexFormat::toHalf(1.0f));
+      break;
+
+    case VertexFormat::POSITION_SNORM16:
+      for (int j = 0; j < 3; ++j) {
+        write(out, VertexFormat::toSnorm16((p[j] - center[j]) / extent));
+      }
+      write(out, (int16_t)32767);
+      break;
+
+    default:
+      for (int j = 0; j < 3; ++j) {
+        write(out, p[j]);
+      }
+      break;
+    }
+
+    if (hasNormals) {
+      const float * n = &data.normals[i * 3];
+      if (VertexFormat::NORMAL_INT_2_10_10_10 == format.normal) {
+        write(out, VertexFormat::toInt2_10_10_10(glm::make_vec3(n)));
+      } else {
+        for (int j = 0; j < 3; ++j) {
+          write(out, n[j]);
+        }
+      }
+    }
+
+    if (hasTexCoords) {
+      const float * t = &data.texCoords[i * 2];
+      for (int j = 0; j < 2; ++j) {
+        if (VertexFormat::TEXCOORD_HALF == format.texCoord) {
+          write(out, VertexFormat::toHalf(t[j]));
+        } else {
+          write(out, t[j]);
+        }
+      }
+    }
+  }
+
+  IndexData indexData = IndexData::pack(data.indices, vertexCount, format.shortIndices);
+
+  stats.vertexCount = vertexCount;
+  stats.indexCount = indexData.count;
+  stats.stride = stride;
+  stats.vertexBytes = vertexData.size();
+  stats.indexBytes = indexData.bytes.size();
+  stats.indexType = indexData.type;
+
+  vao.Bind();
+  vertexBuffer.Bind(Buffer::Target::Array);
+  Buffer::Data(Buffer::Target::Array, vertexData);
+  vertexMemory.set(GpuMemory::BUFFER, GetName(vertexBuffer), stats.vertexBytes);
+  indexBuffer.Bind(Buffer::Target::ElementArray);
+  Buffer::Data(Buffer::Target::ElementArray, indexData.bytes);
+  indexMemory.set(GpuMemory::BUFFER, GetName(indexBuffer), stats.indexBytes);
+
+  // The attributes are matched by the names ShapeWrapper uses
+  GLuint programName = GetName(*program);
+  GLsizei glStride = (GLsizei)stride;
+  for (const GLchar * name : names) {
+    GLint location = glGetAttribLocation(programName, name);
+    if (location < 0) {
+      continue;
+    }
+
+    if (!strcmp("Position", name)) {
+      void * offset = (void*)positionOffset;
+      switch (format.position) {
+      case VertexFormat::POSITION_HALF:
+        glVertexAttribPointer(location, 4, GL_HALF_FLOAT, GL_FALSE, glStride, offset);
+        break;
+      case VertexFormat::POSITION_SNORM16:
+        glVertexAttribPointer(location, 4, GL_SHORT, GL_TRUE, glStride, offset);
+        break;
+      default:
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, glStride, offset);
+        break;
+      }
+    } else if (!strcmp("Normal", name) && hasNormals) {
+      void * offset = (void*)normalOffset;
+      if (VertexFormat::NORMAL_INT_2_10_10_10 == format.normal) {
+        glVertexAttribPointer(location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, glStride, offset);
+      } else {
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, glStride, offset);
+      }
+    } else if (!strcmp("TexCoord", name) && hasTexCoords) {
+      void * offset = (void*)texCoordOffset;
+      if (VertexFormat::TEXCOORD_HALF == format.texCoord) {
+        glVertexAttribPointer(location, 2, GL_HALF_FLOAT, GL_FALSE, glStride, offset);
+      } else {
+        glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, glStride, offset);
+      }
+    } else {
+      continue;
+    }
+    glEnableVertexAttribArray(location);
+  }
+  NoVertexArray().Bind();
+}
+
+void Mesh::Use() {
+  vao.Bind();
+}
+
+void Mesh::Draw() {
+  glFrontFace(GL_CCW);
+  glDrawElements(GL_TRIANGLES, (GLsizei)stats.indexCount, stats.indexType, 0);
+}
+
+void Mesh::DrawInstanced(GLsizei instances) {
+  glFrontFace(GL_CCW);
+  glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)stats.indexCount, stats.indexType, 0, instances);
+}
+
+const mat4 & Mesh::getPositionTransform() const {
+  return positionTransform;
+}
+
+const VertexFormat & Mesh::getFormat() const {
+  return format;
+}
+
+const Mesh::Stats & Mesh::getStats() const {
+  return stats;
+}
@@ -0,0 +1,147 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// How a mesh's vertex attributes are stored in its vertex buffer.
+//
+// The CTM meshes arrive as 32 bit floats with 32 bit indices, which is far
+// more precision than they need.  The compact encodings store positions
+// and texture coordinates as half floats, and normals as signed 10 bit
+// components packed into GL_INT_2_10_10_10_REV, all of which the vertex
+// fetch expands back to floats, so the shaders don't change.  Indices are
+// 16 bit whenever the mesh has few enough vertices.
+//
+// Positions can also be stored as 16 bit normalized integers relative to
+// the mesh's bounding box, which is more precise than half floats over
+// the whole box.  The dequantization is a uniform scale and an offset that
+// has to be applied on top of the modelview matrix (see
+// Mesh::getPositionTransform()), so it also scales the normals, and only
+// suits shaders that renormalize them.
+struct VertexFormat {
+  enum Position {
+    POSITION_FLOAT,
+    POSITION_HALF,
+    POSITION_SNORM16,
+  };
+
+  enum Normal {
+    NORMAL_FLOAT,
+    NORMAL_INT_2_10_10_10,
+  };
+
+  enum TexCoord {
+    TEXCOORD_FLOAT,
+    TEXCOORD_HALF,
+  };
+
+  Position position{ POSITION_HALF };
+  Normal normal{ NORMAL_INT_2_10_10_10 };
+  TexCoord texCoord{ TEXCOORD_HALF };
+  // Use 16 bit indices when every vertex can be addressed with them
+  bool shortIndices{ true };
+
+  // The layout the meshes used to be loaded with
+  static VertexFormat full();
+  static VertexFormat compact();
+
+  static size_t positionBytes(Position position);
+  static size_t normalBytes(Normal normal);
+  static size_t texCoordBytes(TexCoord texCoord);
+  std::string toString() const;
+
+  // Rounds to the nearest half float
+  static uint16_t toHalf(float value);
+  // Clamps to [-1, 1]
+  static int16_t toSnorm16(float value);
+  // x in the low bits, as GL_INT_2_10_10_10_REV expects, and w left at zero
+  static uint32_t toInt2_10_10_10(const vec3 & value);
+};
+
+// Mesh data as loaded, before it's encoded for the GPU
+struct MeshData {
+  // 3 values per vertex
+  std::vector<float> positions;
+  // 3 values per vertex, or empty
+  std::vector<float> normals;
+  // 2 values per vertex, or empty
+  std::vector<float> texCoords;
+  std::vector<GLuint> indices;
+
+  size_t getVertexCount() const;
+  // The axis aligned bounds of the positions
+  void getBounds(vec3 & min, vec3 & max) const;
+
+  static MeshData loadCtm(Resource resource, bool loadNormals = true, bool loadTexCoords = true);
+};
+
+// Element indices packed into the narrowest type that holds them
+struct IndexData {
+  GLenum type{ GL_UNSIGNED_INT };
+  size_t count{ 0 };
+  std::vector<uint8_t> bytes;
+
+  static IndexData pack(const std::vector<GLuint> & indices, size_t vertexCount, bool allowShort = true);
+  static size_t typeSize(GLenum type);
+};
+
+// An indexed triangle mesh in a single interleaved vertex buffer, encoded
+// in a VertexFormat and bound to the named attributes of a program, in the
+// same way as an oglplus ShapeWrapper.
+class Mesh {
+public:
+  struct Stats {
+    size_t vertexCount{ 0 };
+    size_t indexCount{ 0 };
+    size_t stride{ 0 };
+    size_t vertexBytes{ 0 };
+    size_t indexBytes{ 0 };
+    GLenum indexType{ GL_UNSIGNED_INT };
+
+    // Also what one draw reads, if each vertex is fetched once
+    size_t getTotalBytes() const;
+  };
+
+  Mesh(const std::initializer_list<const GLchar*> & names, const MeshData & data,
+    ProgramPtr program, const VertexFormat & format = VertexFormat());
+
+  void Use();
+  void Draw();
+  // For shaders that pick their per-instance data with gl_InstanceID
+  void DrawInstanced(GLsizei instances);
+
+  // Maps the stored positions back to the mesh's coordinates.  Identity
+  // unless the positions are POSITION_SNORM16.
+  const mat4 & getPositionTransform() const;
+  const VertexFormat & getFormat() const;
+  const Stats & getStats() const;
+
+private:
+  VertexFormat format;
+  Stats stats;
+  mat4 positionTransform;
+  oglplus::VertexArray vao;
+  oglplus::Buffer vertexBuffer;
+  oglplus::Buffer indexBuffer;
+  GpuMemory::Allocation vertexMemory;
+  GpuMemory::Allocation indexMemory;
+};
+
+typedef std::shared_ptr<Mesh> MeshPtr;
@@ -26,6 +26,8 @@ typedef std::shared_ptr<oglplus::Program> ProgramPtr;
 typedef std::map<std::string, GLuint> UniformMap;
 
 namespace oria {
+  // Builds a program from GLSL source, leaving result empty on failure
+  void compileProgram(ProgramPtr & result, std::string vs, std::string fs);
   ProgramPtr loadProgram(Resource vs, Resource fs);
   ProgramPtr loadProgram(const std::string & vsFile, const std::string & fsFile);
   UniformMap getActiveUniforms(ProgramPtr & program);
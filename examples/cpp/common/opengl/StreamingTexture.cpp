@@ -0,0 +1,149 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#include "Common.h"
+
+// How long to wait for the GPU to finish with a buffer before giving up and
+// overwriting it anyway
+static const GLuint64 FENCE_TIMEOUT_NANOS = 100 * 1000 * 1000;
+
+StreamingTexture::StreamingTexture() {
+  for (int i = 0; i < RING_SIZE; ++i) {
+    fences[i] = 0;
+  }
+}
+
+StreamingTexture::~StreamingTexture() {
+  release();
+}
+
+void StreamingTexture::release() {
+  for (int i = 0; i < RING_SIZE; ++i) {
+    if (fences[i]) {
+      glDeleteSync(fences[i]);
+      fences[i] = 0;
+    }
+  }
+  if (buffer) {
+    if (mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      mapped = nullptr;
+    }
+    bufferMemory.release();
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+  }
+}
+
+void StreamingTexture::init(const uvec2 & size) {
+  using namespace oglplus;
+  release();
+  this->size = size;
+  frameBytes = size.x * size.y * 4;
+  uploadStats.reset();
+
+  texture = oria::createTexture();
+  Context::Bound(TextureTarget::_2D, *texture)
+    .MagFilter(TextureMagFilter::Linear)
+    .MinFilter(TextureMinFilter::Linear)
+    .WrapS(TextureWrap::ClampToEdge)
+    .WrapT(TextureWrap::ClampToEdge);
+  if (GLEW_ARB_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size.x, size.y);
+  } else {
+    // Still only allocated the once, just not immutable
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0,
+      GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+  }
+  GpuMemory::textureAllocated(*texture, GL_RGBA8, size);
+  DefaultTexture().Bind(TextureTarget::_2D);
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  GLsizeiptr totalBytes = frameBytes * RING_SIZE;
+  if (GLEW_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, totalBytes, nullptr, flags);
+    mapped = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalBytes, flags);
+  } else {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, totalBytes, nullptr, GL_STREAM_DRAW);
+  }
+  bufferMemory.set(GpuMemory::BUFFER, buffer, totalBytes);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool StreamingTexture::isInitialized() const {
+  return 0 != buffer;
+}
+
+bool StreamingTexture::isPersistent() const {
+  return nullptr != mapped;
+}
+
+void StreamingTexture::upload(const void * data) {
+  assert(buffer);
+  uploadStats.time([&] {
+    int index = next;
+    next = (next + 1) % RING_SIZE;
+    size_t offset = frameBytes * index;
+
+    // The texture update from the last time this buffer was used may still
+    // be pending
+    if (fences[index]) {
+      glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NANOS);
+      glDeleteSync(fences[index]);
+      fences[index] = 0;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    if (mapped) {
+      memcpy(mapped + offset, data, frameBytes);
+    } else {
+      void * target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, frameBytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+      if (target) {
+        memcpy(target, data, frameBytes);
+      }
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    texture->Bind(oglplus::TextureTarget::_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y,
+      GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, (const GLvoid *)offset);
+    fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    oglplus::DefaultTexture().Bind(oglplus::TextureTarget::_2D);
+  });
+}
+
+TexturePtr & StreamingTexture::getTexture() {
+  return texture;
+}
+
+const uvec2 & StreamingTexture::getSize() const {
+  return size;
+}
+
+const TimingStats & StreamingTexture::getUploadStats() const {
+  return uploadStats;
+}
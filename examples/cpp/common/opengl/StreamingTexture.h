@@ -0,0 +1,71 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Streams a sequence of same sized BGRA frames into a texture, for video
+// and webcam images.
+//
+// The texture storage is allocated once and is immutable.  Frames are copied
+// into a ring of pixel buffers that stay mapped for the lifetime of the
+// object, and the texture is updated from the buffer with glTexSubImage2D,
+// so the driver can do the transfer asynchronously.  BGRA with 8 bits per
+// channel is the layout GPUs store RGBA8 textures in, so the upload needs no
+// conversion.  Each buffer is fenced after use, and only reused once the GPU
+// has finished reading from it.
+//
+// Without ARB_buffer_storage (GL 4.4) the buffers can't stay mapped, and
+// are mapped again for every frame instead.
+class StreamingTexture {
+public:
+  static const int RING_SIZE = 3;
+
+  StreamingTexture();
+  ~StreamingTexture();
+
+  void init(const uvec2 & size);
+  bool isInitialized() const;
+
+  // Copies a frame of size.x * size.y BGRA pixels into the next pixel
+  // buffer and updates the texture from it
+  void upload(const void * data);
+
+  TexturePtr & getTexture();
+  const uvec2 & getSize() const;
+
+  // Render thread time spent in upload()
+  const TimingStats & getUploadStats() const;
+  bool isPersistent() const;
+
+private:
+  TexturePtr texture;
+  uvec2 size;
+  size_t frameBytes{ 0 };
+  GLuint buffer{ 0 };
+  GpuMemory::Allocation bufferMemory;
+  uint8_t * mapped{ nullptr };
+  GLsync fences[RING_SIZE];
+  int next{ 0 };
+  TimingStats uploadStats;
+
+  void release();
+};
+
+typedef std::shared_ptr<StreamingTexture> StreamingTexturePtr;
@@ -28,6 +28,9 @@
 struct TextureInfo {
   uvec2 size;
   TexturePtr tex;
+  // When the texture was last looked up, for evicting the least recently
+  // used ones
+  uint64_t lastUsed{ 0 };
 };
 typedef std::map<Resource, TextureInfo> TextureMap;
 typedef TextureMap::iterator TextureMapItr;
@@ -54,30 +57,81 @@ namespace oria {
     return loadImage(Platform::getResourceByteVector(res), flip);
   }
 
+  std::recursive_mutex & getTextureMapMutex() {
+    static std::recursive_mutex mutex;
+    return mutex;
+  }
+
+  TextureMap & getTextureMap();
+
+  // Drops the least recently used textures that nothing outside the cache
+  // is holding on to, until the given number of bytes has been freed
+  size_t evictTextures(size_t bytes) {
+    std::lock_guard<std::recursive_mutex> lock(getTextureMapMutex());
+    TextureMap & map = getTextureMap();
+    std::vector<TextureMapItr> unused;
+    for (TextureMapItr itr = map.begin(); itr != map.end(); ++itr) {
+      if (itr->second.tex.unique()) {
+        unused.push_back(itr);
+      }
+    }
+    std::sort(unused.begin(), unused.end(), [](const TextureMapItr & a, const TextureMapItr & b) {
+      return a->second.lastUsed < b->second.lastUsed;
+    });
+
+    size_t before = GpuMemory::getTotal(GpuMemory::TEXTURE).bytes;
+    size_t freed = 0;
+    for (TextureMapItr itr : unused) {
+      if (freed >= bytes) {
+        break;
+      }
+      map.erase(itr);
+      size_t after = GpuMemory::getTotal(GpuMemory::TEXTURE).bytes;
+      freed = before > after ? before - after : 0;
+    }
+    return freed;
+  }
+
   TextureMap & getTextureMap() {
     static TextureMap map;
     static bool registeredShutdown = false;
     if (!registeredShutdown) {
       Platform::addShutdownHook([&]{
+        std::lock_guard<std::recursive_mutex> lock(getTextureMapMutex());
         map.clear();
       });
+      GpuMemory::addBudgetListener(evictTextures);
       registeredShutdown = true;
     }
 
     return map;
   }
 
-  template <typename T, typename F>
-  T loadOrPopulate(std::map<Resource, T> & map, Resource resource, F loader) {
+  template <typename F>
+  TextureInfo loadOrPopulate(Resource resource, F loader) {
+    static uint64_t lookups = 0;
+    std::lock_guard<std::recursive_mutex> lock(getTextureMapMutex());
+    TextureMap & map = getTextureMap();
     if (!map.count(resource)) {
-      map[resource] = loader();
+      GpuMemory::Owner owner("Texture cache");
+      TextureInfo loaded = loader();
+      map[resource] = loaded;
     }
-    return map[resource];
+    TextureInfo & result = map[resource];
+    result.lastUsed = ++lookups;
+    return result;
+  }
+
+  TexturePtr createTexture() {
+    return TexturePtr(new oglplus::Texture(), [](oglplus::Texture * texture) {
+      GpuMemory::released(GpuMemory::TEXTURE, oglplus::GetName(*texture));
+      delete texture;
+    });
   }
 
   TexturePtr load2dTextureFromPngData(std::vector<uint8_t> & data) {
     using namespace oglplus;
-    TexturePtr texture(new Texture());
+    TexturePtr texture = createTexture();
     Context::Bound(TextureTarget::_2D, *texture)
       .MagFilter(TextureMagFilter::Linear)
       .MinFilter(TextureMinFilter::Linear);
@@ -85,13 +139,15 @@ namespace oria {
     // FIXME detect alignment properly, test on both OpenCV and LibPNG
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     Texture::Image2D(TextureTarget::_2D, *image);
+    GpuMemory::textureAllocated(*texture, GLenum(image->InternalFormat()),
+      uvec2(image->Width(), image->Height()));
     return texture;
   }
 
   TextureInfo load2dTextureInternal(const std::vector<uint8_t> & data) {
     using namespace oglplus;
     TextureInfo result;
-    result.tex = TexturePtr(new Texture());
+    result.tex = createTexture();
     Context::Bound(TextureTarget::_2D, *result.tex)
       .MagFilter(TextureMagFilter::Linear)
       .MinFilter(TextureMinFilter::Linear);
@@ -101,6 +157,7 @@ namespace oria {
     // FIXME detect alignment properly, test on both OpenCV and LibPNG
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     Texture::Image2D(TextureTarget::_2D, *image);
+    GpuMemory::textureAllocated(*result.tex, GLenum(image->InternalFormat()), result.size);
     return result;
   }
 
@@ -116,7 +173,7 @@ namespace oria {
   }
 
   TexturePtr load2dTexture(Resource resource, uvec2 & outSize) {
-    const TextureInfo & texInfo = loadOrPopulate(getTextureMap(), resource, [&] {
+    TextureInfo texInfo = loadOrPopulate(resource, [&] {
       return load2dTextureInternal(Platform::getResourceByteVector(resource));
     });
     outSize = texInfo.size;
@@ -131,7 +188,7 @@ namespace oria {
 
   TexturePtr loadCubemapTexture(std::function<ImagePtr(int)> dataLoader) {
     using namespace oglplus;
-    TexturePtr result = TexturePtr(new Texture());
+    TexturePtr result = createTexture();
     Context::Bound(TextureTarget::CubeMap, *result)
       .MagFilter(TextureMagFilter::Linear)
       .MinFilter(TextureMinFilter::Linear)
@@ -140,18 +197,26 @@ namespace oria {
       .WrapR(TextureWrap::ClampToEdge);
 
     glm::uvec2 size;
+    GLenum internalFormat = 0;
+    int faces = 0;
     for (int i = 0; i < 6; ++i) {
       ImagePtr image = dataLoader(i);
       if (!image) {
         continue;
       }
       Texture::Image2D(Texture::CubeMapFace(i), *image);
+      size = uvec2(image->Width(), image->Height());
+      internalFormat = GLenum(image->InternalFormat());
+      ++faces;
+    }
+    if (faces) {
+      GpuMemory::textureAllocated(*result, internalFormat, size, 1, faces);
     }
     return result;
   }
 
   TexturePtr loadCubemapTexture(Resource firstResource, int resourceOrder[6], bool flip) {
-    const TextureInfo & texInfo = loadOrPopulate(getTextureMap(), firstResource, [&] {
+    TextureInfo texInfo = loadOrPopulate(firstResource, [&] {
       TextureInfo result;
       result.tex = loadCubemapTexture([&](int i) {
         Resource imageRes = NO_RESOURCE;
@@ -23,6 +23,9 @@ typedef std::shared_ptr<oglplus::Texture> TexturePtr;
 typedef std::shared_ptr<oglplus::images::Image> ImagePtr;
 
 namespace oria {
+  // A texture that GpuMemory stops counting when it's deleted
+  TexturePtr createTexture();
+
   ImagePtr loadImage(const std::vector<uint8_t> & data, bool flip = true);
   TexturePtr load2dTextureFromPngData(std::vector<uint8_t> & data);
   TexturePtr load2dTexture(const std::vector<uint8_t> & data);
@@ -0,0 +1,164 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+#include "Common.h"
+#include <fstream>
+
+static double toMillis(double seconds) {
+  return seconds * 1000.0;
+}
+
+std::string LatencyTracker::Distribution::toString() const {
+  return Platform::format("avg %5.1f  med %5.1f  95%% %5.1f  99%% %5.1f  max %5.1f ms",
+    mean, median, p95, p99, max);
+}
+
+LatencyTracker::LatencyTracker() {
+}
+
+LatencyTracker::~LatencyTracker() {
+  stopCsv();
+}
+
+void LatencyTracker::beginFrame(unsigned int index, const ovrFrameTiming & timing) {
+  current = Frame();
+  current.index = index;
+  current.timewarpTime = timing.TimewarpPointSeconds;
+  current.scanoutTime = timing.ScanoutMidpointSeconds;
+}
+
+void LatencyTracker::posesQueried(const ovrTrackingState & state) {
+  current.poseQueryTime = ovr_GetTimeInSeconds();
+  current.predictedTime = state.HeadPose.TimeInSeconds;
+  current.sensorTime = state.RawSensorData.TimeInSeconds;
+  current.simulatedSensor = current.sensorTime <= 0;
+  if (current.simulatedSensor) {
+    current.sensorTime = current.poseQueryTime;
+  }
+}
+
+void LatencyTracker::renderStarted() {
+  current.renderStart = ovr_GetTimeInSeconds();
+}
+
+void LatencyTracker::renderFinished() {
+  current.renderEnd = ovr_GetTimeInSeconds();
+}
+
+void LatencyTracker::submitting() {
+  current.submitTime = ovr_GetTimeInSeconds();
+}
+
+void LatencyTracker::frameEnded() {
+  current.endFrameTime = ovr_GetTimeInSeconds();
+  frames.push_back(current);
+  if (frames.size() > HISTORY) {
+    frames.pop_front();
+  }
+  if (csv) {
+    const Frame & f = current;
+    *csv << Platform::format("%u,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%d,%0.3f,%0.3f,%0.3f\n",
+      f.index, f.sensorTime, f.poseQueryTime, f.predictedTime, f.renderStart, f.renderEnd,
+      f.submitTime, f.endFrameTime, f.timewarpTime, f.scanoutTime, f.simulatedSensor ? 1 : 0,
+      toMillis(f.motionToPhoton()), toMillis(f.poseAge()), toMillis(f.predictionError()));
+  }
+}
+
+LatencyTracker::Distribution LatencyTracker::getDistribution(double (Frame::*metric)() const) const {
+  Distribution result;
+  if (frames.empty()) {
+    return result;
+  }
+  std::vector<double> values;
+  values.reserve(frames.size());
+  double total = 0;
+  for (const Frame & frame : frames) {
+    values.push_back(toMillis((frame.*metric)()));
+    total += values.back();
+  }
+  std::sort(values.begin(), values.end());
+  auto percentile = [&](double fraction) {
+    return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))];
+  };
+  result.count = values.size();
+  result.mean = total / values.size();
+  result.min = values.front();
+  result.max = values.back();
+  result.median = percentile(0.5);
+  result.p95 = percentile(0.95);
+  result.p99 = percentile(0.99);
+  return result;
+}
+
+LatencyTracker::Distribution LatencyTracker::getMotionToPhoton() const {
+  return getDistribution(&Frame::motionToPhoton);
+}
+
+LatencyTracker::Distribution LatencyTracker::getPoseAge() const {
+  return getDistribution(&Frame::poseAge);
+}
+
+LatencyTracker::Distribution LatencyTracker::getPredictionError() const {
+  return getDistribution(&Frame::predictionError);
+}
+
+std::vector<std::string> LatencyTracker::getSummary() const {
+  std::vector<std::string> result;
+  if (frames.empty()) {
+    return result;
+  }
+  const Frame & last = frames.back();
+  result.push_back(Platform::format("Latency over %d frames%s", (int)frames.size(),
+    last.simulatedSensor ? " (no sensor, simulated)" : ""));
+  result.push_back("Motion to photon  " + getMotionToPhoton().toString());
+  result.push_back("Pose age          " + getPoseAge().toString());
+  result.push_back("Prediction error  " + getPredictionError().toString());
+  result.push_back(Platform::format("Last frame: render %0.1f ms, EndFrame %0.1f ms, timewarp %0.1f ms before scanout",
+    toMillis(last.renderEnd - last.renderStart), toMillis(last.endFrameTime - last.submitTime),
+    toMillis(last.scanoutTime - last.timewarpTime)));
+  return result;
+}
+
+const std::deque<LatencyTracker::Frame> & LatencyTracker::getFrames() const {
+  return frames;
+}
+
+void LatencyTracker::reset() {
+  frames.clear();
+}
+
+bool LatencyTracker::startCsv(const std::string & path) {
+  stopCsv();
+  csv = std::unique_ptr<std::ofstream>(new std::ofstream(path.c_str()));
+  if (!*csv) {
+    csv.reset();
+    return false;
+  }
+  *csv << "frame,sensor,pose_query,predicted,render_start,render_end,submit,end_frame,timewarp,scanout,"
+    "simulated_sensor,motion_to_photon_ms,pose_age_ms,prediction_error_ms\n";
+  return true;
+}
+
+void LatencyTracker::stopCsv() {
+  csv.reset();
+}
+
+bool LatencyTracker::isWritingCsv() const {
+  return (bool)csv;
+}
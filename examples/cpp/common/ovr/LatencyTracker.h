@@ -0,0 +1,119 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Follows each frame from the sensor sample its poses were predicted from
+// to the moment the SDK expects it to reach the display, so an example can
+// show how old the head pose is by the time anyone sees it.
+//
+// The render loop reports the milestones of each frame as it reaches them,
+// all on the ovr_GetTimeInSeconds() clock.  The scanout time is the SDK's
+// prediction from ovrFrameTiming rather than a measurement, so against the
+// debug HMD, which has no sensor and only simulated display timing, the
+// numbers show the structure of the latency rather than its true size.
+class LatencyTracker {
+public:
+  // Frames kept for the distributions, a few seconds' worth
+  static const size_t HISTORY = 450;
+
+  struct Frame {
+    unsigned int index{ 0 };
+    // When the sensor sample the poses were predicted from was taken
+    double sensorTime{ 0 };
+    double poseQueryTime{ 0 };
+    // The time the SDK predicted the poses for
+    double predictedTime{ 0 };
+    double renderStart{ 0 };
+    double renderEnd{ 0 };
+    // When EndFrame was called, and when it returned
+    double submitTime{ 0 };
+    double endFrameTime{ 0 };
+    // When timewarp samples the orientation again, if it's enabled
+    double timewarpTime{ 0 };
+    double scanoutTime{ 0 };
+    // Set when there was no sensor sample, as with the debug HMD, in which
+    // case the pose query time stands in for it
+    bool simulatedSensor{ false };
+
+    // The latency of motion reaching the eye, ignoring prediction
+    double motionToPhoton() const {
+      return scanoutTime - sensorTime;
+    }
+
+    // How far past the pose query the frame is shown, which is how far the
+    // SDK's prediction has to reach
+    double poseAge() const {
+      return scanoutTime - poseQueryTime;
+    }
+
+    // How far the time the poses were predicted for missed the scanout
+    double predictionError() const {
+      return scanoutTime - predictedTime;
+    }
+  };
+
+  // In milliseconds
+  struct Distribution {
+    size_t count{ 0 };
+    double mean{ 0 };
+    double min{ 0 };
+    double max{ 0 };
+    double median{ 0 };
+    double p95{ 0 };
+    double p99{ 0 };
+
+    std::string toString() const;
+  };
+
+  LatencyTracker();
+  ~LatencyTracker();
+
+  void beginFrame(unsigned int index, const ovrFrameTiming & timing);
+  // Call straight after fetching the eye poses, with the tracking state
+  // they came from
+  void posesQueried(const ovrTrackingState & state);
+  void renderStarted();
+  void renderFinished();
+  void submitting();
+  // Completes the frame, adding it to the history and the CSV file
+  void frameEnded();
+
+  Distribution getMotionToPhoton() const;
+  Distribution getPoseAge() const;
+  Distribution getPredictionError() const;
+  // A few lines describing the distributions, for an overlay
+  std::vector<std::string> getSummary() const;
+  const std::deque<Frame> & getFrames() const;
+  // Clears the history, for instance after a change of settings
+  void reset();
+
+  // Writes every completed frame to a CSV file, one row per frame
+  bool startCsv(const std::string & path);
+  void stopCsv();
+  bool isWritingCsv() const;
+
+private:
+  Frame current;
+  std::deque<Frame> frames;
+  std::unique_ptr<std::ofstream> csv;
+
+  Distribution getDistribution(double (Frame::*metric)() const) const;
+};
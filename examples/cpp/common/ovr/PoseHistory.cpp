@@ -0,0 +1,193 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#include "Common.h"
+
+// Queries stay this many samples clear of the oldest one, so the writer is
+// unlikely to overwrite a slot while a search is looking at it
+static const uint64_t WRITER_MARGIN = 16;
+static const int MAX_QUERY_ATTEMPTS = 4;
+
+PoseHistory::PoseHistory() {
+}
+
+PoseHistory::~PoseHistory() {
+  stop();
+}
+
+void PoseHistory::start(ovrHmd hmd, int rateHz) {
+  stop();
+  quit = false;
+  sampler = std::thread([=] {
+    run(hmd, rateHz);
+  });
+}
+
+void PoseHistory::stop() {
+  if (sampler.joinable()) {
+    quit = true;
+    sampler.join();
+  }
+}
+
+void PoseHistory::run(ovrHmd hmd, int rateHz) {
+  Profiler::setThreadName("Pose sampler");
+  Platform::setThreadPriority(Platform::HIGH);
+  typedef std::chrono::high_resolution_clock Clock;
+  const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(1.0 / rateHz));
+  Clock::time_point next = Clock::now();
+  double lastTime = -1;
+  while (!quit) {
+    ovrTrackingState state = ovrHmd_GetTrackingState(hmd, 0.0);
+    const ovrPoseStatef & head = state.HeadPose;
+    // The tracker may not have produced anything new since the last poll
+    if (head.TimeInSeconds > lastTime) {
+      Sample sample;
+      sample.time = lastTime = head.TimeInSeconds;
+      sample.orientation = ovr::toGlm(head.ThePose.Orientation);
+      sample.position = ovr::toGlm(head.ThePose.Position);
+      record(sample);
+    }
+    next += interval;
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void PoseHistory::record(const Sample & sample) {
+  uint64_t index = count.load(std::memory_order_relaxed);
+  Slot & slot = slots[index % CAPACITY];
+  uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.index.store(index, std::memory_order_relaxed);
+  slot.time.store(sample.time, std::memory_order_relaxed);
+  const float * orientation = &sample.orientation.x;
+  for (int i = 0; i < 4; ++i) {
+    slot.values[i].store(orientation[i], std::memory_order_relaxed);
+  }
+  for (int i = 0; i < 3; ++i) {
+    slot.values[4 + i].store(sample.position[i], std::memory_order_relaxed);
+  }
+
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  count.store(index + 1, std::memory_order_release);
+}
+
+bool PoseHistory::read(uint64_t index, Sample & result) const {
+  const Slot & slot = slots[index % CAPACITY];
+  uint32_t before = slot.sequence.load(std::memory_order_acquire);
+  if (before & 1) {
+    return false;
+  }
+  uint64_t slotIndex = slot.index.load(std::memory_order_relaxed);
+  result.time = slot.time.load(std::memory_order_relaxed);
+  float * orientation = &result.orientation.x;
+  for (int i = 0; i < 4; ++i) {
+    orientation[i] = slot.values[i].load(std::memory_order_relaxed);
+  }
+  for (int i = 0; i < 3; ++i) {
+    result.position[i] = slot.values[4 + i].load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slotIndex == index &&
+    before == slot.sequence.load(std::memory_order_relaxed);
+}
+
+bool PoseHistory::find(double time, Sample & result, bool & covered) const {
+  uint64_t end = count.load(std::memory_order_acquire);
+  if (0 == end) {
+    return false;
+  }
+  uint64_t first = 0;
+  if (end > CAPACITY - WRITER_MARGIN) {
+    first = end - (CAPACITY - WRITER_MARGIN);
+  }
+  uint64_t last = end - 1;
+
+  Sample before, after;
+  if (!read(last, after)) {
+    return false;
+  }
+  if (time >= after.time) {
+    result = after;
+    covered = (time == after.time);
+    return true;
+  }
+  if (!read(first, before)) {
+    return false;
+  }
+  if (time <= before.time) {
+    result = before;
+    covered = (time == before.time);
+    return true;
+  }
+
+  // Narrow down to the pair of samples either side of the requested time
+  while (last - first > 1) {
+    uint64_t middle = first + (last - first) / 2;
+    Sample sample;
+    if (!read(middle, sample)) {
+      return false;
+    }
+    if (sample.time <= time) {
+      first = middle;
+      before = sample;
+    } else {
+      last = middle;
+      after = sample;
+    }
+  }
+
+  float alpha = (float)((time - before.time) / (after.time - before.time));
+  result.time = time;
+  result.orientation = glm::slerp(before.orientation, after.orientation, alpha);
+  result.position = glm::mix(before.position, after.position, alpha);
+  covered = true;
+  return true;
+}
+
+bool PoseHistory::getPose(double time, Sample & result) const {
+  // A read only fails if the writer lapped the search, so a retry will
+  // almost certainly succeed
+  for (int i = 0; i < MAX_QUERY_ATTEMPTS; ++i) {
+    bool covered = false;
+    if (find(time, result, covered)) {
+      return covered;
+    }
+    if (0 == count.load(std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  return false;
+}
+
+bool PoseHistory::getPose(double time, ovrPosef & result) const {
+  Sample sample;
+  bool covered = getPose(time, sample);
+  result.Orientation = ovr::fromGlm(sample.orientation);
+  result.Position = ovr::fromGlm(sample.position);
+  return covered;
+}
+
+uint64_t PoseHistory::getSampleCount() const {
+  return count.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+/************************************************************************************
+ 
+ Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+ Copyright   :   Copyright Brad Davis. All Rights reserved.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ ************************************************************************************/
+
+
+#pragma once
+
+// Records the head pose at a high rate on its own thread, so that any
+// thread can look up where the head was at some moment in the recent past
+// (for instance when a webcam frame was captured) without a call into the
+// SDK and without taking a lock.
+//
+// Samples go into a fixed size ring.  There's a single writer, and each
+// slot carries a sequence number that's odd while the slot is being
+// written, so readers can detect a torn read and retry.  Queries binary
+// search the ring by time and interpolate between the two samples either
+// side of the requested time, with slerp for the orientation and lerp for
+// the position.
+class PoseHistory {
+public:
+  // A little over a second of history at the default rate
+  static const size_t CAPACITY = 1024;
+  static const int DEFAULT_RATE = 1000;
+
+  struct Sample {
+    // On the ovr_GetTimeInSeconds() clock
+    double time{ 0 };
+    glm::quat orientation;
+    glm::vec3 position;
+  };
+
+  PoseHistory();
+  ~PoseHistory();
+
+  // Starts the sampler thread, reading the tracking state rateHz times per
+  // second
+  void start(ovrHmd hmd, int rateHz = DEFAULT_RATE);
+  void stop();
+
+  // Adds a sample.  Only the sampler thread should call this while it's
+  // running, but it can also be used to replay a recorded trace.  Times
+  // must be increasing.
+  void record(const Sample & sample);
+
+  // Fills in the pose at the given time.  Returns false if the time isn't
+  // covered by the history, in which case the result is the oldest or
+  // newest sample, whichever is closer.
+  bool getPose(double time, Sample & result) const;
+  bool getPose(double time, ovrPosef & result) const;
+
+  // The number of samples recorded so far
+  uint64_t getSampleCount() const;
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> sequence{ 0 };
+    std::atomic<uint64_t> index{ 0 };
+    std::atomic<double> time{ 0 };
+    // Orientation x, y, z, w then position x, y, z
+    std::atomic<float> values[7];
+  };
+
+  std::array<Slot, CAPACITY> slots;
+  std::atomic<uint64_t> count{ 0 };
+  std::thread sampler;
+  std::atomic<bool> quit{ false };
+
+  bool read(uint64_t index, Sample & result) const;
+  bool find(double time, Sample & result, bool & covered) const;
+  void run(ovrHmd hmd, int rateHz);
+};
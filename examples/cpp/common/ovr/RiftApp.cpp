@@ -88,6 +88,7 @@ void RiftApp::initGl() {
   glm::uvec2 frameBufferSize = ovr::toGlm(eyeTextures[0].Header.TextureSize);
   for_each_eye([&](ovrEyeType eye) {
     eyeFramebuffers[eye] = FramebufferWrapperPtr(new FramebufferWrapper());
+    eyeFramebuffers[eye]->owner = "Eye framebuffers";
     eyeFramebuffers[eye]->init(frameBufferSize);
     ((ovrGLTexture&)(eyeTextures[eye])).OGL.TexId = 
         oglplus::GetName(eyeFramebuffers[eye]->color);
@@ -108,13 +109,20 @@ void RiftApp::applyEyePoseAndOffset(const glm::mat4 & eyePose, const glm::vec3 &
 }
 
 void RiftApp::draw() {
-  ovrHmd_BeginFrame(hmd, getFrame());
+  {
+    PROFILE_SCOPE("Begin frame");
+    ovrHmd_BeginFrame(hmd, getFrame());
+  }
   MatrixStack & mv = Stacks::modelview();
   MatrixStack & pr = Stacks::projection();
   
-  ovrHmd_GetEyePoses(hmd, getFrame(), eyeOffsets, eyePoses, nullptr);
+  {
+    PROFILE_SCOPE("Get eye poses");
+    ovrHmd_GetEyePoses(hmd, getFrame(), eyeOffsets, eyePoses, nullptr);
+  }
   for (int i = 0; i < 2; ++i) {
     ovrEyeType eye = currentEye = hmd->EyeRenderOrder[i];
+    PROFILE_SCOPE(eye == ovrEye_Left ? "Left eye" : "Right eye");
     Stacks::withPush(pr, mv, [&]{
       const ovrEyeRenderDesc & erd = eyeRenderDescs[eye];
       // Set up the per-eye projection matrix
@@ -140,7 +148,11 @@ void RiftApp::draw() {
   oglplus::DefaultFramebuffer().Bind(oglplus::Framebuffer::Target::Draw);
 
 #if 1
-  ovrHmd_EndFrame(hmd, eyePoses, eyeTextures);
+  {
+    // Includes the SDK's distortion rendering and buffer swap
+    PROFILE_SCOPE("End frame");
+    ovrHmd_EndFrame(hmd, eyePoses, eyeTextures);
+  }
 #else
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   static gl::GeometryPtr geometry = GlUtils::getQuadGeometry(1.0, 1.5f);
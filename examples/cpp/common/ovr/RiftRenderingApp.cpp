@@ -37,6 +37,7 @@ void RiftRenderingApp::initializeRiftRendering() {
     glm::uvec2 frameBufferSize = ovr::toGlm(eyeTextures[0].Header.TextureSize);
     for_each_eye([&](ovrEyeType eye) {
       eyeFramebuffers[eye] = FramebufferWrapperPtr(new FramebufferWrapper());
+      eyeFramebuffers[eye]->owner = "Eye framebuffers";
       eyeFramebuffers[eye]->init(frameBufferSize);
       ((ovrGLTexture&)(eyeTextures[eye])).OGL.TexId =
         oglplus::GetName(eyeFramebuffers[eye]->color);
@@ -59,6 +60,11 @@ RiftRenderingApp::RiftRenderingApp() {
       eyeTextureHeader.RenderViewport.Size = eyeTextureSize;
       eyeTextureHeader.API = ovrRenderAPI_OpenGL;
     });
+
+    const char * latencyCsv = getenv("LATENCY_CSV");
+    if (latencyCsv && *latencyCsv && !latencyTracker.startCsv(latencyCsv)) {
+      SAY_ERR("Unable to write frame latencies to %s", latencyCsv);
+    }
   }
 
 RiftRenderingApp::~RiftRenderingApp() {
@@ -67,15 +73,28 @@ RiftRenderingApp::~RiftRenderingApp() {
 static RateCounter rateCounter;
 
 void RiftRenderingApp::drawRiftFrame() {
+  PROFILE_SCOPE("Rift frame");
   ++frameCount;
-  ovrHmd_BeginFrame(hmd, frameCount);
+  {
+    PROFILE_SCOPE("Begin frame");
+    latencyTracker.beginFrame(frameCount, ovrHmd_BeginFrame(hmd, frameCount));
+  }
   MatrixStack & mv = Stacks::modelview();
   MatrixStack & pr = Stacks::projection();
 
-  perFrameRender();
+  {
+    PROFILE_SCOPE("Per frame render");
+    perFrameRender();
+  }
   
   ovrPosef fetchPoses[2];
-  ovrHmd_GetEyePoses(hmd, frameCount, eyeOffsets, fetchPoses, nullptr);
+  {
+    PROFILE_SCOPE("Get eye poses");
+    ovrTrackingState trackingState;
+    ovrHmd_GetEyePoses(hmd, frameCount, eyeOffsets, fetchPoses, &trackingState);
+    latencyTracker.posesQueried(trackingState);
+  }
+  latencyTracker.renderStarted();
   for (int i = 0; i < 2; ++i) {
     ovrEyeType eye = currentEye = hmd->EyeRenderOrder[i];
     // Force us to alternate eyes if we aren't keeping up with the required framerate
@@ -87,6 +106,7 @@ void RiftRenderingApp::drawRiftFrame() {
     eyePoses[eye] = fetchPoses[eye];
 
     lastEyeRendered = eye;
+    PROFILE_SCOPE(eye == ovrEye_Left ? "Left eye" : "Right eye");
     Stacks::withPush(pr, mv, [&] {
       // Set up the per-eye projection matrix
       pr.top() = projections[eye];
@@ -99,6 +119,9 @@ void RiftRenderingApp::drawRiftFrame() {
       // Render the scene to an offscreen buffer
       eyeFramebuffers[eye]->Bind();
       perEyeRender();
+      if (latencyOverlay) {
+        renderLatencyOverlay();
+      }
     });
     
     if (eyePerFrameMode) {
@@ -106,13 +129,22 @@ void RiftRenderingApp::drawRiftFrame() {
     }
   }
 
+  latencyTracker.renderFinished();
+
   if (endFrameLock) {
+    PROFILE_SCOPE("Wait for end frame lock");
     endFrameLock->lock();
   }
-  ovrHmd_EndFrame(hmd, eyePoses, eyeTextures);
+  {
+    // Includes the SDK's distortion rendering and buffer swap
+    PROFILE_SCOPE("End frame");
+    latencyTracker.submitting();
+    ovrHmd_EndFrame(hmd, eyePoses, eyeTextures);
+  }
   if (endFrameLock) {
     endFrameLock->unlock();
   }
+  latencyTracker.frameEnded();
   rateCounter.increment();
   if (rateCounter.elapsed() > 2.0f) {
     float fps = rateCounter.getRate();
@@ -121,4 +153,37 @@ void RiftRenderingApp::drawRiftFrame() {
   }
 }
 
-
+// Lists the latency distributions in the middle of the eye's view, where
+// the lens is sharpest
+void RiftRenderingApp::renderLatencyOverlay() {
+  using namespace oglplus;
+  // Sorting the history for the percentiles every frame would be wasteful
+  if (latencySummary.empty() || 0 == frameCount % 30) {
+    latencySummary = latencyTracker.getSummary();
+  }
+  MatrixStack & mv = Stacks::modelview();
+  MatrixStack & pr = Stacks::projection();
+  glm::uvec2 size = ovr::toGlm(eyeTextures[currentEye].Header.TextureSize);
+  oria::viewport(size);
+  GLboolean blend = glIsEnabled(GL_BLEND);
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  Context::Enable(Capability::Blend);
+  Context::BlendFunc(BlendFunction::SrcAlpha, BlendFunction::OneMinusSrcAlpha);
+  Context::Disable(Capability::DepthTest);
+  Stacks::withPush(pr, mv, [&] {
+    mv.identity();
+    pr.top() = glm::ortho(-1.0f, 1.0f, -1.0f / aspect(vec2(size)), 1.0f / aspect(vec2(size)), -100.0f, 100.0f);
+    float y = 0.15f;
+    for (const std::string & line : latencySummary) {
+      glm::vec2 cursor(-0.4f, y);
+      oria::renderString(line, cursor, 9.0f);
+      y -= 0.04f;
+    }
+  });
+  if (!blend) {
+    Context::Disable(Capability::Blend);
+  }
+  if (depthTest) {
+    Context::Enable(Capability::DepthTest);
+  }
+}
@@ -23,6 +23,7 @@ class RiftRenderingApp : public RiftManagerApp {
   ovrEyeType currentEye{ovrEye_Count};
   FramebufferWrapperPtr eyeFramebuffers[2];
   unsigned int frameCount{ 0 };
+  std::vector<std::string> latencySummary;
 
 protected:
   ovrPosef eyePoses[2];
@@ -35,6 +36,10 @@ protected:
 
   std::mutex * endFrameLock{ nullptr };
 
+  // Set LATENCY_CSV to a path to log the latency of every frame
+  LatencyTracker latencyTracker;
+  bool latencyOverlay{ false };
+
 private:
   virtual void * getNativeWindow() = 0;
 
@@ -53,6 +58,7 @@ protected:
   virtual void drawRiftFrame() final;
   virtual void perFrameRender() {};
   virtual void perEyeRender() {};
+  virtual void renderLatencyOverlay();
 
 public:
   RiftRenderingApp();
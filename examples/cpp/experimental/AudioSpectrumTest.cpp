@@ -0,0 +1,72 @@
+#include "Common.h"
+#include "AudioSpectrum.h"
+
+// Feeds a pure tone through a NullAudioSink and the analysis ShadertoyVR's
+// music channels use, and checks the 512x2 texture data it produces: the
+// peak of the spectrum in the first row should be the tone's bin, and the
+// second row should be the tone's waveform at the playback position.
+//
+// The tone sits exactly on a bin, so the peak doesn't depend on how the
+// window spreads it.
+
+static const int SAMPLE_RATE = 44100;
+static const float SECONDS = 2.0f;
+static const size_t TONE_BIN = 40;
+// Quiet enough to stay under the analyser's -30dB ceiling, which louder
+// tones saturate across several bins
+static const float AMPLITUDE = 0.05f;
+// Enough for the smoothing to settle on the tone
+static const int ANALYSES = 30;
+
+static float tone(size_t sample) {
+  return AMPLITUDE * sin(2.0f * PI * TONE_BIN * sample / AudioSpectrum::FFT_SIZE);
+}
+
+MAIN_DECL {
+  std::vector<float> samples((size_t)(SAMPLE_RATE * SECONDS));
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = tone(i);
+  }
+
+  NullAudioSink sink;
+  sink.start(samples, SAMPLE_RATE);
+  Platform::sleepMillis(50);
+  size_t position = (size_t)(sink.getPosition() * SAMPLE_RATE) % samples.size();
+
+  AudioSpectrum spectrum;
+  AudioSpectrum::TextureData data;
+  TimingStats stats;
+  for (int i = 0; i < ANALYSES; ++i) {
+    stats.time([&] {
+      spectrum.analyze(samples, position, data);
+    });
+  }
+  SAY("Analysis at sample %d: %s", (int)position, stats.toString().c_str());
+
+  bool passed = true;
+  const uint8_t * bins = &data[0];
+  size_t peak = std::max_element(bins, bins + AudioSpectrum::BINS) - bins;
+  SAY("Spectrum peak in bin %d (%d), expected bin %d", (int)peak, bins[peak], (int)TONE_BIN);
+  if (peak != TONE_BIN || bins[TONE_BIN + 16] >= bins[TONE_BIN] / 2) {
+    SAY_ERR("The spectrum doesn't peak at the tone");
+    passed = false;
+  }
+
+  // The waveform row is the most recent half of the block ending at the
+  // playback position
+  const uint8_t * waveform = &data[AudioSpectrum::BINS];
+  int worstError = 0;
+  for (size_t i = 0; i < AudioSpectrum::BINS; ++i) {
+    size_t sample = (position + samples.size() - AudioSpectrum::BINS + i) % samples.size();
+    int expected = (int)glm::clamp(128.0f * (1.0f + tone(sample)), 0.0f, 255.0f);
+    worstError = std::max(worstError, std::abs(expected - (int)waveform[i]));
+  }
+  SAY("Waveform worst error %d", worstError);
+  if (worstError > 1) {
+    SAY_ERR("The waveform doesn't match the tone");
+    passed = false;
+  }
+
+  SAY("%s", passed ? "Passed" : "Failed");
+  return passed ? 0 : -1;
+}
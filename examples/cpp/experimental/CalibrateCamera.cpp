@@ -1,8 +1,10 @@
 #include "Common.h"
+#include "FrameSource.h"
+#include "CalibrationEngine.h"
 #include <time.h>
 #include <stdio.h>
 
-#if 0
+#ifdef HAVE_OPENCV
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/calib3d/calib3d.hpp>
@@ -19,6 +21,7 @@ static void help()
 {
   cout << "This is a camera calibration sample." << endl
     << "Usage: calibration configurationFile" << endl
+    << "Press 'g' to start collecting views, 'u' to toggle undistortion, 's' to save and ESC to finish." << endl
     << "Near the sample file you'll find the configuration file, which has detailed help of "
     "how to edit it.  It may be any OpenCV supported file format XML/YAML." << endl;
 }
@@ -93,31 +96,23 @@ public:
       inputType = INVALID;
     else
     {
-      if (input[0] >= '0' && input[0] <= '9')
+      bool device = input[0] >= '0' && input[0] <= '9';
+      if (!device && readStringList(input, imageList))
       {
-        stringstream ss(input);
-        ss >> cameraID;
-        inputType = CAMERA;
+        inputType = IMAGE_LIST;
+        nrFrames = (nrFrames < (int)imageList.size()) ? nrFrames : (int)imageList.size();
       }
       else
       {
-        if (readStringList(input, imageList))
-        {
-          inputType = IMAGE_LIST;
-          nrFrames = (nrFrames < (int)imageList.size()) ? nrFrames : (int)imageList.size();
-        }
-        else
-          inputType = VIDEO_FILE;
+        // A camera, a recording or the synthetic checkerboard, see FrameSource
+        string spec = input;
+        if (device && string::npos == input.find(':'))
+          spec += ":1280x720";
+        inputCapture = FrameSource::create(spec, "FRAME_SOURCE");
+        inputType = inputCapture && inputCapture->isLive() ? CAMERA : VIDEO_FILE;
+        if (!inputCapture)
+          inputType = INVALID;
       }
-      if (inputType == CAMERA) {
-        inputCapture.open(cameraID);
-        inputCapture.set(CV_CAP_PROP_FRAME_WIDTH, 1280);
-        inputCapture.set(CV_CAP_PROP_FRAME_HEIGHT, 720);
-      }
-      if (inputType == VIDEO_FILE)
-        inputCapture.open(input);
-      if (inputType != IMAGE_LIST && !inputCapture.isOpened())
-        inputType = INVALID;
     }
     if (inputType == INVALID)
     {
@@ -146,11 +141,11 @@ public:
   Mat nextImage()
   {
     Mat result;
-    if (inputCapture.isOpened())
+    if (inputCapture)
     {
-      Mat view0;
-      inputCapture >> view0;
-      view0.copyTo(result);
+      CapturedFrame frame;
+      if (inputCapture->read(frame))
+        frame.image.copyTo(result);
     }
     else if (atImageList < (int)imageList.size())
       result = imread(imageList[atImageList++], CV_LOAD_IMAGE_COLOR);
@@ -190,10 +185,9 @@ public:
 
 
 
-  int cameraID{ 1 };
   vector<string> imageList;
   int atImageList;
-  VideoCapture inputCapture;
+  FrameSourcePtr inputCapture;
   InputType inputType{ CAMERA };
   bool goodInput;
   int flag;
@@ -212,10 +206,41 @@ static void read(const FileNode& node, Settings& x, const Settings& default_valu
     x.read(node);
 }
 
-enum { DETECTION = 0, CAPTURING = 1, CALIBRATED = 2 };
+// The remap table goes next to the camera parameters, camera.xml giving
+// camera_remap.bin
+static string remapFileName(const string & outputFileName)
+{
+  size_t dot = outputFileName.rfind('.');
+  return outputFileName.substr(0, dot) + "_remap.bin";
+}
+
+static void report(const CalibrationEngine & engine)
+{
+  CalibrationEngine::Stats stats = engine.getStats();
+  CalibrationEngine::Calibration calibration = engine.getCalibration();
+  SAY("%d frames, %d dropped, board found in %d: %d views accepted, %d rejected as redundant",
+    (int)stats.submitted, (int)stats.dropped, (int)stats.found, (int)stats.accepted, (int)stats.rejected);
+  SAY("Detection avg %0.2f ms, refinement avg %0.2f ms, %d solves avg %0.1f ms, max %0.1f ms",
+    stats.detect.getAverage(), stats.refine.getAverage(), (int)stats.solve.getCount(),
+    stats.solve.getAverage(), stats.solve.getMax());
+  SAY("Coverage %0.0f%%", engine.getCoverage() * 100.0f);
+  if (calibration.valid)
+    SAY("Re-projection error %0.3f px from %d views", calibration.rmsError, calibration.views);
+}
 
-bool runCalibrationAndSave(Settings& s, Size imageSize, Mat&  cameraMatrix, Mat& distCoeffs,
-  vector<vector<Point2f> > imagePoints);
+static bool saveCalibration(const Settings & s, const CalibrationEngine & engine, const CalibrationEngine::Settings & engineSettings)
+{
+  CalibrationEngine::Calibration calibration = engine.getCalibration();
+  string remapFile = remapFileName(s.outputFileName);
+  if (!CalibrationEngine::save(calibration, engineSettings, s.outputFileName) ||
+    !CalibrationEngine::exportRemap(calibration, remapFile))
+  {
+    cout << "Calibration failed" << endl;
+    return false;
+  }
+  cout << "Calibration saved to " << s.outputFileName << " and " << remapFile << endl;
+  return true;
+}
 
 MAIN_DECL
 {
@@ -237,328 +262,149 @@ MAIN_DECL
     cout << "Invalid input detected. Application stopping. " << endl;
     return -1;
   }
+  if (s.calibrationPattern != Settings::CHESSBOARD)
+  {
+    cout << "Only chessboard patterns are supported" << endl;
+    return -1;
+  }
+
+  // Detection and solving happen on the engine's threads, so the preview
+  // keeps running at the camera's frame rate however long they take
+  CalibrationEngine::Settings engineSettings;
+  engineSettings.boardSize = s.boardSize;
+  engineSettings.squareSize = s.squareSize;
+  engineSettings.minViews = s.nrFrames;
+  engineSettings.flags = s.flag | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5;
+  CalibrationEngine engine(engineSettings);
 
-  vector<vector<Point2f> > imagePoints;
-  Mat cameraMatrix, distCoeffs;
-  Size imageSize;
-  int mode = s.inputType == Settings::IMAGE_LIST ? CAPTURING : DETECTION;
-  clock_t prevTimestamp = 0;
   const Scalar RED(0, 0, 255), GREEN(0, 255, 0);
   const char ESC_KEY = 27;
 
-  for (int i = 0;; ++i)
+  // A recorded set is processed as fast as the workers can go, and only
+  // shown once it's been calibrated
+  if (s.inputType == Settings::IMAGE_LIST)
   {
-    Mat view;
-    bool blinkOutput = false;
-
-    view = s.nextImage();
-
-    //-----  If no more image, or got enough, then stop calibration and show result -------------
-    if (mode == CAPTURING && imagePoints.size() >= (unsigned)s.nrFrames)
+    for (int i = 0;; ++i)
     {
-      if (runCalibrationAndSave(s, imageSize, cameraMatrix, distCoeffs, imagePoints))
-        mode = CALIBRATED;
-      else
-        mode = DETECTION;
+      Mat view = s.nextImage();
+      if (view.empty())
+        break;
+      if (s.flipVertical)
+        flip(view, view, 0);
+      engine.submit(view, i, true);
     }
-    if (view.empty())          // If no more images then run calibration, save and stop loop.
+    engine.waitForIdle();
+    report(engine);
+    if (!saveCalibration(s, engine, engineSettings) || !s.showUndistorsed)
+      return 0;
+
+    Mat map, newCameraMatrix, view, rview;
+    CalibrationEngine::loadRemap(remapFileName(s.outputFileName), map, newCameraMatrix);
+    for (int i = 0; i < (int)s.imageList.size(); i++)
     {
-      if (imagePoints.size() > 0)
-        runCalibrationAndSave(s, imageSize, cameraMatrix, distCoeffs, imagePoints);
-      break;
+      view = imread(s.imageList[i], 1);
+      if (view.empty())
+        continue;
+      if (s.flipVertical)
+        flip(view, view, 0);
+      remap(view, rview, map, Mat(), INTER_LINEAR);
+      imshow("Image View", rview);
+      char c = (char)waitKey();
+      if (c == ESC_KEY || c == 'q' || c == 'Q')
+        break;
     }
+    return 0;
+  }
 
+  // Live, views are only collected after pressing 'g'
+  bool capturing = false;
+  engine.setAccepting(false);
+  uint64_t mapGeneration = 0, lastDetection = 0;
+  Mat map1, map2;
 
-    imageSize = view.size();  // Format input image.
-    if (s.flipVertical)    flip(view, view, 0);
-
-    vector<Point2f> pointBuf;
-
-    bool found;
-    switch (s.calibrationPattern) // Find feature points on the input format
-    {
-    case Settings::CHESSBOARD:
-      found = findChessboardCorners(view, s.boardSize, pointBuf,
-        CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE);
-      break;
-    case Settings::CIRCLES_GRID:
-      found = findCirclesGrid(view, s.boardSize, pointBuf);
-      break;
-    case Settings::ASYMMETRIC_CIRCLES_GRID:
-      found = findCirclesGrid(view, s.boardSize, pointBuf, CALIB_CB_ASYMMETRIC_GRID);
-      break;
-    default:
-      found = false;
+  for (int i = 0;; ++i)
+  {
+    Mat view = s.nextImage();
+    if (view.empty())
       break;
+    if (s.flipVertical)
+      flip(view, view, 0);
+    double timestamp = s.inputCapture->now();
+    engine.submit(view, timestamp);
+
+    // The latest result is usually for a slightly older frame, which is
+    // close enough to draw over this one
+    CalibrationEngine::Detection detection;
+    bool blinkOutput = false;
+    if (engine.getDetection(detection) && detection.found)
+    {
+      drawChessboardCorners(view, s.boardSize, Mat(detection.view.corners), true);
+      blinkOutput = detection.accepted && detection.index != lastDetection;
+      lastDetection = detection.index;
     }
+    if (capturing)
+      engine.drawCoverage(view);
 
-    if (found)                // If done with success,
+    CalibrationEngine::Calibration calibration = engine.getCalibration();
+    if (calibration.valid && calibration.generation != mapGeneration)
     {
-      // improve the found corners' coordinate accuracy for chessboard
-      if (s.calibrationPattern == Settings::CHESSBOARD)
-      {
-        Mat viewGray;
-        cvtColor(view, viewGray, COLOR_BGR2GRAY);
-        cornerSubPix(viewGray, pointBuf, Size(11, 11),
-          Size(-1, -1), TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
-      }
-
-      if (mode == CAPTURING &&  // For camera only take new samples after delay time
-        (!s.inputCapture.isOpened() || clock() - prevTimestamp > s.delay*1e-3*CLOCKS_PER_SEC))
-      {
-        imagePoints.push_back(pointBuf);
-        prevTimestamp = clock();
-        blinkOutput = s.inputCapture.isOpened();
-      }
-
-      // Draw the corners.
-      drawChessboardCorners(view, s.boardSize, Mat(pointBuf), found);
+      initUndistortRectifyMap(calibration.cameraMatrix, calibration.distCoeffs, Mat(),
+        getOptimalNewCameraMatrix(calibration.cameraMatrix, calibration.distCoeffs, calibration.imageSize, 1, calibration.imageSize, 0),
+        calibration.imageSize, CV_16SC2, map1, map2);
+      mapGeneration = calibration.generation;
     }
 
     //----------------------------- Output Text ------------------------------------------------
-    string msg = (mode == CAPTURING) ? "100/100" :
-      mode == CALIBRATED ? "Calibrated" : "Press 'g' to start";
-    int baseLine = 0;
-    Size textSize = getTextSize(msg, 1, 1, 1, &baseLine);
-    Point textOrigin(view.cols - 2 * textSize.width - 10, view.rows - 2 * baseLine - 10);
-
-    if (mode == CAPTURING)
+    string msg = "Press 'g' to start";
+    if (capturing)
     {
-      if (s.showUndistorsed)
-        msg = format("%d/%d Undist", (int)imagePoints.size(), s.nrFrames);
-      else
-        msg = format("%d/%d", (int)imagePoints.size(), s.nrFrames);
+      msg = format("%d views, %d%% coverage", (int)engine.getViews().size(), (int)(engine.getCoverage() * 100.0f));
+      if (calibration.valid)
+        msg += format(", error %0.2f px%s", calibration.rmsError, s.showUndistorsed ? " Undist" : "");
     }
-
-    putText(view, msg, textOrigin, 1, 1, mode == CALIBRATED ? GREEN : RED);
+    int baseLine = 0;
+    Size textSize = getTextSize(msg, 1, 1, 1, &baseLine);
+    Point textOrigin(view.cols - textSize.width - 10, view.rows - 2 * baseLine - 10);
+    putText(view, msg, textOrigin, 1, 1, calibration.valid ? GREEN : RED);
 
     if (blinkOutput)
       bitwise_not(view, view);
 
     //------------------------- Video capture  output  undistorted ------------------------------
-    if (mode == CALIBRATED && s.showUndistorsed)
+    if (calibration.valid && s.showUndistorsed)
     {
       Mat temp = view.clone();
-      undistort(temp, view, cameraMatrix, distCoeffs);
+      remap(temp, view, map1, map2, INTER_LINEAR);
     }
 
     //------------------------------ Show image and check for input commands -------------------
     imshow("Image View", view);
-    char key = (char)waitKey(s.inputCapture.isOpened() ? 50 : s.delay);
+    char key = (char)waitKey(1);
 
     if (key == ESC_KEY)
       break;
 
-    if (key == 'u' && mode == CALIBRATED)
+    if (key == 'u')
       s.showUndistorsed = !s.showUndistorsed;
 
-    if (s.inputCapture.isOpened() && key == 'g')
+    if (key == 'g')
     {
-      mode = CAPTURING;
-      imagePoints.clear();
+      engine.reset();
+      engine.setAccepting(true);
+      capturing = true;
     }
-  }
-
-  // -----------------------Show the undistorted image for the image list ------------------------
-  if (s.inputType == Settings::IMAGE_LIST && s.showUndistorsed)
-  {
-    Mat view, rview, map1, map2;
-    initUndistortRectifyMap(cameraMatrix, distCoeffs, Mat(),
-      getOptimalNewCameraMatrix(cameraMatrix, distCoeffs, imageSize, 1, imageSize, 0),
-      imageSize, CV_16SC2, map1, map2);
 
-    for (int i = 0; i < (int)s.imageList.size(); i++)
-    {
-      view = imread(s.imageList[i], 1);
-      if (view.empty())
-        continue;
-      remap(view, rview, map1, map2, INTER_LINEAR);
-      imshow("Image View", rview);
-      char c = (char)waitKey();
-      if (c == ESC_KEY || c == 'q' || c == 'Q')
-        break;
-    }
+    if (key == 's' && calibration.valid)
+      saveCalibration(s, engine, engineSettings);
   }
 
-
+  engine.setAccepting(false);
+  engine.waitForIdle();
+  report(engine);
+  if (engine.getCalibration().valid)
+    saveCalibration(s, engine, engineSettings);
   return 0;
 }
-
-static double computeReprojectionErrors(const vector<vector<Point3f> >& objectPoints,
-  const vector<vector<Point2f> >& imagePoints,
-  const vector<Mat>& rvecs, const vector<Mat>& tvecs,
-  const Mat& cameraMatrix, const Mat& distCoeffs,
-  vector<float>& perViewErrors)
-{
-  vector<Point2f> imagePoints2;
-  int i, totalPoints = 0;
-  double totalErr = 0, err;
-  perViewErrors.resize(objectPoints.size());
-
-  for (i = 0; i < (int)objectPoints.size(); ++i)
-  {
-    projectPoints(Mat(objectPoints[i]), rvecs[i], tvecs[i], cameraMatrix,
-      distCoeffs, imagePoints2);
-    err = norm(Mat(imagePoints[i]), Mat(imagePoints2), CV_L2);
-
-    int n = (int)objectPoints[i].size();
-    perViewErrors[i] = (float)std::sqrt(err*err / n);
-    totalErr += err*err;
-    totalPoints += n;
-  }
-
-  return std::sqrt(totalErr / totalPoints);
-}
-
-static void calcBoardCornerPositions(Size boardSize, float squareSize, vector<Point3f>& corners,
-  Settings::Pattern patternType /*= Settings::CHESSBOARD*/)
-{
-  corners.clear();
-
-  switch (patternType)
-  {
-  case Settings::CHESSBOARD:
-  case Settings::CIRCLES_GRID:
-    for (int i = 0; i < boardSize.height; ++i)
-      for (int j = 0; j < boardSize.width; ++j)
-        corners.push_back(Point3f(float(j*squareSize), float(i*squareSize), 0));
-    break;
-
-  case Settings::ASYMMETRIC_CIRCLES_GRID:
-    for (int i = 0; i < boardSize.height; i++)
-      for (int j = 0; j < boardSize.width; j++)
-        corners.push_back(Point3f(float((2 * j + i % 2)*squareSize), float(i*squareSize), 0));
-    break;
-  default:
-    break;
-  }
-}
-
-static bool runCalibration(Settings& s, Size& imageSize, Mat& cameraMatrix, Mat& distCoeffs,
-  vector<vector<Point2f> > imagePoints, vector<Mat>& rvecs, vector<Mat>& tvecs,
-  vector<float>& reprojErrs, double& totalAvgErr)
-{
-
-  cameraMatrix = Mat::eye(3, 3, CV_64F);
-  if (s.flag & CV_CALIB_FIX_ASPECT_RATIO)
-    cameraMatrix.at<double>(0, 0) = 1.0;
-
-  distCoeffs = Mat::zeros(8, 1, CV_64F);
-
-  vector<vector<Point3f> > objectPoints(1);
-  calcBoardCornerPositions(s.boardSize, s.squareSize, objectPoints[0], s.calibrationPattern);
-
-  objectPoints.resize(imagePoints.size(), objectPoints[0]);
-
-  //Find intrinsic and extrinsic camera parameters
-  double rms = calibrateCamera(objectPoints, imagePoints, imageSize, cameraMatrix,
-    distCoeffs, rvecs, tvecs, s.flag | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5);
-
-  cout << "Re-projection error reported by calibrateCamera: " << rms << endl;
-
-  bool ok = checkRange(cameraMatrix) && checkRange(distCoeffs);
-
-  totalAvgErr = computeReprojectionErrors(objectPoints, imagePoints,
-    rvecs, tvecs, cameraMatrix, distCoeffs, reprojErrs);
-
-  return ok;
-}
-
-// Print camera parameters to the output file
-static void saveCameraParams(Settings& s, Size& imageSize, Mat& cameraMatrix, Mat& distCoeffs,
-  const vector<Mat>& rvecs, const vector<Mat>& tvecs,
-  const vector<float>& reprojErrs, const vector<vector<Point2f> >& imagePoints,
-  double totalAvgErr)
-{
-  FileStorage fs(s.outputFileName, FileStorage::WRITE);
-
-  time_t tm;
-  time(&tm);
-  struct tm *t2 = localtime(&tm);
-  char buf[1024];
-  strftime(buf, sizeof(buf) - 1, "%c", t2);
-
-  fs << "calibration_Time" << buf;
-
-  if (!rvecs.empty() || !reprojErrs.empty())
-    fs << "nrOfFrames" << (int)std::max(rvecs.size(), reprojErrs.size());
-  fs << "image_Width" << imageSize.width;
-  fs << "image_Height" << imageSize.height;
-  fs << "board_Width" << s.boardSize.width;
-  fs << "board_Height" << s.boardSize.height;
-  fs << "square_Size" << s.squareSize;
-
-  if (s.flag & CV_CALIB_FIX_ASPECT_RATIO)
-    fs << "FixAspectRatio" << s.aspectRatio;
-
-  if (s.flag)
-  {
-    sprintf(buf, "flags: %s%s%s%s",
-      s.flag & CV_CALIB_USE_INTRINSIC_GUESS ? " +use_intrinsic_guess" : "",
-      s.flag & CV_CALIB_FIX_ASPECT_RATIO ? " +fix_aspectRatio" : "",
-      s.flag & CV_CALIB_FIX_PRINCIPAL_POINT ? " +fix_principal_point" : "",
-      s.flag & CV_CALIB_ZERO_TANGENT_DIST ? " +zero_tangent_dist" : "");
-    cvWriteComment(*fs, buf, 0);
-
-  }
-
-  fs << "flagValue" << s.flag;
-
-  fs << "Camera_Matrix" << cameraMatrix;
-  fs << "Distortion_Coefficients" << distCoeffs;
-
-  fs << "Avg_Reprojection_Error" << totalAvgErr;
-  if (!reprojErrs.empty())
-    fs << "Per_View_Reprojection_Errors" << Mat(reprojErrs);
-
-  if (!rvecs.empty() && !tvecs.empty())
-  {
-    CV_Assert(rvecs[0].type() == tvecs[0].type());
-    Mat bigmat((int)rvecs.size(), 6, rvecs[0].type());
-    for (int i = 0; i < (int)rvecs.size(); i++)
-    {
-      Mat r = bigmat(Range(i, i + 1), Range(0, 3));
-      Mat t = bigmat(Range(i, i + 1), Range(3, 6));
-
-      CV_Assert(rvecs[i].rows == 3 && rvecs[i].cols == 1);
-      CV_Assert(tvecs[i].rows == 3 && tvecs[i].cols == 1);
-      //*.t() is MatExpr (not Mat) so we can use assignment operator
-      r = rvecs[i].t();
-      t = tvecs[i].t();
-    }
-    cvWriteComment(*fs, "a set of 6-tuples (rotation vector + translation vector) for each view", 0);
-    fs << "Extrinsic_Parameters" << bigmat;
-  }
-
-  if (!imagePoints.empty())
-  {
-    Mat imagePtMat((int)imagePoints.size(), (int)imagePoints[0].size(), CV_32FC2);
-    for (int i = 0; i < (int)imagePoints.size(); i++)
-    {
-      Mat r = imagePtMat.row(i).reshape(2, imagePtMat.cols);
-      Mat imgpti(imagePoints[i]);
-      imgpti.copyTo(r);
-    }
-    fs << "Image_points" << imagePtMat;
-  }
-}
-
-bool runCalibrationAndSave(Settings& s, Size imageSize, Mat&  cameraMatrix, Mat& distCoeffs, vector<vector<Point2f> > imagePoints)
-{
-  vector<Mat> rvecs, tvecs;
-  vector<float> reprojErrs;
-  double totalAvgErr = 0;
-
-  bool ok = runCalibration(s, imageSize, cameraMatrix, distCoeffs, imagePoints, rvecs, tvecs,
-    reprojErrs, totalAvgErr);
-  cout << (ok ? "Calibration succeeded" : "Calibration failed")
-    << ". avg re projection error = " << totalAvgErr;
-
-  if (ok)
-    saveCameraParams(s, imageSize, cameraMatrix, distCoeffs, rvecs, tvecs, reprojErrs,
-    imagePoints, totalAvgErr);
-  return ok;
-}
 #else
 MAIN_DECL {
   return 0;
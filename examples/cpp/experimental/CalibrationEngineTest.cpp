@@ -0,0 +1,291 @@
+#include "Common.h"
+#include "FrameSource.h"
+#include "CalibrationEngine.h"
+
+#ifdef HAVE_OPENCV
+#include <opencv2/opencv.hpp>
+
+// Compares the CalibrationEngine with the serial approach CalibrateCamera
+// used to take: searching every frame for the board at full resolution and
+// solving once with every view found.
+//
+// By default the views are rendered through a known camera with barrel
+// distortion, from random board poses, so the errors in the solved
+// parameters can be reported.  Pass a FrameSource spec, such as a list of
+// images or a printf style pattern, to run on a recorded set instead, in
+// which case only the timings and the re-projection errors are meaningful.
+//
+// The images are loaded up front, so only detection and solving are timed.
+
+static const int VIEW_COUNT = 60;
+static const cv::Size IMAGE_SIZE(1280, 720);
+static const cv::Size BOARD_SIZE(9, 6);
+static const float SQUARE_SIZE = 0.024f;
+// Pixels per square in the board texture
+static const int TEXTURE_SQUARE = 48;
+
+struct Camera {
+  cv::Mat matrix;
+  cv::Mat distCoeffs;
+};
+
+static Camera trueCamera() {
+  Camera result;
+  result.matrix = (cv::Mat_<double>(3, 3) <<
+    900, 0, 652,
+    0, 900, 352,
+    0, 0, 1);
+  result.distCoeffs = (cv::Mat_<double>(5, 1) << -0.28, 0.09, 0, 0, 0);
+  return result;
+}
+
+// The board with a one square white border.  Pixel centers are at integer
+// coordinates, so the first inner corner is at 2 squares - 0.5.
+static cv::Mat boardTexture() {
+  cv::Size squares(BOARD_SIZE.width + 3, BOARD_SIZE.height + 3);
+  cv::Mat result(squares * TEXTURE_SQUARE, CV_8U, cv::Scalar(255));
+  for (int y = 1; y < squares.height - 1; ++y) {
+    for (int x = 1; x < squares.width - 1; ++x) {
+      if ((x + y) % 2) {
+        result(cv::Rect(x * TEXTURE_SQUARE, y * TEXTURE_SQUARE, TEXTURE_SQUARE, TEXTURE_SQUARE)).setTo(0);
+      }
+    }
+  }
+  return result;
+}
+
+// Renders the board at a random pose where all its corners are in view.
+// For every pixel the ray through it is found by undistorting, and
+// intersected with the board plane to find the texel to sample.
+class Renderer {
+  Camera camera;
+  cv::Mat texture;
+  // The undistorted normalized image coordinates of each pixel
+  cv::Mat rays;
+  std::vector<cv::Point3f> boardPoints;
+  cv::RNG rng{ 3 };
+
+public:
+  Renderer() : camera(trueCamera()), texture(boardTexture()) {
+    std::vector<cv::Point2f> pixels;
+    for (int y = 0; y < IMAGE_SIZE.height; ++y) {
+      for (int x = 0; x < IMAGE_SIZE.width; ++x) {
+        pixels.push_back(cv::Point2f((float)x, (float)y));
+      }
+    }
+    std::vector<cv::Point2f> normalized;
+    cv::undistortPoints(pixels, normalized, camera.matrix, camera.distCoeffs);
+    rays = cv::Mat(normalized, true).reshape(2, IMAGE_SIZE.height);
+    for (int i = 0; i < BOARD_SIZE.height; ++i) {
+      for (int j = 0; j < BOARD_SIZE.width; ++j) {
+        boardPoints.push_back(cv::Point3f(j * SQUARE_SIZE, i * SQUARE_SIZE, 0));
+      }
+    }
+  }
+
+  const Camera & getCamera() const {
+    return camera;
+  }
+
+  cv::Mat render() {
+    cv::Mat rvec, tvec;
+    std::vector<cv::Point2f> corners;
+    cv::Rect inside(20, 20, IMAGE_SIZE.width - 40, IMAGE_SIZE.height - 40);
+    while (true) {
+      // Tilted up to about 35 degrees either way, and rolled a little
+      rvec = (cv::Mat_<double>(3, 1) << rng.uniform(-0.6, 0.6), rng.uniform(-0.6, 0.6), rng.uniform(-0.4, 0.4));
+      double distance = rng.uniform(0.3, 0.7);
+      cv::Point3d center(SQUARE_SIZE * (BOARD_SIZE.width - 1) / 2.0, SQUARE_SIZE * (BOARD_SIZE.height - 1) / 2.0, 0);
+      cv::Mat rotation;
+      cv::Rodrigues(rvec, rotation);
+      // Put the center of the board somewhere in the view
+      cv::Mat target = (cv::Mat_<double>(3, 1) <<
+        rng.uniform(-0.35, 0.35) * distance, rng.uniform(-0.2, 0.2) * distance, distance);
+      tvec = target - rotation * cv::Mat(center);
+      cv::projectPoints(boardPoints, rvec, tvec, camera.matrix, camera.distCoeffs, corners);
+      bool visible = true;
+      for (const cv::Point2f & corner : corners) {
+        visible = visible && inside.contains(corner);
+      }
+      if (visible) {
+        break;
+      }
+    }
+
+    // Maps normalized image coordinates to board coordinates
+    cv::Mat rotation;
+    cv::Rodrigues(rvec, rotation);
+    cv::Mat plane(3, 3, CV_64F);
+    rotation.col(0).copyTo(plane.col(0));
+    rotation.col(1).copyTo(plane.col(1));
+    tvec.copyTo(plane.col(2));
+    double scale = TEXTURE_SQUARE / SQUARE_SIZE;
+    double origin = 2.0 * TEXTURE_SQUARE - 0.5;
+    cv::Mat toTexture = (cv::Mat_<double>(3, 3) <<
+      scale, 0, origin,
+      0, scale, origin,
+      0, 0, 1);
+    cv::Mat map;
+    cv::perspectiveTransform(rays, map, toTexture * plane.inv());
+
+    cv::Mat result;
+    cv::remap(texture, result, map, cv::Mat(), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(128));
+    cv::GaussianBlur(result, result, cv::Size(3, 3), 0.7);
+    cv::Mat noisy, noise(result.size(), CV_16S);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 3);
+    result.convertTo(noisy, CV_16S);
+    noisy += noise;
+    noisy.convertTo(result, CV_8U);
+    return result;
+  }
+};
+
+static void reportCamera(const char * name, const cv::Mat & matrix, const cv::Mat & distCoeffs, double rmsError) {
+  SAY("%-8s f %7.2f, %7.2f c %7.2f, %7.2f k1 %7.4f k2 %7.4f, re-projection error %0.3f px", name,
+    matrix.at<double>(0, 0), matrix.at<double>(1, 1), matrix.at<double>(0, 2), matrix.at<double>(1, 2),
+    distCoeffs.at<double>(0), distCoeffs.at<double>(1), rmsError);
+}
+
+// The difference between the undistortion tables of two cameras, which is
+// what actually matters to the user of a calibration
+static double mapError(const Camera & truth, const cv::Mat & matrix, const cv::Mat & distCoeffs) {
+  cv::Mat trueMap, map, unused;
+  cv::initUndistortRectifyMap(truth.matrix, truth.distCoeffs, cv::Mat(), truth.matrix, IMAGE_SIZE, CV_32FC2, trueMap, unused);
+  cv::initUndistortRectifyMap(matrix, distCoeffs, cv::Mat(), truth.matrix, IMAGE_SIZE, CV_32FC2, map, unused);
+  double result = 0;
+  for (int y = 0; y < IMAGE_SIZE.height; ++y) {
+    for (int x = 0; x < IMAGE_SIZE.width; ++x) {
+      result = std::max(result, cv::norm(trueMap.at<cv::Vec2f>(y, x) - map.at<cv::Vec2f>(y, x)));
+    }
+  }
+  return result;
+}
+
+MAIN_DECL {
+  std::vector<cv::Mat> images;
+#ifndef OS_WIN
+  if (argc > 1) {
+    FrameSourcePtr source = FrameSource::create(argv[1]);
+    if (!source) {
+      SAY_ERR("Unable to open %s", argv[1]);
+      return -1;
+    }
+    CapturedFrame frame;
+    while (source->read(frame)) {
+      images.push_back(frame.image.clone());
+    }
+  }
+#endif
+  std::unique_ptr<Renderer> renderer;
+  if (images.empty()) {
+    renderer = std::unique_ptr<Renderer>(new Renderer());
+    for (int i = 0; i < VIEW_COUNT; ++i) {
+      images.push_back(renderer->render());
+    }
+  }
+  cv::Size imageSize = images[0].size();
+  SAY("%d images of %dx%d", (int)images.size(), imageSize.width, imageSize.height);
+
+  // The serial baseline
+  CalibrationEngine::Settings settings;
+  settings.boardSize = BOARD_SIZE;
+  settings.squareSize = SQUARE_SIZE;
+  std::vector<std::vector<cv::Point2f> > imagePoints;
+  TimingStats detect;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (const cv::Mat & image : images) {
+    cv::Mat gray = image;
+    if (image.channels() == 3) {
+      cv::cvtColor(image, gray, CV_BGR2GRAY);
+    }
+    std::vector<cv::Point2f> corners;
+    bool found = false;
+    detect.time([&] {
+      found = cv::findChessboardCorners(gray, BOARD_SIZE, corners,
+        CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FAST_CHECK | CV_CALIB_CB_NORMALIZE_IMAGE);
+      if (found) {
+        cv::cornerSubPix(gray, corners, cv::Size(11, 11), cv::Size(-1, -1),
+          cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
+      }
+    });
+    if (found) {
+      imagePoints.push_back(corners);
+    }
+  }
+  std::vector<cv::Point3f> board;
+  for (int i = 0; i < BOARD_SIZE.height; ++i) {
+    for (int j = 0; j < BOARD_SIZE.width; ++j) {
+      board.push_back(cv::Point3f(j * SQUARE_SIZE, i * SQUARE_SIZE, 0));
+    }
+  }
+  std::vector<std::vector<cv::Point3f> > objectPoints(imagePoints.size(), board);
+  cv::Mat matrix = cv::Mat::eye(3, 3, CV_64F), distCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+  std::vector<cv::Mat> rvecs, tvecs;
+  TimingStats solve;
+  double rmsError = 0;
+  if (!imagePoints.empty()) {
+    solve.time([&] {
+      rmsError = cv::calibrateCamera(objectPoints, imagePoints, imageSize, matrix, distCoeffs,
+        rvecs, tvecs, settings.flags);
+    });
+  }
+  double serialMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  SAY("Serial:  %7.1f ms total, detection avg %6.2f ms, max %6.2f ms, one solve of %d views %6.1f ms",
+    serialMillis, detect.getAverage(), detect.getMax(), (int)imagePoints.size(), solve.getAverage());
+
+  // The engine, with the frames queued as fast as it takes them
+  CalibrationEngine::Calibration calibration;
+  CalibrationEngine::Stats stats;
+  {
+    CalibrationEngine engine(settings);
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < images.size(); ++i) {
+      engine.submit(images[i], (double)i, true);
+    }
+    engine.waitForIdle();
+    double engineMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    calibration = engine.getCalibration();
+    stats = engine.getStats();
+    SAY("Engine:  %7.1f ms total with %d workers, detection avg %6.2f ms, refinement avg %6.2f ms",
+      engineMillis, settings.workers, stats.detect.getAverage(), stats.refine.getAverage());
+    SAY("         %d boards found, %d views accepted, %d rejected, %d solves avg %6.1f ms, max %6.1f ms, %0.0f%% coverage",
+      (int)stats.found, (int)stats.accepted, (int)stats.rejected, (int)stats.solve.getCount(),
+      stats.solve.getAverage(), stats.solve.getMax(), engine.getCoverage() * 100.0f);
+  }
+  if (!calibration.valid) {
+    SAY_ERR("The engine failed to calibrate");
+    return -1;
+  }
+
+  if (renderer) {
+    const Camera & truth = renderer->getCamera();
+    reportCamera("Truth", truth.matrix, truth.distCoeffs, 0);
+    reportCamera("Serial", matrix, distCoeffs, rmsError);
+    reportCamera("Engine", calibration.cameraMatrix, calibration.distCoeffs, calibration.rmsError);
+    SAY("Max undistortion error: serial %0.3f px, engine %0.3f px",
+      mapError(truth, matrix, distCoeffs), mapError(truth, calibration.cameraMatrix, calibration.distCoeffs));
+  } else {
+    reportCamera("Serial", matrix, distCoeffs, rmsError);
+    reportCamera("Engine", calibration.cameraMatrix, calibration.distCoeffs, calibration.rmsError);
+  }
+
+  // The exported table should match one built directly
+  const std::string remapFile = "calibration_test_remap.bin";
+  cv::Mat map, newMatrix, expected, unused;
+  if (!CalibrationEngine::exportRemap(calibration, remapFile) ||
+    !CalibrationEngine::loadRemap(remapFile, map, newMatrix)) {
+    SAY_ERR("Unable to round trip the remap table");
+    return -1;
+  }
+  cv::initUndistortRectifyMap(calibration.cameraMatrix, calibration.distCoeffs, cv::Mat(),
+    newMatrix, calibration.imageSize, CV_32FC2, expected, unused);
+  SAY("Remap table round trip max difference %g px", cv::norm(map, expected, cv::NORM_INF));
+  remove(remapFile.c_str());
+  return 0;
+}
+
+#else
+MAIN_DECL {
+  return 0;
+}
+#endif
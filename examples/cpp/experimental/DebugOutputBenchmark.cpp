@@ -0,0 +1,155 @@
+#include "Common.h"
+
+// Compares frame times with the GL debug output off, handled the way the
+// examples used to (synchronous output, every message formatted and
+// printed from the callback), and through DebugOutput in synchronous and
+// asynchronous mode.
+//
+// Each frame draws a few hundred cubes and inserts the same application
+// message a number of times, standing in for a driver performance warning
+// that fires every frame.  The frame is finished with glFinish, so any
+// serialization the debug output forces on the driver is counted.  The old
+// handler's output goes to a string rather than the console, which makes
+// it look cheaper than it was.
+
+static const int FRAMES_PER_MODE = 600;
+static const int CUBES_PER_FRAME = 400;
+static const int MESSAGES_PER_FRAME = 20;
+static const GLuint MESSAGE_ID = 42;
+
+static std::ostringstream legacyOutput;
+
+// What oria::debugCallback used to do with each message
+static void GL_CALLBACK legacyCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei length, const GLchar * message, void * userParam) {
+  legacyOutput << "--- OpenGL Callback Message ---" << std::endl;
+  legacyOutput << Platform::format("type: %s\nseverity: %-8s\nid: %d\nmsg: %s",
+    DebugOutput::typeName(type), DebugOutput::severityName(severity), id, message) << std::endl;
+  legacyOutput << "--- OpenGL Callback Message ---" << std::endl;
+}
+
+class DebugOutputBenchmark : public GlfwApp {
+  enum Mode {
+    OFF,
+    LEGACY,
+    MANAGER_SYNCHRONOUS,
+    MANAGER_ASYNCHRONOUS,
+    MODE_COUNT
+  };
+
+  static const char * modeName(int mode) {
+    switch (mode) {
+    case OFF:
+      return "Off";
+    case LEGACY:
+      return "Synchronous, printed";
+    case MANAGER_SYNCHRONOUS:
+      return "DebugOutput sync";
+    case MANAGER_ASYNCHRONOUS:
+      return "DebugOutput async";
+    }
+    return "";
+  }
+
+  int mode{ OFF };
+  int frames{ 0 };
+  TimingStats frameStats[MODE_COUNT];
+  std::unique_ptr<DebugOutput> output;
+
+public:
+  virtual void preCreate() {
+    GlfwApp::preCreate();
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+  }
+
+  virtual GLFWwindow * createRenderingTarget(glm::uvec2 & outSize, glm::ivec2 & outPosition) {
+    outSize = glm::uvec2(800, 600);
+    outPosition = glm::ivec2(100, 100);
+    return glfw::createWindow(outSize, outPosition);
+  }
+
+  virtual void initGl() {
+    GlfwApp::initGl();
+    glfwSwapInterval(0);
+    if (!glDebugMessageCallback) {
+      FAIL("This benchmark needs KHR_debug");
+    }
+    startMode();
+  }
+
+  void startMode() {
+    frames = 0;
+    glDebugMessageCallback(nullptr, nullptr);
+    output.reset();
+    switch (mode) {
+    case OFF:
+      glDisable(GL_DEBUG_OUTPUT);
+      break;
+
+    case LEGACY:
+      glEnable(GL_DEBUG_OUTPUT);
+      glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+      glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+      glDebugMessageCallback(legacyCallback, nullptr);
+      break;
+
+    default: {
+        DebugOutput::Settings settings;
+        settings.synchronous = MANAGER_SYNCHRONOUS == mode;
+        output = std::unique_ptr<DebugOutput>(new DebugOutput());
+        output->install(settings);
+      }
+      break;
+    }
+  }
+
+  void report() {
+    SAY("Frame time with %d cubes and %d repeated debug messages per frame, over %d frames:",
+      CUBES_PER_FRAME, MESSAGES_PER_FRAME, FRAMES_PER_MODE);
+    for (int i = 0; i < MODE_COUNT; ++i) {
+      SAY("  %-22s %s", modeName(i), frameStats[i].toString().c_str());
+    }
+    SAY("The old handler wrote %0.1f MB of output", legacyOutput.str().size() / (1024.0 * 1024.0));
+  }
+
+  virtual void draw() {
+    frameStats[mode].time([&] {
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      oria::viewport(getSize());
+      MatrixStack & mv = Stacks::modelview();
+      MatrixStack & pr = Stacks::projection();
+      pr.top() = glm::perspective(PI / 3.0f, windowAspect, 0.1f, 100.0f);
+      for (int i = 0; i < CUBES_PER_FRAME; ++i) {
+        mv.withPush([&] {
+          mv.identity();
+          mv.translate(glm::vec3((i % 20) - 10.0f, (i / 20) - 10.0f, -25.0f));
+          mv.scale(glm::vec3(0.4f));
+          oria::renderColorCube();
+        });
+      }
+      static const char MESSAGE[] = "Benchmark stand-in for a repeated driver performance warning";
+      for (int i = 0; i < MESSAGES_PER_FRAME; ++i) {
+        glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_PERFORMANCE, MESSAGE_ID,
+          GL_DEBUG_SEVERITY_MEDIUM, -1, MESSAGE);
+      }
+      if (output) {
+        output->drain();
+      }
+      glFinish();
+    });
+
+    if (++frames >= FRAMES_PER_MODE) {
+      if (output) {
+        output->report();
+      }
+      if (++mode == MODE_COUNT) {
+        report();
+        glfwSetWindowShouldClose(window, 1);
+        mode = OFF;
+      }
+      startMode();
+    }
+  }
+};
+
+RUN_APP(DebugOutputBenchmark);
@@ -0,0 +1,121 @@
+#include "Common.h"
+
+// Checks GpuMemory's estimates against what the driver reports, where it
+// reports anything (GL_NVX_gpu_memory_info or GL_ATI_meminfo), and that
+// going over the budget evicts unused textures from the shared texture
+// cache, least recently used first.
+//
+// The driver's numbers move in whole pages, and other processes allocate
+// too, so they only need to agree roughly.
+
+// The DK2's recommended eye texture size, roughly
+static const uvec2 EYE_SIZE(1182, 1464);
+
+static const Resource CACHED_IMAGES[] = {
+  Resource::IMAGES_TUSCANY_UNDISTORTED_LEFT_DK1_PNG,
+  Resource::IMAGES_TUSCANY_UNDISTORTED_RIGHT_DK1_PNG,
+  Resource::IMAGES_TUSCANY_UNDISTORTED_LEFT_DK2_PNG,
+  Resource::IMAGES_TUSCANY_UNDISTORTED_RIGHT_DK2_PNG,
+  Resource::IMAGES_FLOOR_PNG,
+};
+
+static double megabytes(size_t bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+class GpuMemoryTest : public GlfwApp {
+  FramebufferWrapper eyeFramebuffers[2];
+  TexturePtr floor;
+
+public:
+  virtual GLFWwindow * createRenderingTarget(glm::uvec2 & outSize, glm::ivec2 & outPosition) {
+    outSize = glm::uvec2(320, 240);
+    outPosition = glm::ivec2(100, 100);
+    return glfw::createWindow(outSize, outPosition);
+  }
+
+  // Compares the change in the estimate with the change in what the driver
+  // says is available
+  template <typename F>
+  void measure(const char * name, F f) {
+    glFinish();
+    size_t estimateBefore = GpuMemory::getTotal().bytes;
+    size_t availableBefore = GpuMemory::queryDriver().available;
+    f();
+    glFinish();
+    size_t estimateAfter = GpuMemory::getTotal().bytes;
+    GpuMemory::DriverInfo driver = GpuMemory::queryDriver();
+    if (driver.extension) {
+      SAY("%-28s estimated %+7.1f MB, driver %+7.1f MB", name,
+        megabytes(estimateAfter) - megabytes(estimateBefore),
+        megabytes(availableBefore) - megabytes(driver.available));
+    } else {
+      SAY("%-28s estimated %+7.1f MB", name, megabytes(estimateAfter) - megabytes(estimateBefore));
+    }
+  }
+
+  virtual void initGl() {
+    GlfwApp::initGl();
+    // Set by initBudget() from the driver or the environment, and this
+    // needs to set its own
+    GpuMemory::setBudget(0);
+    GpuMemory::DriverInfo driver = GpuMemory::queryDriver();
+    if (!driver.extension) {
+      SAY("The driver doesn't report its memory, only the estimates are shown");
+    }
+
+    measure("Eye framebuffers", [&] {
+      for (int eye = 0; eye < 2; ++eye) {
+        eyeFramebuffers[eye].owner = "Eye framebuffers";
+        eyeFramebuffers[eye].init(EYE_SIZE);
+      }
+    });
+
+    measure("Cached images", [&] {
+      for (Resource resource : CACHED_IMAGES) {
+        oria::load2dTexture(resource);
+      }
+    });
+
+    measure("Floor mipmaps", [&] {
+      floor = oria::load2dTexture(Resource::IMAGES_FLOOR_PNG);
+      oglplus::Context::Bound(oglplus::TextureTarget::_2D, *floor).GenerateMipmap();
+      GpuMemory::mipmapsGenerated(*floor);
+    });
+
+    // Touch the first image again, so it's the most recently used, then set
+    // a budget that only leaves room for about half the cache
+    oria::load2dTexture(CACHED_IMAGES[0]);
+    GpuMemory::Total textures = GpuMemory::getTotal(GpuMemory::TEXTURE);
+    size_t cached = GpuMemory::getTotalsByOwner()["Texture cache"].bytes;
+    measure("Budget exceeded", [&] {
+      GpuMemory::setBudget(GpuMemory::getTotal().bytes - cached / 2);
+    });
+    GpuMemory::Total remaining = GpuMemory::getTotal(GpuMemory::TEXTURE);
+    SAY("Evicted %d of %d textures, %0.1f MB, leaving the total %s the budget",
+      (int)(textures.count - remaining.count), (int)textures.count,
+      megabytes(textures.bytes - remaining.bytes),
+      GpuMemory::getTotal().bytes <= GpuMemory::getBudget() ? "within" : "over");
+
+    // Loading them again brings the total back over, evicting whatever's
+    // least recently used as it goes
+    measure("Reloaded", [&] {
+      for (Resource resource : CACHED_IMAGES) {
+        oria::load2dTexture(resource);
+      }
+    });
+
+    GpuMemory::report();
+    glfwSetWindowShouldClose(window, 1);
+  }
+
+  virtual void shutdownGl() {
+    floor.reset();
+    GlfwApp::shutdownGl();
+  }
+
+  virtual void draw() {
+  }
+};
+
+RUN_APP(GpuMemoryTest);
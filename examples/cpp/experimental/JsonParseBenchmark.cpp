@@ -0,0 +1,156 @@
+#include "Common.h"
+#include <json/json.h>
+
+// Compares parsing a large JSON asset with jsoncpp, which builds a tree of
+// individually allocated nodes, against JsonReader and JsonDocument, and
+// against loading the same arrays after converting them to binary with
+// JsonArrays.  Reports the best throughput over a number of runs.
+//
+// Pass the path to the WebGL example's distortion mesh, mesh.json, or any
+// other JSON file.
+
+static const int RUNS = 10;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+template <typename F>
+static double bestMillis(F f) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < RUNS; ++i) {
+    Clock::time_point start = Clock::now();
+    f();
+    best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+static void report(const char * name, size_t bytes, double millis) {
+  SAY("  %-34s %8.2f ms %8.1f MB/s", name, millis, (bytes / (1024.0 * 1024.0)) / (millis / 1000.0));
+}
+
+// Counts everything, so the parse can't be skipped
+struct CountingHandler : public JsonHandler {
+  size_t values{ 0 };
+  double sum{ 0 };
+
+  virtual void string(const char * value, size_t length) {
+    ++values;
+  }
+  virtual void number(double value) {
+    ++values;
+    sum += value;
+  }
+};
+
+// Pulls the distortion meshes' arrays straight into typed buffers, the way
+// a loader would
+struct MeshHandler : public JsonHandler {
+  std::string lastKey;
+  std::vector<uint16_t> indices;
+  std::vector<float> floats;
+  JsonNumbers<uint16_t> indexSink{ indices };
+  JsonNumbers<float> floatSink{ floats };
+
+  virtual void key(const char * key, size_t length) {
+    lastKey.assign(key, length);
+  }
+  virtual JsonNumberSink * startArray() {
+    if ("indices" == lastKey) {
+      return &indexSink;
+    }
+    return &floatSink;
+  }
+};
+
+MAIN_DECL {
+  std::string path = "mesh.json";
+#ifndef OS_WIN
+  if (argc > 1) {
+    path = argv[1];
+  }
+#endif
+  std::string text;
+  try {
+    text = oria::readFile(path);
+  } catch (std::runtime_error & error) {
+    SAY_ERR("%s, pass the path to examples/webgl/mesh.json", error.what());
+    return -1;
+  }
+  // jsoncpp can't skip the script around the WebGL assets
+  std::string json = text;
+  size_t start = json.find_first_of("{[");
+  if (std::string::npos != start) {
+    json = json.substr(start);
+  }
+  SAY("%s, %0.1f MB, SSE2 scanning %s", path.c_str(), text.size() / (1024.0 * 1024.0),
+    JsonReader::isSimdEnabled() ? "enabled" : "disabled");
+
+  double jsoncppMillis = bestMillis([&] {
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json, root)) {
+      FAIL("jsoncpp failed to parse %s", path.c_str());
+    }
+  });
+  report("jsoncpp Json::Value", json.size(), jsoncppMillis);
+
+  CountingHandler counter;
+  double saxMillis = bestMillis([&] {
+    JsonReader reader;
+    counter = CountingHandler();
+    if (!reader.parse(text, counter)) {
+      FAIL("JsonReader failed: %s", reader.getError().c_str());
+    }
+  });
+  report("JsonReader, SAX", text.size(), saxMillis);
+
+  size_t documentBytes = 0;
+  double documentMillis = bestMillis([&] {
+    JsonDocument document;
+    if (!document.parse(text)) {
+      FAIL("JsonDocument failed: %s", document.getError().c_str());
+    }
+    documentBytes = document.getMemoryUsage();
+  });
+  report("JsonDocument, arena", text.size(), documentMillis);
+
+  MeshHandler mesh;
+  double typedMillis = bestMillis([&] {
+    JsonReader reader;
+    mesh.indices.clear();
+    mesh.floats.clear();
+    if (!reader.parse(text, mesh)) {
+      FAIL("JsonReader failed: %s", reader.getError().c_str());
+    }
+  });
+  report("JsonReader, into typed arrays", text.size(), typedMillis);
+
+  JsonDocument document;
+  document.parse(text);
+  std::vector<JsonArrays::Array> arrays = JsonArrays::extract(document.getRoot());
+  std::string binaryPath = "json_benchmark.bin";
+  if (!JsonArrays::write(binaryPath, arrays)) {
+    FAIL("Unable to write %s", binaryPath.c_str());
+  }
+  size_t binaryBytes = 0;
+  double binaryMillis = bestMillis([&] {
+    std::vector<JsonArrays::Array> loaded;
+    if (!JsonArrays::read(binaryPath, loaded)) {
+      FAIL("Unable to read %s", binaryPath.c_str());
+    }
+    binaryBytes = 0;
+    for (const JsonArrays::Array & array : loaded) {
+      binaryBytes += array.data.size();
+    }
+  });
+  // Measured against the JSON it replaces
+  report("JsonArrays, binary", text.size(), binaryMillis);
+
+  SAY("  %d values, %d indices and %d floats, %0.1f MB of arena for the document",
+    (int)counter.values, (int)mesh.indices.size(), (int)mesh.floats.size(), documentBytes / (1024.0 * 1024.0));
+  SAY("  %d arrays in %0.2f MB of binary, %0.1fx faster than jsoncpp", (int)arrays.size(),
+    binaryBytes / (1024.0 * 1024.0), jsoncppMillis / binaryMillis);
+  SAY("  The SAX reader is %0.1fx and the document %0.1fx the speed of jsoncpp",
+    jsoncppMillis / saxMillis, jsoncppMillis / documentMillis);
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include "Common.h"
+
+// Converts the large numeric arrays in a JSON file, such as the WebGL
+// example's distortion mesh, into the binary form JsonArrays reads, and
+// lists what it wrote.
+//
+// JsonToBinary input.json [output.bin] [minimum array length]
+
+MAIN_DECL {
+#ifdef OS_WIN
+  // WinMain doesn't get the arguments, but the CRT still parses them
+  int argc = __argc;
+  char ** argv = __argv;
+#endif
+  if (argc < 2) {
+    SAY_ERR("Usage: %s input.json [output.bin] [minimum array length]", argv[0]);
+    return -1;
+  }
+  std::string input = argv[1];
+  std::string output = argc > 2 ? argv[2] : input + ".bin";
+  size_t minimumCount = argc > 3 ? atoi(argv[3]) : 16;
+
+  JsonDocument document;
+  if (!document.parse(oria::readFile(input))) {
+    SAY_ERR("Unable to parse %s: %s", input.c_str(), document.getError().c_str());
+    return -1;
+  }
+  std::vector<JsonArrays::Array> arrays = JsonArrays::extract(document.getRoot(), minimumCount);
+  if (!JsonArrays::write(output, arrays)) {
+    SAY_ERR("Unable to write %s", output.c_str());
+    return -1;
+  }
+  for (const JsonArrays::Array & array : arrays) {
+    SAY("%-32s %8d x %s", array.name.c_str(), (int)array.count, JsonArrays::typeName(array.type));
+  }
+  SAY("Wrote %d arrays to %s", (int)arrays.size(), output.c_str());
+  return 0;
+}
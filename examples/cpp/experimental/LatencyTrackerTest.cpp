@@ -0,0 +1,73 @@
+#include "Common.h"
+
+// Drives the LatencyTracker through the SDK's frame timing without any
+// rendering, using the Rift if there is one and the debug HMD otherwise, so
+// the motion-to-photon and pose age reports can be checked anywhere.  The
+// render cost is simulated by sleeping, first comfortably inside the frame
+// and then past it, to show what a missed frame does to the latency.
+//
+// Pass a path to also write every frame to a CSV file.
+
+static const int FRAMES_PER_SCENARIO = 300;
+
+struct Scenario {
+  const char * name;
+  int renderMillis;
+};
+
+static const Scenario SCENARIOS[] = {
+  { "Light", 4 },
+  { "Heavy", 11 },
+  { "Missing", 16 },
+};
+
+static void runScenario(ovrHmd hmd, LatencyTracker & tracker, const Scenario & scenario, unsigned int & frameIndex) {
+  ovrVector3f eyeOffsets[2] = {};
+  ovrPosef eyePoses[2];
+  tracker.reset();
+  for (int i = 0; i < FRAMES_PER_SCENARIO; ++i) {
+    ++frameIndex;
+    tracker.beginFrame(frameIndex, ovrHmd_BeginFrameTiming(hmd, frameIndex));
+    ovrTrackingState state;
+    ovrHmd_GetEyePoses(hmd, frameIndex, eyeOffsets, eyePoses, &state);
+    tracker.posesQueried(state);
+    tracker.renderStarted();
+    Platform::sleepMillis(scenario.renderMillis);
+    tracker.renderFinished();
+    tracker.submitting();
+    // Stands in for the swap waiting on the next vsync
+    ovrFrameTiming timing = ovrHmd_GetFrameTiming(hmd, frameIndex);
+    ovr_WaitTillTime(timing.NextFrameSeconds);
+    ovrHmd_EndFrameTiming(hmd);
+    tracker.frameEnded();
+  }
+  SAY("%s, %d ms per frame:", scenario.name, scenario.renderMillis);
+  for (const std::string & line : tracker.getSummary()) {
+    SAY("  %s", line.c_str());
+  }
+}
+
+MAIN_DECL {
+  ovr_Initialize();
+  ovrHmd hmd = ovrHmd_Create(0);
+  if (!hmd) {
+    SAY("No Rift found, using the debug HMD's simulated timing");
+    hmd = ovrHmd_CreateDebug(ovrHmd_DK2);
+  }
+  ovrHmd_ConfigureTracking(hmd, ovrTrackingCap_Orientation | ovrTrackingCap_Position, 0);
+
+  LatencyTracker tracker;
+#ifndef OS_WIN
+  if (argc > 1 && !tracker.startCsv(argv[1])) {
+    SAY_ERR("Unable to write to %s", argv[1]);
+  }
+#endif
+  unsigned int frameIndex = 0;
+  for (const Scenario & scenario : SCENARIOS) {
+    runScenario(hmd, tracker, scenario, frameIndex);
+  }
+  tracker.stopCsv();
+  ovrHmd_Destroy(hmd);
+  ovr_Shutdown();
+  return 0;
+}
@@ -0,0 +1,213 @@
+#include "Common.h"
+
+// Tests the LED pose solver on synthetic camera images of a known
+// constellation moving along a head-like path.  Each frame the visible LEDs
+// are rendered as Gaussian spots, along with any spurious blobs and sensor
+// noise, the spots are found with the LedDetector and the pose is solved
+// from their centroids.  The solved pose is compared with the one used to
+// render the frame, and the time taken by tracking and by re-acquisition
+// is reported separately.
+//
+// A frame has converged if its pose is solved within CONVERGED_ROTATION and
+// CONVERGED_POSITION of the truth, which rules out flipped and mismatched
+// solutions.  Each scenario fails if too few frames converge, or if the
+// average error over the converged frames is too large.
+
+static const int FRAME_COUNT = 600;
+static const double FRAME_RATE = 60.0;
+static const float SPOT_SIGMA = 1.5f;
+static const double CONVERGED_ROTATION = 5.0;
+static const double CONVERGED_POSITION = 50.0;
+
+struct Scenario {
+  const char * name;
+  // Amplitude of the uniform per-pixel noise
+  int noise;
+  // Chance of each LED not showing up in a frame
+  float dropout;
+  int spuriousBlobs;
+  // Multiplies the speed of the head motion
+  double speed;
+  // Forces every frame to re-acquire, to measure the cost of RANSAC
+  bool reacquireEveryFrame;
+  // Whether to give the solver the true orientation, off by IMU_ERROR, as
+  // the IMU of an HMD would
+  bool orientationPrior;
+  // The fraction of frames that should converge
+  double minConverged;
+  // Limits on the average error of the converged frames, in degrees and mm
+  double maxRotationError;
+  double maxPositionError;
+};
+
+static const Scenario SCENARIOS[] = {
+  { "Clean", 0, 0.0f, 0, 1.0, false, false, 0.98, 0.5, 5.0 },
+  { "Noisy", 8, 0.1f, 0, 1.0, false, false, 0.90, 1.0, 10.0 },
+  { "Clutter", 8, 0.2f, 3, 1.0, false, false, 0.85, 1.0, 10.0 },
+  { "Fast", 8, 0.1f, 0, 3.0, false, false, 0.85, 1.0, 10.0 },
+  { "Reacquire", 8, 0.1f, 2, 1.0, true, false, 0.75, 1.5, 15.0 },
+  { "Clutter+IMU", 8, 0.2f, 3, 1.0, false, true, 0.90, 1.0, 10.0 },
+  { "Reacq+IMU", 8, 0.1f, 2, 1.0, true, true, 0.85, 1.5, 15.0 },
+};
+
+static const double IMU_ERROR = 2.0 * DEGREES_TO_RADIANS;
+static const double PRIOR_TOLERANCE = 10.0 * DEGREES_TO_RADIANS;
+
+typedef LedPoseSolver::Transform Transform;
+
+static glm::dmat3 rotation(double angle, const glm::dvec3 & axis) {
+  return glm::mat3_cast(glm::angleAxis(angle, axis));
+}
+
+// Turning, nodding and swaying in front of the camera, a little over a
+// metre away.  The model's y axis is up, so it's turned upside down to
+// match the camera's y axis pointing down.
+static Transform truePose(double time) {
+  Transform result;
+  result.rotation =
+    rotation(0.9 * sin(0.8 * time), glm::dvec3(0, 1, 0)) *
+    rotation(0.3 * sin(1.1 * time), glm::dvec3(1, 0, 0)) *
+    rotation(0.15 * sin(0.6 * time) + PI, glm::dvec3(0, 0, 1));
+  result.translation = glm::dvec3(0.2 * sin(0.5 * time), 0.1 * sin(0.7 * time), 1.2 + 0.2 * sin(0.3 * time));
+  return result;
+}
+
+static double angleBetween(const glm::dmat3 & a, const glm::dmat3 & b) {
+  glm::dmat3 difference = a * glm::transpose(b);
+  double trace = difference[0][0] + difference[1][1] + difference[2][2];
+  return acos(glm::clamp((trace - 1.0) / 2.0, -1.0, 1.0));
+}
+
+static void drawSpot(std::vector<uint8_t> & image, const glm::uvec2 & size, const glm::dvec2 & center) {
+  int radius = (int)ceil(SPOT_SIGMA * 3);
+  int cx = (int)floor(center.x), cy = (int)floor(center.y);
+  for (int y = std::max(0, cy - radius); y <= std::min((int)size.y - 1, cy + radius); ++y) {
+    for (int x = std::max(0, cx - radius); x <= std::min((int)size.x - 1, cx + radius); ++x) {
+      double dx = x - center.x, dy = y - center.y;
+      double value = 255.0 * exp(-(dx * dx + dy * dy) / (2.0 * SPOT_SIGMA * SPOT_SIGMA));
+      uint8_t & pixel = image[y * size.x + x];
+      pixel = std::max(pixel, (uint8_t)value);
+    }
+  }
+}
+
+static bool runScenario(const Scenario & scenario, const LedPoseSolver::Model & model, const LedPoseSolver::Camera & camera) {
+  LedPoseSolver solver(model, camera);
+  LedDetector detector;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+  std::uniform_int_distribution<int> noise(0, std::max(scenario.noise, 0));
+  std::vector<uint8_t> image(camera.size.x * camera.size.y);
+  std::vector<glm::vec2> centroids;
+
+  int valid = 0;
+  int converged = 0;
+  double convergedRotationError = 0, convergedPositionError = 0;
+  double rotationError = 0, maxRotationError = 0;
+  double positionError = 0, maxPositionError = 0;
+  double reprojectionError = 0;
+  int totalHypotheses = 0;
+  for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+    Transform truth = truePose(scenario.speed * frame / FRAME_RATE);
+
+    for (uint8_t & pixel : image) {
+      pixel = (uint8_t)noise(random);
+    }
+    for (size_t led = 0; led < model.positions.size(); ++led) {
+      glm::dvec2 point;
+      if (solver.project(truth, (int)led, point) && chance(random) >= scenario.dropout) {
+        drawSpot(image, camera.size, point);
+      }
+    }
+    for (int i = 0; i < scenario.spuriousBlobs; ++i) {
+      drawSpot(image, camera.size, glm::dvec2(chance(random) * camera.size.x, chance(random) * camera.size.y));
+    }
+
+    const std::vector<LedDetector::Blob> & blobs = detector.detect(&image[0], camera.size.x, camera.size.y, camera.size.x);
+    centroids.clear();
+    for (const LedDetector::Blob & blob : blobs) {
+      centroids.push_back(blob.centroid);
+    }
+
+    if (scenario.reacquireEveryFrame) {
+      solver.reset();
+    }
+    if (scenario.orientationPrior) {
+      solver.setOrientationPrior(rotation(IMU_ERROR, glm::normalize(glm::dvec3(1, 1, 0))) * truth.rotation, PRIOR_TOLERANCE);
+    }
+    const LedPoseSolver::Result & result = solver.solve(centroids);
+    totalHypotheses += result.hypotheses;
+    if (!result.valid) {
+      continue;
+    }
+    ++valid;
+    double angle = angleBetween(result.pose.rotation, truth.rotation) * RADIANS_TO_DEGREES;
+    double distance = glm::length(result.pose.translation - truth.translation) * 1000.0;
+    rotationError += angle;
+    maxRotationError = std::max(maxRotationError, angle);
+    positionError += distance;
+    maxPositionError = std::max(maxPositionError, distance);
+    reprojectionError += result.rmsError;
+    if (angle <= CONVERGED_ROTATION && distance <= CONVERGED_POSITION) {
+      ++converged;
+      convergedRotationError += angle;
+      convergedPositionError += distance;
+    }
+  }
+
+  const LedPoseSolver::Stats & stats = solver.getStats();
+  SAY("%-12s %5.1f%% solved, %d re-acquisitions (%d hypotheses), %d failures",
+    scenario.name, 100.0 * valid / FRAME_COUNT, (int)stats.reacquisitions, totalHypotheses, (int)stats.failures);
+  SAY("%-12s tracking avg %7.1f us, max %7.1f us; re-acquiring avg %7.3f ms, max %7.3f ms",
+    "", stats.tracking.getAverage() * 1000.0, stats.tracking.getMax() * 1000.0,
+    stats.reacquiring.getAverage(), stats.reacquiring.getMax());
+  if (valid) {
+    SAY("%-12s error: reprojection %5.2f px, rotation avg %6.3f max %6.3f degrees, position avg %6.2f max %6.2f mm",
+      "", reprojectionError / valid, rotationError / valid, maxRotationError,
+      positionError / valid, maxPositionError);
+  }
+
+  bool passed = true;
+  double convergedFraction = (double)converged / FRAME_COUNT;
+  if (convergedFraction < scenario.minConverged) {
+    SAY("%-12s FAILED: %0.1f%% of frames converged, expected at least %0.1f%%",
+      "", 100.0 * convergedFraction, 100.0 * scenario.minConverged);
+    passed = false;
+  }
+  if (converged) {
+    convergedRotationError /= converged;
+    convergedPositionError /= converged;
+    if (convergedRotationError > scenario.maxRotationError) {
+      SAY("%-12s FAILED: average rotation error %0.3f degrees, expected at most %0.3f",
+        "", convergedRotationError, scenario.maxRotationError);
+      passed = false;
+    }
+    if (convergedPositionError > scenario.maxPositionError) {
+      SAY("%-12s FAILED: average position error %0.2f mm, expected at most %0.2f",
+        "", convergedPositionError, scenario.maxPositionError);
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+MAIN_DECL {
+  LedPoseSolver::Model model;
+#ifndef OS_WIN
+  if (argc > 1 && !model.load(argv[1])) {
+    SAY_ERR("Unable to load an LED model from %s", argv[1]);
+    return -1;
+  }
+#endif
+  if (model.positions.empty()) {
+    model = LedPoseSolver::Model::createTest();
+  }
+  LedPoseSolver::Camera camera;
+  SAY("%d LEDs, %dx%d camera", (int)model.positions.size(), camera.size.x, camera.size.y);
+  bool passed = true;
+  for (const Scenario & scenario : SCENARIOS) {
+    passed &= runScenario(scenario, model, camera);
+  }
+  SAY(passed ? "All scenarios passed" : "Some scenarios failed");
+  return passed ? 0 : 1;
+}
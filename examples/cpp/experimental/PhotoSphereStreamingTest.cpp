@@ -0,0 +1,184 @@
+#include "Common.h"
+#include "TiledPanorama.h"
+
+#ifdef HAVE_OPENCV
+#include <opencv2/opencv.hpp>
+
+// Measures how long large panoramas take to appear and how much memory they
+// need, comparing the tiled, streamed loading with the way the photosphere
+// example used to load them: decoding the whole image, insetting it into a
+// full size buffer and uploading that as a single texture.
+//
+// The panoramas are generated, covering the middle half of the sphere the
+// way phone panoramas do, and tagged with GPano XMP data, so the parsing is
+// exercised as well.  The render loop is simulated at 75 Hz with the head
+// looking straight ahead, then turning 90 degrees, without a GL context, so
+// the uploads aren't timed.  The old path's GPU upload isn't timed either.
+//
+// Pass the largest width to test, 16384 by default.
+
+static const double FRAME_INTERVAL = 1.0 / 75.0;
+// Give up on a view completing after this long
+static const double TIMEOUT_SECONDS = 30.0;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double millisSince(const Clock::time_point & start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static double megabytes(double bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+// A grid every 10 degrees over a color gradient, so the panorama doesn't
+// compress down to nothing
+static cv::Mat generatePanorama(const cv::Size & size) {
+  cv::Mat result(size, CV_8UC3);
+  int gridSpacing = std::max(1, size.width / 36);
+  for (int y = 0; y < size.height; ++y) {
+    cv::Vec3b * row = result.ptr<cv::Vec3b>(y);
+    for (int x = 0; x < size.width; ++x) {
+      bool line = (x % gridSpacing) < 2 || (y % gridSpacing) < 2;
+      row[x] = line ? cv::Vec3b(255, 255, 255) :
+        cv::Vec3b((uint8_t)(x * 255 / size.width), (uint8_t)(y * 255 / size.height), (uint8_t)((x ^ y) & 0x3F));
+    }
+  }
+  return result;
+}
+
+// Inserts an APP1 segment holding the XMP packet right after the SOI marker
+static void addXmp(std::vector<uint8_t> & jpeg, const std::string & xmp) {
+  static const char NAMESPACE[] = "http://ns.adobe.com/xap/1.0/";
+  size_t length = 2 + sizeof(NAMESPACE) + xmp.size();
+  std::vector<uint8_t> segment = { 0xFF, 0xE1, (uint8_t)(length >> 8), (uint8_t)(length & 0xFF) };
+  segment.insert(segment.end(), NAMESPACE, NAMESPACE + sizeof(NAMESPACE));
+  segment.insert(segment.end(), xmp.begin(), xmp.end());
+  jpeg.insert(jpeg.begin() + 2, segment.begin(), segment.end());
+}
+
+static std::string gpanoXmp(const cv::Size & full, const cv::Rect & cropped) {
+  return Platform::format(
+    "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"><rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+    "<rdf:Description rdf:about=\"\" xmlns:GPano=\"http://ns.google.com/photos/1.0/panorama/\" "
+    "GPano:ProjectionType=\"equirectangular\" "
+    "GPano:FullPanoWidthPixels=\"%d\" GPano:FullPanoHeightPixels=\"%d\" "
+    "GPano:CroppedAreaLeftPixels=\"%d\" GPano:CroppedAreaTopPixels=\"%d\">"
+    "<GPano:CroppedAreaImageWidthPixels>%d</GPano:CroppedAreaImageWidthPixels>"
+    "<GPano:CroppedAreaImageHeightPixels>%d</GPano:CroppedAreaImageHeightPixels>"
+    "</rdf:Description></rdf:RDF></x:xmpmeta>",
+    full.width, full.height, cropped.x, cropped.y, cropped.width, cropped.height);
+}
+
+// What the example used to do, up to the upload
+static void loadWhole(const std::vector<uint8_t> & jpeg, const PanoramaMetadata & metadata, double & millis, size_t & bytes) {
+  Clock::time_point start = Clock::now();
+  cv::Mat image = cv::imdecode(jpeg, CV_LOAD_IMAGE_COLOR);
+  cv::cvtColor(image, image, CV_BGR2RGB);
+  size_t fullBytes = metadata.fullSize.x * metadata.fullSize.y * 3;
+  std::vector<uint8_t> full(fullBytes, 84);
+  for (int y = 0; y < image.rows; ++y) {
+    memcpy(&full[((metadata.croppedPosition.y + y) * metadata.fullSize.x + metadata.croppedPosition.x) * 3],
+      image.ptr<uint8_t>(y), image.cols * 3);
+  }
+  millis = millisSince(start);
+  bytes = image.total() * image.elemSize() + fullBytes;
+}
+
+struct StreamResult {
+  double firstFrameMillis{ -1 };
+  double completeMillis{ -1 };
+  int frames{ 0 };
+};
+
+// Runs the residency at the frame rate until the view is complete at the
+// level it wants
+static StreamResult stream(TiledPanorama & panorama, TileResidency & residency, const glm::quat & orientation) {
+  StreamResult result;
+  Clock::time_point start = Clock::now();
+  while (millisSince(start) < TIMEOUT_SECONDS * 1000.0) {
+    Clock::time_point frameStart = Clock::now();
+    bool uploaded = residency.update(orientation, [](const glm::uvec2 &, const uint8_t *) {});
+    ++result.frames;
+    if (uploaded && result.firstFrameMillis < 0) {
+      result.firstFrameMillis = millisSince(start);
+    }
+    if (residency.isComplete() && panorama.getStats().pyramidMillis > 0) {
+      result.completeMillis = millisSince(start);
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(FRAME_INTERVAL) - (Clock::now() - frameStart));
+  }
+  return result;
+}
+
+static void runSize(const cv::Size & full) {
+  cv::Rect cropped(0, full.height / 4, full.width, full.height / 2);
+  std::vector<uint8_t> jpeg;
+  {
+    cv::Mat image = generatePanorama(cropped.size());
+    std::vector<int> parameters = { CV_IMWRITE_JPEG_QUALITY, 90 };
+    cv::imencode(".jpg", image, jpeg, parameters);
+  }
+  addXmp(jpeg, gpanoXmp(full, cropped));
+  SAY("%dx%d panorama, %dx%d cropped, %0.1f MB JPEG", full.width, full.height,
+    cropped.width, cropped.height, megabytes((double)jpeg.size()));
+
+  PanoramaMetadata metadata;
+  if (!PanoramaMetadata::parseXmp(PanoramaMetadata::findXmp(jpeg), metadata) ||
+    metadata.fullSize != glm::uvec2(full.width, full.height) ||
+    metadata.croppedPosition != glm::uvec2(cropped.x, cropped.y) ||
+    metadata.croppedSize != glm::uvec2(cropped.width, cropped.height)) {
+    SAY_ERR("  The GPano metadata didn't survive the round trip");
+    return;
+  }
+
+  double wholeMillis = 0;
+  size_t wholeBytes = 0;
+  loadWhole(jpeg, metadata, wholeMillis, wholeBytes);
+  size_t wholeGpuBytes = (size_t)full.width * full.height * 4;
+  SAY("  Whole image: ready to upload after %6.0f ms, CPU %6.1f MB, GPU %6.1f MB%s",
+    wholeMillis, megabytes((double)wholeBytes), megabytes((double)wholeGpuBytes),
+    std::max(full.width, full.height) > 16384 ? ", larger than most GPUs' maximum texture size" : "");
+
+  TiledPanorama panorama;
+  TileResidency residency(panorama);
+  panorama.load(jpeg);
+  StreamResult ahead = stream(panorama, residency, glm::quat());
+  TiledPanorama::Stats stats = panorama.getStats();
+  const TileResidency::Settings & settings = residency.getSettings();
+  size_t atlasBytes = settings.slots.x * settings.slots.y * TiledPanorama::TILE_BYTES;
+  size_t pageTableBytes = residency.getPageTable().size() * sizeof(TileResidency::PageEntry);
+  SAY("  Tiled:       first frame after %6.0f ms, decode %6.0f ms, coarsest level %6.0f ms, pyramid %6.0f ms",
+    ahead.firstFrameMillis, stats.decodeMillis, stats.firstLevelMillis, stats.pyramidMillis);
+  SAY("               view complete at level %d after %6.0f ms, CPU %6.1f MB, GPU %6.1f MB (%d of %d tiles resident)",
+    residency.getDesiredLevel(), ahead.completeMillis, megabytes((double)panorama.getMemoryUsage()),
+    megabytes((double)(atlasBytes + pageTableBytes)), (int)residency.getResidentCount(),
+    (int)(settings.slots.x * settings.slots.y));
+
+  StreamResult turned = stream(panorama, residency, glm::angleAxis(HALF_PI, glm::vec3(0, 1, 0)));
+  const TileResidency::Stats & residencyStats = residency.getStats();
+  SAY("  Turning 90 degrees: complete after %6.0f ms (%d frames), %d uploads and %d evictions in total",
+    turned.completeMillis, turned.frames, (int)residencyStats.uploads, (int)residencyStats.evictions);
+  SAY("  Residency update avg %0.3f ms, max %0.3f ms, tile copy avg %0.3f ms",
+    residencyStats.update.getAverage(), residencyStats.update.getMax(), stats.tileCopy.getAverage());
+}
+
+MAIN_DECL {
+  int maxWidth = 16384;
+#ifndef OS_WIN
+  if (argc > 1) {
+    maxWidth = atoi(argv[1]);
+  }
+#endif
+  for (int width = 4096; width <= maxWidth; width *= 2) {
+    runSize(cv::Size(width, width / 2));
+  }
+  return 0;
+}
+
+#else
+MAIN_DECL {
+  return 0;
+}
+#endif
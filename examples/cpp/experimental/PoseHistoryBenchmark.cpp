@@ -0,0 +1,174 @@
+#include "Common.h"
+#include <fstream>
+#include <random>
+
+// Measures the cost and accuracy of PoseHistory lookups, driven by a head
+// motion trace replayed at 1 kHz in real time by a writer thread, while
+// several reader threads query random moments in the recent past.
+//
+// The trace is either synthetic, in which case the exact pose is known at
+// any time and the interpolation error can be measured, or recorded, given
+// as a file of lines "time qx qy qz qw px py pz" (for instance written out
+// by a PoseHistory sampler), in which case every other sample is held back
+// and used as the ground truth.
+
+static const int READER_THREADS = 3;
+static const double RUN_SECONDS = 10.0;
+static const double SAMPLE_RATE = 1000.0;
+// Queries look up to this far back, like a webcam frame would
+static const double MAX_QUERY_AGE = 0.2;
+static const int QUERIES_PER_BATCH = 1000;
+
+typedef PoseHistory::Sample Sample;
+
+// A head turning and nodding at up to a few hundred degrees per second,
+// while swaying slightly
+static Sample syntheticPose(double time) {
+  Sample result;
+  result.time = time;
+  float t = (float)time;
+  float yaw = 1.2f * sin(t * 2.1f) + 0.3f * sin(t * 7.3f);
+  float pitch = 0.4f * sin(t * 3.7f + 1.0f);
+  float roll = 0.1f * sin(t * 5.1f + 2.0f);
+  result.orientation = glm::angleAxis(yaw, Vectors::UP) *
+    glm::angleAxis(pitch, Vectors::X_AXIS) *
+    glm::angleAxis(roll, Vectors::Z_AXIS);
+  result.position = glm::vec3(0.05f * sin(t * 1.3f), 0.02f * sin(t * 2.9f), 0.03f * sin(t * 0.7f));
+  return result;
+}
+
+static float angleBetween(const glm::quat & a, const glm::quat & b) {
+  float dot = std::abs(glm::dot(a, b));
+  return 2.0f * acos(std::min(dot, 1.0f)) * RADIANS_TO_DEGREES;
+}
+
+static bool loadTrace(const std::string & path, std::vector<Sample> & trace) {
+  std::ifstream in(path);
+  Sample sample;
+  glm::quat & q = sample.orientation;
+  glm::vec3 & p = sample.position;
+  while (in >> sample.time >> q.x >> q.y >> q.z >> q.w >> p.x >> p.y >> p.z) {
+    trace.push_back(sample);
+  }
+  return trace.size() > 2;
+}
+
+struct ReaderResults {
+  TimingStats queryNanos;
+  TimingStats angleError;
+  TimingStats positionError;
+  size_t misses{ 0 };
+};
+
+MAIN_DECL {
+  std::vector<Sample> recorded;
+#ifndef OS_WIN
+  if (argc > 1 && !loadTrace(argv[1], recorded)) {
+    SAY_ERR("Unable to read a trace from %s", argv[1]);
+    return -1;
+  }
+#endif
+  bool synthetic = recorded.empty();
+  size_t traceSamples = synthetic ? (size_t)(RUN_SECONDS * SAMPLE_RATE) : recorded.size() / 2;
+
+  // Recorded traces are replayed relative to their own start time
+  std::function<Sample(size_t)> writtenSample = [&](size_t i) {
+    if (synthetic) {
+      return syntheticPose((double)i / SAMPLE_RATE);
+    }
+    Sample sample = recorded[i * 2];
+    sample.time -= recorded[0].time;
+    return sample;
+  };
+
+  PoseHistory history;
+  std::atomic<bool> done{ false };
+  std::atomic<double> newestTime{ -1 };
+  typedef std::chrono::high_resolution_clock Clock;
+  Clock::time_point start = Clock::now();
+
+  std::thread writer([&] {
+    for (size_t i = 0; i < traceSamples; ++i) {
+      Sample sample = writtenSample(i);
+      std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(sample.time)));
+      history.record(sample);
+      newestTime = sample.time;
+    }
+    done = true;
+  });
+
+  std::vector<ReaderResults> results(READER_THREADS);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < READER_THREADS; ++r) {
+    readers.push_back(std::thread([&, r] {
+      ReaderResults & result = results[r];
+      std::mt19937 random(r);
+      std::uniform_real_distribution<double> age(0.002, MAX_QUERY_AGE);
+      std::vector<Sample> truths(QUERIES_PER_BATCH);
+      std::vector<Sample> answers(QUERIES_PER_BATCH);
+      std::vector<char> covered(QUERIES_PER_BATCH);
+      while (!done) {
+        double newest = newestTime;
+        if (newest < MAX_QUERY_AGE) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (int i = 0; i < QUERIES_PER_BATCH; ++i) {
+          double time = newest - age(random);
+          if (synthetic) {
+            truths[i] = syntheticPose(time);
+          } else {
+            // Use the held back sample nearest the query time as the truth
+            auto found = std::lower_bound(recorded.begin(), recorded.end(),
+              time + recorded[0].time, [](const Sample & sample, double t) {
+                return sample.time < t;
+              });
+            size_t index = std::distance(recorded.begin(), found) | 1;
+            if (index >= recorded.size()) {
+              index -= 2;
+            }
+            truths[i] = recorded[index];
+            truths[i].time -= recorded[0].time;
+          }
+        }
+        // Timed as a batch, since the clock costs about as much as a query
+        Clock::time_point batchStart = Clock::now();
+        for (int i = 0; i < QUERIES_PER_BATCH; ++i) {
+          covered[i] = history.getPose(truths[i].time, answers[i]);
+        }
+        double nanos = std::chrono::duration<double, std::nano>(Clock::now() - batchStart).count();
+        result.queryNanos.add(nanos / QUERIES_PER_BATCH);
+
+        for (int i = 0; i < QUERIES_PER_BATCH; ++i) {
+          if (!covered[i]) {
+            ++result.misses;
+            continue;
+          }
+          result.angleError.add(angleBetween(truths[i].orientation, answers[i].orientation));
+          result.positionError.add(glm::length(truths[i].position - answers[i].position) * 1000.0f);
+        }
+      }
+    }));
+  }
+
+  writer.join();
+  for (std::thread & reader : readers) {
+    reader.join();
+  }
+
+  SAY("%s trace, %d samples, %d reader threads",
+    synthetic ? "Synthetic" : "Recorded", (int)traceSamples, READER_THREADS);
+  for (int r = 0; r < READER_THREADS; ++r) {
+    const ReaderResults & result = results[r];
+    SAY("Reader %d: %d queries, %d outside the history", r,
+      (int)(result.queryNanos.getCount() * QUERIES_PER_BATCH), (int)result.misses);
+    SAY("  query time     avg %0.1f ns, max %0.1f ns",
+      result.queryNanos.getAverage(), result.queryNanos.getMax());
+    SAY("  angle error    avg %0.4f deg, max %0.4f deg",
+      result.angleError.getAverage(), result.angleError.getMax());
+    SAY("  position error avg %0.4f mm, max %0.4f mm",
+      result.positionError.getAverage(), result.positionError.getMax());
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "Common.h"
+
+// Measures the cost of a PROFILE_SCOPE, which needs to stay well under 50 ns
+// for the profiler to be left in the frame loop, both on a single thread and
+// with several threads recording at once.  Finishes by writing a trace of
+// the threads to profiler_test.json, to check it loads in chrome://tracing.
+
+static const int SCOPES = 10 * 1000 * 1000;
+// Each on its own core, so the time isn't shared
+static const int THREADS = std::max(1, std::min(4, (int)std::thread::hardware_concurrency()));
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double nanosPerIteration(bool profiled) {
+  // Enough work that the loop isn't optimized away, and little enough that
+  // the scope dominates.  Local, so the threads don't contend for it.
+  volatile int sink = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < SCOPES; ++i) {
+    if (profiled) {
+      PROFILE_SCOPE("Test scope");
+      sink = sink + 1;
+    } else {
+      sink = sink + 1;
+    }
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / SCOPES;
+}
+
+static double scopeCost() {
+  // The first scope on a thread registers its ring, so keep it out of the
+  // measurement
+  nanosPerIteration(true);
+  return nanosPerIteration(true) - nanosPerIteration(false);
+}
+
+MAIN_DECL {
+  Profiler::setThreadName("Main");
+  SAY("Single thread: %0.1f ns per scope", scopeCost());
+
+  std::vector<std::thread> threads;
+  std::vector<double> costs(THREADS);
+  for (int i = 0; i < THREADS; ++i) {
+    threads.push_back(std::thread([&costs, i] {
+      Profiler::setThreadName(Platform::format("Worker %d", i).c_str());
+      costs[i] = scopeCost();
+    }));
+  }
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < THREADS; ++i) {
+    SAY("Worker %d of %d: %0.1f ns per scope", i, THREADS, costs[i]);
+  }
+
+  // Something with structure to look at in the trace
+  for (int frame = 0; frame < 10; ++frame) {
+    PROFILE_SCOPE("Frame");
+    {
+      PROFILE_SCOPE("Update");
+      Platform::sleepMillis(2);
+    }
+    {
+      PROFILE_SCOPE("Draw");
+      Platform::sleepMillis(5);
+    }
+  }
+
+  Clock::time_point start = Clock::now();
+  bool written = Profiler::dump("profiler_test.json", 2.0);
+  SAY("%s profiler_test.json in %0.1f ms", written ? "Wrote" : "Failed to write",
+    std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  return written ? 0 : -1;
+}
@@ -0,0 +1,132 @@
+#include "Common.h"
+#include <random>
+
+// Exercises StereoFrameSync with two synthetic cameras, simulated in
+// virtual time so the runs are fast and repeatable.  Each scenario prints
+// the skew statistics and fails if any presented pair is further apart than
+// the tolerance, or if pairs are lost that should have been found.
+
+struct SyntheticCamera {
+  double fps;
+  // Start time of the first frame, in seconds
+  double phase;
+  // Standard deviation of the capture time, in seconds
+  double jitter;
+  // Chance of a frame never arriving
+  double dropRate;
+};
+
+struct Scenario {
+  const char * name;
+  SyntheticCamera cameras[2];
+  double tolerance;
+  // The display rate the pairs are picked up at
+  double displayFps;
+  // The fraction of left frames that should end up paired
+  double minPairedFraction;
+};
+
+static const Scenario SCENARIOS[] = {
+  { "In phase", { { 30, 0, 0.0005, 0 }, { 30, 0.001, 0.0005, 0 } }, 0.016, 75, 0.99 },
+  // Just outside the tolerance, so only the frames the jitter pulls closer
+  // pair up, a little over half of them
+  { "Half a frame out of phase", { { 30, 0, 0.001, 0 }, { 30, 0.0167, 0.001, 0 } }, 0.016, 75, 0.45 },
+  { "Quarter frame out of phase", { { 30, 0, 0.001, 0 }, { 30, 0.008, 0.001, 0 } }, 0.016, 75, 0.95 },
+  { "Dropped frames", { { 30, 0, 0.001, 0.05 }, { 30, 0.002, 0.001, 0.05 } }, 0.016, 75, 0.85 },
+  { "Mismatched rates", { { 30, 0, 0.001, 0 }, { 25, 0, 0.001, 0 } }, 0.016, 75, 0.5 },
+  { "Slow display", { { 60, 0, 0.0005, 0 }, { 60, 0.001, 0.0005, 0 } }, 0.008, 20, 0.99 },
+};
+
+static const double DURATION = 60.0;
+
+// The value carried with each frame is just its own timestamp, so the
+// presented pairs can be checked
+typedef StereoFrameSync<double> FrameSync;
+
+static bool runScenario(const Scenario & scenario) {
+  std::mt19937 random(1234);
+  std::normal_distribution<double> jitter(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  FrameSync sync(scenario.tolerance);
+
+  size_t presented = 0;
+  size_t frames[2] = { 0, 0 };
+  double maxSkew = 0;
+  double lastPresented = -1;
+  bool ordered = true;
+  int next[2] = { 0, 0 };
+  double nextDisplay = 0;
+  double lastCapture[2] = { -1, -1 };
+  for (;;) {
+    // Work out which camera delivers next, or whether the display does
+    double times[2];
+    for (int i = 0; i < 2; ++i) {
+      const SyntheticCamera & camera = scenario.cameras[i];
+      times[i] = camera.phase + next[i] / camera.fps;
+    }
+    int camera = times[0] <= times[1] ? 0 : 1;
+    double now = std::min(times[camera], nextDisplay);
+    if (now > DURATION) {
+      break;
+    }
+
+    if (nextDisplay <= times[camera]) {
+      FrameSync::Pair pair;
+      if (sync.getPair(pair)) {
+        ++presented;
+        double skew = std::abs(pair.frames[0].data - pair.frames[1].data);
+        maxSkew = std::max(maxSkew, skew);
+        if (pair.frames[0].timestamp <= lastPresented) {
+          ordered = false;
+        }
+        lastPresented = pair.frames[0].timestamp;
+      }
+      nextDisplay += 1.0 / scenario.displayFps;
+      continue;
+    }
+
+    ++next[camera];
+    if (uniform(random) < scenario.cameras[camera].dropRate) {
+      continue;
+    }
+    // Jitter can't reorder a camera's own frames
+    double captured = std::max(now + jitter(random) * scenario.cameras[camera].jitter,
+      lastCapture[camera] + 0.0001);
+    lastCapture[camera] = captured;
+    ++frames[camera];
+    sync.push(camera, captured, std::move(captured));
+  }
+
+  FrameSync::Stats stats = sync.getStats();
+  double pairedFraction = (double)stats.pairs / (double)frames[0];
+  SAY("%s", scenario.name);
+  SAY("  frames %d / %d, paired %d (%0.1f%%), presented %d, dropped pairs %d",
+    (int)frames[0], (int)frames[1], (int)stats.pairs, pairedFraction * 100.0,
+    (int)presented, (int)stats.droppedPairs);
+  SAY("  unmatched %d / %d, skew %s",
+    (int)stats.unmatched[0], (int)stats.unmatched[1], stats.skew.toString().c_str());
+
+  bool passed = true;
+  if (maxSkew > scenario.tolerance) {
+    SAY("  FAILED: presented a pair %0.3f ms apart", maxSkew * 1000.0);
+    passed = false;
+  }
+  if (pairedFraction < scenario.minPairedFraction) {
+    SAY("  FAILED: expected at least %0.1f%% of frames paired", scenario.minPairedFraction * 100.0);
+    passed = false;
+  }
+  if (!ordered) {
+    SAY("  FAILED: pairs were presented out of order");
+    passed = false;
+  }
+  return passed;
+}
+
+MAIN_DECL {
+  bool passed = true;
+  for (const Scenario & scenario : SCENARIOS) {
+    passed &= runScenario(scenario);
+  }
+  SAY(passed ? "All scenarios passed" : "Some scenarios failed");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include "Common.h"
+
+// Compares the memory and the GPU time of the CTM meshes loaded the way
+// ShapeWrapper loads them (float attributes and 32 bit indices) with the
+// compact vertex formats.
+//
+// Each mesh is drawn many times per frame into a small viewport, so the
+// vertex fetch rather than the fill rate dominates, and the frame is timed
+// with a GL_TIME_ELAPSED query.  The bandwidth figure assumes every vertex
+// is fetched once per draw, which the post transform cache makes roughly
+// true for these meshes.
+
+static const int FRAMES_PER_CASE = 200;
+static const int WARMUP_FRAMES = 20;
+static const int DRAWS_PER_FRAME = 100;
+
+struct MeshCase {
+  const char * name;
+  Resource resource;
+};
+
+static const MeshCase MESHES[] = {
+  { "Manikin", Resource::MESHES_MANIKIN_CTM },
+  { "Rift", Resource::MESHES_RIFT_CTM },
+  { "Sphere", Resource::MESHES_SPHERE_CTM },
+};
+
+static const int MESH_COUNT = sizeof(MESHES) / sizeof(MESHES[0]);
+
+static VertexFormat snorm16() {
+  VertexFormat result;
+  result.position = VertexFormat::POSITION_SNORM16;
+  return result;
+}
+
+struct FormatCase {
+  const char * name;
+  VertexFormat format;
+};
+
+static const FormatCase FORMATS[] = {
+  { "Full", VertexFormat::full() },
+  { "Compact", VertexFormat::compact() },
+  { "Compact, snorm16", snorm16() },
+};
+
+static const int FORMAT_COUNT = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+static double kilobytes(size_t bytes) {
+  return bytes / 1024.0;
+}
+
+class VertexFormatBenchmark : public GlfwApp {
+  ProgramPtr program;
+  MeshPtr meshes[MESH_COUNT][FORMAT_COUNT];
+  TimingStats gpuStats[MESH_COUNT][FORMAT_COUNT];
+  GLuint query{ 0 };
+  int meshIndex{ 0 };
+  int formatIndex{ 0 };
+  int frames{ 0 };
+
+public:
+  virtual GLFWwindow * createRenderingTarget(glm::uvec2 & outSize, glm::ivec2 & outPosition) {
+    outSize = glm::uvec2(320, 240);
+    outPosition = glm::ivec2(100, 100);
+    return glfw::createWindow(outSize, outPosition);
+  }
+
+  virtual void initGl() {
+    GlfwApp::initGl();
+    glfwSwapInterval(0);
+    glEnable(GL_DEPTH_TEST);
+    glGenQueries(1, &query);
+    program = oria::loadProgram(Resource::SHADERS_LIT_VS, Resource::SHADERS_LITCOLORED_FS);
+    for (int m = 0; m < MESH_COUNT; ++m) {
+      for (int f = 0; f < FORMAT_COUNT; ++f) {
+        meshes[m][f] = oria::loadMesh({ "Position", "Normal" }, MESHES[m].resource, program, FORMATS[f].format);
+      }
+    }
+  }
+
+  virtual void shutdownGl() {
+    glDeleteQueries(1, &query);
+    for (int m = 0; m < MESH_COUNT; ++m) {
+      for (int f = 0; f < FORMAT_COUNT; ++f) {
+        meshes[m][f].reset();
+      }
+    }
+    program.reset();
+    GlfwApp::shutdownGl();
+  }
+
+  void report() {
+    SAY("GPU time for %d draws per frame, over %d frames:", DRAWS_PER_FRAME, FRAMES_PER_CASE);
+    for (int m = 0; m < MESH_COUNT; ++m) {
+      const Mesh::Stats & baseline = meshes[m][0]->getStats();
+      SAY("%s, %d vertices, %d indices:", MESHES[m].name, (int)baseline.vertexCount, (int)baseline.indexCount);
+      for (int f = 0; f < FORMAT_COUNT; ++f) {
+        const Mesh::Stats & stats = meshes[m][f]->getStats();
+        double millis = gpuStats[m][f].getAverage();
+        double gbPerSecond = stats.getTotalBytes() * (double)DRAWS_PER_FRAME / (millis * 1.0e6);
+        SAY("  %-17s %2d byte stride, vertices %7.1f KB, indices %7.1f KB, total %3.0f%%, %0.3f ms, %5.2f GB/s",
+          FORMATS[f].name, (int)stats.stride, kilobytes(stats.vertexBytes), kilobytes(stats.indexBytes),
+          100.0 * stats.getTotalBytes() / baseline.getTotalBytes(), millis, gbPerSecond);
+      }
+    }
+    for (int f = 0; f < FORMAT_COUNT; ++f) {
+      SAY("%s: %s", FORMATS[f].name, FORMATS[f].format.toString().c_str());
+    }
+  }
+
+  virtual void draw() {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    oria::viewport(getSize());
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    pr.top() = glm::perspective(PI / 3.0f, windowAspect, 0.1f, 100.0f);
+    MeshPtr & mesh = meshes[meshIndex][formatIndex];
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int i = 0; i < DRAWS_PER_FRAME; ++i) {
+      mv.withPush([&] {
+        mv.identity();
+        mv.translate(glm::vec3(0, 0, -4.0f)).rotate(i * 0.1f, Vectors::UP);
+        oria::renderGeometry(mesh, program, [&] {
+          oria::bindLights(program);
+        });
+      });
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    if (frames >= WARMUP_FRAMES) {
+      gpuStats[meshIndex][formatIndex].add(nanoseconds / 1.0e6);
+    }
+
+    if (++frames >= WARMUP_FRAMES + FRAMES_PER_CASE) {
+      frames = 0;
+      if (++formatIndex == FORMAT_COUNT) {
+        formatIndex = 0;
+        if (++meshIndex == MESH_COUNT) {
+          meshIndex = 0;
+          report();
+          glfwSetWindowShouldClose(window, 1);
+        }
+      }
+    }
+  }
+};
+
+RUN_APP(VertexFormatBenchmark);
@@ -0,0 +1,214 @@
+#include "Common.h"
+
+// Compares the ways ShadertoyVR has drawn the shader output on the four
+// walls around the viewer in 2D mode, while the view turns a full circle.
+//
+// The old way drew every wall twice, straight from the shader output.  The
+// new way copies the output into a mipmapped texture once, then draws the
+// walls in the frustum with one instanced draw.  The GPU time includes
+// that copy and the mipmap generation.  The fill figure is the number of
+// samples that passed per frame, from a GL_SAMPLES_PASSED query, and for
+// the new way also includes the copy.
+//
+// The shader output is stood in for by a fine checkerboard, which is about
+// the worst case for aliasing on the minified walls.
+
+static const int FRAMES_PER_MODE = 360;
+static const int WARMUP_FRAMES = 20;
+static const uvec2 SOURCE_SIZE(1182, 1461);
+static const int CHECKER_SIZE = 2;
+static const int WALL_COUNT = 4;
+
+// The shaders ShadertoyVR draws the walls with, from the source tree, so
+// the benchmark always measures what ships
+static const std::string WALLS_SHADERS = PROJECT_DIR "/examples/cpp/qt/shadertoy/shaders/walls";
+
+class WallRenderBenchmark : public GlfwApp {
+  enum Mode {
+    TWICE_PER_WALL,
+    INSTANCED_MIPMAPPED,
+    MODE_COUNT
+  };
+
+  static const char * modeName(int mode) {
+    switch (mode) {
+    case TWICE_PER_WALL:
+      return "Each wall twice";
+    case INSTANCED_MIPMAPPED:
+      return "Instanced, mipmapped";
+    }
+    return "";
+  }
+
+  ProgramPtr planeProgram;
+  ShapeWrapperPtr plane;
+  ProgramPtr wallProgram;
+  MeshPtr wallMesh;
+  oglplus::Texture source;
+  FramebufferWrapperPtr wallFramebuffer;
+  GLuint queries[2];
+  TimingStats gpuStats[MODE_COUNT];
+  TimingStats sampleStats[MODE_COUNT];
+  int wallsDrawn{ 0 };
+  int mode{ TWICE_PER_WALL };
+  int frames{ 0 };
+
+public:
+  virtual GLFWwindow * createRenderingTarget(glm::uvec2 & outSize, glm::ivec2 & outPosition) {
+    outSize = glm::uvec2(1280, 800);
+    outPosition = glm::ivec2(100, 100);
+    return glfw::createWindow(outSize, outPosition);
+  }
+
+  virtual void initGl() {
+    using namespace oglplus;
+    GlfwApp::initGl();
+    glfwSwapInterval(0);
+    glGenQueries(2, queries);
+
+    planeProgram = oria::loadProgram(Resource::SHADERS_TEXTURED_VS, Resource::SHADERS_TEXTURED_FS);
+    plane = oria::loadPlane(planeProgram, 1.0f);
+    oria::compileProgram(wallProgram,
+      oria::readFile(WALLS_SHADERS + ".vs"),
+      oria::readFile(WALLS_SHADERS + ".fs"));
+    wallMesh = oria::loadPlaneMesh(wallProgram, 1.0f);
+
+    std::vector<uint8_t> pixels(SOURCE_SIZE.x * SOURCE_SIZE.y * 4);
+    for (size_t y = 0; y < SOURCE_SIZE.y; ++y) {
+      for (size_t x = 0; x < SOURCE_SIZE.x; ++x) {
+        uint8_t value = ((x / CHECKER_SIZE + y / CHECKER_SIZE) & 1) ? 255 : 0;
+        uint8_t * pixel = &pixels[(y * SOURCE_SIZE.x + x) * 4];
+        pixel[0] = pixel[1] = pixel[2] = value;
+        pixel[3] = 255;
+      }
+    }
+    Context::Bound(Texture::Target::_2D, source)
+      .MinFilter(TextureMinFilter::Linear)
+      .MagFilter(TextureMagFilter::Linear)
+      .WrapS(TextureWrap::ClampToEdge)
+      .WrapT(TextureWrap::ClampToEdge)
+      .Image2D(0, PixelDataInternalFormat::RGBA8, SOURCE_SIZE.x, SOURCE_SIZE.y,
+        0, PixelDataFormat::RGBA, PixelDataType::UnsignedByte, &pixels[0]);
+
+    wallFramebuffer = FramebufferWrapperPtr(new FramebufferWrapper());
+    wallFramebuffer->useDepth = false;
+    wallFramebuffer->mipmaps = true;
+    wallFramebuffer->init(SOURCE_SIZE);
+  }
+
+  virtual void shutdownGl() {
+    glDeleteQueries(2, queries);
+    wallFramebuffer.reset();
+    wallMesh.reset();
+    wallProgram.reset();
+    plane.reset();
+    planeProgram.reset();
+    GlfwApp::shutdownGl();
+  }
+
+  static mat4 wallTransform(int wall) {
+    static const vec3 TRANSLATION(0, 0, -3.5f);
+    static const vec3 SCALE(3.0f, 3.0f * SOURCE_SIZE.y / SOURCE_SIZE.x, 3.0f);
+    mat4 rotation = glm::rotate(mat4(), wall * PI / 2.0f, Vectors::Y_AXIS);
+    return glm::scale(glm::translate(rotation, TRANSLATION), SCALE);
+  }
+
+  // What MainWindow::perEyeRender used to do
+  void renderTwicePerWall() {
+    MatrixStack & mv = Stacks::modelview();
+    source.Bind(oglplus::Texture::Target::_2D);
+    for (int i = 0; i < WALL_COUNT; ++i) {
+      mv.withPush([&] {
+        mv.postMultiply(wallTransform(i));
+        oria::renderGeometry(plane, planeProgram, LambdaList({ [&] {
+          oglplus::Uniform<vec2>(*planeProgram, "UvMultiplier").Set(vec2(1));
+        } }));
+        oria::renderGeometry(plane, planeProgram);
+      });
+    }
+    wallsDrawn += WALL_COUNT * 2;
+  }
+
+  // What MainWindow::renderWalls does
+  void renderInstanced() {
+    source.Bind(oglplus::Texture::Target::_2D);
+    wallFramebuffer->Bound([&] {
+      Stacks::withIdentity([&] {
+        oria::renderGeometry(plane, planeProgram, LambdaList({ [&] {
+          oglplus::Uniform<vec2>(*planeProgram, "UvMultiplier").Set(vec2(1));
+        } }));
+      });
+    });
+    oria::viewport(getSize());
+    wallFramebuffer->generateMipmaps();
+
+    mat4 clipFromWorld = Stacks::projection().top() * Stacks::modelview().top();
+    mat4 walls[WALL_COUNT];
+    int visibleWalls = 0;
+    for (int i = 0; i < WALL_COUNT; ++i) {
+      mat4 transform = wallTransform(i);
+      if (oria::intersectsFrustum(clipFromWorld * transform, vec3(-1, -1, 0), vec3(1, 1, 0))) {
+        walls[visibleWalls++] = transform;
+      }
+    }
+    wallsDrawn += visibleWalls;
+    if (visibleWalls) {
+      oria::renderGeometryInstanced(wallMesh, wallProgram, visibleWalls, [&] {
+        glUniformMatrix4fv(glGetUniformLocation(oglplus::GetName(*wallProgram), "Walls"),
+          visibleWalls, GL_FALSE, glm::value_ptr(walls[0]));
+      });
+    }
+  }
+
+  void report() {
+    SAY("Walls at %dx%d over a full turn, %d frames per mode:",
+      (int)SOURCE_SIZE.x, (int)SOURCE_SIZE.y, FRAMES_PER_MODE);
+    for (int i = 0; i < MODE_COUNT; ++i) {
+      SAY("  %-21s GPU %s, %0.2f Msamples per frame", modeName(i),
+        gpuStats[i].toString().c_str(), sampleStats[i].getAverage());
+    }
+  }
+
+  virtual void draw() {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_DEPTH_TEST);
+    oria::viewport(getSize());
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    pr.top() = glm::perspective(PI / 3.0f, windowAspect, 0.01f, 10000.0f);
+    mv.identity().rotate(2.0f * PI * frames / FRAMES_PER_MODE, Vectors::UP);
+
+    if (frames == WARMUP_FRAMES) {
+      wallsDrawn = 0;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+    glBeginQuery(GL_SAMPLES_PASSED, queries[1]);
+    if (TWICE_PER_WALL == mode) {
+      renderTwicePerWall();
+    } else {
+      renderInstanced();
+    }
+    glEndQuery(GL_SAMPLES_PASSED);
+    glEndQuery(GL_TIME_ELAPSED);
+    GLuint64 nanoseconds = 0;
+    GLuint64 samples = 0;
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &nanoseconds);
+    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &samples);
+    if (frames >= WARMUP_FRAMES) {
+      gpuStats[mode].add(nanoseconds / 1.0e6);
+      sampleStats[mode].add(samples / 1.0e6);
+    }
+
+    if (++frames >= WARMUP_FRAMES + FRAMES_PER_MODE) {
+      SAY("%s: %0.2f wall draws per frame", modeName(mode), (float)wallsDrawn / FRAMES_PER_MODE);
+      frames = 0;
+      if (++mode == MODE_COUNT) {
+        report();
+        glfwSetWindowShouldClose(window, 1);
+        mode = TWICE_PER_WALL;
+      }
+    }
+  }
+};
+
+RUN_APP(WallRenderBenchmark);
@@ -0,0 +1,221 @@
+#include "Common.h"
+
+// Compares the render thread cost of the ways of getting webcam frames into
+// a texture, using a synthetic 1080p source running at 60 fps on its own
+// thread, so the results don't depend on what cameras are attached.
+//
+// Each method is run for a fixed number of frames, then the upload times
+// are printed and the next method starts.
+
+static const glm::uvec2 FRAME_SIZE(1920, 1080);
+static const int FRAMES_PER_SECOND = 60;
+static const int FRAMES_PER_METHOD = 600;
+
+struct SyntheticFrame {
+  std::vector<uint8_t> bgr;
+  std::vector<uint8_t> bgra;
+};
+
+// Produces frames of scrolling color bars, as both BGR (what OpenCV
+// delivers) and BGRA
+class SyntheticSource {
+  TripleBuffer<SyntheticFrame> buffer;
+  std::thread thread;
+  std::atomic<bool> stop{ false };
+
+  void run() {
+    const std::chrono::microseconds interval(1000000 / FRAMES_PER_SECOND);
+    auto next = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame = 0; !stop; ++frame) {
+      SyntheticFrame & out = buffer.getBack();
+      uint8_t * bgr = &out.bgr[0];
+      uint8_t * bgra = &out.bgra[0];
+      for (uint32_t y = 0; y < FRAME_SIZE.y; ++y) {
+        for (uint32_t x = 0; x < FRAME_SIZE.x; ++x) {
+          uint8_t value = (uint8_t)((x + frame * 8) & 0xFF);
+          uint8_t band = (uint8_t)(((y / 64) * 40) & 0xFF);
+          bgr[0] = bgra[0] = value;
+          bgr[1] = bgra[1] = band;
+          bgr[2] = bgra[2] = value ^ band;
+          bgra[3] = 0xFF;
+          bgr += 3;
+          bgra += 4;
+        }
+      }
+      buffer.publish();
+      next += interval;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+public:
+  SyntheticSource() {
+    buffer.forEachSlot([&](SyntheticFrame & frame) {
+      frame.bgr.resize(FRAME_SIZE.x * FRAME_SIZE.y * 3);
+      frame.bgra.resize(FRAME_SIZE.x * FRAME_SIZE.y * 4);
+    });
+    thread = std::thread([&] {
+      run();
+    });
+  }
+
+  ~SyntheticSource() {
+    stop = true;
+    thread.join();
+  }
+
+  const SyntheticFrame * getFrame() {
+    if (!buffer.update()) {
+      return nullptr;
+    }
+    return &buffer.getFront();
+  }
+};
+
+class WebcamUploadBenchmark : public GlfwApp {
+  enum Method {
+    // What the webcam demos used to do, reallocating every frame and
+    // converting from BGR in the driver
+    IMAGE_2D_BGR,
+    // Immutable storage, but uploading straight from client memory
+    SUB_IMAGE_BGRA,
+    // Immutable storage, uploading through a ring of mapped pixel buffers
+    STREAMING_BGRA,
+    METHOD_COUNT
+  };
+
+  static const char * methodName(int method) {
+    switch (method) {
+    case IMAGE_2D_BGR:
+      return "Image2D BGR";
+    case SUB_IMAGE_BGRA:
+      return "TexSubImage2D BGRA";
+    case STREAMING_BGRA:
+      return "Streaming PBO BGRA";
+    }
+    return "";
+  }
+
+  SyntheticSource source;
+  int method{ IMAGE_2D_BGR };
+  int uploads{ 0 };
+  TimingStats uploadStats[METHOD_COUNT];
+  TimingStats frameStats[METHOD_COUNT];
+
+  TexturePtr texture;
+  StreamingTexturePtr streamingTexture{ new StreamingTexture() };
+  ProgramPtr program;
+  ShapeWrapperPtr quad;
+
+public:
+  virtual GLFWwindow * createRenderingTarget(glm::uvec2 & outSize, glm::ivec2 & outPosition) {
+    outSize = FRAME_SIZE / 2u;
+    outPosition = glm::ivec2(100, 100);
+    return glfw::createWindow(outSize, outPosition);
+  }
+
+  virtual void initGl() {
+    GlfwApp::initGl();
+    // Don't let vsync hide the cost of the upload
+    glfwSwapInterval(0);
+    program = oria::loadProgram(Resource::SHADERS_TEXTURED_VS, Resource::SHADERS_TEXTURED_FS);
+    quad = oria::loadPlane(program, 1.0f);
+    startMethod();
+  }
+
+  virtual void shutdownGl() {
+    quad.reset();
+    program.reset();
+    texture.reset();
+    // Its buffers and fences need the context, which goes with the window
+    streamingTexture.reset();
+    GlfwApp::shutdownGl();
+  }
+
+  void startMethod() {
+    using namespace oglplus;
+    uploads = 0;
+    texture = TexturePtr(new Texture());
+    Context::Bound(TextureTarget::_2D, *texture)
+      .MagFilter(TextureMagFilter::Linear)
+      .MinFilter(TextureMinFilter::Linear);
+    if (SUB_IMAGE_BGRA == method) {
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, FRAME_SIZE.x, FRAME_SIZE.y);
+    }
+    DefaultTexture().Bind(TextureTarget::_2D);
+    if (STREAMING_BGRA == method) {
+      streamingTexture->init(FRAME_SIZE);
+    }
+  }
+
+  void upload(const SyntheticFrame & frame) {
+    using namespace oglplus;
+    switch (method) {
+    case IMAGE_2D_BGR:
+      Context::Bound(TextureTarget::_2D, *texture)
+        .Image2D(0, PixelDataInternalFormat::RGBA8,
+          FRAME_SIZE.x, FRAME_SIZE.y, 0,
+          PixelDataFormat::BGR, PixelDataType::UnsignedByte,
+          &frame.bgr[0]);
+      break;
+
+    case SUB_IMAGE_BGRA:
+      texture->Bind(TextureTarget::_2D);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, FRAME_SIZE.x, FRAME_SIZE.y,
+        GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, &frame.bgra[0]);
+      break;
+
+    case STREAMING_BGRA:
+      streamingTexture->upload(&frame.bgra[0]);
+      break;
+    }
+    DefaultTexture().Bind(TextureTarget::_2D);
+  }
+
+  void report() {
+    SAY("Render thread cost per %dx%d frame, over %d frames:",
+      FRAME_SIZE.x, FRAME_SIZE.y, FRAMES_PER_METHOD);
+    for (int i = 0; i < METHOD_COUNT; ++i) {
+      SAY("  %-20s upload %s", methodName(i), uploadStats[i].toString().c_str());
+      SAY("  %-20s frame  %s", "", frameStats[i].toString().c_str());
+    }
+    if (!streamingTexture->isPersistent()) {
+      SAY("ARB_buffer_storage isn't available, the pixel buffers were mapped every frame");
+    }
+  }
+
+  virtual void draw() {
+    frameStats[method].time([&] {
+      const SyntheticFrame * frame = source.getFrame();
+      if (frame) {
+        uploadStats[method].time([&] {
+          upload(*frame);
+        });
+        ++uploads;
+      }
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      oria::viewport(getSize());
+      if (STREAMING_BGRA == method) {
+        streamingTexture->getTexture()->Bind(oglplus::TextureTarget::_2D);
+      } else {
+        texture->Bind(oglplus::TextureTarget::_2D);
+      }
+      Stacks::withIdentity([&] {
+        oria::renderGeometry(quad, program);
+      });
+      oglplus::DefaultTexture().Bind(oglplus::TextureTarget::_2D);
+    });
+
+    if (uploads >= FRAMES_PER_METHOD) {
+      if (++method == METHOD_COUNT) {
+        report();
+        glfwSetWindowShouldClose(window, 1);
+        method = IMAGE_2D_BGR;
+      }
+      startMethod();
+    }
+  }
+};
+
+RUN_APP(WebcamUploadBenchmark);
@@ -1,117 +1,247 @@
 #include "Common.h"
-#include <fstream>
-#include <cstdio>
-#include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
+#include "TiledPanorama.h"
 
+// Set PHOTOSPHERE to the path of a JPEG to view it instead of the bundled
+// panorama
+
+// The sphere is drawn around the viewer, so the model space position of a
+// fragment is the direction to look up in the panorama
+static const char * SPHERE_VERTEX_SHADER =
+  "#version 330\n"
+  "uniform mat4 Projection = mat4(1);\n"
+  "uniform mat4 ModelView = mat4(1);\n"
+  "in vec3 Position;\n"
+  "out vec3 vDirection;\n"
+  "void main() {\n"
+  "  gl_Position = Projection * ModelView * vec4(Position, 1);\n"
+  "  vDirection = Position;\n"
+  "}\n";
+
+// Looks up the finest resident tile for the level matching the screen
+// resolution in the page table, then samples it from the atlas
+static const char * SPHERE_FRAGMENT_SHADER =
+  "#version 330\n"
+  "const float PI = 3.14159265;\n"
+  "uniform sampler2D Atlas;\n"
+  "uniform sampler2D PageTable;\n"
+  "uniform int LevelCount;\n"
+  "uniform int LevelRow[16];\n"
+  "uniform vec2 FullSize;\n"
+  "uniform vec2 AtlasSize;\n"
+  "uniform float TileSize;\n"
+  "uniform float TileBorder;\n"
+  "in vec3 vDirection;\n"
+  "out vec4 FragColor;\n"
+  "void main() {\n"
+  "  vec3 d = normalize(vDirection);\n"
+  // Matches TileResidency::toTexCoord
+  "  vec2 uv = vec2(atan(d.x, -d.z) / (2.0 * PI) + 0.5, acos(clamp(d.y, -1.0, 1.0)) / PI);\n"
+  // The texture coordinates jump at the seam, so the level is picked from
+  // how far the direction moves across a pixel instead
+  "  float angle = max(length(dFdx(d)), length(dFdy(d)));\n"
+  "  float level = clamp(floor(log2(max(angle * FullSize.x / (2.0 * PI), 1.0))), 0.0, float(LevelCount - 1));\n"
+  "  vec2 levelSize = FullSize / exp2(level);\n"
+  "  vec2 page = min(floor(uv * levelSize / TileSize), ceil(levelSize / TileSize) - 1.0);\n"
+  "  vec4 entry = floor(texelFetch(PageTable, ivec2(page.x, LevelRow[int(level)] + int(page.y)), 0) * 255.0 + 0.5);\n"
+  "  if (entry.a < 255.0) {\n"
+  "    FragColor = vec4(0, 0, 0, 1);\n"
+  "    return;\n"
+  "  }\n"
+  "  vec2 residentSize = FullSize / exp2(entry.b);\n"
+  "  vec2 texel = uv * residentSize;\n"
+  "  vec2 residentPage = min(floor(texel / TileSize), ceil(residentSize / TileSize) - 1.0);\n"
+  "  vec2 atlas = entry.xy * (TileSize + 2.0 * TileBorder) + TileBorder + texel - residentPage * TileSize;\n"
+  "  FragColor = vec4(textureLod(Atlas, atlas / AtlasSize, 0.0).rgb, 1);\n"
+  "}\n";
 
 class PhotoSphereExample : public RiftApp {
+  TiledPanorama panorama;
+  std::unique_ptr<TileResidency> residency;
+  TexturePtr atlas;
+  glm::uvec2 atlasSize;
+  TexturePtr pageTable;
+  ProgramPtr program;
+  MeshPtr geometry;
+  double loadStart{ 0 };
+  bool firstFrameReported{ false };
+  bool completeReported{ false };
 
 public:
   PhotoSphereExample() {
+    std::vector<uint8_t> jpeg;
+    PanoramaMetadata fallback;
+    const char * path = getenv("PHOTOSPHERE");
+    if (path && *path) {
+      std::string data = oria::readFile(path);
+      jpeg.assign(data.begin(), data.end());
+    } else {
+      // The bundled panorama's XMP data was stripped, but exiv2's dump of it
+      // was kept
+      jpeg = Platform::getResourceByteVector(Resource::IMAGES_PANO_20140620_160351_JPG);
+      parseExiv2(Platform::getResourceString(Resource::MISC_PANO_20140620_160351_EXIV), fallback);
+    }
+    loadStart = ovr_GetTimeInSeconds();
+    panorama.load(jpeg, fallback);
   }
 
-  void drawSphere() {
-    static ProgramPtr program = oria::loadProgram(Resource::SHADERS_TEXTURED_VS, Resource::SHADERS_TEXTURED_FS);
-    static ShapeWrapperPtr geometry = oria::loadShape({ "Position", "TexCoord" }, Resource::MESHES_SPHERE_CTM, program);
-    static TexturePtr t = loadAndPositionPhotoSphereImage(Resource::IMAGES_PANO_20140620_160351_JPG);
-    Platform::addShutdownHook([]{
-      program.reset();
-      geometry.reset();
-      t.reset();
-    }); 
-
-    t->Bind(oglplus::Texture::Target::_2D);
-    MatrixStack & mv = Stacks::modelview();
-    mv.withPush([&] {
-      // Invert the sphere to see its insides
-      mv.scale(vec3(-1));
-      oria::renderGeometry(geometry, program);
-    });
-    oglplus::DefaultTexture().Bind(oglplus::Texture::Target::_2D);
-  }
-
-  void renderScene() {
+  virtual void initGl() {
+    RiftApp::initGl();
     using namespace oglplus;
-    Context::Clear().DepthBuffer();
-    glClear(GL_DEPTH_BUFFER_BIT);
+    oria::compileProgram(program, SPHERE_VERTEX_SHADER, SPHERE_FRAGMENT_SHADER);
+    if (!program) {
+      FAIL("Unable to build the photosphere shader");
+    }
+    geometry = oria::loadMesh({ "Position" }, Resource::MESHES_SPHERE_CTM, program);
 
-    MatrixStack & mv = Stacks::modelview();
-    mv.withPush([&]{
-      mv.translate(glm::vec3(0, 0, -1)).scale(0.2f);
-      drawSphere();
-    });
-    mv.withPush([&]{
-      mv.translate(glm::vec3(0, 0, -1)).scale(0.02f);
-      mv.postMultiply(ovr::toGlm(getEyePose()));
-      oria::renderRift();
-    });
+    // Stream at the resolution of the eye textures
+    const ovrFovPort & fov = getFov(ovrEye_Left);
+    float horizontal = atan(fov.LeftTan) + atan(fov.RightTan);
+    float vertical = atan(fov.UpTan) + atan(fov.DownTan);
+    TileResidency::Settings settings;
+    settings.fov = std::max(horizontal, vertical);
+    settings.pixelsPerRadian = eyeTextures[0].Header.TextureSize.w / horizontal;
+    residency = std::unique_ptr<TileResidency>(new TileResidency(panorama, settings));
 
-    Context::Disable(Capability::CullFace);
-    glDisable(GL_CULL_FACE);
-    mv.withPush([&]{
-      mv.scale(50.0f);
-      drawSphere();
-    });
-    Context::Enable(Capability::CullFace);
+    atlasSize = settings.slots * glm::uvec2(TiledPanorama::SLOT_SIZE);
+    GpuMemory::Owner memoryOwner("Photosphere tiles");
+    atlas = oria::createTexture();
+    Context::Bound(TextureTarget::_2D, *atlas)
+      .MagFilter(TextureMagFilter::Linear)
+      .MinFilter(TextureMinFilter::Linear)
+      .WrapS(TextureWrap::ClampToEdge)
+      .WrapT(TextureWrap::ClampToEdge);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize.x, atlasSize.y, 0,
+      GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+    GpuMemory::textureAllocated(*atlas, GL_RGBA8, atlasSize);
+    DefaultTexture().Bind(TextureTarget::_2D);
+  }
+
+  virtual void shutdownGl() {
+    program.reset();
+    geometry.reset();
+    atlas.reset();
+    pageTable.reset();
+    RiftApp::shutdownGl();
   }
 
-  /**
-   * Call out to the exiv2 binary to retrieve the XMP fields encoded in the target image file.
-   */
-  static TexturePtr loadAndPositionPhotoSphereImage(Resource res) {
-    glm::uvec2 fullPanoSize;
-    glm::uvec2 croppedImageSize;
-    glm::uvec2 croppedImagePos;
+  virtual void update() {
+    RiftApp::update();
     using namespace oglplus;
+    if (panorama.isFailed()) {
+      FAIL("Unable to decode the panorama");
+    }
 
-    TexturePtr texture(new Texture());
-    Platform::addShutdownHook([&]{
-      texture.reset();
+    ovrTrackingState tracking = ovrHmd_GetTrackingState(hmd, ovr_GetTimeInSeconds());
+    glm::quat orientation = ovr::toGlm(tracking.HeadPose.ThePose.Orientation);
+    bool changed = residency->update(orientation, [&](const glm::uvec2 & slot, const uint8_t * bgra) {
+      atlas->Bind(TextureTarget::_2D);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glTexSubImage2D(GL_TEXTURE_2D, 0,
+        slot.x * TiledPanorama::SLOT_SIZE, slot.y * TiledPanorama::SLOT_SIZE,
+        TiledPanorama::SLOT_SIZE, TiledPanorama::SLOT_SIZE,
+        GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, bgra);
     });
-    auto v = Platform::getResourceByteVector(res);
-    cv::Mat mat = cv::imdecode(v, CV_LOAD_IMAGE_COLOR);
-    cv::cvtColor(mat, mat, CV_BGR2RGB);
-    //cv::flip(mat, mat, 0);
-    Context::Bound(TextureTarget::_2D, *texture)
-      .MagFilter(TextureMagFilter::Linear)
-      .MinFilter(TextureMinFilter::Linear);
+    if (!changed) {
+      return;
+    }
 
-    if (parseExifData(Platform::getResourceString(Resource::MISC_PANO_20140620_160351_EXIV), fullPanoSize, croppedImageSize, croppedImagePos)) {
+    glm::uvec2 size = residency->getPageTableSize();
+    if (!pageTable) {
+      GpuMemory::Owner memoryOwner("Photosphere tiles");
+      pageTable = oria::createTexture();
+      Context::Bound(TextureTarget::_2D, *pageTable)
+        .MagFilter(TextureMagFilter::Nearest)
+        .MinFilter(TextureMinFilter::Nearest);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      GpuMemory::textureAllocated(*pageTable, GL_RGBA8, size);
+    }
+    pageTable->Bind(TextureTarget::_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y,
+      GL_RGBA, GL_UNSIGNED_BYTE, &residency->getPageTable()[0]);
+    DefaultTexture().Bind(TextureTarget::_2D);
+    reportProgress();
+  }
 
-      // EXIF data parsed succesfully
-      uchar *embedded = (uchar*)malloc(fullPanoSize.x * fullPanoSize.y * 3);
-      insetImage(fullPanoSize, croppedImageSize, croppedImagePos, mat, embedded);
-      Context::Bound(TextureTarget::_2D, *texture)
-        .Image2D(images::Image(fullPanoSize.x, fullPanoSize.y, 1, 3, embedded));
-      free(embedded);
+  void reportProgress() {
+    double elapsed = (ovr_GetTimeInSeconds() - loadStart) * 1000.0;
+    TiledPanorama::Stats stats = panorama.getStats();
+    if (!firstFrameReported) {
+      firstFrameReported = true;
+      SAY("First frame %0.0f ms after loading started, decoding took %0.0f ms",
+        elapsed, stats.decodeMillis);
     }
-    else {
-      // Failed to load EXIF data
-      texture->Bind(Texture::Target::_2D);
-      Context::PixelStore(PixelStorageMode::UnpackAlignment, 1);
-      Context::Bound(TextureTarget::_2D, *texture)
-        .Image2D(images::Image(mat.cols, mat.rows, 1, 3, mat.datastart));
+    // Until the pyramid is built the view may be complete at a coarser level
+    if (!completeReported && residency->isComplete() && stats.pyramidMillis > 0) {
+      completeReported = true;
+      const TileResidency::Settings & settings = residency->getSettings();
+      glm::uvec2 size = panorama.getSize(0);
+      SAY("View complete at level %d after %0.0f ms, pyramid built after %0.0f ms",
+        residency->getDesiredLevel(), elapsed, stats.pyramidMillis);
+      SAY("%dx%d panorama, %d tiles resident, atlas %0.1f MB, CPU pyramid %0.1f MB",
+        (int)size.x, (int)size.y, (int)residency->getResidentCount(),
+        settings.slots.x * settings.slots.y * TiledPanorama::TILE_BYTES / (1024.0 * 1024.0),
+        panorama.getMemoryUsage() / (1024.0 * 1024.0));
     }
+  }
 
-    return texture;
+  void drawSphere() {
+    using namespace oglplus;
+    Texture::Active(1);
+    pageTable->Bind(TextureTarget::_2D);
+    Texture::Active(0);
+    atlas->Bind(TextureTarget::_2D);
+    int levelCount = panorama.getLevelCount();
+    glm::uvec2 fullSize = panorama.getSize(0);
+    oria::renderGeometry(geometry, program, LambdaList({ [&] {
+      Uniform<GLint>(*program, "Atlas").Set(0);
+      Uniform<GLint>(*program, "PageTable").Set(1);
+      Uniform<GLint>(*program, "LevelCount").Set(levelCount);
+      for (int level = 0; level < levelCount; ++level) {
+        Uniform<GLint>(*program, Platform::format("LevelRow[%d]", level).c_str()).Set(residency->getLevelRow(level));
+      }
+      Uniform<vec2>(*program, "FullSize").Set(vec2(fullSize));
+      Uniform<vec2>(*program, "AtlasSize").Set(vec2(atlasSize));
+      Uniform<GLfloat>(*program, "TileSize").Set((GLfloat)TiledPanorama::TILE_SIZE);
+      Uniform<GLfloat>(*program, "TileBorder").Set((GLfloat)TiledPanorama::TILE_BORDER);
+    } }));
+    Texture::Active(1);
+    DefaultTexture().Bind(TextureTarget::_2D);
+    Texture::Active(0);
+    DefaultTexture().Bind(TextureTarget::_2D);
   }
 
-  /**
-   * Embed the image in mat into a larger frame.
-   */
-  static void insetImage(glm::uvec2 &fullPanoSize, glm::uvec2 &croppedImageSize, glm::uvec2 &croppedImagePos, cv::Mat &mat, uchar *out) {
-    memset(out, 84, fullPanoSize.x * fullPanoSize.y * 3);
-    for (unsigned int y = 0; y < croppedImageSize.y; y++) {
-      int srcRow = y * croppedImageSize.x * 3;
-      int destRow = (croppedImagePos.y + y) * (fullPanoSize.x * 3);
-      memcpy(out + destRow + croppedImagePos.x, mat.datastart + srcRow, croppedImageSize.x * 3);
+  void renderScene() {
+    using namespace oglplus;
+    Context::Clear().ColorBuffer().DepthBuffer();
+
+    MatrixStack & mv = Stacks::modelview();
+    // Nothing to show until the coarsest level has been uploaded
+    if (pageTable) {
+      mv.withPush([&]{
+        mv.translate(glm::vec3(0, 0, -1)).scale(0.2f);
+        drawSphere();
+      });
+    }
+    mv.withPush([&]{
+      mv.translate(glm::vec3(0, 0, -1)).scale(0.02f);
+      mv.postMultiply(ovr::toGlm(getEyePose()));
+      oria::renderRift();
+    });
+
+    if (pageTable) {
+      Context::Disable(Capability::CullFace);
+      mv.withPush([&]{
+        mv.scale(50.0f);
+        drawSphere();
+      });
+      Context::Enable(Capability::CullFace);
     }
   }
 
-  static bool parseExifData(const std::string & exifData, glm::uvec2 &fullPanoSize, glm::uvec2 &croppedImageSize, glm::uvec2 &croppedImagePos) {
-    // Extract pano fields from temp file
+  // Parses the output of "exiv2 -pa print"
+  static bool parseExiv2(const std::string & exifData, PanoramaMetadata & result) {
     int fieldsFound = 0;
     std::string line;
     std::istringstream infile(exifData);
@@ -120,36 +250,19 @@ public:
       std::string field, type, name;
       int value;
       if (iss >> field >> type >> name >> value) {
-        if (field.compare("Xmp.GPano.FullPanoWidthPixels") == 0) { fullPanoSize.x = value; fieldsFound |= (1 << 0); }
-        if (field.compare("Xmp.GPano.FullPanoHeightPixels") == 0) { fullPanoSize.y = value; fieldsFound |= (1 << 1); }
-        if (field.compare("Xmp.GPano.CroppedAreaLeftPixels") == 0) { croppedImagePos.x = value; fieldsFound |= (1 << 2); }
-        if (field.compare("Xmp.GPano.CroppedAreaTopPixels") == 0) { croppedImagePos.y = value; fieldsFound |= (1 << 3); }
-        if (field.compare("Xmp.GPano.CroppedAreaImageWidthPixels") == 0) { croppedImageSize.x = value; fieldsFound |= (1 << 4); }
-        if (field.compare("Xmp.GPano.CroppedAreaImageHeightPixels") == 0) { croppedImageSize.y = value; fieldsFound |= (1 << 5); }
+        if (field.compare("Xmp.GPano.FullPanoWidthPixels") == 0) { result.fullSize.x = value; fieldsFound |= (1 << 0); }
+        if (field.compare("Xmp.GPano.FullPanoHeightPixels") == 0) { result.fullSize.y = value; fieldsFound |= (1 << 1); }
+        if (field.compare("Xmp.GPano.CroppedAreaLeftPixels") == 0) { result.croppedPosition.x = value; fieldsFound |= (1 << 2); }
+        if (field.compare("Xmp.GPano.CroppedAreaTopPixels") == 0) { result.croppedPosition.y = value; fieldsFound |= (1 << 3); }
+        if (field.compare("Xmp.GPano.CroppedAreaImageWidthPixels") == 0) { result.croppedSize.x = value; fieldsFound |= (1 << 4); }
+        if (field.compare("Xmp.GPano.CroppedAreaImageHeightPixels") == 0) { result.croppedSize.y = value; fieldsFound |= (1 << 5); }
       }
     }
-    if (fieldsFound != ((1 << 6) - 1)) {
+    result.valid = fieldsFound == ((1 << 6) - 1);
+    if (!result.valid) {
       std::cout << "Didn't find expected XMP fields" << std::endl;
-      return false;
     }
-    return true;
-  }
-  static bool loadExifDataFromImage(const std::string &pathToImage, glm::uvec2 &fullPanoSize, glm::uvec2 &croppedImageSize, glm::uvec2 &croppedImagePos) {
-    static const std::string pathToExiv2 = "C:\\bin\\exiv2\\exiv2.exe";
-    static const std::string exiv2Params = "-pa print";
-    static const std::string tempFile = "temp.txt";
-
-    // Extract XMP data from image, write to temp file
-    std::string command = pathToExiv2 + " " + exiv2Params + " " + pathToImage + " > " + tempFile;
-    system(command.c_str());
-    std::string exifData = oria::readFile(tempFile);
-    if (parseExifData(exifData, fullPanoSize, croppedImageSize, croppedImagePos)) {
-      remove(tempFile.c_str());
-      return true;
-    }
-
-    std::cout << "output has been left in " + tempFile << std::endl;
-    return false;
+    return result.valid;
   }
 };
 
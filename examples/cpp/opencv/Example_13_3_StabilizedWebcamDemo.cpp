@@ -1,4 +1,5 @@
 #include "Common.h"
+#include "FrameSource.h"
 
 #include <opencv2/opencv.hpp>
 #include <thread>
@@ -15,7 +16,7 @@ private:
 
   bool hasFrame{ false };
   bool stopped{ false };
-  cv::VideoCapture videoCapture;
+  FrameSourcePtr source;
   std::thread captureThread;
   std::mutex mutex;
   CaptureData frame;
@@ -28,12 +29,16 @@ public:
 
   // Spawn capture thread and return webcam aspect ratio (width over height)
   float startCapture() {
-    videoCapture.open(1);
-    if (!videoCapture.isOpened()
-      || !videoCapture.read(frame.image)) {
+    // Set FRAME_SOURCE to use a different camera, a recording or a
+    // generated pattern
+    source = FrameSource::create("1", "FRAME_SOURCE");
+    CapturedFrame first;
+    if (!source || !source->read(first)) {
       FAIL("Could not open video source to capture first frame");
     }
-    float aspectRatio = (float)frame.image.cols / (float)frame.image.rows;
+    // Frame times are on the SDK clock, so they can be used to look up poses
+    source->setClock(ovr_GetTimeInSeconds);
+    float aspectRatio = (float)first.image.cols / (float)first.image.rows;
     captureThread = std::thread(&WebcamHandler::captureLoop, this);
     return aspectRatio;
   }
@@ -41,7 +46,7 @@ public:
   void stopCapture() {
     stopped = true;
     captureThread.join();
-    videoCapture.release();
+    source.reset();
   }
 
   void set(const CaptureData & newFrame) {
@@ -61,14 +66,22 @@ public:
   }
 
   void captureLoop() {
+    Profiler::setThreadName("Capture");
     CaptureData captured;
+    CapturedFrame raw;
+    cv::Mat flipped;
     while (!stopped) {
-      float captureTime = ovr_GetTimeInSeconds();
-      ovrTrackingState tracking = ovrHmd_GetTrackingState(hmd, captureTime);
+      PROFILE_SCOPE("Capture frame");
+      if (!source->read(raw)) {
+        break;
+      }
+      ovrTrackingState tracking = ovrHmd_GetTrackingState(hmd, raw.exposureTime);
       captured.pose = tracking.HeadPose.ThePose;
 
-      videoCapture.read(captured.image);
-      cv::flip(captured.image.clone(), captured.image, 0);
+      cv::flip(raw.image, flipped, 0);
+      // Padded to BGRA, so the render thread can upload it without any
+      // conversion
+      cv::cvtColor(flipped, captured.image, CV_BGR2BGRA);
       set(captured);
     }
   }
@@ -78,7 +91,7 @@ class WebcamApp : public RiftApp {
 
 protected:
 
-  TexturePtr texture;
+  StreamingTexture videoTexture;
   ProgramPtr program;
   ShapeWrapperPtr videoGeometry;
   WebcamHandler captureHandler;
@@ -96,10 +109,6 @@ public:
   void initGl() {
     RiftApp::initGl();
     using namespace oglplus;
-    texture = TexturePtr(new Texture());
-    Context::Bound(TextureTarget::_2D, *texture)
-      .MagFilter(TextureMagFilter::Linear)
-      .MinFilter(TextureMinFilter::Linear);
     program = oria::loadProgram(Resource::SHADERS_TEXTURED_VS, Resource::SHADERS_TEXTURED_FS);
     float aspectRatio = captureHandler.startCapture();
     videoGeometry = oria::loadPlane(program, aspectRatio);
@@ -107,12 +116,12 @@ public:
 
   virtual void update() {
     if (captureHandler.get(captureData)) {
-      using namespace oglplus;
-      Context::Bound(TextureTarget::_2D, *texture)
-        .Image2D(0, PixelDataInternalFormat::RGBA8,
-        captureData.image.cols, captureData.image.rows, 0,
-        PixelDataFormat::BGR, PixelDataType::UnsignedByte,
-        captureData.image.data);
+      const cv::Mat & image = captureData.image;
+      glm::uvec2 size(image.cols, image.rows);
+      if (size != videoTexture.getSize()) {
+        videoTexture.init(size);
+      }
+      videoTexture.upload(image.data);
     }
   }
 
@@ -131,8 +140,11 @@ public:
 
       mv.translate(glm::vec3(0, 0, -2));
       using namespace oglplus;
-      texture->Bind(TextureTarget::_2D);
-      oria::renderGeometry(videoGeometry, program);
+      // Nothing to show until the first frame arrives
+      if (videoTexture.isInitialized()) {
+        videoTexture.getTexture()->Bind(TextureTarget::_2D);
+        oria::renderGeometry(videoGeometry, program);
+      }
       oglplus::DefaultTexture().Bind(TextureTarget::_2D);
     });
   }
@@ -1,27 +1,31 @@
 #include "Common.h"
+#include "FrameSource.h"
 
 #include <opencv2/opencv.hpp>
 #include <thread>
-#include <mutex>
 
 int CAMERA_FOR_EYE[2] = { 2, 1 };
+// Frames further apart than this are never shown together.  About half the
+// frame interval of a 30 fps webcam.
+#define PAIRING_TOLERANCE 0.016
 
 struct CaptureData {
   ovrPosef pose;
   cv::Mat image;
 };
 
+typedef StereoFrameSync<CaptureData> FrameSync;
+
 class WebcamHandler {
 
 private:
 
-  bool hasFrame{ false };
   bool stopped{ false };
-  cv::VideoCapture videoCapture;
+  FrameSourcePtr source;
   std::thread captureThread;
-  std::mutex mutex;
-  CaptureData frame;
   ovrHmd hmd;
+  FrameSync * frameSync{ nullptr };
+  int eye{ 0 };
 
 public:
 
@@ -29,16 +33,26 @@ public:
   }
 
   // Spawn capture thread and return webcam aspect ratio (width over height)
-  float startCapture(ovrHmd & hmdRef, int which) {
+  float startCapture(ovrHmd & hmdRef, FrameSync & sync, int eyeIndex, int which) {
     hmd = hmdRef;
-    videoCapture.open(which);
-    if (!videoCapture.isOpened()) {
+    frameSync = &sync;
+    eye = eyeIndex;
+    CapturedFrame frame;
+    // Set FRAME_SOURCE_LEFT and FRAME_SOURCE_RIGHT to use recordings or
+    // generated patterns instead of the webcams
+    source = FrameSource::create(std::to_string(which),
+      eyeIndex ? "FRAME_SOURCE_RIGHT" : "FRAME_SOURCE_LEFT");
+    if (!source) {
       FAIL("Could not open video source from webcam %i", which);
     }
-    for (int i = 0; i < 10 && !videoCapture.read(frame.image); i++) {
+    // Frame times are on the SDK clock, so they can be used to look up
+    // poses and compared with the other camera
+    source->setClock(ovr_GetTimeInSeconds);
+    bool haveFrame = false;
+    for (int i = 0; i < 10 && !(haveFrame = source->read(frame)); i++) {
       Platform::sleepMillis(10);
     }
-    if (!videoCapture.read(frame.image)) {
+    if (!haveFrame) {
       FAIL("Could not open get first frame from webcam %i", which);
     }
     float aspectRatio = (float)frame.image.cols / (float)frame.image.rows;
@@ -52,35 +66,31 @@ public:
   void stopCapture() {
     stopped = true;
     captureThread.join();
-    videoCapture.release();
-  }
-
-  void set(const CaptureData & newFrame) {
-    std::lock_guard<std::mutex> guard(mutex);
-    frame = newFrame;
-    hasFrame = true;
-  }
-
-  bool get(CaptureData & out) {
-    if (!hasFrame) {
-      return false;
-    }
-    std::lock_guard<std::mutex> guard(mutex);
-    out = frame;
-    hasFrame = false;
-    return true;
+    source.reset();
   }
 
   void captureLoop() {
-    CaptureData captured;
+    Profiler::setThreadName(eye ? "Right capture" : "Left capture");
+    CapturedFrame raw;
+    cv::Mat flipped;
     while (!stopped) {
-      float captureTime = ovr_GetTimeInSeconds();
+      PROFILE_SCOPE("Capture frame");
+      // The timestamp is taken by the source as soon as the frame is
+      // grabbed, since that's what gets compared with the other camera
+      if (!source->read(raw)) {
+        continue;
+      }
+      double captureTime = raw.exposureTime;
+      CaptureData captured;
       ovrTrackingState tracking = ovrHmd_GetTrackingState(hmd, captureTime);
       captured.pose = tracking.HeadPose.ThePose;
 
-      videoCapture.read(captured.image);
-      cv::flip(captured.image.clone(), captured.image, 0);
-      set(captured);
+      cv::flip(raw.image, flipped, 0);
+      // Padded to BGRA, so the render thread can upload it without any
+      // conversion.  Every frame gets a new image, since it may sit in the
+      // frame sync for a while.
+      cv::cvtColor(flipped, captured.image, CV_BGR2BGRA);
+      frameSync->push(eye, captureTime, std::move(captured));
     }
   }
 };
@@ -90,8 +100,9 @@ class WebcamApp : public RiftApp {
 protected:
 
   ProgramPtr program;
-  TexturePtr texture[2];
+  StreamingTexture videoTexture[2];
   ShapeWrapperPtr videoGeometry[2];
+  FrameSync frameSync{ PAIRING_TOLERANCE };
   WebcamHandler captureHandler[2];
   CaptureData captureData[2];
 
@@ -113,26 +124,34 @@ public:
     program = oria::loadProgram(Resource::SHADERS_TEXTURED_VS, Resource::SHADERS_TEXTURED_FS);
 
     for (int i = 0; i < 2; i++) {
-      texture[i] = TexturePtr(new Texture());
-      Context::Bound(TextureTarget::_2D, *texture[i])
-        .MagFilter(TextureMagFilter::Linear)
-        .MinFilter(TextureMinFilter::Linear);
       program = oria::loadProgram(Resource::SHADERS_TEXTURED_VS, Resource::SHADERS_TEXTURED_FS);
-      float aspect = captureHandler[i].startCapture(hmd, CAMERA_FOR_EYE[i]);
+      float aspect = captureHandler[i].startCapture(hmd, frameSync, i, CAMERA_FOR_EYE[i]);
       videoGeometry[i] = oria::loadPlane(program, aspect);
     }
   }
 
   virtual void update() {
+    // Only ever show frames from both cameras that were captured together
+    FrameSync::Pair pair;
+    if (!frameSync.getPair(pair)) {
+      return;
+    }
     for (int i = 0; i < 2; i++) {
-      if (captureHandler[i].get(captureData[i])) {
-        using namespace oglplus;
-        Context::Bound(TextureTarget::_2D, *texture[i])
-          .Image2D(0, PixelDataInternalFormat::RGBA8,
-          captureData[i].image.cols, captureData[i].image.rows, 0,
-          PixelDataFormat::BGR, PixelDataType::UnsignedByte,
-          captureData[i].image.data);
+      captureData[i] = std::move(pair.frames[i].data);
+      const cv::Mat & image = captureData[i].image;
+      glm::uvec2 size(image.cols, image.rows);
+      if (size != videoTexture[i].getSize()) {
+        videoTexture[i].init(size);
       }
+      videoTexture[i].upload(image.data);
+    }
+
+    FrameSync::Stats stats = frameSync.getStats();
+    if (stats.pairs >= 300) {
+      SAY("Stereo skew %s, unmatched frames %d / %d, dropped pairs %d",
+        stats.skew.toString().c_str(), (int)stats.unmatched[0],
+        (int)stats.unmatched[1], (int)stats.droppedPairs);
+      frameSync.resetStats();
     }
   }
 
@@ -151,8 +170,11 @@ public:
       mv.preMultiply(webcamDelta);
 
       mv.translate(glm::vec3(0, 0, -2.75));
-      texture[getCurrentEye()]->Bind(TextureTarget::_2D); 
-      oria::renderGeometry(videoGeometry[getCurrentEye()], program);
+      // Nothing to show until the first frame arrives
+      if (videoTexture[getCurrentEye()].isInitialized()) {
+        videoTexture[getCurrentEye()].getTexture()->Bind(TextureTarget::_2D);
+        oria::renderGeometry(videoGeometry[getCurrentEye()], program);
+      }
     });
     oglplus::DefaultTexture().Bind(TextureTarget::_2D);
   }
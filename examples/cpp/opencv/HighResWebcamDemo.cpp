@@ -1,10 +1,12 @@
 #include "Common.h"
+#include "FrameSource.h"
+#include "CalibrationEngine.h"
 
 #include <opencv2/opencv.hpp>
 #include <thread>
-#include <mutex>
 
 #define CAMERA_PARAMS_FILE "camera.xml"
+#define CAMERA_REMAP_FILE "camera_remap.bin"
 #define CAMERA_WIDTH 1280
 #define CAMERA_HEIGHT 720
 #define CAMERA_HFOV_DEGREES 70.42f
@@ -18,33 +20,38 @@
 template <class T>
 class CaptureHandler {
 private:
-  typedef std::lock_guard<std::mutex> lock_guard;
-
   std::thread captureThread;
-  std::mutex mutex;
+  TripleBuffer<T> buffer;
 
-  bool changed{ false };
   bool stop{ false };
 
   float firstCapture{ -1 };
   int captures{ -1 };
   float cps{ -1 };
 
-  T result;
-
 protected:
 
   bool isStopped() {
     return stop;
   }
 
-  void setResult(const T & newResult) {
+  // The slot the capture thread should fill in next.  It's reused, so
+  // anything allocated in it on a previous frame can be written over.
+  T & getCaptureSlot() {
+    return buffer.getBack();
+  }
+
+  // Hands the filled in capture slot over to the render thread
+  void publishCapture() {
     if (0 == ++captures) {
       firstCapture = Platform::elapsedSeconds();
     }
-    lock_guard guard(mutex);
-    result = newResult;
-    changed = true;
+    buffer.publish();
+  }
+
+  template <typename F>
+  void forEachSlot(F f) {
+    buffer.forEachSlot(f);
   }
 
 public:
@@ -65,9 +72,18 @@ public:
     return (float)captures / elapsed;
   }
 
+  // Captures that were replaced by newer ones before the render thread
+  // picked them up
+  uint64_t getDroppedCaptures() const {
+    return buffer.getDroppedCount();
+  }
+
   void startCapture() {
     stop = false;
-    captureThread = std::thread(&CaptureHandler::captureLoop, this);
+    captureThread = std::thread([this] {
+      Profiler::setThreadName("Capture");
+      captureLoop();
+    });
   }
 
   void stopCapture() {
@@ -75,15 +91,14 @@ public:
     captureThread.join();
   }
 
-  bool getResult(T & outResult) {
-    if (!changed) {
-      return false;
+  // Returns the latest capture if there's been a new one since the last
+  // call, or nullptr otherwise.  The result isn't a copy, it remains valid
+  // until the next call.
+  const T * getResult() {
+    if (!buffer.update()) {
+      return nullptr;
     }
-    lock_guard guard(mutex);
-    changed = false;
-    outResult = result;
-    result = T();
-    return true;
+    return &buffer.getFront();
   }
 
   virtual void captureLoop() = 0;
@@ -91,26 +106,49 @@ public:
 
 struct CaptureData {
   ovrPosef pose;
+  // The time the image was captured, on the ovr_GetTimeInSeconds() clock
+  double captureTime{ 0 };
+  // Time the capture thread spent getting the image out of the camera and
+  // processing it
+  float processingMillis{ 0 };
+  // True if the image was undistorted (and flipped) on the CPU, false if
+  // it's the raw camera image, top row first
+  bool undistorted{ false };
   cv::Mat image;
 };
 
 class WebcamCaptureHandler : public CaptureHandler<CaptureData> {
 private:
-  cv::VideoCapture videoCapture;
+  FrameSourcePtr source;
   ovrHmd hmd;
+  const PoseHistory & poseHistory;
+  cv::Mat cameraMatrix;
+  cv::Mat distCoeffs;
+  cv::Mat optimalMatrix;
+  // Undistorts and flips the image vertically in a single pass
   cv::Mat distortionMap;
   bool hasCalibration{ false };
+  // Undistortion is normally done while rendering, but the CPU path is kept
+  // as a reference
+  std::atomic<bool> cpuUndistort{ false };
+  // The image may be owned by the source, and only valid until the next read
+  CapturedFrame rawFrame;
+  // The raw image padded to BGRA, before CPU undistortion
+  cv::Mat paddedImage;
 
 public:
 
-  WebcamCaptureHandler(ovrHmd hmd) : hmd(hmd) {
-    videoCapture.open(CAMERA_DEVICE);
-    if (!videoCapture.isOpened()) {
+  WebcamCaptureHandler(ovrHmd hmd, const PoseHistory & poseHistory)
+    : hmd(hmd), poseHistory(poseHistory) {
+    // Set FRAME_SOURCE to run from a recording or a generated pattern
+    source = FrameSource::create(Platform::format("%d:%dx%d@60",
+      CAMERA_DEVICE, CAMERA_WIDTH, CAMERA_HEIGHT), "FRAME_SOURCE");
+    if (!source) {
       FAIL("Could not open video source");
     }
+    source->setClock(ovr_GetTimeInSeconds);
+    source->setEstimatedLatency(CAMERA_LATENCY);
 
-    cv::Mat cameraMatrix;
-    cv::Mat distCoeffs;
     cv::Mat map1, map2;
 
     cv::FileStorage fs(CAMERA_PARAMS_FILE, cv::FileStorage::READ); // Read the settings
@@ -119,62 +157,186 @@ public:
       fs["Distortion_Coefficients"] >> distCoeffs;
       hasCalibration = true;
       cv::Size imageSize(CAMERA_WIDTH, CAMERA_HEIGHT);
-      cv::Mat optimalMatrix = getOptimalNewCameraMatrix(
-        cameraMatrix, distCoeffs, imageSize, 1, imageSize, 0);
-      initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), 
-        optimalMatrix, imageSize, CV_16SC2, map1, map2);
-      distortionMap = cv::Mat(imageSize, CV_32FC2);
-      cv::Mat map3(imageSize, CV_32FC1);
-      cv::convertMaps(map1, map2, distortionMap, map3, CV_32FC2);
+      cv::Mat undistortMap;
+      // CalibrateCamera exports the table along with the parameters, which
+      // saves building it here
+      if (!CalibrationEngine::loadRemap(CAMERA_REMAP_FILE, undistortMap, optimalMatrix) ||
+        undistortMap.size() != imageSize) {
+        optimalMatrix = getOptimalNewCameraMatrix(
+          cameraMatrix, distCoeffs, imageSize, 1, imageSize, 0);
+        initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(),
+          optimalMatrix, imageSize, CV_16SC2, map1, map2);
+        cv::Mat map3(imageSize, CV_32FC1);
+        cv::convertMaps(map1, map2, undistortMap, map3, CV_32FC2);
+      }
+      // Looking up the source pixels for the flipped image in a flipped map
+      // saves a separate pass (and copy) to flip the result
+      cv::flip(undistortMap, distortionMap, 0);
     }
 
-    videoCapture.set(CV_CAP_PROP_FRAME_WIDTH, CAMERA_WIDTH);
-    videoCapture.set(CV_CAP_PROP_FRAME_HEIGHT, CAMERA_HEIGHT);
-    videoCapture.set(CV_CAP_PROP_FPS, 60);
+    forEachSlot([&](CaptureData & slot) {
+      slot.image.create(CAMERA_HEIGHT, CAMERA_WIDTH, CV_8UC4);
+    });
   }
-  
+
+  bool isCalibrated() const {
+    return hasCalibration;
+  }
+
+  bool isCpuUndistort() const {
+    return cpuUndistort;
+  }
+
+  void setCpuUndistort(bool enabled) {
+    cpuUndistort = enabled;
+  }
+
+  // Undistorts and flips a raw camera image on the CPU, exactly as the
+  // capture thread does when CPU undistortion is enabled
+  void undistort(const cv::Mat & raw, cv::Mat & result) const {
+    if (hasCalibration) {
+      remap(raw, result, distortionMap, cv::Mat(), cv::INTER_LINEAR);
+    } else {
+      cv::flip(raw, result, 0);
+    }
+  }
+
+  // Builds a lookup table of size.x * size.y samples of the undistortion
+  // map, holding the normalized source texture coordinates for each output
+  // position, with the first row at the top of the image.  The texels are
+  // laid out so that sampling the table with linear filtering at an output
+  // texture coordinate gives the source coordinate at that point, which is
+  // accurate enough because the lens distortion varies slowly.
+  void getUndistortionLookup(const glm::uvec2 & size, std::vector<glm::vec2> & result) const {
+    // The output pixel under the center of each table texel is
+    // (i + 0.5) * step - 0.5, so scale the new camera matrix to produce the
+    // map directly at those positions
+    glm::vec2 step = glm::vec2(CAMERA_WIDTH, CAMERA_HEIGHT) / glm::vec2(size);
+    cv::Mat lookupMatrix = optimalMatrix.clone();
+    lookupMatrix.at<double>(0, 0) /= step.x;
+    lookupMatrix.at<double>(1, 1) /= step.y;
+    lookupMatrix.at<double>(0, 2) = (lookupMatrix.at<double>(0, 2) - step.x / 2.0 + 0.5) / step.x;
+    lookupMatrix.at<double>(1, 2) = (lookupMatrix.at<double>(1, 2) - step.y / 2.0 + 0.5) / step.y;
+
+    cv::Mat mapX, mapY;
+    initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(),
+      lookupMatrix, cv::Size(size.x, size.y), CV_32FC1, mapX, mapY);
+
+    result.resize(size.x * size.y);
+    for (int y = 0; y < (int)size.y; ++y) {
+      for (int x = 0; x < (int)size.x; ++x) {
+        glm::vec2 source(mapX.at<float>(y, x), mapY.at<float>(y, x));
+        result[y * size.x + x] = (source + 0.5f) / glm::vec2(CAMERA_WIDTH, CAMERA_HEIGHT);
+      }
+    }
+  }
+
   virtual void captureLoop() {
     while (!isStopped()) {
-      CaptureData captured;
-      float captureTime = 
-        ovr_GetTimeInSeconds() - CAMERA_LATENCY;
-      ovrTrackingState tracking = 
-        ovrHmd_GetTrackingState(hmd, captureTime);
-      captured.pose = tracking.HeadPose.ThePose;
-
-      if (!videoCapture.grab() ||
-          !videoCapture.retrieve(captured.image)) {
+      PROFILE_SCOPE("Capture frame");
+      if (!source->read(rawFrame)) {
         FAIL("Failed video capture");
       }
 
-      if (hasCalibration) {
-        remap(captured.image.clone(), captured.image, distortionMap, cv::Mat(), cv::INTER_LINEAR);
+      CaptureData & captured = getCaptureSlot();
+      captured.captureTime = rawFrame.exposureTime;
+      // The pose history covers the recent past without a call into the
+      // SDK, which is only needed until it has some samples
+      if (!poseHistory.getPose(captured.captureTime, captured.pose)) {
+        ovrTrackingState tracking = 
+          ovrHmd_GetTrackingState(hmd, captured.captureTime);
+        captured.pose = tracking.HeadPose.ThePose;
       }
 
-      cv::flip(captured.image.clone(), captured.image, 0);
-      setResult(captured);
+      // Everything from here on is CPU work on the capture thread, the read
+      // mostly waits for the camera
+      double start = ovr_GetTimeInSeconds();
+      captured.undistorted = cpuUndistort;
+      // The image is padded to BGRA here, so the texture upload on the
+      // render thread is a straight copy.  Both paths write into the slot's
+      // existing buffer, unless the camera didn't honor the requested
+      // resolution.
+      if (captured.undistorted) {
+        cv::cvtColor(rawFrame.image, paddedImage, CV_BGR2BGRA);
+        undistort(paddedImage, captured.image);
+      } else {
+        cv::cvtColor(rawFrame.image, captured.image, CV_BGR2BGRA);
+      }
+      captured.processingMillis = (float)((ovr_GetTimeInSeconds() - start) * 1000.0);
+      publishCapture();
     }
   }
 };
 
+// Renders the webcam image, either as is or undistorting it while sampling
+// through a lookup texture built from the camera calibration.  The raw
+// camera image is uploaded top row first, so the shader also takes care of
+// flipping it.
+static const char * VIDEO_VERTEX_SHADER =
+  "#version 330\n"
+  "uniform mat4 Projection = mat4(1);\n"
+  "uniform mat4 ModelView = mat4(1);\n"
+  "in vec3 Position;\n"
+  "in vec2 TexCoord;\n"
+  "out vec2 vTexCoord;\n"
+  "void main() {\n"
+  "  gl_Position = Projection * ModelView * vec4(Position, 1);\n"
+  "  vTexCoord = TexCoord;\n"
+  "}\n";
+
+static const char * VIDEO_FRAGMENT_SHADER =
+  "#version 330\n"
+  "uniform sampler2D Camera;\n"
+  "uniform sampler2D UndistortLookup;\n"
+  // 0 for an image that's already been undistorted and flipped, 1 to only
+  // flip the raw image, 2 to undistort it as well
+  "uniform int Mode = 0;\n"
+  "in vec2 vTexCoord;\n"
+  "out vec4 FragColor;\n"
+  "void main() {\n"
+  "  vec2 coord = vTexCoord;\n"
+  "  if (Mode > 0) {\n"
+  "    coord.y = 1.0 - coord.y;\n"
+  "  }\n"
+  "  if (Mode > 1) {\n"
+  "    coord = texture(UndistortLookup, coord).xy;\n"
+  // Matches the black border cv::remap produces
+  "    if (any(lessThan(coord, vec2(0))) || any(greaterThan(coord, vec2(1)))) {\n"
+  "      FragColor = vec4(0, 0, 0, 1);\n"
+  "      return;\n"
+  "    }\n"
+  "  }\n"
+  "  FragColor = vec4(texture(Camera, coord).rgb, 1);\n"
+  "}\n";
+
+// One lookup texel per 8x8 block of camera pixels
+#define UNDISTORT_LOOKUP_STEP 8
+
 class WebcamApp : public RiftApp
 {
 protected:
+  PoseHistory poseHistory;
   WebcamCaptureHandler captureHandler;
-  CaptureData captureData;
+  // Points into the capture handler's buffer, only valid until the next
+  // call to getResult()
+  const CaptureData * captureData{ nullptr };
+  TimingStats captureStats;
 
-  TexturePtr texture;
+  StreamingTexture videoTexture;
+  TexturePtr undistortLookup;
   ShapeWrapperPtr videoGeometry;
   ProgramPtr videoRenderProgram;
 
 public:
 
-  WebcamApp() : captureHandler(hmd) {
+  WebcamApp() : captureHandler(hmd, poseHistory) {
+    poseHistory.start(hmd);
     captureHandler.startCapture();
   }
 
   virtual ~WebcamApp() {
     captureHandler.stopCapture();
+    poseHistory.stop();
   }
 
 void initGl() {
@@ -184,59 +346,165 @@ void initGl() {
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-  videoRenderProgram = oria::loadProgram(
-    Resource::SHADERS_TEXTURED_VS,
-    Resource::SHADERS_TEXTURED_FS);
+  oria::compileProgram(videoRenderProgram, VIDEO_VERTEX_SHADER, VIDEO_FRAGMENT_SHADER);
+  if (!videoRenderProgram) {
+    FAIL("Unable to build the video shader");
+  }
 
   using namespace oglplus;
-  texture = TexturePtr(new Texture());
-  Context::Bound(TextureTarget::_2D, *texture)
-    .MagFilter(TextureMagFilter::Linear)
-    .MinFilter(TextureMinFilter::Linear);
+  videoTexture.init(glm::uvec2(CAMERA_WIDTH, CAMERA_HEIGHT));
+
+  if (captureHandler.isCalibrated()) {
+    glm::uvec2 lookupSize = 
+      glm::uvec2(CAMERA_WIDTH, CAMERA_HEIGHT) / glm::uvec2(UNDISTORT_LOOKUP_STEP);
+    std::vector<glm::vec2> lookup;
+    captureHandler.getUndistortionLookup(lookupSize, lookup);
+    undistortLookup = TexturePtr(new Texture());
+    Context::Bound(TextureTarget::_2D, *undistortLookup)
+      .MagFilter(TextureMagFilter::Linear)
+      .MinFilter(TextureMinFilter::Linear)
+      .WrapS(TextureWrap::ClampToEdge)
+      .WrapT(TextureWrap::ClampToEdge)
+      .Image2D(0, PixelDataInternalFormat::RG32F,
+        lookupSize.x, lookupSize.y, 0,
+        PixelDataFormat::RG, PixelDataType::Float,
+        &lookup[0]);
+  }
   DefaultTexture().Bind(TextureTarget::_2D);
 
   videoGeometry = oria::loadPlane(videoRenderProgram, CAMERA_ASPECT);
 }
 
+virtual void onKey(int key, int scancode, int action, int mods) {
+  if (GLFW_PRESS == action) {
+    switch (key) {
+    case GLFW_KEY_U:
+      // Switch between undistorting on the GPU and the CPU, to compare the
+      // capture thread cost
+      captureHandler.setCpuUndistort(!captureHandler.isCpuUndistort());
+      captureStats.reset();
+      return;
+
+    case GLFW_KEY_V:
+      validateUndistortion();
+      return;
+    }
+  }
+  RiftApp::onKey(key, scancode, action, mods);
+}
+
 virtual void update() {
-  if (captureHandler.getResult(captureData)) {
-    using namespace oglplus;
-    Context::Bound(TextureTarget::_2D, *texture)
-      .Image2D(0, PixelDataInternalFormat::RGBA8,
-             captureData.image.cols, captureData.image.rows, 0,
-             PixelDataFormat::BGR, PixelDataType::UnsignedByte,
-             captureData.image.data);
-    DefaultTexture().Bind(TextureTarget::_2D);
+  const CaptureData * latest = captureHandler.getResult();
+  if (latest) {
+    captureData = latest;
+    captureStats.add(captureData->processingMillis);
+    glm::uvec2 imageSize(captureData->image.cols, captureData->image.rows);
+    if (imageSize != videoTexture.getSize()) {
+      videoTexture.init(imageSize);
+    }
+    videoTexture.upload(captureData->image.data);
   }
 }
 
+void renderVideo(ShapeWrapperPtr & geometry) {
+  using namespace oglplus;
+  int mode = 0;
+  if (!captureData->undistorted) {
+    mode = undistortLookup ? 2 : 1;
+  }
+  Texture::Active(1);
+  if (undistortLookup) {
+    undistortLookup->Bind(Texture::Target::_2D);
+  }
+  Texture::Active(0);
+  videoTexture.getTexture()->Bind(Texture::Target::_2D);
+  oria::renderGeometry(geometry, videoRenderProgram, [&]{
+    Uniform<GLint>(*videoRenderProgram, "Camera").Set(0);
+    Uniform<GLint>(*videoRenderProgram, "UndistortLookup").Set(1);
+    Uniform<GLint>(*videoRenderProgram, "Mode").Set(mode);
+  });
+  Texture::Active(1);
+  DefaultTexture().Bind(Texture::Target::_2D);
+  Texture::Active(0);
+  DefaultTexture().Bind(Texture::Target::_2D);
+}
+
+// Undistorts the current raw frame on the GPU, reads it back and compares
+// it to the output of cv::remap for the same frame
+void validateUndistortion() {
+  if (!captureData || captureData->undistorted || !undistortLookup) {
+    SAY("Validation needs a calibrated camera and GPU undistortion");
+    return;
+  }
+
+  cv::Mat reference;
+  captureHandler.undistort(captureData->image, reference);
+
+  glm::uvec2 size(CAMERA_WIDTH, CAMERA_HEIGHT);
+  FramebufferWrapper framebuffer;
+  framebuffer.init(size);
+  cv::Mat result(CAMERA_HEIGHT, CAMERA_WIDTH, CV_8UC4);
+  GLboolean blend = glIsEnabled(GL_BLEND);
+  glDisable(GL_BLEND);
+  ShapeWrapperPtr quad = oria::loadPlane(videoRenderProgram, 1.0f);
+  framebuffer.Bound([&] {
+    oria::viewport(size);
+    Stacks::withIdentity([&] {
+      renderVideo(quad);
+    });
+    // Rows come back bottom first, which matches the flipped CPU result
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size.x, size.y, GL_BGRA, GL_UNSIGNED_BYTE, result.data);
+  });
+  if (blend) {
+    glEnable(GL_BLEND);
+  }
+
+  // The remap border is transparent, while the shader's is opaque
+  cv::cvtColor(reference, reference, CV_BGRA2BGR);
+  cv::cvtColor(result, result, CV_BGRA2BGR);
+  cv::Mat difference;
+  cv::absdiff(reference, result, difference);
+  double maxError;
+  cv::minMaxLoc(difference.reshape(1), nullptr, &maxError);
+  cv::Scalar meanError = cv::mean(difference);
+  SAY("GPU undistortion vs cv::remap: PSNR %0.2f dB, mean error %0.3f, max error %d",
+    cv::PSNR(reference, result),
+    (meanError[0] + meanError[1] + meanError[2]) / 3.0,
+    (int)maxError);
+}
+
 virtual void renderScene() {
   glClear(GL_DEPTH_BUFFER_BIT);
   oria::renderSkybox(Resource::IMAGES_SKY_CITY_XNEG_PNG);
   MatrixStack & mv = Stacks::modelview();
 
-  mv.withPush([&]{
+  if (captureData) mv.withPush([&]{
     mv.identity();
 
     glm::quat eyePose = ovr::toGlm(getEyePose().Orientation);
-    glm::quat webcamPose = ovr::toGlm(captureData.pose.Orientation);
+    glm::quat webcamPose = ovr::toGlm(captureData->pose.Orientation);
     glm::mat4 webcamDelta = glm::mat4_cast(glm::inverse(eyePose) * webcamPose);
 
     mv.preMultiply(webcamDelta);
     mv.translate(glm::vec3(0, 0, -IMAGE_DISTANCE));
 
-    texture->Bind(oglplus::Texture::Target::_2D);
-    oria::renderGeometry(videoGeometry, videoRenderProgram);
-    oglplus::DefaultTexture().Bind(oglplus::Texture::Target::_2D);
+    renderVideo(videoGeometry);
   });
 
   std::string message = Platform::format(
     "OpenGL FPS: %0.2f\n"
-    "Vidcap FPS: %0.2f\n",
-    fps, captureHandler.getCapturesPerSecond());
+    "Vidcap FPS: %0.2f\n"
+    "Dropped: %d\n"
+    "Capture CPU: %0.2f ms (%s undistort)\n"
+    "Upload: %0.2f ms\n",
+    fps, captureHandler.getCapturesPerSecond(),
+    (int)captureHandler.getDroppedCaptures(),
+    captureStats.getAverage(),
+    captureHandler.isCpuUndistort() ? "CPU" : "GPU",
+    videoTexture.getUploadStats().getAverage());
   GlfwApp::renderStringAt(message, glm::vec2(-0.5f, 0.5f));
 }
 };
 
 RUN_OVR_APP(WebcamApp);
-
@@ -144,18 +144,30 @@ void QRiftWindow::drawFrame() {
 }
 
 void QRiftWindow::renderLoop() {
+  Profiler::setThreadName("Render");
   m_context->makeCurrent(this);
   setup();
 
   while (!shuttingDown) {
-    if (QCoreApplication::hasPendingEvents())
-      QCoreApplication::processEvents();
-    tasks.drainTaskQueue();
+    PROFILE_SCOPE("Frame");
+    {
+      PROFILE_SCOPE("Process events");
+      if (QCoreApplication::hasPendingEvents())
+        QCoreApplication::processEvents();
+    }
+    {
+      PROFILE_SCOPE("Render thread tasks");
+      tasks.drainTaskQueue();
+    }
 
     m_context->makeCurrent(this);
     drawFrame();
+    debugOutput.drain();
 #ifndef USE_RIFT
-    m_context->swapBuffers(this);
+    {
+      PROFILE_SCOPE("Swap buffers");
+      m_context->swapBuffers(this);
+    }
     static RateCounter rateCounter;
     rateCounter.increment();
     if (rateCounter.elapsed() > 1.0f) {
@@ -165,6 +177,8 @@ void QRiftWindow::renderLoop() {
     }
 #endif
   }
+  debugOutput.drain();
+  debugOutput.report();
   m_context->doneCurrent();
   m_context->moveToThread(QApplication::instance()->thread());
 }
@@ -175,17 +189,8 @@ void QRiftWindow::setup() {
   glewInit();
 
   GLenum error = glGetError();
-  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-  GLuint unusedIds = 0;
-  if (glDebugMessageCallback) {
-    glDebugMessageCallback(oria::debugCallback, this);
-    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
-      0, &unusedIds, true);
-  } else if (glDebugMessageCallbackARB) {
-    glDebugMessageCallbackARB(oria::debugCallback, this);
-    glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
-      0, &unusedIds, true);
-  }
+  debugOutput.install();
+  GpuMemory::initBudget();
   error = glGetError();
 #ifdef USE_RIFT
   initializeRiftRendering();
@@ -30,6 +30,7 @@ class QRiftWindow :
   bool shuttingDown{ false };
   LambdaThread renderThread;
   TaskQueueWrapper tasks;
+  DebugOutput debugOutput;
   QOpenGLContext * m_context;
 
 protected:
@@ -176,6 +176,7 @@ QOffscreenUi::~QOffscreenUi() {
   // underlying platform window may already be destroyed. To avoid all the trouble, use
   // another surface that is valid for sure.
   m_context->makeCurrent(m_offscreenSurface);
+  releaseFboPool();
 
   // Delete the render control first since it will free the scenegraph resources.
   // Destroy the QQuickWindow only afterwards.
@@ -194,6 +195,8 @@ QOffscreenUi::~QOffscreenUi() {
 
 
 void QOffscreenUi::setup(const QSize & size, QOpenGLContext * shareContext) {
+  // The UI is rendered on the thread that sets it up
+  Profiler::setThreadName("UI");
   m_uiSize = oria::qt::toGlm(size);
 
   QSurfaceFormat format;
@@ -251,7 +254,73 @@ void QOffscreenUi::setup(const QSize & size, QOpenGLContext * shareContext) {
   // Initialize the render control and our OpenGL resources.
   m_context->makeCurrent(m_offscreenSurface);
   m_renderControl->initialize(m_context);
+  allocateFboPool();
+}
+
+void QOffscreenUi::allocateFboPool() {
+  GpuMemory::Owner memoryOwner("Offscreen UI");
+  uvec2 size(m_uiSize);
+  for (PooledFbo & pooled : m_fboPool) {
+    glGenTextures(1, &pooled.texture);
+    glBindTexture(GL_TEXTURE_2D, pooled.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (GLEW_ARB_texture_storage) {
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size.x, size.y);
+    } else {
+      // Still only allocated the once, just not immutable
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GpuMemory::textureAllocated(pooled.texture, GL_RGBA8, size);
+
+    // Qt Quick may need a depth and stencil buffer
+    glGenRenderbuffers(1, &pooled.depthStencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, pooled.depthStencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    GpuMemory::allocated(GpuMemory::RENDERBUFFER, pooled.depthStencil,
+      GpuMemory::imageBytes(GL_DEPTH24_STENCIL8, size));
+
+    glGenFramebuffers(1, &pooled.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, pooled.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pooled.texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, pooled.depthStencil);
+    if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER)) {
+      qWarning() << "Offscreen UI framebuffer is incomplete";
+    }
 
+    m_fboMap[pooled.texture] = &pooled;
+    m_readyFboQueue.push_back(&pooled);
+  }
+  QOpenGLFramebufferObject::bindDefault();
+}
+
+void QOffscreenUi::releaseFboPool() {
+  collectReturnedTextures();
+  for (PooledFbo & pooled : m_fboPool) {
+    if (pooled.fence) {
+      glDeleteSync(pooled.fence);
+    }
+    if (pooled.fbo) {
+      glDeleteFramebuffers(1, &pooled.fbo);
+    }
+    if (pooled.depthStencil) {
+      GpuMemory::released(GpuMemory::RENDERBUFFER, pooled.depthStencil);
+      glDeleteRenderbuffers(1, &pooled.depthStencil);
+    }
+    if (pooled.texture) {
+      GpuMemory::released(GpuMemory::TEXTURE, pooled.texture);
+      glDeleteTextures(1, &pooled.texture);
+    }
+    pooled = PooledFbo();
+  }
+  m_fboMap.clear();
+  m_fboLocks.clear();
+  m_readyFboQueue.clear();
 }
 
 QQmlContext * QOffscreenUi::qmlContext() {
@@ -315,7 +384,7 @@ void QOffscreenUi::run() {
 void QOffscreenUi::lockTexture(int texture) {
   Q_ASSERT(m_fboMap.count(texture));
   if (!m_fboLocks.count(texture)) {
-    Q_ASSERT(m_readyFboQueue.front()->texture() == texture);
+    Q_ASSERT(m_readyFboQueue.front()->texture == (GLuint)texture);
     m_readyFboQueue.pop_front();
     m_fboLocks[texture] = 1;
   } else {
@@ -328,30 +397,76 @@ void QOffscreenUi::releaseTexture(int texture) {
   Q_ASSERT(m_fboLocks.count(texture));
   int newLockCount = --m_fboLocks[texture];
   if (!newLockCount) {
-    m_readyFboQueue.push_back(m_fboMap[texture].data());
+    m_readyFboQueue.push_back(m_fboMap[texture]);
     m_fboLocks.remove(texture);
   }
 }
 
-QOpenGLFramebufferObject* QOffscreenUi::getReadyFbo() {
-  QOpenGLFramebufferObject* result = nullptr;
+void QOffscreenUi::returnTexture(GLuint texture, GLsync fence) {
+  std::unique_lock<std::mutex> lock(m_returnLock);
+  m_returnedTextures.push_back(ReturnedTexture(texture, fence));
+}
+
+// Takes back the textures other contexts are done with, keeping their
+// fences until the framebuffer is next rendered into
+void QOffscreenUi::collectReturnedTextures() {
+  std::vector<ReturnedTexture> returned;
+  {
+    std::unique_lock<std::mutex> lock(m_returnLock);
+    returned.swap(m_returnedTextures);
+  }
+  for (const ReturnedTexture & entry : returned) {
+    PooledFbo * pooled = m_fboMap.value(entry.first, nullptr);
+    if (!pooled) {
+      // Only after the pool was released
+      if (entry.second) {
+        glDeleteSync(entry.second);
+      }
+      continue;
+    }
+    if (pooled->fence) {
+      glDeleteSync(pooled->fence);
+    }
+    pooled->fence = entry.second;
+    releaseTexture(entry.first);
+  }
+}
+
+QOffscreenUi::PooledFbo* QOffscreenUi::getReadyFbo() {
+  collectReturnedTextures();
   if (m_readyFboQueue.empty()) {
-    qDebug() << "Building new offscreen FBO number " << m_fboMap.size() + 1;
-    result = new QOpenGLFramebufferObject(QSize(m_uiSize.x, m_uiSize.y), 
-        QOpenGLFramebufferObject::CombinedDepthStencil);
-    m_fboMap[result->texture()] = QSharedPointer<QOpenGLFramebufferObject>(result);
-    m_readyFboQueue.push_back(result);
+    return nullptr;
+  }
+  PooledFbo * result = m_readyFboQueue.front();
+  if (result->fence) {
+    // Have the GPU wait for the other context to finish reading the
+    // texture, without blocking here
+    glWaitSync(result->fence, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync(result->fence);
+    result->fence = 0;
   }
-  return m_readyFboQueue.front();
+  return result;
 }
 
 void QOffscreenUi::updateQuick() {
   if (m_paused) {
     return;
   }
+  PROFILE_SCOPE("Render UI");
   if (!m_context->makeCurrent(m_offscreenSurface))
     return;
 
+  PooledFbo* fbo;
+  {
+    std::unique_lock<std::mutex> Lock(renderLock);
+    fbo = getReadyFbo();
+  }
+  if (!fbo) {
+    // Every framebuffer is still in use, so try again shortly
+    requestRender();
+    return;
+  }
+
   // Polish, synchronize and render the next frame (into our fbo).  In this example
   // everything happens on the same thread and therefore all three steps are performed
   // in succession from here. In a threaded setup the render() call would happen on a
@@ -362,21 +477,14 @@ void QOffscreenUi::updateQuick() {
     m_polish = false;
   }
 
-  QOpenGLFramebufferObject* fbo;
-  
-  {
-    std::unique_lock<std::mutex> Lock(renderLock);
-    fbo = getReadyFbo();
-  }
-
-  m_quickWindow->setRenderTarget(fbo);
-  fbo->bind();
+  m_quickWindow->setRenderTarget(fbo->fbo, QSize(m_uiSize.x, m_uiSize.y));
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo->fbo);
   m_renderControl->render();
   m_quickWindow->resetOpenGLState();
   QOpenGLFramebufferObject::bindDefault();
   glFinish();
 
-  emit textureUpdated(fbo->texture());
+  emit textureUpdated(fbo->texture);
 }
 
 QPointF QOffscreenUi::mapWindowToUi(const QPointF & p) {
@@ -462,7 +570,7 @@ static ImagePtr loadImageWithAlpha(const std::vector<uint8_t> & data, bool flip)
 
 TexturePtr loadCursor(Resource res) {
   using namespace oglplus;
-  TexturePtr texture(new Texture());
+  TexturePtr texture = oria::createTexture();
   Context::Bound(TextureTarget::_2D, *texture)
     .MagFilter(TextureMagFilter::Linear)
     .MinFilter(TextureMinFilter::Linear);
@@ -471,6 +579,7 @@ TexturePtr loadCursor(Resource res) {
   // FIXME detect alignment properly, test on both OpenCV and LibPNG
   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   Texture::Storage2D(TextureTarget::_2D, 1, PixelDataInternalFormat::RGBA8, image->Width() * 2, image->Height() * 2);
+  GpuMemory::textureAllocated(*texture, GL_RGBA8, uvec2(image->Width() * 2, image->Height() * 2));
   {
     size_t size = image->Width() * 2 * image->Height() * 2 * 4;
     uint8_t * empty = new uint8_t[size]; memset(empty, 0, size);
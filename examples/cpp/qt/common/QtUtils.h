@@ -164,15 +164,41 @@ public slots:
     void lockTexture(int texture);
     void releaseTexture(int texture);
 
+public:
+    // Hands back a texture from textureUpdated that was used in another
+    // context, with a fence that's signaled once that use is done.  Safe to
+    // call from any thread.  The fence is deleted by the UI.
+    void returnTexture(GLuint texture, GLsync fence);
+
 signals:
     void textureUpdated(int texture);
 
 private:
-    QMap<int, QSharedPointer<QOpenGLFramebufferObject>> m_fboMap;
+    // The UI renders into a fixed pool of framebuffers, allocated up front
+    // with immutable texture storage.  If every one of them is still in use
+    // the UI waits for one to come back rather than making another.
+    static const int POOL_SIZE = 4;
+
+    struct PooledFbo {
+        GLuint fbo{ 0 };
+        GLuint texture{ 0 };
+        GLuint depthStencil{ 0 };
+        // Signaled once the last user of the texture is done with it
+        GLsync fence{ 0 };
+    };
+    typedef std::pair<GLuint, GLsync> ReturnedTexture;
+
+    PooledFbo m_fboPool[POOL_SIZE];
+    QMap<int, PooledFbo*> m_fboMap;
     QMap<int, int> m_fboLocks;
-    QQueue<QOpenGLFramebufferObject*> m_readyFboQueue;
-  
-    QOpenGLFramebufferObject* getReadyFbo();
+    QQueue<PooledFbo*> m_readyFboQueue;
+    std::mutex m_returnLock;
+    std::vector<ReturnedTexture> m_returnedTextures;
+
+    void allocateFboPool();
+    void releaseFboPool();
+    void collectReturnedTextures();
+    PooledFbo* getReadyFbo();
 
 public:
     QOpenGLContext *m_context{ new QOpenGLContext };
@@ -21,6 +21,7 @@ limitations under the License.
 #include "Application.h"
 #include "Globals.h"
 #include "MainWindow.h"
+#include "PresetProfiler.h"
 
 
 QSharedPointer<QFile> LOG_FILE;
@@ -48,14 +49,31 @@ ShadertoyApp::ShadertoyApp(int argc, char ** argv) : QApplication(argc, argv) {
     }
     ORIGINAL_MESSAGE_HANDLER = qInstallMessageHandler(MessageOutput);
 
+    // Profiling is headless, so don't bring up the Rift window
+    profiling = arguments().contains("--profile");
+    if (profiling) {
+        return;
+    }
+
     mainWindow = new MainWindow();
     mainWindow->start();
     mainWindow->requestActivate();
 }
 
+int ShadertoyApp::run() {
+    if (profiling) {
+        return PresetProfiler::run(arguments());
+    }
+    return exec();
+}
+
 void ShadertoyApp::destroyWindow() {
+    if (!mainWindow) {
+        return;
+    }
     mainWindow->stop();
     delete mainWindow;
+    mainWindow = nullptr;
 }
 
 void ShadertoyApp::MessageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg) {
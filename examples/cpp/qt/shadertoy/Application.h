@@ -24,12 +24,16 @@ limitations under the License.
 class ShadertoyApp : public QApplication {
   Q_OBJECT
   QWidget desktopWindow;
-  MainWindow * mainWindow;
+  MainWindow * mainWindow{ nullptr };
+  bool profiling{ false };
 public:
   ShadertoyApp(int argc, char ** argv);
   virtual ~ShadertoyApp();
   void destroyWindow();
 
+  // Runs the event loop, or when started with --profile, the preset profiler
+  int run();
+
 private:
   void setupDesktopWindow();
   static void MessageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg);
@@ -0,0 +1,275 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "QtCommon.h"
+#include "AudioChannel.h"
+
+using namespace oglplus;
+
+// How often the worker produces a new spectrum
+static const int ANALYSIS_INTERVAL_MS = 10;
+
+static uint16_t readLe16(const uint8_t * p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLe32(const uint8_t * p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Reads a RIFF WAVE file containing 8, 16, 24 bit integer or 32 bit float
+// PCM data, mixed down to a single channel
+bool AudioChannel::loadWav(const QString & path, std::vector<float> & outSamples, int & outSampleRate) {
+    QByteArray data = readFileToByteArray(path);
+    const uint8_t * begin = (const uint8_t *)data.constData();
+    const uint8_t * end = begin + data.size();
+    if (data.size() < 12 || memcmp(begin, "RIFF", 4) || memcmp(begin + 8, "WAVE", 4)) {
+        qWarning() << "Not a WAV file " << path;
+        return false;
+    }
+
+    uint16_t format = 0, channels = 0, bitsPerSample = 0;
+    uint32_t sampleRate = 0;
+    const uint8_t * pcm = nullptr;
+    size_t pcmBytes = 0;
+    for (const uint8_t * chunk = begin + 12; chunk + 8 <= end;) {
+        uint32_t chunkSize = readLe32(chunk + 4);
+        const uint8_t * body = chunk + 8;
+        if (chunkSize > (size_t)(end - body)) {
+            chunkSize = (uint32_t)(end - body);
+        }
+        if (!memcmp(chunk, "fmt ", 4) && chunkSize >= 16) {
+            format = readLe16(body);
+            channels = readLe16(body + 2);
+            sampleRate = readLe32(body + 4);
+            bitsPerSample = readLe16(body + 14);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format at the start of the sub-format GUID
+            if (0xFFFE == format && chunkSize >= 26) {
+                format = readLe16(body + 24);
+            }
+        } else if (!memcmp(chunk, "data", 4)) {
+            pcm = body;
+            pcmBytes = chunkSize;
+        }
+        // Chunks are word aligned
+        chunk = body + chunkSize + (chunkSize & 1);
+    }
+
+    bool integer = (1 == format) && (8 == bitsPerSample || 16 == bitsPerSample || 24 == bitsPerSample);
+    bool floating = (3 == format) && (32 == bitsPerSample);
+    if (!pcm || !channels || !sampleRate || !(integer || floating)) {
+        qWarning() << "Unsupported WAV format " << format << " (" << bitsPerSample << " bits) in " << path;
+        return false;
+    }
+
+    size_t bytesPerSample = bitsPerSample / 8;
+    size_t frameCount = pcmBytes / (bytesPerSample * channels);
+    outSamples.resize(frameCount);
+    outSampleRate = sampleRate;
+    const uint8_t * p = pcm;
+    for (size_t i = 0; i < frameCount; ++i) {
+        float sum = 0;
+        for (size_t c = 0; c < channels; ++c, p += bytesPerSample) {
+            switch (bitsPerSample) {
+            case 8:
+                sum += ((float)p[0] - 128.0f) / 128.0f;
+                break;
+            case 16:
+                sum += (float)(int16_t)readLe16(p) / 32768.0f;
+                break;
+            case 24:
+                sum += (float)((int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8) / 8388608.0f;
+                break;
+            case 32: {
+                uint32_t bits = readLe32(p);
+                float value;
+                memcpy(&value, &bits, sizeof(float));
+                sum += value;
+                break;
+            }
+            }
+        }
+        outSamples[i] = sum / channels;
+    }
+    return !outSamples.empty();
+}
+
+AudioOutputDevice::AudioOutputDevice(const std::vector<float> & samples, int sampleRate) {
+    pcm.resize((int)(samples.size() * sizeof(int16_t)));
+    int16_t * out = (int16_t *)pcm.data();
+    for (size_t i = 0; i < samples.size(); ++i) {
+        out[i] = (int16_t)glm::clamp(samples[i] * 32767.0f, -32768.0f, 32767.0f);
+    }
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(1);
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+}
+
+AudioOutputDevice::~AudioOutputDevice() {
+    if (output) {
+        output->stop();
+    }
+}
+
+void AudioOutputDevice::play() {
+    QAudioDeviceInfo info = QAudioDeviceInfo::defaultOutputDevice();
+    if (info.isNull() || !info.isFormatSupported(format)) {
+        qWarning() << "No audio output for " << format.sampleRate() << "Hz mono, music will be silent";
+        return;
+    }
+    open(QIODevice::ReadOnly);
+    output = new QAudioOutput(info, format, this);
+    output->start(this);
+    if (QAudio::NoError != output->error()) {
+        qWarning() << "Unable to start audio output, error " << output->error();
+        return;
+    }
+    bufferedBytes = output->bufferSize();
+    playing = true;
+}
+
+double AudioOutputDevice::getPosition() const {
+    qint64 played = std::max<qint64>(0, bytesRead - bufferedBytes);
+    return (double)played / (sizeof(int16_t) * format.sampleRate());
+}
+
+qint64 AudioOutputDevice::readData(char * data, qint64 maxSize) {
+    if (pcm.isEmpty()) {
+        return 0;
+    }
+    // Loops the track for as long as the output wants more
+    qint64 offset = bytesRead % pcm.size();
+    qint64 written = 0;
+    while (written < maxSize) {
+        qint64 count = std::min(maxSize - written, pcm.size() - offset);
+        memcpy(data + written, pcm.constData() + offset, count);
+        written += count;
+        offset = 0;
+    }
+    bytesRead += written;
+    return written;
+}
+
+QtAudioSink::~QtAudioSink() {
+    if (device) {
+        // After the queued play(), since posted events are delivered in order
+        device->deleteLater();
+    }
+}
+
+void QtAudioSink::start(const std::vector<float> & samples, int sampleRate) {
+    clock.start(samples, sampleRate);
+    device = new AudioOutputDevice(samples, sampleRate);
+    device->moveToThread(QCoreApplication::instance()->thread());
+    QMetaObject::invokeMethod(device, "play", Qt::QueuedConnection);
+}
+
+double QtAudioSink::getPosition() const {
+    if (device && device->isPlaying()) {
+        return device->getPosition();
+    }
+    return clock.getPosition();
+}
+
+AudioChannel::AudioChannel(const QString & path, AudioSinkPtr sink) : sink(sink) {
+    QString wavPath = path;
+    if (!wavPath.endsWith(".wav", Qt::CaseInsensitive)) {
+        QFileInfo info(path);
+        wavPath = info.path() + "/" + info.completeBaseName() + ".wav";
+    }
+    if (!loadWav(wavPath, samples, sampleRate)) {
+        qWarning() << "Unable to load audio for " << path;
+        return;
+    }
+
+    pending.fill(0);
+
+    texture = oria::createTexture();
+    Context::Bound(TextureTarget::_2D, *texture)
+        .MagFilter(TextureMagFilter::Linear)
+        .MinFilter(TextureMinFilter::Linear)
+        .WrapS(TextureWrap::ClampToEdge)
+        .WrapT(TextureWrap::ClampToEdge);
+    Texture::Storage2D(TextureTarget::_2D, 1, PixelDataInternalFormat::R8, BINS, 2);
+    GpuMemory::textureAllocated(*texture, GL_R8, uvec2(BINS, 2));
+    DefaultTexture().Bind(TextureTarget::_2D);
+
+    valid = true;
+    thread = std::thread([&] {
+        run();
+    });
+}
+
+AudioChannel::~AudioChannel() {
+    if (!valid) {
+        return;
+    }
+    quit = true;
+    condition.notify_all();
+    thread.join();
+    qDebug() << "Audio FFT cost: " << fftStats.toString().c_str();
+}
+
+void AudioChannel::run() {
+    Profiler::setThreadName("Audio analysis");
+    sink->start(samples, sampleRate);
+    TextureData result;
+    while (!quit) {
+        double position = sink->getPosition();
+        size_t samplePosition = (size_t)(position * sampleRate) % samples.size();
+        fftStats.time([&] {
+            PROFILE_SCOPE("Audio FFT");
+            spectrum.analyze(samples, samplePosition, result);
+        });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        pending = result;
+        pendingTime = (float)samplePosition / sampleRate;
+        dirty = true;
+        condition.wait_for(lock, std::chrono::milliseconds(ANALYSIS_INTERVAL_MS), [&] {
+            return (bool)quit;
+        });
+    }
+}
+
+void AudioChannel::update() {
+    if (!valid) {
+        return;
+    }
+    PROFILE_SCOPE("Update audio channel");
+
+    TextureData latest;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!dirty) {
+            return;
+        }
+        latest = pending;
+        currentTime = pendingTime;
+        dirty = false;
+    }
+
+    texture->Bind(TextureTarget::_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BINS, 2, GL_RED, GL_UNSIGNED_BYTE, &latest[0]);
+    DefaultTexture().Bind(TextureTarget::_2D);
+}
@@ -0,0 +1,152 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <QAudioOutput>
+#include "MediaChannel.h"
+#include "AudioSpectrum.h"
+
+// Feeds a track to the default audio output, looping it, as 16 bit mono PCM.
+// Lives on the application thread, since QAudioOutput needs an event loop.
+class AudioOutputDevice : public QIODevice {
+    Q_OBJECT
+
+public:
+    AudioOutputDevice(const std::vector<float> & samples, int sampleRate);
+    virtual ~AudioOutputDevice();
+
+    bool isPlaying() const {
+        return playing;
+    }
+
+    // What's been handed to the device less what's still in its buffer
+    double getPosition() const;
+
+    virtual bool isSequential() const {
+        return true;
+    }
+
+public slots:
+    void play();
+
+protected:
+    virtual qint64 readData(char * data, qint64 maxSize);
+    virtual qint64 writeData(const char * data, qint64 maxSize) {
+        return -1;
+    }
+
+private:
+    QByteArray pcm;
+    QAudioFormat format;
+    QAudioOutput * output{ nullptr };
+    std::atomic<bool> playing{ false };
+    std::atomic<qint64> bytesRead{ 0 };
+    std::atomic<int> bufferedBytes{ 0 };
+};
+
+// Plays the track through the default audio output.  If there's no device,
+// or it can't play the track's format, the track is played silently, with
+// the same clock as a NullAudioSink.
+class QtAudioSink : public AudioSink {
+    AudioOutputDevice * device{ nullptr };
+    NullAudioSink clock;
+
+public:
+    virtual ~QtAudioSink();
+    virtual void start(const std::vector<float> & samples, int sampleRate);
+    virtual double getPosition() const;
+};
+
+// Exposes a piece of music to a shader in the same form as shadertoy: a
+// 512x2 single channel texture with the frequency spectrum in the first row
+// and the waveform in the second.
+//
+// Only uncompressed WAV files are decoded.  Shadertoy's own tracks are mp3
+// files, so for those a .wav file with the same base name is looked for
+// alongside.
+//
+// The spectrum is computed on a worker thread, the render thread only
+// uploads the latest result.
+class AudioChannel : public MediaChannel {
+public:
+    static const size_t BINS = AudioSpectrum::BINS;
+
+    AudioChannel(const QString & path, AudioSinkPtr sink = AudioSinkPtr(new QtAudioSink()));
+    virtual ~AudioChannel();
+
+    virtual void update();
+
+    virtual bool isValid() const {
+        return valid;
+    }
+
+    virtual TexturePtr getTexture() const {
+        return texture;
+    }
+
+    virtual vec3 getResolution() const {
+        return vec3(BINS, 2, 1);
+    }
+
+    // Playback position within the track
+    virtual float getTime() const {
+        return currentTime;
+    }
+
+    int getSampleRate() const {
+        return sampleRate;
+    }
+
+    // Worker thread cost of windowing, transforming and converting one block
+    // of samples.  Only safe to read once the channel has been destroyed, or
+    // from the worker thread.
+    const TimingStats & getFftStats() const {
+        return fftStats;
+    }
+
+    static bool loadWav(const QString & path, std::vector<float> & outSamples, int & outSampleRate);
+
+private:
+    typedef AudioSpectrum::TextureData TextureData;
+
+    bool valid{ false };
+    int sampleRate{ 44100 };
+    float currentTime{ 0 };
+    std::vector<float> samples;
+    AudioSinkPtr sink;
+    TexturePtr texture;
+
+    // Analysis state, only touched by the worker thread
+    AudioSpectrum spectrum;
+    TimingStats fftStats;
+
+    // Handoff between the worker and the render thread
+    std::mutex mutex;
+    std::condition_variable condition;
+    TextureData pending;
+    float pendingTime{ 0 };
+    bool dirty{ false };
+
+    std::thread thread;
+    std::atomic<bool> quit{ false };
+
+    void run();
+};
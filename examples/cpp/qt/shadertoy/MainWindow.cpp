@@ -33,6 +33,11 @@ static const float INV_ROOT_2 = 1.0f / ROOT_2;
 static uvec2 UI_SIZE(1280, 720);
 static float UI_ASPECT = aspect(vec2(UI_SIZE));
 static float UI_INVERSE_ASPECT = 1.0f / UI_ASPECT;
+// Matches the size of the Walls array in walls.vs
+static const int WALL_COUNT = 4;
+// The mouse sprite's size, relative to the UI
+static const float CURSOR_SCALE = 0.1f;
+static const char * UI_UPDATE_NAMES[] = { "idle", "cursor", "full" };
 
 struct Preset {
     const Resource res;
@@ -40,47 +45,11 @@ struct Preset {
     Preset(Resource res, const char * name) : res(res), name(name) {};
 };
 
-const QStringList PRESETS({
-    ":/shaders/default.xml",
-    ":/shaders/4df3DS.json",
-    ":/shaders/4dfGzs.json",
-    ":/shaders/4djGWR.json",
-    ":/shaders/4ds3zn.json",
-    ":/shaders/4dXGRM_flying_steel_cubes.xml",
-    // ":/shaders/4sBGD1.json",
-    // ":/shaders/4slGzn.json",
-    ":/shaders/4sX3R2.json", // Monster
-    ":/shaders/4sXGRM_oceanic.xml",
-    ":/shaders/4tXGDn.json", // Morphing
-    //":/shaders/ld23DG_crazy.xml",
-    ":/shaders/ld2GRz.json", // meta-balls
-    // ":/shaders/ldfGzr.json",
-    // ":/shaders/ldj3Dm.json", // fish swimming
-    ":/shaders/ldl3zr_mobius_balls.xml",
-    // ":/shaders/ldSGRW.json",
-    // ":/shaders/lsl3W2.json",
-    ":/shaders/lss3WS_relentless.xml",
-    // ":/shaders/lts3Wn.json",
-    ":/shaders/MdX3Rr.json", // elevated
-    // ":/shaders/MsBGRh.json",
-    // ":/shaders/MsSGD1_hand_drawn_sketch.xml",
-    ":/shaders/MsXGz4.json", // cubemap
-    ":/shaders/MsXGzM.json", // voronoi rocks
-    // ":/shaders/MtfGR8_snowglobe.xml",
-    // ":/shaders/XdBSzd.json",
-    ":/shaders/Xlf3D8.json", // sci-fi
-    ":/shaders/XsBSRG_morning_city.xml",
-    ":/shaders/XsjXR1.json", // worms
-    ":/shaders/XslXW2.json", // mechanical (2D)
-    // ":/shaders/XsSSRW.json"
-});
-
 MainWindow::MainWindow() {
     // Fixes an occasional crash caused by a race condition between the Rift
     // render thread and the UI thread, triggered when Rift swapbuffers overlaps
     // with the UI thread binding a new FBO (specifically, generating a texture
     // for the FBO.
-    // Perhaps I should just create N FBOs and have the UI object iterate over them
     {
         QString configLocation = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
         configPath = QDir(configLocation);
@@ -88,13 +57,13 @@ MainWindow::MainWindow() {
     }
 
     fetcher.fetchNetworkShaders();
+    presetCosts.load();
 
-    connect(&timer, &QTimer::timeout, this, &MainWindow::onTimer);
-    timer.start(100);
     setupOffscreenUi();
     onLoadPreset(0);
     Platform::addShutdownHook([&] {
         shaderFramebuffer.reset();
+        upsampler.release();
         uiProgram.reset();
         uiShape.reset();
         uiFramebuffer.reset();
@@ -103,6 +72,16 @@ MainWindow::MainWindow() {
         uiFramebuffer.reset();
         planeProgram.reset();
         plane.reset();
+        wallProgram.reset();
+        wallMesh.reset();
+        wallFramebuffer.reset();
+        for (GpuTimer & timer : uiCompositeTimers) {
+            timer.release();
+        }
+        if (lastUiSync) {
+            glDeleteSync(lastUiSync);
+            lastUiSync = 0;
+        }
     });
 }
 
@@ -132,6 +111,11 @@ void MainWindow::setup() {
         Resource::SHADERS_TEXTURED_FS);
     plane = oria::loadPlane(planeProgram, 1.0);
 
+    oria::compileProgram(wallProgram,
+        readFileToString(":/shaders/walls.vs").toStdString(),
+        readFileToString(":/shaders/walls.fs").toStdString());
+    wallMesh = oria::loadPlaneMesh(wallProgram, 1.0);
+
     mouseTexture = loadCursor(Resource::IMAGES_CURSOR_PNG);
     mouseShape = oria::loadPlane(uiProgram, UI_INVERSE_ASPECT);
 
@@ -140,6 +124,7 @@ void MainWindow::setup() {
 
     shaderFramebuffer = FramebufferWrapperPtr(new FramebufferWrapper());
     shaderFramebuffer->init(textureSize());
+    upsampler.setup();
 
     DefaultFramebuffer().Bind(Framebuffer::Target::Draw);
 }
@@ -153,7 +138,7 @@ void MainWindow::setupOffscreenUi() {
     uiWindow->setup(QSize(UI_SIZE.x, UI_SIZE.y), context());
     {
         QStringList dataList;
-        foreach(const QString path, PRESETS) {
+        foreach(const QString path, shadertoy::PRESETS) {
             shadertoy::Shader shader = shadertoy::loadShaderFile(path);
             dataList.append(shader.name);
         }
@@ -247,6 +232,10 @@ void MainWindow::setupOffscreenUi() {
         setItemText("fps", QString().sprintf("%0.0f", fps));
     });
 
+    connect(this, &MainWindow::textureResolutionUpdated, this, [&](float newRes) {
+        setItemText("res", QString().sprintf("%0.2f", newRes));
+    });
+
     setItemText("res", QString().sprintf("%0.2f", texRes));
     uiWindow->setSourceSize(size());
 }
@@ -307,7 +296,7 @@ void MainWindow::onToggleUi() {
 }
 
 void MainWindow::onLoadNextPreset() {
-    static const int PRESETS_SIZE = PRESETS.size();
+    static const int PRESETS_SIZE = shadertoy::PRESETS.size();
     int newPreset = (activePresetIndex + 1) % PRESETS_SIZE;
     onLoadPreset(newPreset);
 }
@@ -317,14 +306,24 @@ void MainWindow::onFontSizeChanged(int newSize) {
 }
 
 void MainWindow::onLoadPreviousPreset() {
-    static const int PRESETS_SIZE = PRESETS.size();
+    static const int PRESETS_SIZE = shadertoy::PRESETS.size();
     int newPreset = (activePresetIndex + PRESETS_SIZE - 1) % PRESETS_SIZE;
     onLoadPreset(newPreset);
 }
 
 void MainWindow::onLoadPreset(int index) {
     activePresetIndex = index;
-    loadShader(shadertoy::loadShaderFile(PRESETS.at(index)));
+    QString path = shadertoy::PRESETS.at(index);
+    loadShader(shadertoy::loadShaderFile(path));
+    // The eye texture size is only known on the render thread
+    queueRenderThreadTask([&, path] {
+        float newRes = presetCosts.scaleFor(path, uvec2(textureSize()));
+        if (newRes > 0 && newRes != texRes) {
+            qDebug() << "Using profiled texture resolution " << newRes << " for " << path;
+            texRes = newRes;
+            emit textureResolutionUpdated(newRes);
+        }
+    });
 }
 
 void MainWindow::onLoadShaderFile(const QString & shaderPath) {
@@ -353,8 +352,8 @@ void MainWindow::onNewShaderHighlighted(const QString & shaderPath) {
 }
 
 void MainWindow::onNewPresetHighlighted(int presetId) {
-    if (-1 != presetId && presetId < PRESETS.size()) {
-        QString path = PRESETS.at(presetId);
+    if (-1 != presetId && presetId < shadertoy::PRESETS.size()) {
+        QString path = shadertoy::PRESETS.at(presetId);
         QString previewPath = path;
         previewPath.replace(QRegularExpression("\\.(json|xml)$"), ".jpg");
         setItemProperty("previewImage", "source", "qrc" + previewPath);
@@ -398,6 +397,8 @@ void MainWindow::onShaderSourceChanged(const QString & shaderSource) {
     queueRenderThreadTask([&, shaderSource] {
         renderer.setShaderSourceInternal(shaderSource);
         renderer.updateUniforms();
+        upsampleFactor = shadertoy::parseUpsampleFactor(shaderSource);
+        upsampler.reset();
     });
 }
 
@@ -463,24 +464,6 @@ void MainWindow::onShutdown() {
     QApplication::instance()->quit();
 }
 
-void MainWindow::onTimer() {
-    TextureDeleteQueue tempTextureDeleteQueue;
-
-    // Scope the lock tightly
-    {
-        Lock lock(textureLock);
-        if (!textureDeleteQueue.empty()) {
-            tempTextureDeleteQueue.swap(textureDeleteQueue);
-        }
-    }
-
-    if (!tempTextureDeleteQueue.empty()) {
-        std::for_each(tempTextureDeleteQueue.begin(), tempTextureDeleteQueue.end(), [&](int usedTexture) {
-            uiWindow->releaseTexture(usedTexture);
-        });
-    }
-}
-
 void MainWindow::loadShader(const shadertoy::Shader & shader) {
     assert(!shader.fragmentSource.isEmpty());
     activeShader = shader;
@@ -496,6 +479,8 @@ void MainWindow::loadShader(const shadertoy::Shader & shader) {
     queueRenderThreadTask([&, shader] {
         renderer.setShaderInternal(shader);
         renderer.updateUniforms();
+        upsampleFactor = shader.upsample;
+        upsampler.reset();
     });
 }
 
@@ -525,6 +510,39 @@ bool MainWindow::event(QEvent * e) {
         return true;
       }
     }
+#endif
+    if (e->type() == QEvent::KeyPress && Qt::Key_F12 == static_cast<QKeyEvent*>(e)->key()) {
+        Profiler::dumpToFile();
+        return true;
+    }
+    if (e->type() == QEvent::KeyPress && Qt::Key_F10 == static_cast<QKeyEvent*>(e)->key()) {
+        // The driver queries need the rendering context
+        queueRenderThreadTask([&] {
+            GpuMemory::report();
+        });
+        return true;
+    }
+    if (e->type() == QEvent::KeyPress && Qt::Key_F9 == static_cast<QKeyEvent*>(e)->key()) {
+        // Logs the GPU time of each shader pass since the last report
+        queueRenderThreadTask([&] {
+            for (auto & pass : renderer.getPassStats()) {
+                qDebug() << pass.first << pass.second.toString().c_str();
+            }
+            renderer.resetPassStats();
+            for (int i = 0; i < UI_UPDATE_COUNT; ++i) {
+                qDebug() << "UI composite," << UI_UPDATE_NAMES[i] << uiCompositeTimers[i].getStats().toString().c_str();
+                uiCompositeTimers[i].reset();
+            }
+        });
+        return true;
+    }
+#ifdef USE_RIFT
+    if (e->type() == QEvent::KeyPress && Qt::Key_F11 == static_cast<QKeyEvent*>(e)->key()) {
+        queueRenderThreadTask([&] {
+            latencyOverlay = !latencyOverlay;
+        });
+        return true;
+    }
 #endif
     if (uiWindow) {
         if (uiWindow->interceptEvent(e)) {
@@ -544,86 +562,63 @@ void MainWindow::resizeEvent(QResizeEvent *e) {
 // Rendering functionality
 //
 void MainWindow::perFrameRender() {
+    {
+        PROFILE_SCOPE("Render shared buffers");
+        // At the same resolution the eyes will render at
+        uvec2 size = renderSize();
+        if (upsampleFactor > 1 && upsampler.isReady()) {
+            size = glm::max(uvec2(1), size / uvec2(upsampleFactor));
+        }
+        renderer.setResolution(vec2(size));
+        renderer.renderSharedBuffers();
+    }
+
+    PROFILE_SCOPE("Composite UI");
     Context::Enable(Capability::Blend);
     Context::BlendFunc(BlendFunction::SrcAlpha, BlendFunction::OneMinusSrcAlpha);
     Context::Disable(Capability::ScissorTest);
     Context::Disable(Capability::DepthTest);
     Context::Disable(Capability::CullFace);
     if (uiVisible) {
-        static GLuint lastUiTexture = 0;
-        static GLsync lastUiSync;
-        GLuint currentUiTexture = uiTexture.exchange(0);
-        if (0 == currentUiTexture) {
-            currentUiTexture = lastUiTexture;
-        } else {
-            // If the texture has changed, push it into the trash bin for
-            // deletion once it's finished rendering
-            if (lastUiTexture) {
-                textureTrash.push(SyncPair(lastUiTexture, lastUiSync));
-            }
-            lastUiTexture = currentUiTexture;
-        }
-        MatrixStack & mv = Stacks::modelview();
-        if (currentUiTexture) {
-            Texture::Active(0);
-            // Composite the UI image and the mouse sprite
-            uiFramebuffer->Bound([&] {
-                Context::Clear().ColorBuffer();
-                oria::viewport(UI_SIZE);
-                // Clear out the projection and modelview here.
-                Stacks::withIdentity([&] {
-                    glBindTexture(GL_TEXTURE_2D, currentUiTexture);
-                    oria::renderGeometry(plane, uiProgram);
-
-                    // Render the mouse sprite on the UI
-                    QSizeF mp = uiWindow->getMousePosition().load();
-                    mv.translate(vec3(mp.width(), mp.height(), 0.0f));
-                    mv.scale(vec3(0.1f));
-                    mouseTexture->Bind(Texture::Target::_2D);
-                    oria::renderGeometry(mouseShape, uiProgram);
-                });
-            });
-            lastUiSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-        }
-    }
-
-    TextureDeleteQueue tempTextureDeleteQueue;
-    while (!textureTrash.empty()) {
-        SyncPair & top = textureTrash.front();
-        GLuint & texture = top.first;
-        GLsync & sync = top.second;
-        GLenum result = glClientWaitSync(sync, 0, 0);
-        if (GL_ALREADY_SIGNALED == result || GL_CONDITION_SATISFIED == result) {
-            tempTextureDeleteQueue.push_back(texture);
-            textureTrash.pop();
-        } else {
-            break;
-        }
-    }
-
-    if (!tempTextureDeleteQueue.empty()) {
-        Lock lock(textureLock);
-        textureDeleteQueue.insert(textureDeleteQueue.end(),
-            tempTextureDeleteQueue.begin(), tempTextureDeleteQueue.end());
+        compositeUi(uiTexture.exchange(0));
     }
 }
 
 void MainWindow::perEyeRender() {
-    // Render the shadertoy effect into a framebuffer, possibly at a
-    // smaller resolution than recommended
-    shaderFramebuffer->Bound([&] {
-        Context::Clear().ColorBuffer();
-        oria::viewport(renderSize());
-        renderer.setResolution(renderSize());
 #ifdef USE_RIFT
-        renderer.setPosition(ovr::toGlm(getEyePose().Position) * eyeOffsetScale);
+    renderer.setPosition(ovr::toGlm(getEyePose().Position) * eyeOffsetScale);
+    int eye = getCurrentEye();
+#else
+    int eye = 0;
 #endif
-        renderer.render();
-    });
+    renderer.setEye(eye);
+    bool upsampling = upsampleFactor > 1 && upsampler.isReady();
+    {
+        PROFILE_SCOPE("Render shader");
+        if (upsampling) {
+            upsampler.render(eye, uvec2(textureSize()), renderSize(), upsampleFactor, [&](const uvec2 & lowSize) {
+                renderer.setResolution(vec2(lowSize));
+                renderer.render();
+            });
+        } else {
+            // Render the shadertoy effect into a framebuffer, possibly at a
+            // smaller resolution than recommended
+            shaderFramebuffer->Bound([&] {
+                Context::Clear().ColorBuffer();
+                oria::viewport(renderSize());
+                renderer.setResolution(renderSize());
+                renderer.render();
+            });
+        }
+    }
     oria::viewport(textureSize());
 
     // Now re-render the shader output to the screen.
-    shaderFramebuffer->BindColor(Texture::Target::_2D);
+    if (upsampling) {
+        upsampler.bindResult(eye);
+    } else {
+        shaderFramebuffer->BindColor(Texture::Target::_2D);
+    }
 #ifdef USE_RIFT
     if (activeShader.vrEnabled) {
 #endif
@@ -636,26 +631,7 @@ void MainWindow::perEyeRender() {
 #ifdef USE_RIFT
     } else {
         // In 2D mode, we want to render it as a window behind the UI
-        Context::Clear().ColorBuffer();
-        MatrixStack & mv = Stacks::modelview();
-        static vec3 scale = vec3(3.0f, 3.0f / (textureSize().x / textureSize().y), 3.0f);
-        static vec3 trans = vec3(0, 0, -3.5);
-        static mat4 rot = glm::rotate(mat4(), PI / 2.0f, Vectors::Y_AXIS);
-
-
-        for (int i = 0; i < 4; ++i) {
-            mv.withPush([&] {
-                for (int j = 0; j < i; ++j) {
-                    mv.postMultiply(rot);
-                }
-                mv.translate(trans);
-                mv.scale(scale);
-                oria::renderGeometry(plane, planeProgram, LambdaList({ [&] {
-                    Uniform<vec2>(*planeProgram, "UvMultiplier").Set(vec2(texRes));
-                } }));
-                oria::renderGeometry(plane, planeProgram);
-            });
-        }
+        renderWalls();
     }
 #endif
 
@@ -672,6 +648,146 @@ void MainWindow::perEyeRender() {
     }
 }
 
+// The pixels of the UI composite the mouse sprite covers, with a pixel to
+// spare for the filtering at its edges
+static ivec4 cursorRect(const vec2 & mousePosition) {
+    vec2 halfSize = vec2(UI_INVERSE_ASPECT, 1.0f) * CURSOR_SCALE;
+    vec2 size = vec2(UI_SIZE);
+    vec2 lower = (mousePosition - halfSize + 1.0f) / 2.0f * size;
+    vec2 upper = (mousePosition + halfSize + 1.0f) / 2.0f * size;
+    ivec2 minimum = glm::max(ivec2(glm::floor(lower)) - 1, ivec2(0));
+    ivec2 maximum = glm::min(ivec2(glm::ceil(upper)) + 1, ivec2(UI_SIZE));
+    return ivec4(minimum, glm::max(maximum - minimum, ivec2(0)));
+}
+
+void MainWindow::compositeUi(GLuint newUiTexture) {
+    if (newUiTexture) {
+        // If the texture has changed, hand the old one back to the UI, which
+        // waits on the fence before rendering into it again
+        if (lastUiTexture) {
+            uiWindow->returnTexture(lastUiTexture, lastUiSync);
+            lastUiSync = 0;
+        }
+        lastUiTexture = newUiTexture;
+    }
+    if (!lastUiTexture) {
+        return;
+    }
+
+    QSizeF mp = uiWindow->getMousePosition().load();
+    vec2 mousePosition(mp.width(), mp.height());
+    // The composite in uiFramebuffer is kept between frames.  A new UI
+    // image means redrawing all of it, but while only the mouse moves,
+    // only the pixels under the old and new cursor need to change.
+    UiUpdate update = UI_IDLE;
+    if (newUiTexture) {
+        update = UI_FULL;
+    } else if (mousePosition != compositedMousePosition) {
+        update = UI_CURSOR;
+    }
+
+    uiCompositeTimers[update].time([&] {
+        if (UI_IDLE == update) {
+            return;
+        }
+        Texture::Active(0);
+        uiFramebuffer->Bound([&] {
+            oria::viewport(UI_SIZE);
+            if (UI_FULL == update) {
+                Context::Clear().ColorBuffer();
+                renderUi(mousePosition);
+                return;
+            }
+            Context::Enable(Capability::ScissorTest);
+            ivec4 rects[] = { cursorRect(compositedMousePosition), cursorRect(mousePosition) };
+            for (const ivec4 & rect : rects) {
+                glScissor(rect.x, rect.y, rect.z, rect.w);
+                Context::Clear().ColorBuffer();
+                renderUi(mousePosition);
+            }
+            Context::Disable(Capability::ScissorTest);
+        });
+    });
+    if (UI_IDLE != update) {
+        compositedMousePosition = mousePosition;
+        // Only the latest draw matters, since it's after the earlier ones
+        if (lastUiSync) {
+            glDeleteSync(lastUiSync);
+        }
+        lastUiSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+// Draws the UI image with the mouse sprite over it
+void MainWindow::renderUi(const vec2 & mousePosition) {
+    MatrixStack & mv = Stacks::modelview();
+    // Clear out the projection and modelview here.
+    Stacks::withIdentity([&] {
+        glBindTexture(GL_TEXTURE_2D, lastUiTexture);
+        oria::renderGeometry(plane, uiProgram);
+
+        // Render the mouse sprite on the UI
+        mv.translate(vec3(mousePosition, 0.0f));
+        mv.scale(vec3(CURSOR_SCALE));
+        mouseTexture->Bind(Texture::Target::_2D);
+        oria::renderGeometry(mouseShape, uiProgram);
+    });
+}
+
+void MainWindow::renderWalls() {
+    PROFILE_SCOPE("Render walls");
+    // Copy the rendered part of the shader output into a mipmapped texture
+    // once, rather than sampling it per wall, since the walls are mostly
+    // seen at an angle or from a distance
+    uvec2 size = renderSize();
+    if (!wallFramebuffer || wallFramebuffer->size != size) {
+        wallFramebuffer = FramebufferWrapperPtr(new FramebufferWrapper());
+        wallFramebuffer->useDepth = false;
+        wallFramebuffer->mipmaps = true;
+        wallFramebuffer->init(size);
+    }
+    // Copied as is, so it's blended the same way as before
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    Context::Disable(Capability::Blend);
+    wallFramebuffer->Bound([&] {
+        Stacks::withIdentity([&] {
+            oria::renderGeometry(plane, planeProgram, LambdaList({ [&] {
+                Uniform<vec2>(*planeProgram, "UvMultiplier").Set(vec2(texRes));
+            } }));
+        });
+    });
+    if (blend) {
+        Context::Enable(Capability::Blend);
+    }
+    oria::viewport(textureSize());
+    wallFramebuffer->generateMipmaps();
+
+    Context::Clear().ColorBuffer();
+    static vec3 scale = vec3(3.0f, 3.0f / (textureSize().x / textureSize().y), 3.0f);
+    static vec3 trans = vec3(0, 0, -3.5);
+    static mat4 rot = glm::rotate(mat4(), PI / 2.0f, Vectors::Y_AXIS);
+
+    // Only the walls in the frustum are drawn, usually one or two of them
+    mat4 clipFromWorld = Stacks::projection().top() * Stacks::modelview().top();
+    mat4 walls[WALL_COUNT];
+    int visibleWalls = 0;
+    mat4 wall;
+    for (int i = 0; i < WALL_COUNT; ++i) {
+        mat4 transform = glm::scale(glm::translate(wall, trans), scale);
+        if (oria::intersectsFrustum(clipFromWorld * transform, vec3(-1, -1, 0), vec3(1, 1, 0))) {
+            walls[visibleWalls++] = transform;
+        }
+        wall = wall * rot;
+    }
+    if (!visibleWalls) {
+        return;
+    }
+    oria::renderGeometryInstanced(wallMesh, wallProgram, visibleWalls, [&] {
+        glUniformMatrix4fv(glGetUniformLocation(GetName(*wallProgram), "Walls"),
+            visibleWalls, GL_FALSE, glm::value_ptr(walls[0]));
+    });
+}
+
 void MainWindow::onSixDofMotion(const vec3 & tr, const vec3 & mo) {
     SAY("%f, %f, %f", tr.x, tr.y, tr.z);
     queueRenderThreadTask([&, tr, mo] {
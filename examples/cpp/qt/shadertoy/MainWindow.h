@@ -23,16 +23,13 @@ limitations under the License.
 #include "Shadertoy.h"
 #include "Renderer.h"
 #include "Fetcher.h"
+#include "PresetProfiler.h"
+#include "TemporalUpsampler.h"
 
 class MainWindow : public QRiftWindow {
   Q_OBJECT
 
   typedef std::atomic<GLuint> AtomicGlTexture;
-  typedef std::pair<GLuint, GLsync> SyncPair;
-  typedef std::queue<SyncPair> TextureTrashcan;
-  typedef std::vector<GLuint> TextureDeleteQueue;
-  typedef std::mutex Mutex;
-  typedef std::unique_lock<Mutex> Lock;
 
   // A cache of all the input textures available
   QDir configPath;
@@ -46,6 +43,9 @@ class MainWindow : public QRiftWindow {
   GlslHighlighter highlighter;
 
   int activePresetIndex{ 0 };
+  // Measured preset costs, if the profiler has been run, used to pick
+  // the texture resolution as presets are loaded
+  PresetCostReport presetCosts;
   float savedEyePosScale{ 1.0f };
 
   //////////////////////////////////////////////////////////////////////////////
@@ -62,6 +62,11 @@ class MainWindow : public QRiftWindow {
   // This allows us to have a clear UI regardless of the shader performance
   FramebufferWrapperPtr shaderFramebuffer;
 
+  // For shaders that opt in, renders the effect at reduced resolution and
+  // reconstructs it over several frames.  Only touched on the render thread.
+  TemporalUpsampler upsampler;
+  int upsampleFactor{ 1 };
+
   // The current mouse position as reported by the main thread
   bool uiVisible{ false };
   QVariantAnimation animation;
@@ -70,10 +75,22 @@ class MainWindow : public QRiftWindow {
 
   // A wrapper for passing the UI texture from the app to the widget
   AtomicGlTexture uiTexture{ 0 };
-  TextureTrashcan textureTrash;
-  TextureDeleteQueue textureDeleteQueue;
-  Mutex textureLock;
-  QTimer timer;
+
+  // The UI texture and mouse position in the current uiFramebuffer
+  // composite, and a fence for the last draw that read the texture.  The
+  // texture goes back to the UI's pool with the fence when it's replaced.
+  // Render thread only.
+  GLuint lastUiTexture{ 0 };
+  GLsync lastUiSync{ 0 };
+  vec2 compositedMousePosition;
+  // How much of the composite a frame had to redraw, for measuring it
+  enum UiUpdate {
+    UI_IDLE,
+    UI_CURSOR,
+    UI_FULL,
+    UI_UPDATE_COUNT
+  };
+  GpuTimer uiCompositeTimers[UI_UPDATE_COUNT];
 
   // GLSL and geometry for the UI
   ProgramPtr uiProgram;
@@ -88,6 +105,12 @@ class MainWindow : public QRiftWindow {
   ProgramPtr planeProgram;
   ShapeWrapperPtr plane;
 
+  // In 2D mode the shader output is shown on walls around the viewer,
+  // sampled from a mipmapped copy of it, with one instanced draw
+  ProgramPtr wallProgram;
+  MeshPtr wallMesh;
+  FramebufferWrapperPtr wallFramebuffer;
+
   // Measure the FPS for use in dynamic scaling
   GLuint exchangeUiTexture(GLuint newUiTexture) {
     return uiTexture.exchange(newUiTexture);
@@ -129,6 +152,12 @@ private:
   //
   void perFrameRender();
   void perEyeRender();
+  // Draws the walls that are in view, with the shader output bound
+  void renderWalls();
+  // Brings the UI composite up to date with the latest UI texture and
+  // mouse position, redrawing as little of it as possible
+  void compositeUi(GLuint newUiTexture);
+  void renderUi(const vec2 & mousePosition);
 
 
 private slots:
@@ -152,9 +181,9 @@ private slots:
   void onEpfModeChanged(bool checked);
   void onRestartShader();
   void onShutdown();
-  void onTimer();
   void onSixDofMotion(const vec3 & tr, const vec3 & mo);
 
 signals:
   void fpsUpdated(float);
+  void textureResolutionUpdated(float);
 };
@@ -0,0 +1,40 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+// A shadertoy input channel whose content changes over time, such as a video
+// or a piece of music.  Implementations produce their data on a worker thread
+// and are given a chance to update their texture once per frame on the render
+// thread.
+class MediaChannel {
+public:
+    virtual ~MediaChannel() {}
+
+    // Must be called on the render thread, with the GL context current
+    virtual void update() = 0;
+    virtual bool isValid() const = 0;
+    virtual TexturePtr getTexture() const = 0;
+    // The value reported to the shader via iChannelResolution
+    virtual vec3 getResolution() const = 0;
+    // The playback position, in seconds, reported via iChannelTime
+    virtual float getTime() const = 0;
+};
+
+typedef std::shared_ptr<MediaChannel> MediaChannelPtr;
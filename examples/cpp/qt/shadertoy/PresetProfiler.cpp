@@ -0,0 +1,451 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "QtCommon.h"
+#include "Globals.h"
+#include "Shadertoy.h"
+#include "Renderer.h"
+#include "TemporalUpsampler.h"
+#include "PresetProfiler.h"
+
+#include <QCommandLineParser>
+#include <QOffscreenSurface>
+#include <QJsonDocument>
+
+using namespace oglplus;
+
+static const char * REPORT_FILE = "preset_costs.json";
+
+// The rate the animation is stepped at when comparing renders, and how far
+// the view turns each frame, roughly a slow head turn
+static const float COMPARISON_FRAME_TIME = 1.0f / 75.0f;
+static const float COMPARISON_YAW_STEP = 0.01f;
+
+static const float MIN_SCALE = 0.1f;
+static const float MAX_SCALE = 1.0f;
+
+float PresetProfiler::maxScale(float millisPerMegapixel, const uvec2 & eyeSize, float budgetMillis) {
+    float megapixels = 2.0f * eyeSize.x * eyeSize.y / 1.0e6f;
+    if (millisPerMegapixel <= 0 || megapixels <= 0) {
+        return MAX_SCALE;
+    }
+    // Pixel count, and so cost, goes with the square of the scale
+    float scale = sqrt(budgetMillis / (millisPerMegapixel * megapixels));
+    return std::max(MIN_SCALE, std::min(MAX_SCALE, scale));
+}
+
+QString PresetProfiler::defaultReportPath() {
+    return CONFIG_DIR.absoluteFilePath(REPORT_FILE);
+}
+
+PresetProfiler::PresetProfiler(const Settings & settings) : settings(settings) {
+    if (this->settings.output.isEmpty()) {
+        this->settings.output = defaultReportPath();
+    }
+}
+
+std::vector<PresetProfiler::Result> PresetProfiler::profile(const QStringList & presets) {
+    std::vector<Result> results;
+
+    Renderer renderer;
+    renderer.setup(QOpenGLContext::currentContext());
+    renderer.setResolution(vec2(settings.resolution));
+
+    FramebufferWrapper framebuffer(settings.resolution);
+    GLuint query = 0;
+    glGenQueries(1, &query);
+
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    float megapixels = settings.resolution.x * settings.resolution.y / 1.0e6f;
+
+    foreach(const QString & path, presets) {
+        Result result;
+        result.path = path;
+        shadertoy::Shader shader = shadertoy::loadShaderFile(path);
+        result.name = shader.name;
+        qDebug() << "Profiling " << path;
+
+        for (int i = 0; i < shadertoy::MAX_CHANNELS; ++i) {
+            renderer.setChannelTextureInternal(i, shader.channelTypes[i], shader.channelTextures[i]);
+        }
+        renderer.getCompileStats().reset();
+        renderer.getLinkStats().reset();
+        if (!renderer.setShaderSourceInternal(shader.fragmentSource) || !renderer.setBuffersInternal(shader)) {
+            qWarning() << "Failed to build " << path;
+            results.push_back(result);
+            continue;
+        }
+        renderer.resetPassStats();
+        result.compileMillis = renderer.getCompileStats().getAverage();
+        result.linkMillis = renderer.getLinkStats().getAverage();
+
+        TimingStats gpuStats;
+        framebuffer.Bound([&] {
+            Stacks::withPush(pr, mv, [&] {
+                pr.top() = glm::perspective(PI / 2.0f, aspect(vec2(settings.resolution)), 0.01f, 10000.0f);
+                int totalFrames = settings.warmupFrames + settings.frames;
+                for (int frame = 0; frame < totalFrames; ++frame) {
+                    // Sweep the view around the horizon, since many effects
+                    // cost very different amounts looking at the sky or the ground
+                    float yaw = 2.0f * PI * frame / totalFrames;
+                    mv.identity().rotate(yaw, Vectors::UP);
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+                    renderer.renderSharedBuffers();
+                    renderer.render();
+                    glEndQuery(GL_TIME_ELAPSED);
+                    GLuint64 nanoseconds = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+                    if (frame >= settings.warmupFrames) {
+                        gpuStats.add(nanoseconds / 1.0e6);
+                    }
+                }
+            });
+        });
+
+        result.valid = true;
+        result.gpuMillis = gpuStats.getAverage();
+        result.gpuMaxMillis = gpuStats.getMax();
+        result.millisPerMegapixel = result.gpuMillis / megapixels;
+        result.maxScale = maxScale(result.millisPerMegapixel, settings.eyeSize, settings.budgetMillis);
+        qDebug() << "\tGPU " << gpuStats.toString().c_str()
+            << ", compile " << result.compileMillis << " ms, link " << result.linkMillis << " ms";
+        auto passStats = renderer.getPassStats();
+        if (passStats.size() > 1) {
+            for (auto & pass : passStats) {
+                result.passMillis.push_back({ pass.first, (float)pass.second.getAverage() });
+                qDebug() << "\t\t" << pass.first << " " << pass.second.toString().c_str();
+            }
+        }
+
+        int factor = settings.upsample > 1 ? settings.upsample : shader.upsample;
+        if (factor > 1) {
+            compareUpsampled(renderer, factor, result);
+        }
+        if (renderer.hasSharedBuffers()) {
+            compareShared(renderer, result);
+        }
+        results.push_back(result);
+    }
+
+    glDeleteQueries(1, &query);
+    // The renderer registers hooks to release its GL resources, so they have
+    // to run while it still exists
+    Platform::runShutdownHooks();
+
+    std::stable_sort(results.begin(), results.end(), [](const Result & a, const Result & b) {
+        if (a.valid != b.valid) {
+            return a.valid;
+        }
+        return a.gpuMillis > b.gpuMillis;
+    });
+    return results;
+}
+
+static std::vector<uint8_t> readColor(GLuint texture, const uvec2 & size) {
+    std::vector<uint8_t> pixels(size.x * size.y * 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return pixels;
+}
+
+static GLuint boundTexture() {
+    GLint texture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+    return texture;
+}
+
+// Renders the same frames at full resolution and through the temporal
+// upsampler, with the animation time pinned so the two are comparable
+void PresetProfiler::compareUpsampled(Renderer & renderer, int factor, Result & result) {
+    TemporalUpsampler upsampler;
+    upsampler.setup();
+    if (!upsampler.isReady()) {
+        return;
+    }
+
+    FramebufferWrapper reference(settings.resolution);
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    TimingStats gpuStats;
+    double squaredError = 0;
+    size_t samples = 0;
+
+    Stacks::withPush(pr, mv, [&] {
+        pr.top() = glm::perspective(PI / 2.0f, aspect(vec2(settings.resolution)), 0.01f, 10000.0f);
+        int totalFrames = settings.warmupFrames + settings.frames;
+        for (int frame = 0; frame < totalFrames; ++frame) {
+            renderer.setFixedTime(frame * COMPARISON_FRAME_TIME);
+            mv.identity().rotate(frame * COMPARISON_YAW_STEP, Vectors::UP);
+            renderer.renderSharedBuffers();
+
+            reference.Bound([&] {
+                renderer.setResolution(vec2(settings.resolution));
+                renderer.render();
+            });
+
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            upsampler.render(0, settings.resolution, settings.resolution, factor, [&](const uvec2 & lowSize) {
+                renderer.setResolution(vec2(lowSize));
+                renderer.render();
+            });
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+
+            // Let the history fill before measuring either time or quality
+            if (frame < settings.warmupFrames) {
+                continue;
+            }
+            gpuStats.add(nanoseconds / 1.0e6);
+
+            reference.BindColor();
+            std::vector<uint8_t> expected = readColor(boundTexture(), settings.resolution);
+            upsampler.bindResult(0);
+            std::vector<uint8_t> actual = readColor(boundTexture(), settings.resolution);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                // Ignore alpha, it isn't displayed
+                if (3 == (i & 3)) {
+                    continue;
+                }
+                double difference = (double)expected[i] - (double)actual[i];
+                squaredError += difference * difference;
+                ++samples;
+            }
+        }
+    });
+    glDeleteQueries(1, &query);
+    renderer.setFixedTime(-1.0f);
+    renderer.setResolution(vec2(settings.resolution));
+
+    double meanSquaredError = samples ? squaredError / samples : 0;
+    result.upsample = factor;
+    result.upsampledGpuMillis = gpuStats.getAverage();
+    // Identical images have infinite PSNR, cap it at something representable in JSON
+    result.upsampledPsnr = meanSquaredError > 0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : 100.0f;
+    qDebug() << "\tUpsampled 1/" << factor << " GPU " << gpuStats.toString().c_str()
+        << ", PSNR " << result.upsampledPsnr << " dB";
+}
+
+// Renders both eyes every frame, first sharing the view-independent buffers
+// between them and then rendering them for each eye as well
+void PresetProfiler::compareShared(Renderer & renderer, Result & result) {
+    FramebufferWrapper framebuffer(settings.resolution);
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    TimingStats gpuStats[2];
+
+    framebuffer.Bound([&] {
+        Stacks::withPush(pr, mv, [&] {
+            pr.top() = glm::perspective(PI / 2.0f, aspect(vec2(settings.resolution)), 0.01f, 10000.0f);
+            int totalFrames = settings.warmupFrames + settings.frames;
+            for (int pass = 0; pass < 2; ++pass) {
+                bool shared = 0 == pass;
+                renderer.setShareBuffers(shared);
+                renderer.restart();
+                for (int frame = 0; frame < totalFrames; ++frame) {
+                    float yaw = 2.0f * PI * frame / totalFrames;
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+                    renderer.renderSharedBuffers();
+                    for (int eye = 0; eye < Renderer::MAX_EYES; ++eye) {
+                        renderer.setEye(eye);
+                        mv.identity().rotate(yaw, Vectors::UP);
+                        renderer.render();
+                    }
+                    glEndQuery(GL_TIME_ELAPSED);
+                    GLuint64 nanoseconds = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+                    if (frame >= settings.warmupFrames) {
+                        gpuStats[pass].add(nanoseconds / 1.0e6);
+                    }
+                }
+            }
+        });
+    });
+    glDeleteQueries(1, &query);
+    renderer.setShareBuffers(true);
+    renderer.setEye(0);
+
+    result.shared = true;
+    result.stereoGpuMillis = gpuStats[0].getAverage();
+    result.stereoUnsharedGpuMillis = gpuStats[1].getAverage();
+    qDebug() << "\tStereo GPU, shared buffers " << gpuStats[0].toString().c_str()
+        << ", per eye " << gpuStats[1].toString().c_str();
+}
+
+bool PresetProfiler::writeReport(const std::vector<Result> & results) {
+    QJsonObject settingsObject;
+    settingsObject["width"] = (int)settings.resolution.x;
+    settingsObject["height"] = (int)settings.resolution.y;
+    settingsObject["frames"] = settings.frames;
+    settingsObject["eyeWidth"] = (int)settings.eyeSize.x;
+    settingsObject["eyeHeight"] = (int)settings.eyeSize.y;
+    settingsObject["budgetMs"] = settings.budgetMillis;
+
+    QJsonArray presetArray;
+    for (const Result & result : results) {
+        QJsonObject preset;
+        preset["path"] = result.path;
+        preset["name"] = result.name;
+        preset["valid"] = result.valid;
+        preset["compileMs"] = result.compileMillis;
+        preset["linkMs"] = result.linkMillis;
+        preset["gpuMs"] = result.gpuMillis;
+        preset["gpuMaxMs"] = result.gpuMaxMillis;
+        preset["msPerMegapixel"] = result.millisPerMegapixel;
+        preset["maxScale"] = result.maxScale;
+        preset["maxWidth"] = (int)(result.maxScale * settings.eyeSize.x);
+        preset["maxHeight"] = (int)(result.maxScale * settings.eyeSize.y);
+        if (!result.passMillis.empty()) {
+            QJsonObject passes;
+            for (auto & pass : result.passMillis) {
+                passes[pass.first] = pass.second;
+            }
+            preset["passGpuMs"] = passes;
+        }
+        if (result.upsample > 1) {
+            preset["upsample"] = result.upsample;
+            preset["upsampledGpuMs"] = result.upsampledGpuMillis;
+            preset["upsampledPsnr"] = result.upsampledPsnr;
+            preset["upsampledSaving"] = result.gpuMillis > 0 ?
+                1.0f - result.upsampledGpuMillis / result.gpuMillis : 0.0f;
+        }
+        if (result.shared) {
+            preset["stereoGpuMs"] = result.stereoGpuMillis;
+            preset["stereoUnsharedGpuMs"] = result.stereoUnsharedGpuMillis;
+            preset["sharedSaving"] = result.stereoUnsharedGpuMillis > 0 ?
+                1.0f - result.stereoGpuMillis / result.stereoUnsharedGpuMillis : 0.0f;
+        }
+        presetArray.append(preset);
+    }
+
+    QJsonObject root;
+    root["settings"] = settingsObject;
+    root["presets"] = presetArray;
+
+    QFile file(settings.output);
+    if (!file.open(QIODevice::Truncate | QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Unable to write profile report " << settings.output;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    file.close();
+    qDebug() << "Wrote profile report " << settings.output;
+    return true;
+}
+
+static bool parseSize(const QString & value, uvec2 & outSize) {
+    QStringList parts = value.split("x");
+    if (2 != parts.size() || parts[0].toInt() <= 0 || parts[1].toInt() <= 0) {
+        qWarning() << "Bad size " << value << ", expected WIDTHxHEIGHT";
+        return false;
+    }
+    outSize = uvec2(parts[0].toInt(), parts[1].toInt());
+    return true;
+}
+
+int PresetProfiler::run(const QStringList & arguments) {
+    QCommandLineParser parser;
+    QCommandLineOption profileOption("profile", "Profile the GPU cost of each preset and exit");
+    QCommandLineOption framesOption("frames", "Number of frames to measure per preset", "count", "100");
+    QCommandLineOption sizeOption("size", "Resolution to render at", "WxH", "1024x1024");
+    QCommandLineOption eyeSizeOption("eye-size", "Per eye texture size the budget applies to", "WxH", "1182x1461");
+    QCommandLineOption budgetOption("budget", "Frame budget in milliseconds", "ms", QString::number(1000.0 / 75.0));
+    QCommandLineOption upsampleOption("upsample", "Compare every preset against temporal upsampling at 1/N resolution", "N", "1");
+    QCommandLineOption outputOption("output", "Report file", "file", defaultReportPath());
+    parser.addOption(profileOption);
+    parser.addOption(framesOption);
+    parser.addOption(sizeOption);
+    parser.addOption(eyeSizeOption);
+    parser.addOption(budgetOption);
+    parser.addOption(upsampleOption);
+    parser.addOption(outputOption);
+    parser.process(arguments);
+
+    Settings settings;
+    settings.frames = std::max(1, parser.value(framesOption).toInt());
+    settings.budgetMillis = parser.value(budgetOption).toFloat();
+    settings.upsample = parser.value(upsampleOption).toInt();
+    settings.output = parser.value(outputOption);
+    if (!parseSize(parser.value(sizeOption), settings.resolution) ||
+        !parseSize(parser.value(eyeSizeOption), settings.eyeSize)) {
+        return -1;
+    }
+
+    QSurfaceFormat format;
+    format.setDepthBufferSize(16);
+    format.setStencilBufferSize(8);
+    format.setVersion(4, 3);
+    format.setProfile(QSurfaceFormat::OpenGLContextProfile::CoreProfile);
+
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        qWarning() << "Unable to create an OpenGL context for profiling";
+        return -1;
+    }
+    glewExperimental = true;
+    glewInit();
+    glGetError();
+
+    int exitCode = 0;
+    {
+        PresetProfiler profiler(settings);
+        if (!profiler.writeReport(profiler.profile(shadertoy::PRESETS))) {
+            exitCode = -1;
+        }
+    }
+    context.doneCurrent();
+    return exitCode;
+}
+
+bool PresetCostReport::load(const QString & path) {
+    millisPerMegapixel.clear();
+    if (!QFile::exists(path)) {
+        return false;
+    }
+    QJsonObject root = QJsonDocument::fromJson(readFileToByteArray(path)).object();
+    budgetMillis = root["settings"].toObject()["budgetMs"].toDouble(budgetMillis);
+    QJsonArray presets = root["presets"].toArray();
+    for (int i = 0; i < presets.count(); ++i) {
+        QJsonObject preset = presets.at(i).toObject();
+        if (preset["valid"].toBool()) {
+            millisPerMegapixel[preset["path"].toString()] = preset["msPerMegapixel"].toDouble();
+        }
+    }
+    qDebug() << "Loaded costs for " << millisPerMegapixel.size() << " presets from " << path;
+    return true;
+}
+
+float PresetCostReport::scaleFor(const QString & preset, const uvec2 & eyeSize) const {
+    auto itr = millisPerMegapixel.find(preset);
+    if (millisPerMegapixel.end() == itr) {
+        return 0;
+    }
+    return PresetProfiler::maxScale(itr->second, eyeSize, budgetMillis);
+}
@@ -0,0 +1,115 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+class Renderer;
+
+// Renders each preset headlessly for a number of frames at a fixed
+// resolution, measuring the GPU time of each frame with timer queries as
+// well as the time taken to compile and link the program, and writes the
+// results to a JSON report, most expensive first.
+//
+// The cost of rendering shadertoy effects is almost entirely in the fragment
+// shader, so it scales with the number of pixels.  Each preset is tagged with
+// its cost per megapixel, and from that the largest texRes at which both eyes
+// can be rendered within the frame budget.
+//
+// Presets that opt in to temporal upsampling are also rendered both ways
+// with a fixed animation time, reporting the GPU time of the upsampled path
+// and its PSNR against the full resolution render.
+//
+// Presets with view-independent buffer passes are also rendered in stereo,
+// two eyes a frame, with those buffers shared between the eyes and then
+// rendered for each eye, to measure what sharing saves.
+//
+// Run with ShadertoyVR --profile [--frames N] [--size WxH] [--eye-size WxH]
+// [--budget ms] [--upsample N] [--output file]
+class PresetProfiler {
+public:
+    struct Settings {
+        // The resolution the presets are actually rendered at
+        uvec2 resolution{ 1024, 1024 };
+        int warmupFrames{ 10 };
+        int frames{ 100 };
+        // The per-eye texture size and frame budget used to work out the
+        // maximum texRes for each preset.  Defaults to the DK2 at 75 Hz.
+        uvec2 eyeSize{ 1182, 1461 };
+        float budgetMillis{ 1000.0f / 75.0f };
+        // Compare every preset against temporal upsampling at this factor,
+        // rather than only the ones that opt in with #pragma upsample
+        int upsample{ 1 };
+        QString output;
+    };
+
+    struct Result {
+        QString path;
+        QString name;
+        bool valid{ false };
+        float compileMillis{ 0 };
+        float linkMillis{ 0 };
+        // GPU time per frame at the profiling resolution
+        float gpuMillis{ 0 };
+        float gpuMaxMillis{ 0 };
+        float millisPerMegapixel{ 0 };
+        // GPU time of each pass, for presets with buffer passes
+        std::vector<std::pair<QString, float>> passMillis;
+        float maxScale{ 0 };
+        // Temporal upsampling results, when it was tested
+        int upsample{ 1 };
+        float upsampledGpuMillis{ 0 };
+        float upsampledPsnr{ 0 };
+        // Stereo GPU time per frame, when there are shared buffers to compare
+        bool shared{ false };
+        float stereoGpuMillis{ 0 };
+        float stereoUnsharedGpuMillis{ 0 };
+    };
+
+    PresetProfiler(const Settings & settings);
+
+    std::vector<Result> profile(const QStringList & presets);
+    bool writeReport(const std::vector<Result> & results);
+
+    static QString defaultReportPath();
+    // Both eyes are rendered at texRes * eyeSize every frame
+    static float maxScale(float millisPerMegapixel, const uvec2 & eyeSize, float budgetMillis);
+    // Parses the command line, runs the profiler over all the presets and
+    // returns the process exit code
+    static int run(const QStringList & arguments);
+
+private:
+    Settings settings;
+
+    void compareUpsampled(Renderer & renderer, int factor, Result & result);
+    void compareShared(Renderer & renderer, Result & result);
+};
+
+// The application side of the profiler, used to pick a texRes for each
+// preset as it's loaded
+class PresetCostReport {
+    float budgetMillis{ 1000.0f / 75.0f };
+    std::map<QString, float> millisPerMegapixel;
+
+public:
+    bool load(const QString & path = PresetProfiler::defaultReportPath());
+
+    // Returns the largest texRes at which the preset fits within the budget
+    // the report was generated with, or 0 if the preset wasn't profiled
+    float scaleFor(const QString & preset, const uvec2 & eyeSize) const;
+};
@@ -0,0 +1,63 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "QtCommon.h"
+#include "RenderTargetPool.h"
+
+using namespace oglplus;
+
+FramebufferWrapperPtr RenderTargetPool::acquire(const uvec2 & size) {
+    FramebufferWrapperPtr result;
+    auto itr = std::find_if(free.begin(), free.end(), [&](const FramebufferWrapperPtr & target) {
+        return target->size == size;
+    });
+    if (itr != free.end()) {
+        result = *itr;
+        free.erase(itr);
+    } else {
+        result = FramebufferWrapperPtr(new FramebufferWrapper());
+        result->owner = "Shadertoy buffers";
+        result->colorFormat = FORMAT;
+        result->useDepth = false;
+        result->init(size);
+        ++allocations;
+    }
+
+    // Leaves the clear color alone
+    static const GLfloat ZERO[4] = { 0, 0, 0, 0 };
+    result->Bound([&] {
+        glClearBufferfv(GL_COLOR, 0, ZERO);
+    });
+    return result;
+}
+
+void RenderTargetPool::release(FramebufferWrapperPtr & target) {
+    if (!target) {
+        return;
+    }
+    free.push_front(target);
+    target.reset();
+    while (free.size() > MAX_FREE) {
+        free.pop_back();
+    }
+}
+
+void RenderTargetPool::clear() {
+    free.clear();
+}
@@ -0,0 +1,52 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+// Hands out the float render targets used by the shadertoy buffer passes.
+// Targets that are given back are kept for reuse by a later request of the
+// same size, since changing texRes or loading another preset would
+// otherwise reallocate every target, and only the most recently released
+// few are kept.
+//
+// Targets are RGBA16F without a depth buffer, and come back cleared to
+// zero, as Shadertoy's buffers start out.
+class RenderTargetPool {
+public:
+    static const size_t MAX_FREE = 8;
+    static const GLenum FORMAT = GL_RGBA16F;
+
+    FramebufferWrapperPtr acquire(const uvec2 & size);
+    // Returns the target to the pool and resets the pointer
+    void release(FramebufferWrapperPtr & target);
+    void clear();
+
+    size_t getFreeCount() const {
+        return free.size();
+    }
+
+    size_t getAllocationCount() const {
+        return allocations;
+    }
+
+private:
+    // Most recently released first
+    std::list<FramebufferWrapperPtr> free;
+    size_t allocations{ 0 };
+};
@@ -20,9 +20,41 @@ limitations under the License.
 #include "QtCommon.h"
 #include "Shadertoy.h"
 #include "Renderer.h"
+#include "Globals.h"
 
 using namespace oglplus;
 
+Renderer::Renderer() {
+    for (int i = 0; i < MAX_VIEWS; ++i) {
+        frames[i] = 0;
+        for (BufferPass & buffer : buffers) {
+            buffer.current[i] = 0;
+        }
+    }
+}
+
+void Renderer::restart() {
+    // Leaves the clear color alone
+    static const GLfloat ZERO[4] = { 0, 0, 0, 0 };
+    startTime = Platform::elapsedSeconds();
+    for (int i = 0; i < MAX_VIEWS; ++i) {
+        frames[i] = 0;
+        // Buffers that feed back into themselves would otherwise carry on
+        // from their old state.  They're cleared in place, as there are
+        // more of them than the pool keeps free.
+        for (BufferPass & buffer : buffers) {
+            for (int j = 0; j < 2; ++j) {
+                if (buffer.targets[i][j]) {
+                    buffer.targets[i][j]->Bound([&] {
+                        glClearBufferfv(GL_COLOR, 0, ZERO);
+                    });
+                }
+            }
+            buffer.current[i] = 0;
+        }
+    }
+}
+
 void Renderer::setup(QOpenGLContext * context) {
     this->context = context;
     initTextureCache();
@@ -32,6 +64,16 @@ void Renderer::setup(QOpenGLContext * context) {
     skybox = oria::loadSkybox(shadertoyProgram);
 
     Platform::addShutdownHook([&] {
+        for (int i = 0; i < 4; ++i) {
+            channels[i] = Channel();
+        }
+        for (BufferPass & buffer : buffers) {
+            releaseBuffer(buffer);
+            buffer.gpuTimer.release();
+        }
+        bufferOrder.clear();
+        targetPool.clear();
+        imageGpuTimer.release();
         textureCache.clear();
         shadertoyProgram.reset();
         vertexShader.reset();
@@ -42,6 +84,8 @@ void Renderer::setup(QOpenGLContext * context) {
 
 void Renderer::initTextureCache() {
     using namespace shadertoy;
+    // Every preset texture is loaded up front, so they're all resident
+    GpuMemory::Owner memoryOwner("Shadertoy textures");
     QRegExp re("(tex|cube)(\\d+)(_0)?\\.(png|jpg)");
 
     for (int i = 0; i < TEXTURES.size(); ++i) {
@@ -105,11 +149,29 @@ void Renderer::render() {
     if (!shadertoyProgram) {
         return;
     }
+    for (int i = 0; i < 4; ++i) {
+        if (channels[i].media) {
+            channels[i].media->update();
+        }
+    }
+    for (int index : bufferOrder) {
+        for (Channel & channel : buffers[index].channels) {
+            if (channel.media) {
+                channel.media->update();
+            }
+        }
+    }
+    if (!bufferOrder.empty()) {
+        renderBuffers(false);
+    }
     MatrixStack & mv = Stacks::modelview();
-    mv.withPush([&] {
-        mv.untranslate();
-        oria::renderGeometry(skybox, shadertoyProgram, uniformLambdas);
+    imageGpuTimer.time([&] {
+        mv.withPush([&] {
+            mv.untranslate();
+            oria::renderGeometry(skybox, shadertoyProgram, uniformLambdas);
+        });
     });
+    ++frames[view];
     for (int i = 0; i < 4; ++i) {
         oglplus::DefaultTexture().Active(0);
         DefaultTexture().Bind(Texture::Target::_2D);
@@ -118,102 +180,248 @@ void Renderer::render() {
     oglplus::Texture::Active(0);
 }
 
+bool Renderer::hasSharedBuffers() const {
+    for (int index : bufferOrder) {
+        if (isShared(buffers[index])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Renderer::renderSharedBuffers() {
+    if (!shadertoyProgram || !hasSharedBuffers()) {
+        return;
+    }
+    int eye = view;
+    view = SHARED_VIEW;
+    // The shared buffers shouldn't depend on the view, but give them a fixed
+    // one looking down -Z anyway, so that they don't follow the head
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    Stacks::withPush(pr, mv, [&] {
+        pr.top() = glm::perspective(PI / 2.0f, aspect(resolution), 0.01f, 10000.0f);
+        mv.identity();
+        renderBuffers(true);
+    });
+    ++frames[SHARED_VIEW];
+    view = eye;
+}
+
+void Renderer::renderBuffers(bool shared) {
+    uvec2 size = glm::max(uvec2(1), uvec2(resolution));
+    // The buffers are drawn with their own viewport, and without whatever
+    // blending the caller has set up
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    Context::Disable(Capability::Blend);
+
+    MatrixStack & mv = Stacks::modelview();
+    for (int index : bufferOrder) {
+        BufferPass & buffer = buffers[index];
+        if (!buffer.program || isShared(buffer) != shared) {
+            continue;
+        }
+        FramebufferWrapperPtr * targets = buffer.targets[view];
+        bool resized = !targets[0] || targets[0]->size != size;
+        if (resized) {
+            for (int i = 0; i < 2; ++i) {
+                targetPool.release(targets[i]);
+                targets[i] = targetPool.acquire(size);
+            }
+            buffer.current[view] = 0;
+        }
+        // Between updates the other passes keep reading the last output
+        if (!resized && 0 != frames[view] % buffer.updateDivisor) {
+            continue;
+        }
+
+        int & current = buffer.current[view];
+        buffer.gpuTimer.time([&] {
+            targets[1 - current]->Bound([&] {
+                mv.withPush([&] {
+                    mv.untranslate();
+                    oria::renderGeometry(skybox, buffer.program, buffer.uniformLambdas);
+                });
+            });
+        });
+        current = 1 - current;
+    }
+
+    if (blend) {
+        Context::Enable(Capability::Blend);
+    }
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void Renderer::bindChannel(int index, const Channel & channel) {
+    Texture::Active(index);
+    if (channel.buffer >= 0) {
+        const BufferPass & buffer = buffers[channel.buffer];
+        // Before the buffer has rendered this frame, or while it's rendering,
+        // this is its previous output
+        int bufferView = viewOf(buffer);
+        const FramebufferWrapperPtr & target = buffer.targets[bufferView][buffer.current[bufferView]];
+        if (target) {
+            target->BindColor();
+        } else {
+            DefaultTexture().Bind(Texture::Target::_2D);
+        }
+    } else if (channel.texture) {
+        channel.texture->Bind(channel.target);
+    }
+}
+
 void Renderer::updateUniforms() {
+    updateUniforms(shadertoyProgram, channels, uniformLambdas);
+    for (BufferPass & buffer : buffers) {
+        updateUniforms(buffer.program, buffer.channels, buffer.uniformLambdas);
+    }
+}
+
+void Renderer::updateUniforms(ProgramPtr & programPtr, Channel * channels, LambdaList & uniformLambdas) {
     using namespace shadertoy;
+    uniformLambdas.clear();
+    if (!programPtr) {
+        return;
+    }
+    // The lambdas are rebuilt whenever the program changes
+    Program * program = programPtr.get();
     typedef std::map<std::string, GLuint> Map;
-    Map activeUniforms = oria::getActiveUniforms(shadertoyProgram);
-    shadertoyProgram->Bind();
+    Map activeUniforms = oria::getActiveUniforms(programPtr);
+    program->Bind();
     //    UNIFORM_DATE;
     for (int i = 0; i < 4; ++i) {
         const char * uniformName = shadertoy::UNIFORM_CHANNELS[i];
         if (activeUniforms.count(uniformName)) {
             context->functions()->glUniform1i(activeUniforms[uniformName], i);
         }
-        if (channels[i].texture) {
+        if (channels[i].texture && !channels[i].media) {
             if (activeUniforms.count(UNIFORM_CHANNEL_RESOLUTIONS[i])) {
-                Uniform<vec3>(*shadertoyProgram, UNIFORM_CHANNEL_RESOLUTIONS[i]).Set(channels[i].resolution);
+                Uniform<vec3>(*program, UNIFORM_CHANNEL_RESOLUTIONS[i]).Set(channels[i].resolution);
             }
-
         }
     }
     NoProgram().Bind();
 
-    uniformLambdas.clear();
     if (activeUniforms.count(UNIFORM_GLOBALTIME)) {
-        uniformLambdas.push_back([&] {
-            Uniform<GLfloat>(*shadertoyProgram, UNIFORM_GLOBALTIME).Set(Platform::elapsedSeconds() - startTime);
+        uniformLambdas.push_back([=] {
+            float time = fixedTime >= 0 ? fixedTime : Platform::elapsedSeconds() - startTime;
+            Uniform<GLfloat>(*program, UNIFORM_GLOBALTIME).Set(time);
         });
     }
 
     if (activeUniforms.count(UNIFORM_RESOLUTION)) {
-        uniformLambdas.push_back([&] {
+        uniformLambdas.push_back([=] {
             vec3 res = vec3(resolution, 0);
-            Uniform<vec3>(*shadertoyProgram, UNIFORM_RESOLUTION).Set(res);
+            Uniform<vec3>(*program, UNIFORM_RESOLUTION).Set(res);
+        });
+    }
+
+    if (activeUniforms.count(UNIFORM_FRAME)) {
+        uniformLambdas.push_back([=] {
+            Uniform<GLint>(*program, UNIFORM_FRAME).Set(frames[view]);
         });
     }
 
 #ifdef USE_RIFT
     if (activeUniforms.count(shadertoy::UNIFORM_POSITION)) {
-        uniformLambdas.push_back([&] {
-            Uniform<vec3>(*shadertoyProgram, shadertoy::UNIFORM_POSITION).Set(position);
+        uniformLambdas.push_back([=] {
+            Uniform<vec3>(*program, shadertoy::UNIFORM_POSITION).Set(position);
         });
     }
 #endif
 
+    // Media channels report their playback position every frame, and
+    // buffers can change size
     for (int i = 0; i < 4; ++i) {
-        if (activeUniforms.count(UNIFORM_CHANNELS[i]) && channels[i].texture) {
+        if (channels[i].buffer >= 0 && activeUniforms.count(UNIFORM_CHANNEL_RESOLUTIONS[i])) {
+            int bufferIndex = channels[i].buffer;
             uniformLambdas.push_back([=] {
-                if (this->channels[i].texture) {
-                    Texture::Active(i);
-                    this->channels[i].texture->Bind(channels[i].target);
-                }
+                const BufferPass & buffer = buffers[bufferIndex];
+                const FramebufferWrapperPtr & target = buffer.targets[viewOf(buffer)][0];
+                vec3 res = target ? vec3(target->size, 1) : vec3(resolution, 1);
+                Uniform<vec3>(*program, UNIFORM_CHANNEL_RESOLUTIONS[i]).Set(res);
+            });
+        }
+        if (!channels[i].media) {
+            continue;
+        }
+        if (activeUniforms.count(UNIFORM_CHANNEL_TIMES[i])) {
+            uniformLambdas.push_back([=] {
+                Uniform<GLfloat>(*program, UNIFORM_CHANNEL_TIMES[i]).Set(channels[i].media->getTime());
+            });
+        }
+        if (activeUniforms.count(UNIFORM_CHANNEL_RESOLUTIONS[i])) {
+            uniformLambdas.push_back([=] {
+                Uniform<vec3>(*program, UNIFORM_CHANNEL_RESOLUTIONS[i]).Set(channels[i].media->getResolution());
             });
         }
     }
-}
 
-bool Renderer::setShaderSourceInternal(QString source) {
-    try {
-        position = vec3();
-        if (!vertexShader) {
-            QString vertexShaderSource = readFileToString(":/shaders/default.vs").toLocal8Bit().constData();
-            vertexShader = VertexShaderPtr(new VertexShader());
-            vertexShader->Source(vertexShaderSource.toLocal8Bit().constData());
-            vertexShader->Compile();
+    for (int i = 0; i < 4; ++i) {
+        if (activeUniforms.count(UNIFORM_CHANNELS[i]) && (channels[i].texture || channels[i].buffer >= 0)) {
+            uniformLambdas.push_back([=] {
+                bindChannel(i, channels[i]);
+            });
         }
+    }
+}
 
-        QString header = shadertoy::SHADER_HEADER;
-        for (int i = 0; i < 4; ++i) {
-            const Channel & channel = channels[i];
-            QString line; line.sprintf("uniform sampler%s iChannel%d;\n",
-                channel.target == Texture::Target::CubeMap ? "Cube" : "2D", i);
-            header += line;
-        }
-        header += shadertoy::LINE_NUMBER_HEADER;
-        FragmentShaderPtr newFragmentShader(new FragmentShader());
-        source.
-            replace(QRegExp("\\t"), "  ").
-            replace(QRegExp("\\bgl_FragColor\\b"), "FragColor").
-            replace(QRegExp("\\btexture2D\\b"), "texture").
-            replace(QRegExp("\\btextureCube\\b"), "texture");
-        source.insert(0, header);
-        QByteArray qb = source.toLocal8Bit();
-        GLchar * fragmentSource = (GLchar*)qb.data();
-        StrCRef src(fragmentSource);
-        newFragmentShader->Source(GLSLSource(src));
+ProgramPtr Renderer::buildProgram(QString source, const Channel * channels, FragmentShaderPtr & outFragmentShader) {
+    if (!vertexShader) {
+        QString vertexShaderSource = readFileToString(":/shaders/default.vs").toLocal8Bit().constData();
+        vertexShader = VertexShaderPtr(new VertexShader());
+        vertexShader->Source(vertexShaderSource.toLocal8Bit().constData());
+        vertexShader->Compile();
+    }
+
+    QString header = shadertoy::SHADER_HEADER;
+    for (int i = 0; i < 4; ++i) {
+        const Channel & channel = channels[i];
+        QString line; line.sprintf("uniform sampler%s iChannel%d;\n",
+            channel.target == Texture::Target::CubeMap ? "Cube" : "2D", i);
+        header += line;
+    }
+    header += shadertoy::LINE_NUMBER_HEADER;
+    FragmentShaderPtr newFragmentShader(new FragmentShader());
+    source.
+        replace(QRegExp("\\t"), "  ").
+        replace(QRegExp("\\bgl_FragColor\\b"), "FragColor").
+        replace(QRegExp("\\btexture2D\\b"), "texture").
+        replace(QRegExp("\\btextureCube\\b"), "texture");
+    source.insert(0, header);
+    QByteArray qb = source.toLocal8Bit();
+    GLchar * fragmentSource = (GLchar*)qb.data();
+    StrCRef src(fragmentSource);
+    newFragmentShader->Source(GLSLSource(src));
+    compileStats.time([&] {
         newFragmentShader->Compile();
-        ProgramPtr result(new Program());
-        result->AttachShader(*vertexShader);
-        result->AttachShader(*newFragmentShader);
+    });
+    ProgramPtr result(new Program());
+    result->AttachShader(*vertexShader);
+    result->AttachShader(*newFragmentShader);
 
+    linkStats.time([&] {
         result->Link();
+    });
+    outFragmentShader.swap(newFragmentShader);
+    return result;
+}
+
+bool Renderer::setShaderSourceInternal(QString source) {
+    try {
+        position = vec3();
+        FragmentShaderPtr newFragmentShader;
+        ProgramPtr result = buildProgram(source, channels, newFragmentShader);
         shadertoyProgram.swap(result);
         if (!skybox) {
             skybox = oria::loadSkybox(shadertoyProgram);
         }
         fragmentShader.swap(newFragmentShader);
         updateUniforms();
-        startTime = Platform::elapsedSeconds();
+        restart();
         emit compileSuccess();
     } catch (ProgramBuildError & err) {
         emit compileError(QString(err.Log().c_str()));
@@ -230,6 +438,7 @@ Renderer::TextureData Renderer::loadTexture(QString source) {
 
     if (!textureCache.count(source)) {
         qWarning() << "Texture " << source << " not found, loading";
+        GpuMemory::Owner memoryOwner("Shadertoy textures");
         std::vector<uint8_t> textureData = readFileToVector(source);
         if (!textureData.empty()) {
             textureCache[source].tex = oria::load2dTexture(textureData, textureCache[source].size);
@@ -240,6 +449,22 @@ Renderer::TextureData Renderer::loadTexture(QString source) {
     return textureCache[source];
 }
 
+// Video and audio inputs are streamed from disk rather than loaded into the
+// texture cache.  Shadertoy refers to them by server paths (/presets/vid00.webm),
+// so fall back on looking for the file name in the media folder of the
+// configuration directory.
+QString Renderer::resolveMediaPath(const QString & source) {
+    QString path = source;
+    if (path.startsWith("file:")) {
+        path = QUrl(path).toLocalFile();
+    }
+    if (QFile(path).exists()) {
+        return path;
+    }
+    QString fileName = path.split("/").back();
+    return CONFIG_DIR.absoluteFilePath("media/" + fileName);
+}
+
 void Renderer::setChannelTextureInternal(int channel, shadertoy::ChannelInputType type, const QString & textureSource) {
     using namespace oglplus;
     if (textureSource == channelSources[channel]) {
@@ -250,35 +475,212 @@ void Renderer::setChannelTextureInternal(int channel, shadertoy::ChannelInputTyp
 
     if (QUrl() == textureSource) {
         channels[channel].texture.reset();
+        channels[channel].media.reset();
         channels[channel].target = Texture::Target::_2D;
+        channels[channel].buffer = -1;
+        updateBufferOrder();
         return;
     }
 
+    channels[channel] = loadChannel(type, textureSource);
+    updateBufferOrder();
+}
+
+Renderer::Channel Renderer::loadChannel(shadertoy::ChannelInputType type, const QString & textureSource) {
     Channel newChannel;
-    uvec2 size;
-    auto texData = loadTexture(textureSource);
-    newChannel.texture = texData.tex;
+    TextureData texData;
+    GpuMemory::Owner memoryOwner("Shadertoy channels");
     switch (type) {
     case shadertoy::ChannelInputType::TEXTURE:
+        texData = loadTexture(textureSource);
+        newChannel.texture = texData.tex;
         newChannel.target = Texture::Target::_2D;
         newChannel.resolution = vec3(texData.size, 0);
         break;
 
     case shadertoy::ChannelInputType::CUBEMAP:
+        texData = loadTexture(textureSource);
+        newChannel.texture = texData.tex;
         newChannel.target = Texture::Target::CubeMap;
         newChannel.resolution = vec3(texData.size.x);
         break;
 
     case shadertoy::ChannelInputType::VIDEO:
-        // FIXME, not supported
+        newChannel.media = MediaChannelPtr(new VideoChannel(resolveMediaPath(textureSource)));
         break;
 
     case shadertoy::ChannelInputType::AUDIO:
-        // FIXME, not supported
+        newChannel.media = MediaChannelPtr(new AudioChannel(resolveMediaPath(textureSource)));
         break;
+
+    case shadertoy::ChannelInputType::BUFFER:
+        newChannel.buffer = shadertoy::bufferIndex(textureSource);
+        newChannel.target = Texture::Target::_2D;
+        break;
+    }
+
+    if (newChannel.media) {
+        if (newChannel.media->isValid()) {
+            newChannel.texture = newChannel.media->getTexture();
+            newChannel.target = Texture::Target::_2D;
+            newChannel.resolution = newChannel.media->getResolution();
+        } else {
+            newChannel.media.reset();
+        }
     }
+    return newChannel;
+}
 
-    channels[channel] = newChannel;
+void Renderer::releaseBuffer(BufferPass & buffer) {
+    buffer.uniformLambdas.clear();
+    buffer.program.reset();
+    buffer.fragmentShader.reset();
+    for (int i = 0; i < shadertoy::MAX_CHANNELS; ++i) {
+        buffer.channels[i] = Channel();
+    }
+    for (int i = 0; i < MAX_VIEWS; ++i) {
+        targetPool.release(buffer.targets[i][0]);
+        targetPool.release(buffer.targets[i][1]);
+        buffer.current[i] = 0;
+    }
+    buffer.viewIndependent = false;
+    buffer.updateDivisor = 1;
+    buffer.gpuTimer.reset();
+}
+
+bool Renderer::setBuffersInternal(const shadertoy::Shader & shader) {
+    using namespace shadertoy;
+    bool success = true;
+    for (int i = 0; i < MAX_BUFFERS; ++i) {
+        BufferPass & buffer = buffers[i];
+        releaseBuffer(buffer);
+        const shadertoy::BufferPass & pass = shader.buffers[i];
+        if (!pass.isEnabled()) {
+            continue;
+        }
+        for (int c = 0; c < MAX_CHANNELS; ++c) {
+            if (!pass.channelTextures[c].isEmpty()) {
+                buffer.channels[c] = loadChannel(pass.channelTypes[c], pass.channelTextures[c]);
+            }
+        }
+        buffer.viewIndependent = parseViewIndependent(pass.fragmentSource);
+        buffer.updateDivisor = parseUpdateDivisor(pass.fragmentSource);
+        try {
+            buffer.program = buildProgram(pass.fragmentSource, buffer.channels, buffer.fragmentShader);
+        } catch (ProgramBuildError & err) {
+            emit compileError(QString("Buffer %1: %2").arg(bufferName(i)).arg(err.Log().c_str()));
+            buffer.program.reset();
+            success = false;
+        }
+    }
+
+    // A buffer reading one that's rendered per eye can't be shared, nor can
+    // anything reading it in turn
+    bool demoted = true;
+    while (demoted) {
+        demoted = false;
+        for (int i = 0; i < MAX_BUFFERS; ++i) {
+            BufferPass & buffer = buffers[i];
+            if (!buffer.viewIndependent) {
+                continue;
+            }
+            for (const Channel & channel : buffer.channels) {
+                if (channel.buffer >= 0 && !buffers[channel.buffer].viewIndependent &&
+                        buffers[channel.buffer].program) {
+                    qWarning() << "Buffer" << bufferName(i) << "reads per-eye buffer"
+                        << bufferName(channel.buffer) << ", rendering it per eye";
+                    buffer.viewIndependent = false;
+                    demoted = true;
+                    break;
+                }
+            }
+        }
+    }
+    updateBufferOrder();
+    updateUniforms();
+    return success;
+}
+
+void Renderer::updateBufferOrder() {
+    using namespace shadertoy;
+    // Work out which buffers the image pass needs, directly or through
+    // other buffers, and which of them each reads
+    bool needed[MAX_BUFFERS] = {};
+    bool reads[MAX_BUFFERS][MAX_BUFFERS] = {};
+    std::vector<int> pending;
+    for (int i = 0; i < MAX_CHANNELS; ++i) {
+        if (channels[i].buffer >= 0) {
+            pending.push_back(channels[i].buffer);
+        }
+    }
+    while (!pending.empty()) {
+        int index = pending.back();
+        pending.pop_back();
+        if (needed[index]) {
+            continue;
+        }
+        needed[index] = true;
+        for (const Channel & channel : buffers[index].channels) {
+            if (channel.buffer >= 0) {
+                reads[index][channel.buffer] = channel.buffer != index;
+                pending.push_back(channel.buffer);
+            }
+        }
+    }
+
+    // Repeatedly take the first buffer whose inputs have all rendered, or
+    // when there's a cycle, simply the first
+    bufferOrder.clear();
+    bool done[MAX_BUFFERS] = {};
+    while (true) {
+        int next = -1;
+        int fallback = -1;
+        for (int i = 0; i < MAX_BUFFERS && next < 0; ++i) {
+            if (!needed[i] || done[i] || !buffers[i].program) {
+                continue;
+            }
+            if (fallback < 0) {
+                fallback = i;
+            }
+            bool ready = true;
+            for (int j = 0; j < MAX_BUFFERS; ++j) {
+                if (reads[i][j] && needed[j] && !done[j] && buffers[j].program) {
+                    ready = false;
+                }
+            }
+            if (ready) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            next = fallback;
+        }
+        if (next < 0) {
+            break;
+        }
+        done[next] = true;
+        bufferOrder.push_back(next);
+    }
+}
+
+std::vector<std::pair<QString, TimingStats>> Renderer::getPassStats() {
+    std::vector<std::pair<QString, TimingStats>> result;
+    for (int index : bufferOrder) {
+        QString name = "Buffer " + shadertoy::bufferName(index);
+        if (isShared(buffers[index])) {
+            name += " (shared)";
+        }
+        result.push_back({ name, buffers[index].gpuTimer.getStats() });
+    }
+    result.push_back({ "Image", imageGpuTimer.getStats() });
+    return result;
+}
+
+void Renderer::resetPassStats() {
+    for (BufferPass & buffer : buffers) {
+        buffer.gpuTimer.reset();
+    }
+    imageGpuTimer.reset();
 }
 
 void Renderer::setShaderInternal(const shadertoy::Shader & shader) {
@@ -286,4 +688,6 @@ void Renderer::setShaderInternal(const shadertoy::Shader & shader) {
         setChannelTextureInternal(i, shader.channelTypes[i], shader.channelTextures[i]);
     }
     setShaderSourceInternal(shader.fragmentSource);
+    // After the image pass, so a buffer's compile error is the last reported
+    setBuffersInternal(shader);
 }
@@ -19,13 +19,57 @@ limitations under the License.
 
 #pragma once
 
+#include "VideoChannel.h"
+#include "AudioChannel.h"
+#include "RenderTargetPool.h"
+
+// Renders a shadertoy effect: the image pass, drawn into whatever
+// framebuffer is bound, preceded by any Buffer A to D passes it reads.
+//
+// The buffer passes render into float targets at the current resolution,
+// in dependency order, skipping buffers nothing reads.  Each eye has its
+// own pair of targets per buffer, written alternately, so that a buffer
+// can read its own previous frame, and feedback effects don't mix the two
+// eyes' views.  Where buffers read each other in a cycle, the earlier
+// letter goes first, as on Shadertoy.
+//
+// Buffers marked with "#pragma view_independent" don't depend on the eye
+// position or orientation, so they're rendered once per frame by
+// renderSharedBuffers(), before the eyes, into targets both eyes read.  Any
+// buffer can also be updated at a fraction of the frame rate with
+// "#pragma update_divisor N", for simulations that don't need to run at the
+// display rate.
 class Renderer : public QObject {
     Q_OBJECT
+public:
+    static const int MAX_EYES = 2;
+    // View-independent buffers have one set of targets shared by the eyes
+    static const int SHARED_VIEW = MAX_EYES;
+    static const int MAX_VIEWS = MAX_EYES + 1;
+
 protected:
     struct Channel {
         oglplus::Texture::Target target;
         TexturePtr texture;
         vec3 resolution;
+        // Set for channels whose texture content changes over time
+        MediaChannelPtr media;
+        // Set for channels reading the output of a buffer pass
+        int buffer{ -1 };
+    };
+
+    struct BufferPass {
+        FragmentShaderPtr fragmentShader;
+        ProgramPtr program;
+        Channel channels[shadertoy::MAX_CHANNELS];
+        LambdaList uniformLambdas;
+        bool viewIndependent{ false };
+        // Only rendered on every updateDivisor'th frame of its view
+        int updateDivisor{ 1 };
+        // The most recent output is targets[view][current[view]]
+        FramebufferWrapperPtr targets[MAX_VIEWS][2];
+        int current[MAX_VIEWS];
+        GpuTimer gpuTimer;
     };
     struct TextureData {
         TexturePtr tex;
@@ -43,6 +87,19 @@ protected:
     Channel channels[4];
     QString channelSources[4];
 
+    BufferPass buffers[shadertoy::MAX_BUFFERS];
+    // The buffers the image pass needs, in the order they're rendered
+    std::vector<int> bufferOrder;
+    RenderTargetPool targetPool;
+    GpuTimer imageGpuTimer;
+    // The eye being rendered, or SHARED_VIEW in renderSharedBuffers()
+    int view{ 0 };
+    // Frames rendered for each view since the shader was loaded, for iFrame
+    int frames[MAX_VIEWS];
+    // If false, view-independent buffers are rendered for each eye like the
+    // others, for comparison
+    bool shareBuffers{ true };
+
     //// The shadertoy rendering resolution scale.  1.0 means full resolution
     //// as defined by the Oculus SDK as the ideal offscreen resolution
     //// pre-distortion
@@ -55,6 +112,8 @@ protected:
     vec3 position;
     // The amount of time since we started running
     float startTime{ 0.0f };
+    // If set, iGlobalTime is pinned to this value, for repeatable renders
+    float fixedTime{ -1.0f };
 
     // The current fragment source
     LambdaList uniformLambdas;
@@ -67,16 +126,42 @@ protected:
     FragmentShaderPtr fragmentShader;
     // The compiled shadertoy program
     ProgramPtr shadertoyProgram;
+    // CPU time spent building shadertoy programs
+    TimingStats compileStats;
+    TimingStats linkStats;
 
     void initTextureCache();
+    Channel loadChannel(shadertoy::ChannelInputType type, const QString & textureSource);
+    // Prepends the uniform and sampler declarations and builds the program
+    ProgramPtr buildProgram(QString source, const Channel * channels, FragmentShaderPtr & outFragmentShader);
+    void updateUniforms(ProgramPtr & program, Channel * channels, LambdaList & uniformLambdas);
+    void bindChannel(int index, const Channel & channel);
+    void updateBufferOrder();
+    bool isShared(const BufferPass & buffer) const {
+        return shareBuffers && buffer.viewIndependent;
+    }
+    // The view whose targets hold a buffer's output for the current view
+    int viewOf(const BufferPass & buffer) const {
+        return isShared(buffer) ? SHARED_VIEW : view;
+    }
+    // Renders the buffers of the current view that are due this frame
+    void renderBuffers(bool shared);
+    void releaseBuffer(BufferPass & buffer);
 
 public:
+    Renderer();
+
     void setup(QOpenGLContext * context);
+    // Renders the view-independent buffers at the current resolution.  Call
+    // once per frame, before rendering the eyes.
+    void renderSharedBuffers();
     void render();
     void updateUniforms();
 
-    void restart() {
-        startTime = Platform::elapsedSeconds();
+    void restart();
+
+    void setFixedTime(float seconds) {
+        fixedTime = seconds;
     }
 
     void setPosition(const vec3 & position) {
@@ -87,6 +172,31 @@ public:
         this->resolution = resolution;
     }
 
+    // Selects the set of buffer pass targets to use
+    void setEye(int eye) {
+        assert(eye >= 0 && eye < MAX_EYES);
+        view = eye;
+    }
+
+    void setShareBuffers(bool shareBuffers) {
+        this->shareBuffers = shareBuffers;
+    }
+
+    // True if the current shader has a buffer that renderSharedBuffers() draws
+    bool hasSharedBuffers() const;
+
+    TimingStats & getCompileStats() {
+        return compileStats;
+    }
+
+    TimingStats & getLinkStats() {
+        return linkStats;
+    }
+
+    // The GPU time of each pass that has rendered, image pass last
+    std::vector<std::pair<QString, TimingStats>> getPassStats();
+    void resetPassStats();
+
     QString canonicalTexturePath(QString texturePath) {
         while (canonicalPathMap.count(texturePath)) {
             texturePath = canonicalPathMap[texturePath];
@@ -94,9 +204,13 @@ public:
         return texturePath;
     }
 
+    static QString resolveMediaPath(const QString & source);
+
     virtual bool setShaderSourceInternal(QString source);
     virtual TextureData loadTexture(QString source);
     virtual void setChannelTextureInternal(int channel, shadertoy::ChannelInputType type, const QString & textureSource);
+    // Replaces the buffer passes with the shader's
+    virtual bool setBuffersInternal(const shadertoy::Shader & shader);
     virtual void setShaderInternal(const shadertoy::Shader & shader);
 
 signals:
@@ -22,14 +22,18 @@ limitations under the License.
 
 #include <QDomDocument>
 #include <QXmlQuery>
-#include <QJsonValue>
-#include <QJsonDocument>
 
 namespace shadertoy {
 
   const char * UNIFORM_RESOLUTION = "iResolution";
   const char * UNIFORM_GLOBALTIME = "iGlobalTime";
   const char * UNIFORM_CHANNEL_TIME = "iChannelTime";
+  const char * UNIFORM_CHANNEL_TIMES[MAX_CHANNELS] = {
+    "iChannelTime[0]",
+    "iChannelTime[1]",
+    "iChannelTime[2]",
+    "iChannelTime[3]",
+  };
   const char * UNIFORM_CHANNEL_RESOLUTIONS[MAX_CHANNELS] = {
     "iChannelResolution[0]",
     "iChannelResolution[1]",
@@ -48,6 +52,7 @@ namespace shadertoy {
     "iChannel2",
     "iChannel3",
   };
+  const char * UNIFORM_FRAME = "iFrame";
 
   const char * SHADER_HEADER = "#version 330\n"
     "uniform vec3      iResolution;           // viewport resolution (in pixels)\n"
@@ -58,6 +63,7 @@ namespace shadertoy {
     "uniform vec4      iDate;                 // (year, month, day, time in seconds)\n"
     "uniform float     iSampleRate;           // sound sample rate (i.e., 44100)\n"
     "uniform vec3      iPos; // Head position\n"
+    "uniform int       iFrame;                // frames rendered since the shader was loaded\n"
     "in vec3 iDir; // Direction from viewer\n"
     "out vec4 FragColor;\n";
 
@@ -91,6 +97,42 @@ namespace shadertoy {
     "/presets/cube04_%1.png",
     "/presets/cube05_%1.png",
   });
+
+  const QStringList PRESETS({
+    ":/shaders/default.xml",
+    ":/shaders/4df3DS.json",
+    ":/shaders/4dfGzs.json",
+    ":/shaders/4djGWR.json",
+    ":/shaders/4ds3zn.json",
+    ":/shaders/4dXGRM_flying_steel_cubes.xml",
+    // ":/shaders/4sBGD1.json",
+    // ":/shaders/4slGzn.json",
+    ":/shaders/4sX3R2.json", // Monster
+    ":/shaders/4sXGRM_oceanic.xml",
+    ":/shaders/4tXGDn.json", // Morphing
+    //":/shaders/ld23DG_crazy.xml",
+    ":/shaders/ld2GRz.json", // meta-balls
+    // ":/shaders/ldfGzr.json",
+    // ":/shaders/ldj3Dm.json", // fish swimming
+    ":/shaders/ldl3zr_mobius_balls.xml",
+    // ":/shaders/ldSGRW.json",
+    // ":/shaders/lsl3W2.json",
+    ":/shaders/lss3WS_relentless.xml",
+    // ":/shaders/lts3Wn.json",
+    ":/shaders/MdX3Rr.json", // elevated
+    // ":/shaders/MsBGRh.json",
+    // ":/shaders/MsSGD1_hand_drawn_sketch.xml",
+    ":/shaders/MsXGz4.json", // cubemap
+    ":/shaders/MsXGzM.json", // voronoi rocks
+    // ":/shaders/MtfGR8_snowglobe.xml",
+    // ":/shaders/XdBSzd.json",
+    ":/shaders/Xlf3D8.json", // sci-fi
+    ":/shaders/XsBSRG_morning_city.xml",
+    ":/shaders/XsjXR1.json", // worms
+    ":/shaders/XslXW2.json", // mechanical (2D)
+    ":/shaders/ripples.xml", // shared buffer
+    // ":/shaders/XsSSRW.json"
+  });
 }
 
 
@@ -105,6 +147,30 @@ namespace shadertoy {
   static const char * XML_CHANNEL_ATTR_ID = "id";
   static const char * XML_CHANNEL_ATTR_SOURCE = "source";
   static const char * XML_CHANNEL_ATTR_TYPE = "type";
+  static const char * XML_BUFFER = "buffer";
+  static const char * XML_BUFFER_ATTR_ID = "id";
+  // Shadertoy identifies the buffers in its JSON by these output ids
+  static const int JSON_FIRST_BUFFER_ID = 257;
+  // Slower than this and a simulation is better off using iGlobalTime
+  static const int MAX_UPDATE_DIVISOR = 16;
+
+  QString bufferName(int buffer) {
+    return QString(QChar('A' + buffer));
+  }
+
+  int bufferIndex(const QString & source) {
+    if (1 == source.size()) {
+      int index = source.at(0).toUpper().toLatin1() - 'A';
+      return (index >= 0 && index < MAX_BUFFERS) ? index : -1;
+    }
+    // Shadertoy's own sources look like /media/previz/buffer00.png
+    QRegExp re("buffer0?(\\d)");
+    if (-1 != re.indexIn(source)) {
+      int index = re.cap(1).toInt();
+      return index < MAX_BUFFERS ? index : -1;
+    }
+    return -1;
+  }
 
   ChannelInputType channelTypeFromString(const QString & channelTypeStr) {
     ChannelInputType channelType = ChannelInputType::TEXTURE;
@@ -112,11 +178,44 @@ namespace shadertoy {
       channelType = ChannelInputType::TEXTURE;
     } else if (channelTypeStr == "cube") {
       channelType = ChannelInputType::CUBEMAP;
+    } else if (channelTypeStr == "vid") {
+      channelType = ChannelInputType::VIDEO;
+    } else if (channelTypeStr == "mus") {
+      channelType = ChannelInputType::AUDIO;
+    } else if (channelTypeStr == "buf") {
+      channelType = ChannelInputType::BUFFER;
     }
     return channelType;
   }
 
 
+  int parseUpsampleFactor(const QString & fragmentSource) {
+    QRegExp re("#pragma\\s+upsample\\s+(\\d+)");
+    if (-1 == re.indexIn(fragmentSource)) {
+      return 1;
+    }
+    // Only half and quarter resolution are supported
+    int factor = re.cap(1).toInt();
+    if (factor >= 4) {
+      return 4;
+    } else if (factor >= 2) {
+      return 2;
+    }
+    return 1;
+  }
+
+  bool parseViewIndependent(const QString & fragmentSource) {
+    return fragmentSource.contains(QRegExp("#pragma\\s+view_independent\\b"));
+  }
+
+  int parseUpdateDivisor(const QString & fragmentSource) {
+    QRegExp re("#pragma\\s+update_divisor\\s+(\\d+)");
+    if (-1 == re.indexIn(fragmentSource)) {
+      return 1;
+    }
+    return std::max(1, std::min(MAX_UPDATE_DIVISOR, re.cap(1).toInt()));
+  }
+
   ChannelInputType fromShadertoyString(const QString & channelType) {
     // texture music cubemap ???
     if (channelType == "cubemap") {
@@ -125,33 +224,114 @@ namespace shadertoy {
       return ChannelInputType::TEXTURE;
     } else if (channelType == "music") {
       return ChannelInputType::AUDIO;
+    } else if (channelType == "video") {
+      return ChannelInputType::VIDEO;
+    } else if (channelType == "buffer") {
+      return ChannelInputType::BUFFER;
     } else {
-      // FIXME add support for video
       throw std::runtime_error("Unable to parse channel type");
     }
   }
 
+  // Shadertoy has written ids both as numbers and as strings
+  static int jsonBufferId(const JsonValue & id) {
+    int value = id.isString() ? QString::fromUtf8(id.asCString()).toInt() : id.asInt(-1);
+    value -= JSON_FIRST_BUFFER_ID;
+    return (value >= 0 && value < MAX_BUFFERS) ? value : -1;
+  }
+
   Shader parseShaderJson(const QByteArray & shaderJson) {
     Shader result;
-    QJsonDocument jsonResponse = QJsonDocument::fromJson(shaderJson);
-    QJsonObject jsonObject = jsonResponse.object();
-    QJsonObject info = path(jsonResponse.object(), { "Shader", 0, "info" }).toObject();
-    result.name = info["name"].toString().toLocal8Bit();
-    result.id = info["id"].toString().toLocal8Bit();
-    //result.description = info["description"].toString().toLocal8Bit();
-    QJsonObject renderPass = path(jsonResponse.object(), { "Shader", 0, "renderpass", 0 }).toObject();
-    result.fragmentSource = renderPass["code"].toString().toLocal8Bit();
-    QJsonArray inputs = renderPass["inputs"].toArray();
-    for (int i = 0; i < inputs.count(); ++i) {
-      QJsonObject channel = inputs.at(i).toObject();
-      int channelIndex = channel["channel"].toInt();
-      result.channelTypes[channelIndex] = fromShadertoyString(channel["ctype"].toString());
-      result.channelTextures[channelIndex] = channel["src"].toString().toLocal8Bit();
+    JsonDocument document;
+    if (!document.parse(shaderJson.constData(), shaderJson.size())) {
+      qWarning() << "Unable to parse shader: " << document.getError().c_str();
+      return result;
+    }
+    const JsonValue & shader = document["Shader"][0];
+    const JsonValue & info = shader["info"];
+    result.name = QString::fromUtf8(info["name"].asCString());
+    result.id = QString::fromUtf8(info["id"].asCString());
+    const JsonValue & renderPasses = shader["renderpass"];
+    for (size_t p = 0; p < renderPasses.size(); ++p) {
+      const JsonValue & renderPass = renderPasses[(int)p];
+      QString * fragmentSource = &result.fragmentSource;
+      ChannelInputType * channelTypes = result.channelTypes;
+      QString * channelTextures = result.channelTextures;
+      // Old exports have a single pass with no type
+      const char * passType = renderPass["type"].asCString();
+      if (!strcmp("buffer", passType)) {
+        int buffer = jsonBufferId(renderPass["outputs"][0]["id"]);
+        if (buffer < 0) {
+          buffer = bufferIndex(QString::fromUtf8(renderPass["name"].asCString()).right(1));
+        }
+        if (buffer < 0) {
+          qWarning() << "Skipping a buffer pass with no recognizable output";
+          continue;
+        }
+        BufferPass & bufferPass = result.buffers[buffer];
+        fragmentSource = &bufferPass.fragmentSource;
+        channelTypes = bufferPass.channelTypes;
+        channelTextures = bufferPass.channelTextures;
+      } else if (*passType && strcmp("image", passType)) {
+        // Sound and common passes aren't supported
+        continue;
+      }
+
+      *fragmentSource = QString::fromUtf8(renderPass["code"].asCString());
+      const JsonValue & inputs = renderPass["inputs"];
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        const JsonValue & channel = inputs[(int)i];
+        int channelIndex = channel["channel"].asInt(-1);
+        if (channelIndex < 0 || channelIndex >= MAX_CHANNELS) {
+          continue;
+        }
+        channelTypes[channelIndex] = fromShadertoyString(channel["ctype"].asCString());
+        QString source = QString::fromUtf8(channel["src"].asCString());
+        if (ChannelInputType::BUFFER == channelTypes[channelIndex]) {
+          int buffer = jsonBufferId(channel["id"]);
+          if (buffer < 0) {
+            buffer = bufferIndex(source);
+          }
+          source = buffer < 0 ? QString() : bufferName(buffer);
+        }
+        channelTextures[channelIndex] = source;
+      }
     }
     result.vrEnabled = result.fragmentSource.contains("#pragma vr");
+    result.upsample = parseUpsampleFactor(result.fragmentSource);
     return result;
   }
 
+  static void readChannelXml(const QDomNode & child, ChannelInputType * channelTypes, QString * channelTextures) {
+    auto attributes = child.attributes();
+    int channelIndex = -1;
+    QString source;
+    if (attributes.contains(XML_CHANNEL_ATTR_ID)) {
+      channelIndex = attributes.namedItem(XML_CHANNEL_ATTR_ID).nodeValue().toInt();
+    }
+
+    if (channelIndex < 0 || channelIndex >= shadertoy::MAX_CHANNELS) {
+      return;
+    }
+
+    // Compatibility mode
+    if (attributes.contains(XML_CHANNEL_ATTR_SOURCE)) {
+      source = attributes.namedItem(XML_CHANNEL_ATTR_SOURCE).nodeValue();
+      QRegExp re(CHANNEL_REGEX);
+      if (!re.exactMatch(source)) {
+        return;
+      }
+      channelTypes[channelIndex] = channelTypeFromString(re.cap(1));
+      channelTextures[channelIndex] = ("preset://" + re.cap(1) + "/" + re.cap(2));
+      return;
+    }
+
+    if (attributes.contains(XML_CHANNEL_ATTR_TYPE)) {
+      channelTypes[channelIndex] = channelTypeFromString(attributes.namedItem(XML_CHANNEL_ATTR_TYPE).nodeValue());
+      channelTextures[channelIndex] = child.firstChild().nodeValue();
+    }
+  }
+
   Shader loadShaderXml(QIODevice & ioDevice) {
     QDomDocument dom;
     Shader result;
@@ -167,37 +347,26 @@ namespace shadertoy {
       } if (child.nodeName() == XML_NAME) {
         result.name = child.firstChild().nodeValue();
       } else if (child.nodeName() == XML_CHANNEL) {
-        auto attributes = child.attributes();
-        int channelIndex = -1;
-        QString source;
-        if (attributes.contains(XML_CHANNEL_ATTR_ID)) {
-          channelIndex = attributes.namedItem(XML_CHANNEL_ATTR_ID).nodeValue().toInt();
-        }
-
-        if (channelIndex < 0 || channelIndex >= shadertoy::MAX_CHANNELS) {
+        readChannelXml(child, result.channelTypes, result.channelTextures);
+      } else if (child.nodeName() == XML_BUFFER) {
+        int buffer = bufferIndex(child.attributes().namedItem(XML_BUFFER_ATTR_ID).nodeValue());
+        if (buffer < 0) {
           continue;
         }
-
-
-        // Compatibility mode
-        if (attributes.contains(XML_CHANNEL_ATTR_SOURCE)) {
-          source = attributes.namedItem(XML_CHANNEL_ATTR_SOURCE).nodeValue();
-          QRegExp re(CHANNEL_REGEX);
-          if (!re.exactMatch(source)) {
-            continue;
+        BufferPass & bufferPass = result.buffers[buffer];
+        auto bufferChildren = child.childNodes();
+        for (int j = 0; j < bufferChildren.count(); ++j) {
+          auto bufferChild = bufferChildren.at(j);
+          if (bufferChild.nodeName() == XML_FRAGMENT_SOURCE) {
+            bufferPass.fragmentSource = bufferChild.firstChild().nodeValue();
+          } else if (bufferChild.nodeName() == XML_CHANNEL) {
+            readChannelXml(bufferChild, bufferPass.channelTypes, bufferPass.channelTextures);
           }
-          result.channelTypes[channelIndex] = channelTypeFromString(re.cap(1));
-          result.channelTextures[channelIndex] = ("preset://" + re.cap(1) + "/" + re.cap(2));
-          continue;
-        }
-
-        if (attributes.contains(XML_CHANNEL_ATTR_TYPE)) {
-          result.channelTypes[channelIndex] = channelTypeFromString(attributes.namedItem(XML_CHANNEL_ATTR_SOURCE).nodeValue());
-          result.channelTextures[channelIndex] = child.firstChild().nodeValue();
         }
       }
     }
     result.vrEnabled = result.fragmentSource.contains("#pragma vr");
+    result.upsample = parseUpsampleFactor(result.fragmentSource);
     return result;
   }
 
@@ -230,20 +399,52 @@ namespace shadertoy {
     return result;
   }
 
+  static const char * channelTypeToString(ChannelInputType channelType) {
+    switch (channelType) {
+    case ChannelInputType::CUBEMAP:
+      return "cube";
+    case ChannelInputType::VIDEO:
+      return "vid";
+    case ChannelInputType::AUDIO:
+      return "mus";
+    case ChannelInputType::BUFFER:
+      return "buf";
+    default:
+      return "tex";
+    }
+  }
+
+  static void writeChannelsXml(QDomDocument & document, QDomElement & parent,
+      const ChannelInputType * channelTypes, const QString * channelTextures) {
+    for (int i = 0; i < MAX_CHANNELS; ++i) {
+      if (!channelTextures[i].isEmpty()) {
+        QDomElement channelElement = document.createElement(XML_CHANNEL);
+        channelElement.setAttribute(XML_CHANNEL_ATTR_ID, i);
+        channelElement.setAttribute(XML_CHANNEL_ATTR_TYPE, channelTypeToString(channelTypes[i]));
+        channelElement.appendChild(document.createTextNode(channelTextures[i]));
+        parent.appendChild(channelElement);
+      }
+    }
+  }
+
   // FIXME no error handling.
   QDomDocument writeShaderXml(const Shader & shader) {
     QDomDocument result;
     QDomElement root = result.createElement(XML_ROOT_NAME);
     result.appendChild(root);
 
-    for (int i = 0; i < MAX_CHANNELS; ++i) {
-      if (!shader.channelTextures[i].isEmpty()) {
-        QDomElement channelElement = result.createElement(XML_CHANNEL);
-        channelElement.setAttribute(XML_CHANNEL_ATTR_ID, i);
-        channelElement.setAttribute(XML_CHANNEL_ATTR_TYPE, shader.channelTypes[i] == ChannelInputType::CUBEMAP ? "cube" : "tex");
-        channelElement.appendChild(result.createTextNode(shader.channelTextures[i]));
-        root.appendChild(channelElement);
+    writeChannelsXml(result, root, shader.channelTypes, shader.channelTextures);
+    for (int i = 0; i < MAX_BUFFERS; ++i) {
+      const BufferPass & bufferPass = shader.buffers[i];
+      if (!bufferPass.isEnabled()) {
+        continue;
       }
+      QDomElement bufferElement = result.createElement(XML_BUFFER);
+      bufferElement.setAttribute(XML_BUFFER_ATTR_ID, bufferName(i));
+      writeChannelsXml(result, bufferElement, bufferPass.channelTypes, bufferPass.channelTextures);
+      bufferElement.appendChild(result.createElement(XML_FRAGMENT_SOURCE)).
+        appendChild(result.createCDATASection(bufferPass.fragmentSource));
+      root.appendChild(bufferElement);
     }
     root.appendChild(result.createElement(XML_FRAGMENT_SOURCE)).
       appendChild(result.createCDATASection(shader.fragmentSource));
@@ -21,14 +21,18 @@ limitations under the License.
 
 namespace shadertoy {
   static const int MAX_CHANNELS = 4;
+  // Buffer A to D
+  static const int MAX_BUFFERS = 4;
 
   enum class ChannelInputType {
-    TEXTURE, CUBEMAP, AUDIO, VIDEO,
+    // The texture source of a BUFFER channel is the buffer's letter
+    TEXTURE, CUBEMAP, AUDIO, VIDEO, BUFFER,
   };
 
   extern const char * UNIFORM_RESOLUTION;
   extern const char * UNIFORM_GLOBALTIME;
   extern const char * UNIFORM_CHANNEL_TIME;
+  extern const char * UNIFORM_CHANNEL_TIMES[MAX_CHANNELS];
   extern const char * UNIFORM_CHANNEL_RESOLUTIONS[MAX_CHANNELS];
   extern const char * UNIFORM_CHANNEL_RESOLUTION;
   extern const char * UNIFORM_MOUSE_COORDS;
@@ -36,12 +40,28 @@ namespace shadertoy {
   extern const char * UNIFORM_SAMPLE_RATE;
   extern const char * UNIFORM_POSITION;
   extern const char * UNIFORM_CHANNELS[MAX_CHANNELS];
+  extern const char * UNIFORM_FRAME;
 
   extern const char * SHADER_HEADER;
   extern const char * LINE_NUMBER_HEADER;
 
   extern const QStringList TEXTURES;
   extern const QStringList CUBEMAPS;
+  extern const QStringList PRESETS;
+
+  // One of the Buffer A to D passes, which render into float targets that
+  // the image pass and the other buffers can read through BUFFER channels.
+  // A buffer that reads itself, or one that hasn't rendered yet this frame,
+  // sees the previous frame's output.
+  struct BufferPass {
+    QString fragmentSource;
+    ChannelInputType channelTypes[MAX_CHANNELS];
+    QString channelTextures[MAX_CHANNELS];
+
+    bool isEnabled() const {
+      return !fragmentSource.isEmpty();
+    }
+  };
 
   struct Shader {
     QString id;
@@ -49,10 +69,26 @@ namespace shadertoy {
     QString name;
     QString fragmentSource;
     bool vrEnabled{ false };
+    // Opt in to rendering at 1/upsample resolution and reconstructing the
+    // full resolution image over several frames, with "#pragma upsample 2"
+    int upsample{ 1 };
     ChannelInputType channelTypes[MAX_CHANNELS];
     QString channelTextures[MAX_CHANNELS];
+    BufferPass buffers[MAX_BUFFERS];
   };
 
+  // "A" to "D"
+  QString bufferName(int buffer);
+  // The buffer a BUFFER channel's texture source refers to, or -1
+  int bufferIndex(const QString & source);
+  // Reads the upsample factor from a fragment source, 1 if not present
+  int parseUpsampleFactor(const QString & fragmentSource);
+  // True if a buffer pass is marked "#pragma view_independent", meaning it
+  // can be rendered once per frame for both eyes
+  bool parseViewIndependent(const QString & fragmentSource);
+  // How many display frames each update of a buffer pass lasts, from
+  // "#pragma update_divisor N", 1 if not present
+  int parseUpdateDivisor(const QString & fragmentSource);
   Shader loadShaderFile(const QString & shaderPath);
   void saveShaderXml(const QString & shaderPath, const Shader & shader);
 }
@@ -0,0 +1,151 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "QtCommon.h"
+#include "TemporalUpsampler.h"
+
+using namespace oglplus;
+
+void TemporalUpsampler::setup() {
+    try {
+        VertexShader vs;
+        vs.Source(readFileToString(":/shaders/upsample.vs").toLocal8Bit().constData());
+        vs.Compile();
+        FragmentShader fs;
+        fs.Source(readFileToString(":/shaders/upsample.fs").toLocal8Bit().constData());
+        fs.Compile();
+        program = ProgramPtr(new Program());
+        program->AttachShader(vs);
+        program->AttachShader(fs);
+        program->Link();
+        quad = oria::loadPlane(program, 1.0f);
+    } catch (ProgramBuildError & err) {
+        qWarning() << "Unable to build the upsampling shader: " << err.Log().c_str();
+        program.reset();
+    }
+}
+
+void TemporalUpsampler::release() {
+    for (int i = 0; i < MAX_EYES; ++i) {
+        eyes[i] = EyeState();
+    }
+    lowRes.reset();
+    quad.reset();
+    program.reset();
+    allocatedFactor = 0;
+}
+
+void TemporalUpsampler::reset() {
+    for (int i = 0; i < MAX_EYES; ++i) {
+        eyes[i].valid = false;
+    }
+}
+
+void TemporalUpsampler::allocate(const uvec2 & textureSize, int factor) {
+    if (textureSize == allocatedSize && factor == allocatedFactor) {
+        return;
+    }
+    allocatedSize = textureSize;
+    allocatedFactor = factor;
+    lowRes = FramebufferWrapperPtr(new FramebufferWrapper());
+    lowRes->init(glm::max(uvec2(1), textureSize / uvec2(factor)));
+    for (int i = 0; i < MAX_EYES; ++i) {
+        EyeState & eye = eyes[i];
+        for (int j = 0; j < 2; ++j) {
+            eye.history[j] = FramebufferWrapperPtr(new FramebufferWrapper());
+            eye.history[j]->init(textureSize);
+        }
+        eye.valid = false;
+    }
+}
+
+void TemporalUpsampler::render(int eye, const uvec2 & textureSize, const uvec2 & renderSize, int factor,
+    std::function<void(const uvec2 &)> renderScene) {
+    assert(eye >= 0 && eye < MAX_EYES);
+    allocate(textureSize, factor);
+    EyeState & state = eyes[eye];
+    if (state.renderSize != renderSize) {
+        state.renderSize = renderSize;
+        state.valid = false;
+    }
+
+    MatrixStack & mv = Stacks::modelview();
+    MatrixStack & pr = Stacks::projection();
+    // The shadertoy renderer drops the translation, so only the rotation
+    // matters for reprojection
+    mat4 view = mv.top();
+    view[3] = vec4(0, 0, 0, 1);
+    mat4 viewProjection = pr.top() * view;
+
+    // Walk the sub-pixel grid along diagonals, so consecutive frames sample
+    // well separated positions
+    uint32_t sample = state.frame++ % (factor * factor);
+    uvec2 cell(sample % factor, (sample / factor + sample % factor) % factor);
+    vec2 jitter = (vec2(cell) + 0.5f) / (float)factor - 0.5f;
+
+    uvec2 lowSize = glm::max(uvec2(1), renderSize / uvec2(factor));
+    lowRes->Bound([&] {
+        oria::viewport(lowSize);
+        pr.withPush([&] {
+            pr.preMultiply(glm::translate(mat4(), vec3(2.0f * jitter / vec2(lowSize), 0)));
+            renderScene(lowSize);
+        });
+    });
+
+    FramebufferWrapperPtr & previous = state.history[state.current];
+    FramebufferWrapperPtr & target = state.history[1 - state.current];
+    mat4 reprojection = state.viewProjection * glm::inverse(viewProjection);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    Context::Disable(Capability::Blend);
+    target->Bound([&] {
+        oria::viewport(renderSize);
+        Texture::Active(1);
+        previous->BindColor();
+        Texture::Active(0);
+        lowRes->BindColor();
+        Stacks::withIdentity([&] {
+            oria::renderGeometry(quad, program, LambdaList({ [&] {
+                Uniform<GLint>(*program, "Current").Set(0);
+                Uniform<GLint>(*program, "History").Set(1);
+                Uniform<vec2>(*program, "RenderSize").Set(vec2(renderSize));
+                Uniform<vec2>(*program, "LowSize").Set(vec2(lowSize));
+                Uniform<vec2>(*program, "LowTextureSize").Set(vec2(lowRes->size));
+                Uniform<vec2>(*program, "HistoryTextureSize").Set(vec2(previous->size));
+                Uniform<vec2>(*program, "Jitter").Set(jitter);
+                Uniform<mat4>(*program, "Reprojection").Set(reprojection);
+                Uniform<GLint>(*program, "HistoryValid").Set(state.valid ? 1 : 0);
+            } }));
+        });
+        Texture::Active(1);
+        DefaultTexture().Bind(Texture::Target::_2D);
+        Texture::Active(0);
+    });
+    if (blend) {
+        Context::Enable(Capability::Blend);
+    }
+
+    state.current = 1 - state.current;
+    state.viewProjection = viewProjection;
+    state.valid = true;
+}
+
+void TemporalUpsampler::bindResult(int eye) {
+    assert(eye >= 0 && eye < MAX_EYES);
+    eyes[eye].history[eyes[eye].current]->BindColor();
+}
@@ -0,0 +1,82 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+// Renders a shadertoy effect at a fraction of the target resolution and
+// reconstructs the full resolution image over a number of frames.
+//
+// Each frame the low resolution render is offset by a different sub-pixel
+// jitter, so that over factor * factor frames every full resolution pixel
+// gets sampled.  The results are accumulated in a per-eye history buffer,
+// which is reprojected by the change in head orientation since the previous
+// frame.  The shadertoy skybox has no translation applied, so this
+// reprojection is exact for the scene, and only animation or position
+// changes need the neighbourhood clamp to stop ghosting.
+//
+// The jitter is applied to the projection, so only effects driven by iDir
+// (the VR enabled ones) benefit.  Effects that work from gl_FragCoord still
+// render at reduced resolution, and are just smoothed by the accumulation.
+class TemporalUpsampler {
+public:
+    static const int MAX_EYES = 2;
+
+    void setup();
+    void release();
+
+    bool isReady() const {
+        return (bool)program;
+    }
+
+    // Throws away the accumulated history, for instance because the shader changed
+    void reset();
+
+    // Renders the scene at renderSize / factor into a low resolution target
+    // and accumulates the result into the history for the given eye.  The
+    // scene lambda is called with the low resolution target bound, the
+    // viewport set and the projection jittered, and is passed the low
+    // resolution size.
+    //
+    // The result covers renderSize in a texture of textureSize, the same
+    // layout as rendering directly at texRes.
+    void render(int eye, const uvec2 & textureSize, const uvec2 & renderSize, int factor,
+        std::function<void(const uvec2 &)> renderScene);
+
+    // Binds the most recent result for the eye
+    void bindResult(int eye);
+
+private:
+    struct EyeState {
+        FramebufferWrapperPtr history[2];
+        int current{ 0 };
+        uint32_t frame{ 0 };
+        uvec2 renderSize;
+        mat4 viewProjection;
+        bool valid{ false };
+    };
+
+    EyeState eyes[MAX_EYES];
+    FramebufferWrapperPtr lowRes;
+    uvec2 allocatedSize;
+    int allocatedFactor{ 0 };
+    ProgramPtr program;
+    ShapeWrapperPtr quad;
+
+    void allocate(const uvec2 & textureSize, int factor);
+};
@@ -0,0 +1,241 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#include "QtCommon.h"
+#include "VideoChannel.h"
+
+using namespace oglplus;
+
+#ifdef HAVE_OPENCV
+
+VideoChannel::VideoChannel(const QString & path) : path(path) {
+    cv::VideoCapture probe;
+    if (!open(probe, 0)) {
+        qWarning() << "Unable to open video " << path;
+        return;
+    }
+    size = uvec2(probe.get(CV_CAP_PROP_FRAME_WIDTH), probe.get(CV_CAP_PROP_FRAME_HEIGHT));
+    double reportedFps = probe.get(CV_CAP_PROP_FPS);
+    // Some containers don't report a frame rate
+    if (reportedFps > 1.0) {
+        fps = reportedFps;
+    }
+    probe.release();
+
+    texture = oria::createTexture();
+    Context::Bound(TextureTarget::_2D, *texture)
+        .MagFilter(TextureMagFilter::Linear)
+        .MinFilter(TextureMinFilter::Linear)
+        .WrapS(TextureWrap::ClampToEdge)
+        .WrapT(TextureWrap::ClampToEdge);
+    // Allocated once, every frame after this is a sub-image update
+    Texture::Storage2D(TextureTarget::_2D, 1, PixelDataInternalFormat::RGBA8, size.x, size.y);
+    GpuMemory::textureAllocated(*texture, GL_RGBA8, size);
+    DefaultTexture().Bind(TextureTarget::_2D);
+
+    glGenBuffers(PBO_COUNT, pbos);
+    for (size_t i = 0; i < PBO_COUNT; ++i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size.x * size.y * 4, nullptr, GL_STREAM_DRAW);
+        GpuMemory::allocated(GpuMemory::BUFFER, pbos[i], size.x * size.y * 4);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    valid = true;
+    thread = std::thread([&] {
+        run();
+    });
+}
+
+VideoChannel::~VideoChannel() {
+    if (!valid) {
+        return;
+    }
+    quit = true;
+    condition.notify_all();
+    thread.join();
+    for (size_t i = 0; i < PBO_COUNT; ++i) {
+        GpuMemory::released(GpuMemory::BUFFER, pbos[i]);
+    }
+    glDeleteBuffers(PBO_COUNT, pbos);
+}
+
+bool VideoChannel::open(cv::VideoCapture & capture, size_t startFrame) {
+    if (!capture.open(path.toLocal8Bit().constData())) {
+        return false;
+    }
+    if (startFrame) {
+        capture.set(CV_CAP_PROP_POS_FRAMES, (double)startFrame);
+    }
+    return true;
+}
+
+bool VideoChannel::decode(cv::VideoCapture & capture, Frame & frame) {
+    PROFILE_SCOPE("Decode video frame");
+    cv::Mat raw;
+    if (!capture.read(raw) || raw.empty()) {
+        return false;
+    }
+    // The previous buffer may still be sitting in the queue, so always
+    // convert into a fresh one.  Converting to BGRA here means the render
+    // thread can hand the data straight to the driver in its native layout.
+    frame.image = cv::Mat();
+    cv::flip(raw, raw, 0);
+    cv::cvtColor(raw, frame.image, CV_BGR2BGRA);
+    return true;
+}
+
+void VideoChannel::push(Frame & frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&] {
+        return quit || queue.size() < QUEUE_SIZE;
+    });
+    if (!quit) {
+        queue.push_back(frame);
+    }
+}
+
+void VideoChannel::run() {
+    Profiler::setThreadName("Video decode");
+    std::unique_ptr<cv::VideoCapture> capture(new cv::VideoCapture());
+    std::unique_ptr<cv::VideoCapture> next(new cv::VideoCapture());
+    if (!open(*capture, 0)) {
+        return;
+    }
+
+    // Large videos only keep a few frames, rather than hundreds of megabytes
+    size_t frameBytes = std::max<size_t>(1, size.x * size.y * 4);
+    size_t loopHeadFrames = std::max(MIN_LOOP_HEAD_FRAMES, std::min(LOOP_HEAD_BYTES / frameBytes, LOOP_HEAD_FRAMES));
+
+    Frame frame;
+    size_t frameIndex = 0;
+    float loopOffset = 0;
+    while (!quit && loopHead.size() < loopHeadFrames && decode(*capture, frame)) {
+        frame.mediaTime = frame.playbackTime = frameIndex++ / fps;
+        loopHead.push_back(frame);
+        push(frame);
+    }
+
+    // Have a second decoder sitting just past the loop head, ready to take
+    // over when the first one runs off the end of the file.  If the whole
+    // video fits in the loop head there's no need for one.
+    if (loopHeadFrames == loopHead.size()) {
+        open(*next, loopHeadFrames);
+    }
+
+    while (!quit) {
+        if (decode(*capture, frame)) {
+            frame.mediaTime = frameIndex++ / fps;
+            frame.playbackTime = loopOffset + frame.mediaTime;
+            push(frame);
+            continue;
+        }
+
+        if (loopHead.empty()) {
+            qWarning() << "No decodable frames in " << path;
+            break;
+        }
+
+        // End of file.  Replay the already decoded start of the video, then
+        // continue with the decoder that was positioned past it.
+        loopOffset += frameIndex / fps;
+        for (size_t i = 0; i < loopHead.size() && !quit; ++i) {
+            Frame headFrame = loopHead[i];
+            headFrame.playbackTime = loopOffset + headFrame.mediaTime;
+            push(headFrame);
+        }
+        frameIndex = loopHead.size();
+        if (next->isOpened()) {
+            std::swap(capture, next);
+            // The queue is full of loop head frames at this point, so
+            // there's plenty of time to re-prime the spare decoder
+            next->release();
+            open(*next, loopHeadFrames);
+        }
+    }
+}
+
+void VideoChannel::upload(const cv::Mat & image) {
+    size_t bytes = image.total() * image.elemSize();
+    pboIndex = (pboIndex + 1) % PBO_COUNT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[pboIndex]);
+    // Invalidating the buffer lets the driver hand back fresh storage rather
+    // than waiting on a transfer from a previous frame that is still in flight
+    void * dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dest) {
+        memcpy(dest, image.data, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        texture->Bind(TextureTarget::_2D);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows,
+            GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        DefaultTexture().Bind(TextureTarget::_2D);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void VideoChannel::update() {
+    if (!valid) {
+        return;
+    }
+    PROFILE_SCOPE("Update video channel");
+
+    Frame due;
+    bool haveFrame = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (startTime < 0) {
+            // Don't start the clock until the first frame is ready
+            if (queue.empty()) {
+                return;
+            }
+            startTime = Platform::elapsedSeconds();
+        }
+        float now = Platform::elapsedSeconds() - startTime;
+        // If we've fallen behind, skip straight to the newest frame that's due
+        while (!queue.empty() && queue.front().playbackTime <= now) {
+            due = queue.front();
+            queue.pop_front();
+            haveFrame = true;
+        }
+    }
+
+    if (!haveFrame) {
+        return;
+    }
+    condition.notify_one();
+    currentTime = due.mediaTime;
+    uploadStats.time([&] {
+        upload(due.image);
+    });
+}
+
+#else
+
+VideoChannel::VideoChannel(const QString & path) {
+    qWarning() << "Video channels require OpenCV, unable to play " << path;
+}
+
+VideoChannel::~VideoChannel() {
+}
+
+void VideoChannel::update() {
+}
+
+#endif
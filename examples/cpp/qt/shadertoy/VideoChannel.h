@@ -0,0 +1,113 @@
+/************************************************************************************
+
+Authors     :   Bradley Austin Davis <bdavis@saintandreas.org>
+Copyright   :   Copyright Bradley Austin Davis. All Rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+************************************************************************************/
+
+#pragma once
+
+#include "MediaChannel.h"
+
+#ifdef HAVE_OPENCV
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#endif
+
+// Plays a video file into a texture for use as a shadertoy input channel.
+//
+// Decoding and color conversion happen on a worker thread, which keeps a
+// small queue of ready frames.  The render thread only picks the frame due
+// for the current playback time and streams it into a texture that is
+// allocated once, via a pair of pixel buffer objects, so the upload never
+// waits on the GPU.
+//
+// The first frames of the video are kept decoded in memory, so that when the
+// decoder hits the end of the file the loop can restart from those while a
+// second decoder, already positioned past them, takes over.
+class VideoChannel : public MediaChannel {
+public:
+    VideoChannel(const QString & path);
+    virtual ~VideoChannel();
+
+    virtual void update();
+
+    virtual bool isValid() const {
+        return valid;
+    }
+
+    virtual TexturePtr getTexture() const {
+        return texture;
+    }
+
+    // The resolution of the video, in pixels
+    virtual vec3 getResolution() const {
+        return vec3(size, 1);
+    }
+
+    // The media time of the currently displayed frame
+    virtual float getTime() const {
+        return currentTime;
+    }
+
+    // Render thread cost of getting decoded frames into the texture
+    const TimingStats & getUploadStats() const {
+        return uploadStats;
+    }
+
+private:
+    static const size_t QUEUE_SIZE = 8;
+    // The decoded start of the video is kept for looping, up to this many
+    // frames or bytes, whichever is fewer, but never less than the minimum
+    static const size_t LOOP_HEAD_FRAMES = 30;
+    static const size_t LOOP_HEAD_BYTES = 64 * 1024 * 1024;
+    static const size_t MIN_LOOP_HEAD_FRAMES = 4;
+    static const size_t PBO_COUNT = 2;
+
+    bool valid{ false };
+    uvec2 size;
+    float currentTime{ 0 };
+    float startTime{ -1 };
+    TexturePtr texture;
+    GLuint pbos[PBO_COUNT];
+    size_t pboIndex{ 0 };
+    TimingStats uploadStats;
+
+#ifdef HAVE_OPENCV
+    struct Frame {
+        cv::Mat image;
+        // Position of the frame within the video
+        float mediaTime{ 0 };
+        // Position of the frame within the overall playback, which keeps
+        // increasing as the video loops
+        float playbackTime{ 0 };
+    };
+
+    QString path;
+    double fps{ 30 };
+    std::vector<Frame> loopHead;
+    std::deque<Frame> queue;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread thread;
+    std::atomic<bool> quit{ false };
+
+    bool open(cv::VideoCapture & capture, size_t startFrame);
+    bool decode(cv::VideoCapture & capture, Frame & frame);
+    void push(Frame & frame);
+    void run();
+    void upload(const cv::Mat & image);
+#endif
+};
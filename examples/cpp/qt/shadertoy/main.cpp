@@ -31,7 +31,7 @@ MAIN_DECL {
 #endif
 
     QT_APP_WITH_ARGS(ShadertoyApp);
-    int result = app.exec();
+    int result = app.run();
     app.destroyWindow();
 
     ovr_Shutdown();
@@ -0,0 +1,79 @@
+#version 330
+
+// Reconstructs a full resolution frame from a jittered low resolution render
+// and the previous full resolution frame
+
+// The low resolution, jittered render of the current frame
+uniform sampler2D Current;
+// The previous full resolution result
+uniform sampler2D History;
+
+// Size of the region being rendered in the full and low resolution targets
+uniform vec2 RenderSize;
+uniform vec2 LowSize;
+// Allocated size of the low resolution and history textures
+uniform vec2 LowTextureSize;
+uniform vec2 HistoryTextureSize;
+// How far this frame's projection was shifted, in low resolution pixels.
+// The content moves by the jitter, so each texel's sample is taken at its
+// centre minus the jitter.
+uniform vec2 Jitter;
+// Maps this frame's clip space to the previous frame's, for the eye rotation
+uniform mat4 Reprojection;
+uniform bool HistoryValid;
+
+// How much of a pixel comes from the current frame when one of this frame's
+// samples landed inside it, and when it's only covered by an upsampled value
+uniform float SampledAlpha = 0.5;
+uniform float UpsampledAlpha = 0.05;
+
+out vec4 FragColor;
+
+vec4 fetchCurrent(ivec2 texel) {
+  return texelFetch(Current, clamp(texel, ivec2(0), ivec2(LowSize) - 1), 0);
+}
+
+void main() {
+  vec2 uv = gl_FragCoord.xy / RenderSize;
+  vec2 lowCoord = uv * LowSize;
+  ivec2 texel = ivec2(floor(lowCoord));
+
+  // The upsampled current frame, with the jitter taken back out
+  vec4 upsampled = texture(Current, (lowCoord + Jitter) / LowTextureSize);
+  if (!HistoryValid) {
+    FragColor = upsampled;
+    return;
+  }
+
+  // Where the nearest sample of this frame actually landed, in full
+  // resolution pixels relative to this one
+  vec2 sampleOffset = ((vec2(texel) + 0.5 - Jitter) / LowSize - uv) * RenderSize;
+  bool sampled = all(lessThan(abs(sampleOffset), vec2(0.5)));
+
+  vec4 minColor = vec4(1e9);
+  vec4 maxColor = vec4(-1e9);
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      vec4 neighbour = fetchCurrent(texel + ivec2(x, y));
+      minColor = min(minColor, neighbour);
+      maxColor = max(maxColor, neighbour);
+    }
+  }
+
+  vec4 previous = Reprojection * vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+  vec2 previousUv = (previous.xy / previous.w) * 0.5 + 0.5;
+  if (any(lessThan(previousUv, vec2(0))) || any(greaterThan(previousUv, vec2(1)))) {
+    FragColor = sampled ? fetchCurrent(texel) : upsampled;
+    return;
+  }
+
+  // Clamping the history to the range of what's around this pixel now
+  // keeps disoccluded and changing content from leaving trails
+  vec4 history = texture(History, previousUv * RenderSize / HistoryTextureSize);
+  history = clamp(history, minColor, maxColor);
+  if (sampled) {
+    FragColor = mix(history, fetchCurrent(texel), SampledAlpha);
+  } else {
+    FragColor = mix(history, upsampled, UpsampledAlpha);
+  }
+}
@@ -0,0 +1,11 @@
+#version 330
+
+// The shader output, with mipmaps
+uniform sampler2D sampler;
+
+in vec2 vTexCoord;
+out vec4 FragColor;
+
+void main() {
+  FragColor = texture(sampler, vTexCoord);
+}
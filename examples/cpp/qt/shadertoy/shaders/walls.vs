@@ -0,0 +1,16 @@
+#version 330
+
+uniform mat4 Projection = mat4(1);
+uniform mat4 ModelView = mat4(1);
+// The transform of each visible wall, indexed by instance
+uniform mat4 Walls[4];
+
+layout(location = 0) in vec3 Position;
+layout(location = 1) in vec2 TexCoord;
+
+out vec2 vTexCoord;
+
+void main() {
+  vTexCoord = TexCoord;
+  gl_Position = Projection * ModelView * Walls[gl_InstanceID] * vec4(Position, 1);
+}
@@ -47,11 +47,6 @@ static float UI_INVERSE_ASPECT = 1.0f / UI_ASPECT;
 class MainWindow : public QRiftWindow {
     Q_OBJECT
     using AtomicGlTexture = std::atomic<GLuint>;
-    using SyncPair = std::pair<GLuint, GLsync>;
-    using TextureTrashcan = std::queue<SyncPair>;
-    using TextureDeleteQueue = std::vector<GLuint>;
-    using Mutex = std::mutex;
-    using Lock = std::unique_lock<Mutex>;
     // A cache of all the input textures available 
     QDir configPath;
     QSettings settings;
@@ -85,10 +80,10 @@ class MainWindow : public QRiftWindow {
 
     // A wrapper for passing the UI texture from the app to the widget
     AtomicGlTexture uiTexture{ 0 };
-    TextureTrashcan textureTrash;
-    TextureDeleteQueue textureDeleteQueue;
-    Mutex textureLock;
-    QTimer timer;
+    // The UI texture being drawn, and the fence for its most recent draw,
+    // which goes back to the UI with the texture
+    GLuint lastUiTexture{ 0 };
+    GLsync lastUiSync{ 0 };
 
     // GLSL and geometry for the UI
     ProgramPtr uiProgram;
@@ -126,15 +121,12 @@ public:
         // render thread and the UI thread, triggered when Rift swapbuffers overlaps 
         // with the UI thread binding a new FBO (specifically, generating a texture 
         // for the FBO.  
-        // Perhaps I should just create N FBOs and have the UI object iterate over them
         {
             QString configLocation = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
             configPath = QDir(configLocation);
             configPath.mkpath("shaders");
         }
 
-        connect(&timer, &QTimer::timeout, this, &MainWindow::onTimer);
-        timer.start(100);
         setupOffscreenUi();
         Platform::addShutdownHook([&] {
             vrFramebuffer.reset();
@@ -146,6 +138,10 @@ public:
             uiFramebuffer.reset();
             planeProgram.reset();
             plane.reset();
+            if (lastUiSync) {
+                glDeleteSync(lastUiSync);
+                lastUiSync = 0;
+            }
         });
     }
 
@@ -311,24 +307,6 @@ private slots:
         QApplication::instance()->quit();
     }
 
-    void onTimer() {
-        TextureDeleteQueue tempTextureDeleteQueue;
-
-        // Scope the lock tightly
-        {
-            Lock lock(textureLock);
-            if (!textureDeleteQueue.empty()) {
-                tempTextureDeleteQueue.swap(textureDeleteQueue);
-            }
-        }
-
-        if (!tempTextureDeleteQueue.empty()) {
-            std::for_each(tempTextureDeleteQueue.begin(), tempTextureDeleteQueue.end(), [&](int usedTexture) {
-                uiWindow->releaseTexture(usedTexture);
-            });
-        }
-    }
-
 private:
 
     ///////////////////////////////////////////////////////
@@ -383,16 +361,15 @@ private:
         Context::Disable(Capability::DepthTest);
         Context::Disable(Capability::CullFace);
         if (uiVisible) {
-            static GLuint lastUiTexture = 0;
-            static GLsync lastUiSync;
             GLuint currentUiTexture = uiTexture.exchange(0);
             if (0 == currentUiTexture) {
                 currentUiTexture = lastUiTexture;
             } else {
-                // If the texture has changed, push it into the trash bin for
-                // deletion once it's finished rendering
+                // If the texture has changed, hand the old one back to the
+                // UI, which waits on the fence before rendering into it again
                 if (lastUiTexture) {
-                    textureTrash.push(SyncPair(lastUiTexture, lastUiSync));
+                    uiWindow->returnTexture(lastUiTexture, lastUiSync);
+                    lastUiSync = 0;
                 }
                 lastUiTexture = currentUiTexture;
             }
@@ -417,29 +394,13 @@ private:
                         oria::renderGeometry(mouseShape, uiProgram);
                     });
                 });
+                // Only the latest draw matters, since it's after the earlier ones
+                if (lastUiSync) {
+                    glDeleteSync(lastUiSync);
+                }
                 lastUiSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
             }
         }
-
-        TextureDeleteQueue tempTextureDeleteQueue;
-        while (!textureTrash.empty()) {
-            SyncPair & top = textureTrash.front();
-            GLuint & texture = top.first;
-            GLsync & sync = top.second;
-            GLenum result = glClientWaitSync(sync, 0, 0);
-            if (GL_ALREADY_SIGNALED == result || GL_CONDITION_SATISFIED == result) {
-                tempTextureDeleteQueue.push_back(texture);
-                textureTrash.pop();
-            } else {
-                break;
-            }
-        }
-
-        if (!tempTextureDeleteQueue.empty()) {
-            Lock lock(textureLock);
-            textureDeleteQueue.insert(textureDeleteQueue.end(),
-                tempTextureDeleteQueue.begin(), tempTextureDeleteQueue.end());
-        }
     }
 
     void perEyeRender() {